@@ -68,6 +68,123 @@ in vec2 vtx_texcoord[8];
 out vec4 col0;
 out vec4 col1;
 
+#ifdef _DEF_GENERIC
+// Generic shader, used while the shader for the current state compiles. Everything that is a
+// define above comes from ShaderManager::GenericState instead
+
+struct GenericStage {
+    ivec4 color_sel;    // a, b, c, d
+    ivec4 alpha_sel;    // a, b, c, d
+    ivec4 dest;         // color dest, alpha dest, color clamp, alpha clamp
+    ivec4 texture;      // texmap (-1 if disabled), texcoord, ras color
+};
+
+struct GenericChannel {
+    ivec4 source;
+    ivec4 lighting;
+};
+
+layout(std140) uniform _GENERIC_UBO {
+    GenericStage gen_stages[16];
+    GenericChannel gen_channels[2];
+    ivec4 gen_fragment;     // last stage, alpha compare 0, alpha compare 1, compare logic
+    ivec4 gen_output;       // efb format, destination alpha, final color dest, final alpha dest
+    ivec4 gen_vertex;
+};
+
+vec4 GenericTexture(int texmap, int texcoord) {
+    vec2 coord = vtx_texcoord[texcoord];
+    
+    // Samplers can only be indexed by constants
+    switch (texmap) {
+    case 0: return texture2D(texture[0], coord);
+    case 1: return texture2D(texture[1], coord);
+    case 2: return texture2D(texture[2], coord);
+    case 3: return texture2D(texture[3], coord);
+    case 4: return texture2D(texture[4], coord);
+    case 5: return texture2D(texture[5], coord);
+    case 6: return texture2D(texture[6], coord);
+    default: return texture2D(texture[7], coord);
+    }
+}
+
+vec4 GenericRasColor(int sel) {
+    switch (sel) {
+    case 1: return vtx_color[1];
+    case 7: return vec4(0.0f, 0.0f, 0.0f, 0.0f);
+    default: return vtx_color[0];
+    }
+}
+
+vec3 GenericColorInput(int sel, vec4 regs[4], vec4 tex, vec4 ras, vec4 konst) {
+    switch (sel) {
+    case 0: return regs[0].rgb;
+    case 1: return regs[0].aaa;
+    case 2: return regs[1].rgb;
+    case 3: return regs[1].aaa;
+    case 4: return regs[2].rgb;
+    case 5: return regs[2].aaa;
+    case 6: return regs[3].rgb;
+    case 7: return regs[3].aaa;
+    case 8: return tex.rgb;
+    case 9: return tex.aaa;
+    case 10: return ras.rgb;
+    case 11: return ras.aaa;
+    case 12: return vec3(1.0f, 1.0f, 1.0f);
+    case 13: return vec3(0.5f, 0.5f, 0.5f);
+    case 14: return konst.rgb;
+    default: return vec3(0.0f, 0.0f, 0.0f);
+    }
+}
+
+float GenericAlphaInput(int sel, vec4 regs[4], vec4 tex, vec4 ras, vec4 konst) {
+    switch (sel) {
+    case 0: return regs[0].a;
+    case 1: return regs[1].a;
+    case 2: return regs[2].a;
+    case 3: return regs[3].a;
+    case 4: return tex.a;
+    case 5: return ras.a;
+    case 6: return konst.a;
+    default: return 0.0f;
+    }
+}
+
+bool GenericCompare(int comp, int val, int ref) {
+    switch (comp) {
+    case 0: return false;
+    case 1: return val < ref;
+    case 2: return val == ref;
+    case 3: return val <= ref;
+    case 4: return val > ref;
+    case 5: return val != ref;
+    case 6: return val >= ref;
+    default: return true;
+    }
+}
+
+bool GenericAlphaCompare(int val) {
+    bool res0 = GenericCompare(gen_fragment.y, val, tev_state.alpha_func_ref0);
+    bool res1 = GenericCompare(gen_fragment.z, val, tev_state.alpha_func_ref1);
+    
+    switch (gen_fragment.w) {
+    case 0: return res0 && res1;
+    case 1: return res0 || res1;
+    case 2: return res0 != res1;
+    default: return res0 == res1;
+    }
+}
+
+vec4 GenericEFBFormat(vec4 val) {
+    switch (gen_output.x) {
+    case 0: return vec4((round(val.rgb * 255.0f) / 255.0f), 1.0f);
+    case 1: return FIX_U6(val);
+    case 2: return vec4(FIX_U5(val.r), FIX_U6(val.g), FIX_U5(val.b), 1.0f);
+    default: return vec4(val.rgb, 1.0f);
+    }
+}
+#endif // _DEF_GENERIC
+
 void main() {
     float alpha; 
     TevStage stage;
@@ -86,6 +203,41 @@ void main() {
     vec4 reg_d;
     vec4 scale;
     
+#ifdef _DEF_GENERIC
+    vec4 regs[4] = vec4[4](prev, color0, color1, color2);
+    
+    for (int s = 0; s <= gen_fragment.x; s++) {
+        GenericStage gen = gen_stages[s];
+        
+        tex = (gen.texture.x < 0) ? vec4(1.0f, 1.0f, 1.0f, 1.0f) : 
+            GenericTexture(gen.texture.x, gen.texture.y);
+        stage = tev_stages[s];
+        konst = stage.konst;
+        ras = GenericRasColor(gen.texture.z);
+        scale = vec4(stage.color_scale, stage.color_scale, stage.color_scale, 1.0);
+        
+        reg_a = FIX_U8(vec4(GenericColorInput(gen.color_sel.x, regs, tex, ras, konst), 
+            GenericAlphaInput(gen.alpha_sel.x, regs, tex, ras, konst)));
+        reg_b = FIX_U8(vec4(GenericColorInput(gen.color_sel.y, regs, tex, ras, konst), 
+            GenericAlphaInput(gen.alpha_sel.y, regs, tex, ras, konst)));
+        reg_c = FIX_U8(vec4(GenericColorInput(gen.color_sel.z, regs, tex, ras, konst), 
+            GenericAlphaInput(gen.alpha_sel.z, regs, tex, ras, konst)));
+        reg_d = vec4(GenericColorInput(gen.color_sel.w, regs, tex, ras, konst), 
+            GenericAlphaInput(gen.alpha_sel.w, regs, tex, ras, konst));
+        
+        stage_result = scale * (reg_d + 
+            (vec4(stage.color_sub, stage.color_sub, stage.color_sub, stage.alpha_sub) * 
+            (mix(reg_a, reg_b, reg_c) + 
+            vec4(stage.color_bias, stage.color_bias, stage.color_bias, stage.alpha_bias))));
+        
+        regs[gen.dest.x].rgb = (gen.dest.z != 0) ? clamp(stage_result.rgb, 0.0, 1.0) : 
+            stage_result.rgb;
+        regs[gen.dest.y].a = (gen.dest.w != 0) ? clamp(stage_result.a, 0.0, 1.0) : 
+            stage_result.a;
+    }
+    prev = fract(vec4(regs[gen_output.z].rgb, regs[gen_output.w].a) * 255.0f/256.0f) * 
+        256.0f/255.0f;
+#else
     STAGE_RESULT(0);
 #if _DEF_NUM_STAGES > 0
     STAGE_RESULT(1);
@@ -133,6 +285,7 @@ void main() {
     STAGE_RESULT(15);
 #endif
     prev = fract(_DEF_STAGE_DEST * 255.0f/256.0f) * 256.0f/255.0f;
+#endif // _DEF_GENERIC
     col0 = prev;
     col1 = prev;
     
@@ -140,6 +293,15 @@ void main() {
     // -------------
 
     int val = int(prev.a * 255.0f) & 0xFF;                                   
+#ifdef _DEF_GENERIC
+    if (!GenericAlphaCompare(val)) {
+        discard;
+    }
+    if (gen_output.y != 0) {
+        col0.a = tev_state.dest_alpha;
+    }
+    col0 = GenericEFBFormat(col0);
+#else
     if (_DEF_ALPHA_COMPARE(val, tev_state.alpha_func_ref0, tev_state.alpha_func_ref1)) {
         discard;
     }
@@ -147,4 +309,5 @@ void main() {
     col0.a = tev_state.dest_alpha;
 #endif
     col0 = _DEF_EFB_FORMAT(col0);
+#endif // _DEF_GENERIC
 }
\ No newline at end of file
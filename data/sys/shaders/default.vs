@@ -276,6 +276,104 @@ out vec2 vtx_texcoord[8];
     xf_normal_mem[addr].z, xf_normal_mem[addr + 1].z, xf_normal_mem[addr + 2].z, 0.0, \
     xf_normal_mem[addr].w, xf_normal_mem[addr + 1].w, xf_normal_mem[addr + 2].w, 1.0)
 
+#ifdef _DEF_GENERIC
+// Generic shader, used while the shader for the current state compiles. Everything that is a
+// define above comes from ShaderManager::GenericState instead
+
+struct GenericStage {
+    ivec4 color_sel;
+    ivec4 alpha_sel;
+    ivec4 dest;
+    ivec4 texture;
+};
+
+struct GenericChannel {
+    ivec4 source;       // material color, material alpha, ambient color, ambient alpha source
+    ivec4 lighting;     // color light mask, alpha light mask, color function, alpha function
+};
+
+layout(std140) uniform _GENERIC_UBO {
+    GenericStage gen_stages[16];
+    GenericChannel gen_channels[2];
+    ivec4 gen_fragment;
+    ivec4 gen_output;
+    ivec4 gen_vertex;   // flags, color 0 format (-1 if absent), color 1 format, num color channels
+};
+
+vec2 GenericTexCoord(int addr, vec4 texcoord, float dqf) {
+    return vec4(XF_MTX44(addr) * vec4(texcoord.st * dqf, 0.0f, 1.0f)).st;
+}
+
+vec4 GenericVertexColor(int format, vec4 color) {
+    switch (format) {
+    case 0: // RGB565
+        return vec4(float(int(color[1]) >> 3) / 31.0f,
+            float(((int(color[1]) & 0x7) << 3) | (int(color[0]) >> 5)) / 63.0f,
+            float(int(color[0]) & 0x1F) / 31.0f, 1.0f);
+    case 1: // RGB8
+        return vec4(clamp((color.rgb / 255.0f), 0.0, 1.0), 1.0);
+    case 3: // RGBA4
+        return vec4(float(int(color[1]) >> 4) / 15.0f, float(int(color[1]) & 0xF) / 15.0f,
+            float(int(color[0]) >> 4) / 15.0f, float(int(color[0]) & 0xF) / 15.0f);
+    case 4: // RGBA6
+        return vec4(float(int(color[0]) >> 2) / 63.0f,
+            float(((int(color[0]) & 0x3) << 4) | (int(color[1]) >> 4)) / 63.0f,
+            float(((int(color[1]) & 0xF) << 2) | (int(color[2]) >> 6)) / 63.0f,
+            float(int(color[2]) & 0x3F) / 63.0f);
+    case 5: // RGBA8
+        return clamp((color.abgr / 255.0f), 0.0, 1.0);
+    default:
+        return vec4(1.0, 1.0, 1.0, 1.0);
+    }
+}
+
+// Material or ambient color source, see ShaderManager::GenericSource
+vec4 GenericSource(int source, vec4 col[2], vec4 reg) {
+    switch (source) {
+    case 0: return vec4(0.0f, 0.0f, 0.0f, 0.0f);
+    case 1: return vec4(1.0f, 1.0f, 1.0f, 1.0f);
+    case 2: return reg;
+    case 3: return col[0];
+    default: return col[1];
+    }
+}
+
+// Light intensity, func is the attenuation function | diffuse function << 2
+float GenericLight(int light, int func, vec3 pos, vec3 nrm) {
+    int attn_func = func & 3;
+    int diffuse_func = func >> 2;
+    float atten = 1.0f;
+    float intensity;
+
+    // Simple diffuse lighting
+    if ((attn_func & 1) == 0) {
+        intensity = dot(normalize(state.light[light].pos.xyz - pos), nrm);
+    // Specular lighting
+    } else if (attn_func == 1) {
+        atten = (dot(nrm, normalize(state.light[light].pos.xyz)) >= 0.0f) ? 
+            max(0.0f, dot(nrm, state.light[light].dir.xyz)) : 0.0f;
+        atten = max(0.0f, dot(state.light[light].cos_atten.xyz, vec3(1, atten, atten * atten))) / 
+            dot(state.light[light].dist_atten.xyz, vec3(1, atten, atten * atten));
+        intensity = atten * dot(normalize(state.light[light].pos.xyz), nrm);
+    // Spot lighting
+    } else {
+        vec3 l_dir = state.light[light].pos.xyz - pos;
+        float l_dist = sqrt(dot(l_dir, l_dir));
+        l_dir = l_dir / l_dist;
+        atten = max(0.0f, dot(l_dir, state.light[light].dir.xyz));
+        atten = max(0.0f, dot(state.light[light].cos_atten.xyz, 
+            vec3(1.0f, atten, atten * atten))) / 
+            dot(state.light[light].dist_atten.xyz, vec3(1.0f, l_dist, l_dist * l_dist));
+        intensity = atten * dot(l_dir, nrm);
+    }
+    switch (diffuse_func) {
+    case 0: return atten;
+    case 1: return intensity;
+    default: return max(intensity, 0.0f);
+    }
+}
+#endif // _DEF_GENERIC
+
 void main() {
     vec4    pos;
     vec4    nrm;
@@ -295,6 +393,15 @@ void main() {
 #ifdef _DEF_POS_DQF // Position shift (dequantization factor) only U8/S8/U16/S16 formats
     pos_dqf = state.cp_pos_dqf;
 #endif
+
+#ifdef _DEF_GENERIC
+    if ((gen_vertex.x & 0x001) != 0) {
+        pos_nrm_index = int(matrix_idx_pos[0]);
+    }
+    if ((gen_vertex.x & 0x400) != 0) {
+        pos_dqf = state.cp_pos_dqf;
+    }
+#endif
     
     pos = XF_MTX44(pos_nrm_index) * vec4(position.xyz * pos_dqf, 1.0);
     pos_nrm_index &= 0x1F; // Normal matrix is only 32 entries
@@ -356,6 +463,33 @@ void main() {
     vtx_texcoord[7] = vec4(XF_MTX44(state.cp_tex_matrix_offset[1][3]) * 
         vec4(texcoord7.st * state.cp_tex_dqf[1][3], 0.0f, 1.0f)).st;
 #endif
+
+#ifdef _DEF_GENERIC // Matrix indexed texture coords
+    if ((gen_vertex.x & 0x002) != 0) {
+        vtx_texcoord[0] = GenericTexCoord(int(matrix_idx_tex03[0]), texcoord0, state.cp_tex_dqf[0][0]);
+    }
+    if ((gen_vertex.x & 0x004) != 0) {
+        vtx_texcoord[1] = GenericTexCoord(int(matrix_idx_tex03[1]), texcoord1, state.cp_tex_dqf[0][1]);
+    }
+    if ((gen_vertex.x & 0x008) != 0) {
+        vtx_texcoord[2] = GenericTexCoord(int(matrix_idx_tex03[2]), texcoord2, state.cp_tex_dqf[0][2]);
+    }
+    if ((gen_vertex.x & 0x010) != 0) {
+        vtx_texcoord[3] = GenericTexCoord(int(matrix_idx_tex03[3]), texcoord3, state.cp_tex_dqf[0][3]);
+    }
+    if ((gen_vertex.x & 0x020) != 0) {
+        vtx_texcoord[4] = GenericTexCoord(int(matrix_idx_tex47[0]), texcoord4, state.cp_tex_dqf[1][0]);
+    }
+    if ((gen_vertex.x & 0x040) != 0) {
+        vtx_texcoord[5] = GenericTexCoord(int(matrix_idx_tex47[1]), texcoord5, state.cp_tex_dqf[1][1]);
+    }
+    if ((gen_vertex.x & 0x080) != 0) {
+        vtx_texcoord[6] = GenericTexCoord(int(matrix_idx_tex47[2]), texcoord6, state.cp_tex_dqf[1][2]);
+    }
+    if ((gen_vertex.x & 0x100) != 0) {
+        vtx_texcoord[7] = GenericTexCoord(int(matrix_idx_tex47[3]), texcoord7, state.cp_tex_dqf[1][3]);
+    }
+#endif
     
     // Vertex color 0
 #ifdef _DEF_COLOR0_ENABLE
@@ -421,6 +555,31 @@ void main() {
     mat[1]      = _DEF_COLOR1_MATERIAL_SRC;
     l_amb[0]    = _DEF_COLOR0_AMBIENT_SRC;
     l_amb[1]    = _DEF_COLOR1_AMBIENT_SRC;
+
+#ifdef _DEF_GENERIC
+    col[0] = GenericVertexColor(gen_vertex.y, color0);
+    col[1] = GenericVertexColor(gen_vertex.z, color1);
+    
+    for (int chan = 0; chan < 2; chan++) {
+        GenericChannel gen = gen_channels[chan];
+        
+        mat[chan] = vec4(GenericSource(gen.source.x, col, state.xf_material_color[chan]).rgb,
+            GenericSource(gen.source.y, col, state.xf_material_color[chan]).a);
+        l_amb[chan] = vec4(GenericSource(gen.source.z, col, state.xf_ambient_color[chan]).rgb,
+            GenericSource(gen.source.w, col, state.xf_ambient_color[chan]).a);
+            
+        for (int light = 0; light < 8; light++) {
+            if ((gen.lighting.x & (1 << light)) != 0) {
+                l_amb[chan].rgb += GenericLight(light, gen.lighting.z, pos.xyz, nrm.xyz) * 
+                    state.light[light].col.rgb;
+            }
+            if ((gen.lighting.y & (1 << light)) != 0) {
+                l_amb[chan].a += GenericLight(light, gen.lighting.w, pos.xyz, nrm.xyz) * 
+                    state.light[light].col.a;
+            }
+        }
+    }
+#endif
     
     _DEF_SET_CHAN0_LIGHT0_ATTEN;
     _DEF_SET_CHAN0_LIGHT0_ATTEN_ALPHA;
@@ -489,6 +648,14 @@ void main() {
     _DEF_SET_CHAN1_LIGHT7_ALPHA;
     
     
+#ifdef _DEF_GENERIC
+    // Unlit channels have an ambient of one, so this is just the material for them
+    vtx_color[0] = mat[0] * clamp(l_amb[0], 0.0f, 1.0f);
+    vtx_color[1] = mat[1] * clamp(l_amb[1], 0.0f, 1.0f);
+    if (gen_vertex.w < 2) {
+        vtx_color[1] = (gen_vertex.z >= 0) ? col[0] : vtx_color[0];
+    }
+#else
 #if _DEF_NUM_COLOR_CHANNELS == 0
     vtx_color[0] = col[0];
 #endif // _DEF_NUM_COLOR_CHANNELS == 0
@@ -512,6 +679,7 @@ void main() {
     vtx_color[1] = vtx_color[0];
 #endif // _DEF_COLOR1_ENABLE
 #endif // _DEF_NUM_COLOR_CHANNELS < 2
+#endif // _DEF_GENERIC
 
     gl_Position = state.projection_matrix * pos;
 }
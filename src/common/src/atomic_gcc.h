@@ -45,6 +45,10 @@ inline void AtomicIncrement(volatile u32& target) {
     __sync_add_and_fetch(&target, 1);
 }
 
+inline u32 AtomicExchangeAdd(volatile u32& target, u32 value) {
+    return __sync_fetch_and_add(&target, value);
+}
+
 inline u32 AtomicLoad(volatile u32& src) {
     return src;
 }
@@ -49,6 +49,10 @@ inline void AtomicDecrement(volatile u32& target) {
     InterlockedDecrement((volatile LONG*)&target);
 }
 
+inline u32 AtomicExchangeAdd(volatile u32& target, u32 value) {
+    return (u32)InterlockedExchangeAdd((volatile LONG*)&target, (LONG)value);
+}
+
 inline u32 AtomicLoad(volatile u32& src) {
     return src;
 }
@@ -37,9 +37,13 @@ Config::Config() {
     default_renderer_config.enable_wireframe = false;
     default_renderer_config.enable_shaders = true;
     default_renderer_config.enable_texture_dumping = false;
+    default_renderer_config.enable_frame_dumping = false;
     default_renderer_config.enable_textures = true;
     default_renderer_config.anti_aliasing_mode = 0;
     default_renderer_config.anistropic_filtering_mode = 0;
+    default_renderer_config.texture_cache_size = 512;
+    default_renderer_config.enable_shader_cache = true;
+    default_renderer_config.enable_async_shaders = true;
 
     default_res.width = 640;
     default_res.height = 480;
@@ -59,9 +63,17 @@ Config::Config() {
     set_enable_ipl(false);
     set_powerpc_core(CPU_INTERPRETER);
     set_powerpc_frequency(486);
+    set_enable_fastmem(false);
     
     memset(renderer_config_, 0, sizeof(renderer_config_));
     set_renderer_config(RENDERER_OPENGL_3, default_renderer_config);
+
+    // Null renderer runs are for measuring, don't let shaders from an earlier run skew them
+    default_renderer_config.enable_shader_cache = false;
+    set_renderer_config(RENDERER_NULL, default_renderer_config);
+
+    // The software renderer has no shaders to cache or compile
+    set_renderer_config(RENDERER_SOFTWARE, default_renderer_config);
     set_current_renderer(RENDERER_OPENGL_3);
 
     set_enable_fullscreen(false);
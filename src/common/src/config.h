@@ -103,6 +103,7 @@ public:
         CPU_NULL = 0,       ///< No CPU core
         CPU_INTERPRETER,    ///< Interpreter CPU core
         CPU_DYNAREC,        ///< Dynamic recompiler CPU core
+        CPU_CACHED_INTERPRETER, ///< Interpreter running pre-decoded blocks
         NUMBER_OF_CPU_CONFIGS
     };
 
@@ -111,9 +112,13 @@ public:
         bool enable_wireframe;
         bool enable_shaders;
         bool enable_texture_dumping;
+        bool enable_frame_dumping;  ///< Write each XFB copy to dump/frames (software renderer)
         bool enable_textures;
         int anti_aliasing_mode;
         int anistropic_filtering_mode;
+        int texture_cache_size;     ///< MB of decoded textures to keep, 0 for no limit
+        bool enable_shader_cache;   ///< Keep compiled shaders on disk, per game
+        bool enable_async_shaders;  ///< Compile shaders in the background, draw generically meanwhile
     } ;
 
     /// Struct used for configuring a screen resolution
@@ -130,7 +135,7 @@ public:
         RENDERER_DIRECTX9,      ///< DirectX9 core (not implemented)
         RENDERER_DIRECTX10,     ///< DirectX10 core (not implemented)
         RENDERER_DIRECTX11,     ///< DirectX11 core (not implemented)
-        RENDERER_SOFTWARE,      ///< Software  core (not implemented)
+        RENDERER_SOFTWARE,      ///< Software core
         RENDERER_HARDWARE,      ///< Hardware core (not implemented- this would be a driver)
         NUMBER_OF_VIDEO_CONFIGS
     };
@@ -177,6 +182,9 @@ public:
     int powerpc_frequency() { return powerpc_frequency_; }
     void set_powerpc_frequency(int val) { powerpc_frequency_ = val; }
 
+    bool enable_fastmem() { return enable_fastmem_; }
+    void set_enable_fastmem(bool val) { enable_fastmem_ = val; }
+
     RendererType current_renderer() { return current_renderer_; }
     void set_current_renderer(RendererType val) { current_renderer_ = val; }
 
@@ -263,6 +271,8 @@ public:
             return "interpreter";
         case CPU_DYNAREC:
             return "dynarec";
+        case CPU_CACHED_INTERPRETER:
+            return "cached";
         }
         return "null";
     }
@@ -292,6 +302,7 @@ private:
     CPUCoreType powerpc_core_;
 
     int powerpc_frequency_;
+    bool enable_fastmem_;
 
     bool enable_fullscreen_;
 
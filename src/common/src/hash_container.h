@@ -26,6 +26,7 @@
 #define COMMON_HASH_CONTAINER_H_
 
 #include <map>
+#include <vector>
 #include "common.h"
 
 /// Hash container generic interface - Don't use directly, use a derived class
@@ -113,4 +114,342 @@ private:
     DISALLOW_COPY_AND_ASSIGN(HashContainer_STLMap);
 };
 
+/// Open addressing index from a 64-bit key to a 32-bit node number. Linear probing, entries are
+/// deleted by shifting the rest of their cluster back so there are no tombstones to wade through.
+class HashContainerIndex {
+public:
+    static const u32 kNone = 0xFFFFFFFF;
+
+    HashContainerIndex() : count_(0) {
+        slots_.resize(kMinCapacity);
+    }
+
+    /// Returns the node stored at key, or kNone
+    u32 Find(u64 key) const {
+        size_t mask = slots_.size() - 1;
+        for (size_t i = Mix(key) & mask; slots_[i].node != kNone; i = (i + 1) & mask) {
+            if (slots_[i].key == key) {
+                return slots_[i].node;
+            }
+        }
+        return kNone;
+    }
+
+    /// Store node at key, replacing whatever was there
+    void Insert(u64 key, u32 node) {
+        if ((count_ + 1) * 2 > slots_.size()) {
+            Grow();
+        }
+        size_t mask = slots_.size() - 1;
+        size_t i = Mix(key) & mask;
+        for (; slots_[i].node != kNone; i = (i + 1) & mask) {
+            if (slots_[i].key == key) {
+                slots_[i].node = node;
+                return;
+            }
+        }
+        slots_[i].key = key;
+        slots_[i].node = node;
+        count_++;
+    }
+
+    /// Remove key from the index
+    void Remove(u64 key) {
+        size_t mask = slots_.size() - 1;
+        size_t i = Mix(key) & mask;
+        for (; slots_[i].key != key; i = (i + 1) & mask) {
+            if (slots_[i].node == kNone) {
+                return;
+            }
+        }
+        if (slots_[i].node == kNone) {
+            return;
+        }
+        // Pull back any later entry of the cluster that would no longer be reachable
+        for (size_t j = (i + 1) & mask; slots_[j].node != kNone; j = (j + 1) & mask) {
+            size_t home = Mix(slots_[j].key) & mask;
+            if (((j - home) & mask) >= ((j - i) & mask)) {
+                slots_[i] = slots_[j];
+                i = j;
+            }
+        }
+        slots_[i].node = kNone;
+        count_--;
+    }
+
+private:
+    static const size_t kMinCapacity = 64;
+
+    struct Slot {
+        Slot() : key(0), node(kNone) { }
+        u64 key;
+        u32 node;
+    };
+
+    /// Spread the key bits, texture hashes and addresses have poor low bits
+    static inline size_t Mix(u64 key) {
+        key ^= key >> 33;
+        key *= 0xFF51AFD7ED558CCDULL;
+        key ^= key >> 33;
+        return (size_t)key;
+    }
+
+    void Grow() {
+        std::vector<Slot> old;
+        old.swap(slots_);
+        slots_.resize(old.size() * 2);
+        count_ = 0;
+        for (size_t i = 0; i < old.size(); i++) {
+            if (old[i].node != kNone) {
+                Insert(old[i].key, old[i].node);
+            }
+        }
+    }
+
+    std::vector<Slot>   slots_;
+    size_t              count_;
+};
+
+/**
+ * Hash container for caches of host objects. Lookup by hash and by source address are O(1),
+ * entries are kept on an intrusive LRU list and the container keeps a running total of the bytes
+ * the entries say they cost, so the owner can evict oldest-first against a budget. Value pointers
+ * stay valid until their entry is removed.
+ */
+template <class HashType, class ValueType> class HashContainer_LRU : 
+    public HashContainer<HashType, ValueType> {
+
+public:
+    static const u32 kNoAddress = 0xFFFFFFFF; ///< Value has no source address, isn't indexed by one
+
+    HashContainer_LRU() : lru_head_(kNone), lru_tail_(kNone), bytes_(0) {
+    }
+    ~HashContainer_LRU() {
+        for (size_t i = 0; i < chunks_.size(); i++) {
+            delete[] chunks_[i];
+        }
+    }
+
+    ValueType* Update(HashType hash, ValueType value) {
+        return Update(hash, value, kNoAddress, 0);
+    }
+
+    /**
+     * Add (or update if already exists) a value, it becomes the most recently used entry
+     * @param hash Hash to use
+     * @param value Value to update at given hash in the container
+     * @param address Source address of the value for FetchFromAddress, or kNoAddress
+     * @param bytes Size in bytes the value counts against the cache budget
+     * @return Pointer to the value stored in the container
+     */
+    ValueType* Update(HashType hash, const ValueType& value, u32 address, size_t bytes) {
+        u32 index = hash_index_.Find((u64)hash);
+        if (index != kNone) {
+            Unlink(index);
+        } else {
+            index = Allocate();
+            hash_index_.Insert((u64)hash, index);
+        }
+        Node& node = GetNode(index);
+        node.value = value;
+        node.hash = hash;
+        node.address = address;
+        node.bytes = bytes;
+        Link(index);
+        return &node.value;
+    }
+
+    void Remove(HashType hash) {
+        u32 index = hash_index_.Find((u64)hash);
+        if (index == kNone) {
+            return;
+        }
+        hash_index_.Remove((u64)hash);
+        Unlink(index);
+
+        Node& node = GetNode(index);
+        node.value = ValueType();
+        node.live_pos = kNone;
+        free_.push_back(index);
+    }
+
+    ValueType* FetchFromHash(HashType hash) {
+        u32 index = hash_index_.Find((u64)hash);
+        return index == kNone ? NULL : &GetNode(index).value;
+    }
+
+    /**
+     * Fetch the most recently added value from the given source address
+     * @param address Source address of the value
+     * @return Pointer to the value on success, otherwise NULL. Older values from the same address
+     * are reached with NextAtAddress
+     */
+    ValueType* FetchFromAddress(u32 address) {
+        u32 index = address_index_.Find(address);
+        return index == kNone ? NULL : &GetNode(index).value;
+    }
+
+    /// Returns the next older value from the same source address as value, or NULL
+    ValueType* NextAtAddress(const ValueType* value) {
+        u32 index = ToNode(value).address_next;
+        return index == kNone ? NULL : &GetNode(index).value;
+    }
+
+    /// Fetch the value at the given integer index (in no particular order), NULL if out of range
+    ValueType* FetchFromIndex(int index) {
+        if (index < 0 || index >= Size()) {
+            return NULL;
+        }
+        return &GetNode(live_[index]).value;
+    }
+
+    int Size() {
+        return static_cast<int>(live_.size());
+    }
+
+    /// Mark a value as the most recently used
+    void Touch(const ValueType* value) {
+        u32 index = ToNode(value).self;
+        if (index != lru_head_) {
+            RemoveFromLRU(index);
+            PushLRU(index);
+        }
+    }
+
+    /// Returns the least recently used value, NULL if the container is empty
+    ValueType* Oldest() {
+        return lru_tail_ == kNone ? NULL : &GetNode(lru_tail_).value;
+    }
+
+    /// Returns the value used next after value, NULL if value is the most recently used
+    ValueType* Newer(const ValueType* value) {
+        u32 index = ToNode(value).lru_prev;
+        return index == kNone ? NULL : &GetNode(index).value;
+    }
+
+    /// Returns the total size in bytes of all values, as given to Update
+    size_t bytes() const { return bytes_; }
+
+private:
+    static const u32 kNone      = HashContainerIndex::kNone;
+    static const int kChunkBits = 6; ///< Nodes are allocated 64 at a time so they never move
+
+    struct Node {
+        ValueType   value;          ///< Must stay first, values are mapped back to their node
+        HashType    hash;
+        u32         address;
+        size_t      bytes;
+        u32         self;           ///< Node number
+        u32         lru_prev;       ///< Next more recently used node
+        u32         lru_next;       ///< Next less recently used node
+        u32         address_next;   ///< Next older node from the same address
+        u32         live_pos;       ///< Position in live_
+    };
+
+    inline Node& GetNode(u32 index) {
+        return chunks_[index >> kChunkBits][index & ((1 << kChunkBits) - 1)];
+    }
+
+    inline Node& ToNode(const ValueType* value) {
+        return *reinterpret_cast<Node*>(const_cast<ValueType*>(value));
+    }
+
+    u32 Allocate() {
+        if (free_.empty()) {
+            u32 base = static_cast<u32>(chunks_.size() << kChunkBits);
+            chunks_.push_back(new Node[1 << kChunkBits]);
+            for (int i = (1 << kChunkBits) - 1; i >= 0; i--) {
+                free_.push_back(base + i);
+            }
+        }
+        u32 index = free_.back();
+        free_.pop_back();
+        GetNode(index).self = index;
+        return index;
+    }
+
+    void PushLRU(u32 index) {
+        Node& node = GetNode(index);
+        node.lru_prev = kNone;
+        node.lru_next = lru_head_;
+        if (lru_head_ != kNone) {
+            GetNode(lru_head_).lru_prev = index;
+        } else {
+            lru_tail_ = index;
+        }
+        lru_head_ = index;
+    }
+
+    void RemoveFromLRU(u32 index) {
+        Node& node = GetNode(index);
+        if (node.lru_prev != kNone) {
+            GetNode(node.lru_prev).lru_next = node.lru_next;
+        } else {
+            lru_head_ = node.lru_next;
+        }
+        if (node.lru_next != kNone) {
+            GetNode(node.lru_next).lru_prev = node.lru_prev;
+        } else {
+            lru_tail_ = node.lru_prev;
+        }
+    }
+
+    /// Put a node on the LRU list, in the address chain and in live_, and count its bytes
+    void Link(u32 index) {
+        Node& node = GetNode(index);
+        PushLRU(index);
+
+        node.address_next = kNone;
+        if (node.address != kNoAddress) {
+            node.address_next = address_index_.Find(node.address);
+            address_index_.Insert(node.address, index);
+        }
+
+        node.live_pos = static_cast<u32>(live_.size());
+        live_.push_back(index);
+
+        bytes_ += node.bytes;
+    }
+
+    /// Undo Link
+    void Unlink(u32 index) {
+        Node& node = GetNode(index);
+        RemoveFromLRU(index);
+
+        u32 head = (node.address != kNoAddress) ? address_index_.Find(node.address) : kNone;
+        if (head == index) {
+            if (node.address_next == kNone) {
+                address_index_.Remove(node.address);
+            } else {
+                address_index_.Insert(node.address, node.address_next);
+            }
+        } else {
+            for (u32 i = head; i != kNone; i = GetNode(i).address_next) {
+                if (GetNode(i).address_next == index) {
+                    GetNode(i).address_next = node.address_next;
+                    break;
+                }
+            }
+        }
+
+        u32 last = live_.back();
+        live_[node.live_pos] = last;
+        GetNode(last).live_pos = node.live_pos;
+        live_.pop_back();
+
+        bytes_ -= node.bytes;
+    }
+
+    std::vector<Node*>  chunks_;        ///< Node storage
+    std::vector<u32>    free_;          ///< Unused node numbers
+    std::vector<u32>    live_;          ///< Used node numbers, for FetchFromIndex
+    HashContainerIndex  hash_index_;    ///< Hash -> node
+    HashContainerIndex  address_index_; ///< Source address -> newest node from that address
+    u32                 lru_head_;      ///< Most recently used node
+    u32                 lru_tail_;      ///< Least recently used node
+    size_t              bytes_;
+
+    DISALLOW_COPY_AND_ASSIGN(HashContainer_LRU);
+};
+
 #endif // COMMON_HASH_CONTAINER_H_
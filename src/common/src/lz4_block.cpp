@@ -0,0 +1,200 @@
+/**
+ * Copyright (C) 2005-2012 Gekko Emulator
+ *
+ * @file    lz4_block.cpp
+ * @author  ShizZy <shizzy247@gmail.com>
+ * @date    2013-02-27
+ * @brief   Compression to and from the LZ4 block format
+ *
+ * @section LICENSE
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details at
+ * http://www.gnu.org/copyleft/gpl.html
+ *
+ * Official project repository can be found at:
+ * http://code.google.com/p/gekko-gc-emu/
+ */
+
+#include <string.h>
+
+#include "lz4_block.h"
+
+namespace common {
+
+// A block is a list of sequences: a token (literal count << 4 | match length - 4), the literal
+// count past 15, the literals, a 16-bit little endian match offset and the match length past 15.
+// The last sequence only has literals, and the format asks for the last 5 bytes to be literals
+// and for the last match to start at least 12 bytes before the end of the block.
+
+static const int kMinMatch          = 4;
+static const int kLastLiterals      = 5;
+static const int kMatchStartLimit   = 12;
+static const int kMaxOffset         = 0xFFFF;
+static const int kHashBits          = 12;
+
+/// Reads 4 bytes for match finding, the byte order doesn't matter
+static inline u32 _read_32(const u8* ptr) {
+    u32 val;
+    memcpy(&val, ptr, 4);
+    return val;
+}
+
+/// Hashes the 4 bytes at a position
+static inline u32 _hash(u32 val) {
+    return (val * 2654435761U) >> (32 - kHashBits);
+}
+
+/// Writes the part of a literal count or match length that doesn't fit in the token
+static inline u8* _write_length(u8* op, size_t len) {
+    for (; len >= 255; len -= 255) {
+        *op++ = 255;
+    }
+    *op++ = (u8)len;
+    return op;
+}
+
+/// Reads the part of a literal count or match length that doesn't fit in the token
+static inline bool _read_length(const u8*& ip, const u8* end, size_t& len) {
+    u8 val;
+    do {
+        if (ip >= end) {
+            return false;
+        }
+        val = *ip++;
+        len += val;
+    } while (val == 255);
+    return true;
+}
+
+/**
+ * Writes a sequence
+ * @param op Output position
+ * @param literals First literal
+ * @param num_literals Number of literals
+ * @param offset Match offset, only written if match_len isn't 0
+ * @param match_len Match length, 0 for the last sequence
+ * @return Output position after the sequence
+ */
+static u8* _write_sequence(u8* op, const u8* literals, size_t num_literals, u32 offset,
+    size_t match_len) {
+    u8* token = op++;
+    *token = (u8)((num_literals < 15 ? num_literals : 15) << 4);
+    if (num_literals >= 15) {
+        op = _write_length(op, num_literals - 15);
+    }
+    memcpy(op, literals, num_literals);
+    op += num_literals;
+
+    if (match_len != 0) {
+        *op++ = (u8)offset;
+        *op++ = (u8)(offset >> 8);
+        match_len -= kMinMatch;
+        *token |= (u8)(match_len < 15 ? match_len : 15);
+        if (match_len >= 15) {
+            op = _write_length(op, match_len - 15);
+        }
+    }
+    return op;
+}
+
+/// Gets the largest size data can grow to when compressed
+size_t LZ4CompressBound(size_t size) {
+    return size + size / 255 + 16;
+}
+
+/// Compresses data into a single LZ4 block
+size_t LZ4Compress(const u8* src, size_t size, u8* dst) {
+    const u8* ip = src;
+    const u8* anchor = src;
+    u8* op = dst;
+
+    if (size > (size_t)kMatchStartLimit) {
+        const u8* match_start_limit = src + size - kMatchStartLimit;
+        const u8* match_end_limit = src + size - kLastLiterals;
+        u32 table[1 << kHashBits];
+        memset(table, 0, sizeof(table));
+
+        // Position 0 is never looked up as a match, so 0 doubles as "empty"
+        ip++;
+        while (ip < match_start_limit) {
+            u32 val = _read_32(ip);
+            u32 h = _hash(val);
+            const u8* ref = src + table[h];
+            table[h] = (u32)(ip - src);
+
+            if (ref == src || (ip - ref) > kMaxOffset || _read_32(ref) != val) {
+                ip++;
+                continue;
+            }
+            const u8* end = ip + kMinMatch;
+            ref += kMinMatch;
+            while (end < match_end_limit && *end == *ref) {
+                end++;
+                ref++;
+            }
+            op = _write_sequence(op, anchor, ip - anchor, (u32)(end - ref), end - ip);
+            ip = anchor = end;
+        }
+    }
+    return _write_sequence(op, anchor, src + size - anchor, 0, 0) - dst;
+}
+
+/// Decompresses a single LZ4 block
+bool LZ4Decompress(const u8* src, size_t size, u8* dst, size_t dst_size) {
+    const u8* ip = src;
+    const u8* end = src + size;
+    u8* op = dst;
+    u8* op_end = dst + dst_size;
+
+    while (ip < end) {
+        u8 token = *ip++;
+
+        size_t num_literals = token >> 4;
+        if (num_literals == 15 && !_read_length(ip, end, num_literals)) {
+            return false;
+        }
+        if (num_literals > (size_t)(end - ip) || num_literals > (size_t)(op_end - op)) {
+            return false;
+        }
+        memcpy(op, ip, num_literals);
+        ip += num_literals;
+        op += num_literals;
+
+        // The last sequence ends after its literals
+        if (ip == end) {
+            break;
+        }
+        if (end - ip < 2) {
+            return false;
+        }
+        size_t offset = ip[0] | (ip[1] << 8);
+        ip += 2;
+        if (offset == 0 || offset > (size_t)(op - dst)) {
+            return false;
+        }
+        size_t match_len = token & 15;
+        if (match_len == 15 && !_read_length(ip, end, match_len)) {
+            return false;
+        }
+        match_len += kMinMatch;
+        if (match_len > (size_t)(op_end - op)) {
+            return false;
+        }
+        // Matches may overlap the bytes they produce, copy byte by byte
+        const u8* ref = op - offset;
+        for (size_t i = 0; i < match_len; i++) {
+            op[i] = ref[i];
+        }
+        op += match_len;
+    }
+    return op == op_end;
+}
+
+} // namespace
@@ -0,0 +1,63 @@
+/**
+ * Copyright (C) 2005-2012 Gekko Emulator
+ *
+ * @file    lz4_block.h
+ * @author  ShizZy <shizzy247@gmail.com>
+ * @date    2013-02-27
+ * @brief   Compression to and from the LZ4 block format
+ *
+ * @section LICENSE
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details at
+ * http://www.gnu.org/copyleft/gpl.html
+ *
+ * Official project repository can be found at:
+ * http://code.google.com/p/gekko-gc-emu/
+ */
+
+#ifndef COMMON_LZ4_BLOCK_H_
+#define COMMON_LZ4_BLOCK_H_
+
+#include <stddef.h>
+
+#include "types.h"
+
+namespace common {
+
+/**
+ * Gets the largest size data can grow to when compressed
+ * @param size Size of the uncompressed data in bytes
+ * @return Size the destination buffer of LZ4Compress needs
+ */
+size_t LZ4CompressBound(size_t size);
+
+/**
+ * Compresses data into a single LZ4 block. This is a plain greedy compressor, fast rather than
+ * thorough, but any LZ4 decoder can read its output.
+ * @param src Data to compress
+ * @param size Size of the data in bytes
+ * @param dst Receives the block, LZ4CompressBound(size) bytes
+ * @return Size of the block in bytes
+ */
+size_t LZ4Compress(const u8* src, size_t size, u8* dst);
+
+/**
+ * Decompresses a single LZ4 block
+ * @param src Block to decompress
+ * @param size Size of the block in bytes
+ * @param dst Receives the data
+ * @param dst_size Size of the decompressed data in bytes
+ * @return True on success, false if the block is corrupt or doesn't decompress to dst_size bytes
+ */
+bool LZ4Decompress(const u8* src, size_t size, u8* dst, size_t dst_size);
+
+} // namespace
+
+#endif // COMMON_LZ4_BLOCK_H_
@@ -0,0 +1,141 @@
+/**
+ * Copyright (C) 2005-2012 Gekko Emulator
+ *
+ * @file    mapped_file.cpp
+ * @author  ShizZy <shizzy247@gmail.com>
+ * @date    2013-02-27
+ * @brief   Read-only memory mapping of a whole file
+ *
+ * @section LICENSE
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details at
+ * http://www.gnu.org/copyleft/gpl.html
+ *
+ * Official project repository can be found at:
+ * http://code.google.com/p/gekko-gc-emu/
+ */
+
+#include "common.h"
+#include "mapped_file.h"
+
+#if EMU_PLATFORM != PLATFORM_WINDOWS
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+namespace common {
+
+#if EMU_PLATFORM == PLATFORM_WINDOWS
+
+MappedFile::MappedFile() : file_(INVALID_HANDLE_VALUE), mapping_(NULL), data_(NULL), size_(0) {
+}
+
+MappedFile::~MappedFile() {
+    Close();
+}
+
+/// Map a file
+bool MappedFile::Open(const char* filename) {
+    Close();
+
+    file_ = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file_ == INVALID_HANDLE_VALUE) {
+        LOG_ERROR(TCOMMON, "MappedFile: unable to open %s (error %d)", filename, GetLastError());
+        return false;
+    }
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file_, &size) || size.QuadPart == 0 ||
+        (u64)size.QuadPart != (u64)(size_t)size.QuadPart) {
+        LOG_ERROR(TCOMMON, "MappedFile: %s is empty or too large to map", filename);
+        Close();
+        return false;
+    }
+    mapping_ = CreateFileMapping(file_, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (mapping_ != NULL) {
+        data_ = (u8*)MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0);
+    }
+    if (data_ == NULL) {
+        LOG_ERROR(TCOMMON, "MappedFile: unable to map %s (error %d)", filename, GetLastError());
+        Close();
+        return false;
+    }
+    size_ = size.QuadPart;
+    return true;
+}
+
+/// Unmap the file
+void MappedFile::Close() {
+    if (data_ != NULL) {
+        UnmapViewOfFile(data_);
+        data_ = NULL;
+    }
+    if (mapping_ != NULL) {
+        CloseHandle(mapping_);
+        mapping_ = NULL;
+    }
+    if (file_ != INVALID_HANDLE_VALUE) {
+        CloseHandle(file_);
+        file_ = INVALID_HANDLE_VALUE;
+    }
+    size_ = 0;
+}
+
+#else
+
+MappedFile::MappedFile() : data_(NULL), size_(0) {
+}
+
+MappedFile::~MappedFile() {
+    Close();
+}
+
+/// Map a file
+bool MappedFile::Open(const char* filename) {
+    Close();
+
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        LOG_ERROR(TCOMMON, "MappedFile: unable to open %s", filename);
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) < 0 || info.st_size == 0 ||
+        (u64)info.st_size != (u64)(size_t)info.st_size) {
+        LOG_ERROR(TCOMMON, "MappedFile: %s is empty or too large to map", filename);
+        close(fd);
+        return false;
+    }
+    // The mapping keeps its own reference to the file
+    void* ptr = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (ptr == MAP_FAILED) {
+        LOG_ERROR(TCOMMON, "MappedFile: unable to map %s", filename);
+        return false;
+    }
+    data_ = (u8*)ptr;
+    size_ = info.st_size;
+    return true;
+}
+
+/// Unmap the file
+void MappedFile::Close() {
+    if (data_ != NULL) {
+        munmap(data_, (size_t)size_);
+        data_ = NULL;
+    }
+    size_ = 0;
+}
+
+#endif
+
+} // namespace
@@ -0,0 +1,74 @@
+/**
+ * Copyright (C) 2005-2012 Gekko Emulator
+ *
+ * @file    mapped_file.h
+ * @author  ShizZy <shizzy247@gmail.com>
+ * @date    2013-02-27
+ * @brief   Read-only memory mapping of a whole file
+ *
+ * @section LICENSE
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details at
+ * http://www.gnu.org/copyleft/gpl.html
+ *
+ * Official project repository can be found at:
+ * http://code.google.com/p/gekko-gc-emu/
+ */
+
+#ifndef COMMON_MAPPED_FILE_H_
+#define COMMON_MAPPED_FILE_H_
+
+#include "common.h"
+
+#if EMU_PLATFORM == PLATFORM_WINDOWS
+#include <windows.h>
+#endif
+
+namespace common {
+
+/**
+ * @brief File mapped into the address space for reading. Pages are only read in from disk when
+ * they are touched and can be dropped again by the OS, so files larger than RAM can be read.
+ */
+class MappedFile {
+public:
+    MappedFile();
+    ~MappedFile();
+
+    /**
+     * @brief Map a file
+     * @param filename Name of the file
+     * @return True on success
+     */
+    bool Open(const char* filename);
+
+    /// Unmap the file
+    void Close();
+
+    /// Returns the contents of the file, NULL if no file is mapped
+    const u8* data() const { return data_; }
+
+    /// Returns the size of the file in bytes
+    u64 size() const { return size_; }
+
+private:
+#if EMU_PLATFORM == PLATFORM_WINDOWS
+    HANDLE  file_;      ///< File handle
+    HANDLE  mapping_;   ///< File mapping handle
+#endif
+    u8*     data_;      ///< Mapped contents
+    u64     size_;      ///< Size of the file in bytes
+
+    DISALLOW_COPY_AND_ASSIGN(MappedFile);
+};
+
+} // namespace
+
+#endif // COMMON_MAPPED_FILE_H_
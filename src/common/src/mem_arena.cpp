@@ -0,0 +1,211 @@
+/**
+ * Copyright (C) 2005-2012 Gekko Emulator
+ *
+ * @file    mem_arena.cpp
+ * @author  ShizZy <shizzy247@gmail.com>
+ * @date    2013-02-02
+ * @brief   Shared memory arena that can be mapped into the address space multiple times
+ *
+ * @section LICENSE
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details at
+ * http://www.gnu.org/copyleft/gpl.html
+ *
+ * Official project repository can be found at:
+ * http://code.google.com/p/gekko-gc-emu/
+ */
+
+#include "common.h"
+#include "mem_arena.h"
+
+#if EMU_PLATFORM != PLATFORM_WINDOWS
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+namespace common {
+
+#if EMU_PLATFORM == PLATFORM_WINDOWS
+
+const int kMirrorRetries = 16; ///< Attempts at finding free address space for a mirrored view
+
+MemArena::MemArena() : handle_(NULL), size_(0) {
+}
+
+MemArena::~MemArena() {
+    Release();
+}
+
+/// Allocate the backing memory of the arena
+bool MemArena::Create(size_t size) {
+    handle_ = CreateFileMapping(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE,
+        (DWORD)((u64)size >> 32), (DWORD)size, NULL);
+    if (handle_ == NULL) {
+        LOG_ERROR(TCOMMON, "MemArena: CreateFileMapping failed (error %d)", GetLastError());
+        return false;
+    }
+    size_ = size;
+    return true;
+}
+
+/// Release the backing memory, all views must have been unmapped
+void MemArena::Release() {
+    if (handle_ != NULL) {
+        CloseHandle(handle_);
+        handle_ = NULL;
+    }
+    size_ = 0;
+}
+
+/// Map a view of the arena
+u8* MemArena::MapView(size_t offset, size_t size, void* base) {
+    return (u8*)MapViewOfFileEx(handle_, FILE_MAP_ALL_ACCESS, (DWORD)((u64)offset >> 32),
+        (DWORD)offset, size, base);
+}
+
+/// Unmap a view created by MapView
+void MemArena::UnmapView(void* view, size_t size) {
+    UnmapViewOfFile(view);
+}
+
+/// Map the whole arena twice, back to back
+u8* MemArena::MapMirrored() {
+    // Windows can't map into reserved space, so find a hole and hope nobody takes it meanwhile
+    for (int i = 0; i < kMirrorRetries; i++) {
+        u8* base = ReserveAddressSpace(size_ * 2);
+        if (base == NULL) {
+            break;
+        }
+        u8* lo = MapView(0, size_, base);
+        u8* hi = MapView(0, size_, base + size_);
+        if (lo == base && hi == (base + size_)) {
+            return base;
+        }
+        if (lo != NULL) UnmapView(lo, size_);
+        if (hi != NULL) UnmapView(hi, size_);
+    }
+    return NULL;
+}
+
+/// Unmap a view created by MapMirrored
+void MemArena::UnmapMirrored(u8* view) {
+    UnmapView(view, size_);
+    UnmapView(view + size_, size_);
+}
+
+/// Reserve a range of address space without committing memory to it
+u8* MemArena::ReserveAddressSpace(size_t size) {
+    u8* ptr = (u8*)VirtualAlloc(NULL, size, MEM_RESERVE, PAGE_NOACCESS);
+    if (ptr != NULL) {
+        VirtualFree(ptr, 0, MEM_RELEASE);
+    }
+    return ptr;
+}
+
+/// Release a range of address space reserved by ReserveAddressSpace
+void MemArena::ReleaseAddressSpace(u8* ptr, size_t size) {
+    // Nothing to do, ReserveAddressSpace already gave the range back
+}
+
+#else
+
+MemArena::MemArena() : fd_(-1), size_(0) {
+}
+
+MemArena::~MemArena() {
+    Release();
+}
+
+/// Allocate the backing memory of the arena
+bool MemArena::Create(size_t size) {
+#ifdef SYS_memfd_create
+    fd_ = syscall(SYS_memfd_create, "gekko", 0);
+#endif
+    if (fd_ < 0) {
+        // Older kernels, fall back to an unlinked POSIX shared memory object
+        char name[64];
+        sprintf(name, "/gekko.%d", (int)getpid());
+        fd_ = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+        shm_unlink(name);
+    }
+    if (fd_ < 0) {
+        LOG_ERROR(TCOMMON, "MemArena: unable to create shared memory");
+        return false;
+    }
+    if (ftruncate(fd_, size) < 0) {
+        LOG_ERROR(TCOMMON, "MemArena: unable to resize shared memory to %d bytes", size);
+        Release();
+        return false;
+    }
+    size_ = size;
+    return true;
+}
+
+/// Release the backing memory, all views must have been unmapped
+void MemArena::Release() {
+    if (fd_ >= 0) {
+        close(fd_);
+        fd_ = -1;
+    }
+    size_ = 0;
+}
+
+/// Map a view of the arena
+u8* MemArena::MapView(size_t offset, size_t size, void* base) {
+    void* ptr = mmap(base, size, PROT_READ | PROT_WRITE, MAP_SHARED | (base ? MAP_FIXED : 0),
+        fd_, offset);
+    if (ptr == MAP_FAILED) {
+        return NULL;
+    }
+    return (u8*)ptr;
+}
+
+/// Unmap a view created by MapView
+void MemArena::UnmapView(void* view, size_t size) {
+    munmap(view, size);
+}
+
+/// Map the whole arena twice, back to back
+u8* MemArena::MapMirrored() {
+    u8* base = ReserveAddressSpace(size_ * 2);
+    if (base == NULL) {
+        return NULL;
+    }
+    if (MapView(0, size_, base) == NULL || MapView(0, size_, base + size_) == NULL) {
+        ReleaseAddressSpace(base, size_ * 2);
+        return NULL;
+    }
+    return base;
+}
+
+/// Unmap a view created by MapMirrored
+void MemArena::UnmapMirrored(u8* view) {
+    munmap(view, size_ * 2);
+}
+
+/// Reserve a range of address space without committing memory to it
+u8* MemArena::ReserveAddressSpace(size_t size) {
+    void* ptr = mmap(NULL, size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (ptr == MAP_FAILED) {
+        return NULL;
+    }
+    return (u8*)ptr;
+}
+
+/// Release a range of address space reserved by ReserveAddressSpace
+void MemArena::ReleaseAddressSpace(u8* ptr, size_t size) {
+    munmap(ptr, size);
+}
+
+#endif
+
+} // namespace
@@ -0,0 +1,115 @@
+/**
+ * Copyright (C) 2005-2012 Gekko Emulator
+ *
+ * @file    mem_arena.h
+ * @author  ShizZy <shizzy247@gmail.com>
+ * @date    2013-02-02
+ * @brief   Shared memory arena that can be mapped into the address space multiple times
+ *
+ * @section LICENSE
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details at
+ * http://www.gnu.org/copyleft/gpl.html
+ *
+ * Official project repository can be found at:
+ * http://code.google.com/p/gekko-gc-emu/
+ */
+
+#ifndef COMMON_MEM_ARENA_H_
+#define COMMON_MEM_ARENA_H_
+
+#include "common.h"
+
+#if EMU_PLATFORM == PLATFORM_WINDOWS
+#include <windows.h>
+#endif
+
+namespace common {
+
+/**
+ * @brief Block of shared memory (memfd/shm on POSIX, a pagefile backed section on Windows) that
+ * can be mapped at several virtual addresses at once, e.g. to build mirrored ring buffers
+ */
+class MemArena {
+public:
+    MemArena();
+    ~MemArena();
+
+    /**
+     * @brief Allocate the backing memory of the arena
+     * @param size Size of the arena in bytes, must be a multiple of the page size
+     * @return True on success, false if shared memory isn't available
+     */
+    bool Create(size_t size);
+
+    /// Release the backing memory, all views must have been unmapped
+    void Release();
+
+    /**
+     * @brief Map a view of the arena
+     * @param offset Offset into the arena to map, page aligned
+     * @param size Size of the view in bytes
+     * @param base Address to map the view at, or NULL to let the OS choose
+     * @return Pointer to the view, or NULL on failure
+     */
+    u8* MapView(size_t offset, size_t size, void* base = NULL);
+
+    /**
+     * @brief Unmap a view created by MapView
+     * @param view Pointer to the view
+     * @param size Size of the view in bytes
+     */
+    void UnmapView(void* view, size_t size);
+
+    /**
+     * @brief Map the whole arena twice, back to back, so that reads and writes that run off the
+     * end of the first view continue at the start of the arena
+     * @return Pointer to the first view (2 * size bytes of address space), or NULL on failure
+     */
+    u8* MapMirrored();
+
+    /**
+     * @brief Unmap a view created by MapMirrored
+     * @param view Pointer to the first view
+     */
+    void UnmapMirrored(u8* view);
+
+    /**
+     * @brief Reserve a range of address space without committing memory to it
+     * @param size Size of the range in bytes
+     * @return Pointer to the range, or NULL on failure. On Windows the range is released again
+     * immediately, and the pointer is only a hint for subsequent MapView calls
+     */
+    static u8* ReserveAddressSpace(size_t size);
+
+    /**
+     * @brief Release a range of address space reserved by ReserveAddressSpace
+     * @param ptr Pointer to the range
+     * @param size Size of the range in bytes
+     */
+    static void ReleaseAddressSpace(u8* ptr, size_t size);
+
+    /// Returns the size of the arena in bytes
+    size_t size() const { return size_; }
+
+private:
+#if EMU_PLATFORM == PLATFORM_WINDOWS
+    HANDLE  handle_;    ///< Section handle
+#else
+    int     fd_;        ///< Shared memory file descriptor
+#endif
+    size_t  size_;      ///< Size of the arena in bytes
+
+    DISALLOW_COPY_AND_ASSIGN(MemArena);
+};
+
+} // namespace
+
+#endif // COMMON_MEM_ARENA_H_
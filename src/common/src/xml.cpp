@@ -267,6 +267,9 @@ void ParsePowerPCNode(rapidxml::xml_node<> *node, Config& config) {
         // Use dynarec core
         } else if (E_OK == _stricmp(core_str, "dynarec")) {
             config.set_powerpc_core(Config::CPU_DYNAREC);       // Dynarec selected
+        // Use cached interpreter core
+        } else if (E_OK == _stricmp(core_str, "cached")) {
+            config.set_powerpc_core(Config::CPU_CACHED_INTERPRETER); // Cached interpreter selected
         // Unsupported type
         } else {
             LOG_ERROR(TCONFIG, "Invalid PowerPC type %s for attribute 'core' selected!", 
@@ -277,7 +280,13 @@ void ParsePowerPCNode(rapidxml::xml_node<> *node, Config& config) {
         if (attr) {
             config.set_powerpc_frequency(atoi(attr->value()));
         }
-        LOG_NOTICE(TCONFIG, "Configured core=%s freq=%d", core_str, config.powerpc_frequency());
+        // Map guest memory into the host address space (recompiler only)
+        attr = node->first_attribute("fastmem");
+        if (attr) {
+            config.set_enable_fastmem(E_OK == _stricmp(attr->value(), "true"));
+        }
+        LOG_NOTICE(TCONFIG, "Configured core=%s freq=%d fastmem=%d", core_str, 
+            config.powerpc_frequency(), config.enable_fastmem());
     }
 }
 
@@ -294,6 +303,10 @@ void ParseVideoNode(rapidxml::xml_node<> *node, Config& config) {
     if (!node) {
         return;
     }
+    rapidxml::xml_attribute<> *renderer_attr = node->first_attribute("renderer");
+    if (renderer_attr) {
+        config.set_current_renderer(Config::StringToRenderType(renderer_attr->value()));
+    }
     config.set_enable_fullscreen(GetXMLElementAsBool(node, "EnableFullscreen"));
     
     // Set resolutions
@@ -305,7 +318,8 @@ void ParseVideoNode(rapidxml::xml_node<> *node, Config& config) {
     config.set_fullscreen_resolution(res);
 
     // Parse all search renderer nodes
-    for (rapidxml::xml_node<> *elem = node->first_node("Renderer"); 1; ) {
+    for (rapidxml::xml_node<> *elem = node->first_node("Renderer"); elem; 
+        elem = elem->next_sibling("Renderer")) {
         Config::RendererConfig renderer_config;
 
         rapidxml::xml_attribute<> *attr = elem->first_attribute("name");
@@ -316,14 +330,16 @@ void ParseVideoNode(rapidxml::xml_node<> *node, Config& config) {
         renderer_config.enable_shaders = GetXMLElementAsBool(elem, "EnableShaders");
         renderer_config.enable_textures = GetXMLElementAsBool(elem, "EnableTextures");
         renderer_config.enable_texture_dumping = GetXMLElementAsBool(elem, "EnableTextureDumping");
+        renderer_config.enable_frame_dumping = GetXMLElementAsBool(elem, "EnableFrameDumping");
         renderer_config.anti_aliasing_mode = GetXMLElementAsInt(elem, "AntiAliasingMode");
         renderer_config.anistropic_filtering_mode = GetXMLElementAsInt(elem, "AnistropicFilteringMode");
+        renderer_config.texture_cache_size = GetXMLElementAsInt(elem, "TextureCacheSize");
+        renderer_config.enable_shader_cache = GetXMLElementAsBool(elem, "EnableShaderCache");
+        renderer_config.enable_async_shaders = GetXMLElementAsBool(elem, "EnableAsyncShaders");
 
         config.set_renderer_config(type, renderer_config);
 
         LOG_NOTICE(TCONFIG, "Renderer %s configured", attr->value());
-
-        break;
     }
 }
 
@@ -34,7 +34,9 @@
 #include "dvd/realdvd.h"
 #include "powerpc/cpu_core.h"
 #include "powerpc/interpreter/cpu_int.h"
+#include "powerpc/interpreter/cpu_int_cached.h"
 #include "powerpc/recompiler/cpu_rec.h"
+#include "powerpc/recompiler_x64/cpu_jit_x64.h"
 
 // TODO: Include logic is stupid... video_core shouldn't be included if USE_NEW_VIDEO_CORE is false, but that variable is defined in that header..
 #include "video_core.h"
@@ -103,9 +105,15 @@ int Init(EmuWindow* emu_window) {
     if (common::g_config->powerpc_core() == common::Config::CPU_INTERPRETER) {
         delete cpu; // TODO: STUPID!
         cpu = new GekkoCPUInterpreter();
+    } else if (common::g_config->powerpc_core() == common::Config::CPU_CACHED_INTERPRETER) {
+        delete cpu;
+        cpu = new GekkoCPUCachedInterpreter();
     } else {
 
-#ifndef EMU_IGNORE_RECOMPILER
+#if defined(EMU_JIT_X64)
+        delete cpu;
+        cpu = new GekkoCPURecompilerX64();
+#elif !defined(EMU_IGNORE_RECOMPILER)
 
 #ifdef EMU_ARCHITECTURE_X86
         delete cpu;
@@ -118,7 +126,7 @@ int Init(EmuWindow* emu_window) {
 #else
         LOG_ERROR(TCORE, "Recompiler removed from this build - Please switch your configuration to the interpreter!\n");
         return E_ERR;
-#endif // EMU_IGNORE_RECOMPILER
+#endif // EMU_JIT_X64
 
     }
 	SetState(SYS_IDLE);
@@ -0,0 +1,227 @@
+/**
+ * Copyright (C) 2005-2012 Gekko Emulator
+ *
+ * @file    disc_image.cpp
+ * @author  ShizZy <shizzy247@gmail.com>
+ * @date    2013-02-14
+ * @brief   Read-only disc image backend, memory mapped or block cached
+ *
+ * @section LICENSE
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details at
+ * http://www.gnu.org/copyleft/gpl.html
+ *
+ * Official project repository can be found at:
+ * http://code.google.com/p/gekko-gc-emu/
+ */
+
+#include "common.h"
+#include "disc_image.h"
+
+#if EMU_PLATFORM != PLATFORM_WINDOWS
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+namespace dvd {
+
+/// Largest image that gets memory mapped, 32-bit hosts can't spare the address space for a full disc
+#ifdef EMU_ARCHITECTURE_X64
+const u64 kMaxMappedSize = 0xFFFFFFFFFFFFFFFFULL;
+#else
+const u64 kMaxMappedSize = 256 * 1024 * 1024;
+#endif
+
+DiscImage::DiscImage() :
+#if EMU_PLATFORM == PLATFORM_WINDOWS
+    file_(INVALID_HANDLE_VALUE),
+    map_handle_(NULL),
+#else
+    fd_(-1),
+#endif
+    mapping_(NULL),
+    size_(0),
+    use_counter_(0) {
+    memset(blocks_, 0, sizeof(blocks_));
+}
+
+DiscImage::~DiscImage() {
+    Close();
+}
+
+/// Open a disc image
+bool DiscImage::Open(const char* filename) {
+    Close();
+
+#if EMU_PLATFORM == PLATFORM_WINDOWS
+    file_ = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file_ == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(file_, &file_size) || file_size.QuadPart == 0) {
+        Close();
+        return false;
+    }
+    size_ = file_size.QuadPart;
+
+    if (size_ <= kMaxMappedSize) {
+        map_handle_ = CreateFileMapping(file_, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (map_handle_ != NULL) {
+            mapping_ = (u8*)MapViewOfFile(map_handle_, FILE_MAP_READ, 0, 0, 0);
+        }
+    }
+#else
+    fd_ = open(filename, O_RDONLY);
+    if (fd_ < 0) {
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd_, &st) != 0 || st.st_size == 0) {
+        Close();
+        return false;
+    }
+    size_ = st.st_size;
+
+    if (size_ <= kMaxMappedSize) {
+        void* view = mmap(NULL, (size_t)size_, PROT_READ, MAP_PRIVATE, fd_, 0);
+        if (view != MAP_FAILED) {
+            mapping_ = (u8*)view;
+        }
+    }
+#endif
+    filename_ = filename;
+
+    if (mapping_ == NULL) {
+        for (int i = 0; i < kNumBlocks; i++) {
+            blocks_[i].data = new u8[kBlockSize];
+        }
+        LOG_NOTICE(TDVD, "DiscImage: %s is not memory mapped, using a %dKB block cache", filename,
+            (kNumBlocks * kBlockSize) >> 10);
+    }
+    return true;
+}
+
+/// Close the image
+void DiscImage::Close() {
+#if EMU_PLATFORM == PLATFORM_WINDOWS
+    if (mapping_ != NULL) {
+        UnmapViewOfFile(mapping_);
+    }
+    if (map_handle_ != NULL) {
+        CloseHandle(map_handle_);
+        map_handle_ = NULL;
+    }
+    if (file_ != INVALID_HANDLE_VALUE) {
+        CloseHandle(file_);
+        file_ = INVALID_HANDLE_VALUE;
+    }
+#else
+    if (mapping_ != NULL) {
+        munmap(mapping_, (size_t)size_);
+    }
+    if (fd_ >= 0) {
+        close(fd_);
+        fd_ = -1;
+    }
+#endif
+    for (int i = 0; i < kNumBlocks; i++) {
+        delete[] blocks_[i].data;
+    }
+    memset(blocks_, 0, sizeof(blocks_));
+    use_counter_ = 0;
+
+    mapping_ = NULL;
+    size_ = 0;
+    filename_.clear();
+}
+
+/// Positioned read straight from the file
+size_t DiscImage::ReadAt(u64 offset, void* dst, size_t len) {
+#if EMU_PLATFORM == PLATFORM_WINDOWS
+    OVERLAPPED overlapped;
+    DWORD bytes_read = 0;
+    memset(&overlapped, 0, sizeof(overlapped));
+    overlapped.Offset = (DWORD)offset;
+    overlapped.OffsetHigh = (DWORD)(offset >> 32);
+    if (!ReadFile(file_, dst, (DWORD)len, &bytes_read, &overlapped)) {
+        return 0;
+    }
+    return bytes_read;
+#else
+    size_t total = 0;
+    while (total < len) {
+        ssize_t res = pread(fd_, (u8*)dst + total, len - total, (off_t)(offset + total));
+        if (res <= 0) {
+            break;
+        }
+        total += res;
+    }
+    return total;
+#endif
+}
+
+/// Returns the cache block holding block index, reading it in on a miss
+DiscImage::CacheBlock* DiscImage::GetBlock(u64 index) {
+    CacheBlock* victim = &blocks_[0];
+
+    use_counter_++;
+    for (int i = 0; i < kNumBlocks; i++) {
+        CacheBlock* block = &blocks_[i];
+        if (block->last_use && block->index == index) {
+            block->last_use = use_counter_;
+            return block;
+        }
+        if (block->last_use < victim->last_use) {
+            victim = block;
+        }
+    }
+    victim->index = index;
+    victim->valid = (u32)ReadAt(index << kBlockShift, victim->data, kBlockSize);
+    victim->last_use = use_counter_;
+    return victim;
+}
+
+/// Read from the image
+size_t DiscImage::Read(u64 offset, void* dst, size_t len) {
+    if (offset >= size_) {
+        return 0;
+    }
+    if (len > size_ - offset) {
+        len = (size_t)(size_ - offset);
+    }
+    if (mapping_ != NULL) {
+        memcpy(dst, mapping_ + offset, len);
+        return len;
+    }
+
+    std::lock_guard<std::mutex> lock(cache_mutex_);
+    size_t total = 0;
+    while (total < len) {
+        CacheBlock* block = GetBlock(offset >> kBlockShift);
+        u32 block_offset = (u32)(offset & (kBlockSize - 1));
+        if (block_offset >= block->valid) {
+            break;
+        }
+        size_t count = block->valid - block_offset;
+        if (count > len - total) {
+            count = len - total;
+        }
+        memcpy((u8*)dst + total, block->data + block_offset, count);
+        total += count;
+        offset += count;
+    }
+    return total;
+}
+
+} // namespace
@@ -0,0 +1,117 @@
+/**
+ * Copyright (C) 2005-2012 Gekko Emulator
+ *
+ * @file    disc_image.h
+ * @author  ShizZy <shizzy247@gmail.com>
+ * @date    2013-02-14
+ * @brief   Read-only disc image backend, memory mapped or block cached
+ *
+ * @section LICENSE
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details at
+ * http://www.gnu.org/copyleft/gpl.html
+ *
+ * Official project repository can be found at:
+ * http://code.google.com/p/gekko-gc-emu/
+ */
+
+#ifndef CORE_DVD_DISC_IMAGE_H_
+#define CORE_DVD_DISC_IMAGE_H_
+
+#include <string>
+
+#include "common.h"
+#include "std_mutex.h"
+
+#if EMU_PLATFORM == PLATFORM_WINDOWS
+#include <windows.h>
+#endif
+
+namespace dvd {
+
+/**
+ * @brief Read-only view of a GCM/ISO image. The whole image is memory mapped when it fits in the
+ * address space, so a read is a plain copy. Otherwise reads go through a small LRU cache of fixed
+ * size blocks filled with positioned reads. Reads may be issued from any thread.
+ */
+class DiscImage {
+public:
+    static const int    kBlockShift     = 17;                   ///< 128KB cache blocks
+    static const u32    kBlockSize      = 1 << kBlockShift;
+    static const int    kNumBlocks      = 32;                   ///< 4MB of cached blocks
+
+    DiscImage();
+    ~DiscImage();
+
+    /**
+     * @brief Open a disc image
+     * @param filename Path of the image
+     * @return True on success
+     */
+    bool Open(const char* filename);
+
+    /// Close the image, it must not be read concurrently
+    void Close();
+
+    /**
+     * @brief Read from the image
+     * @param offset Offset into the image in bytes
+     * @param dst Destination buffer
+     * @param len Number of bytes to read
+     * @return Number of bytes read, short at the end of the image
+     */
+    size_t Read(u64 offset, void* dst, size_t len);
+
+    /// Returns true if an image is open
+    bool IsOpen() const { return size_ != 0; }
+
+    /// Returns true if the image is served from a memory mapping
+    bool IsMapped() const { return mapping_ != NULL; }
+
+    /// Returns the size of the image in bytes
+    u64 size() const { return size_; }
+
+    /// Returns the path the image was opened from
+    const std::string& filename() const { return filename_; }
+
+private:
+    struct CacheBlock {
+        u64     index;      ///< Block number in the image
+        u32     last_use;   ///< LRU stamp, 0 if the block is empty
+        u32     valid;      ///< Number of valid bytes, short for the last block of the image
+        u8*     data;
+    };
+
+    /// Positioned read straight from the file, doesn't touch the file pointer
+    size_t ReadAt(u64 offset, void* dst, size_t len);
+
+    /// Returns the cache block holding block index, reading it in on a miss
+    CacheBlock* GetBlock(u64 index);
+
+#if EMU_PLATFORM == PLATFORM_WINDOWS
+    HANDLE      file_;
+    HANDLE      map_handle_;
+#else
+    int         fd_;
+#endif
+    u8*         mapping_;       ///< Whole image, NULL when using the block cache
+    u64         size_;
+    std::string filename_;
+
+    std::mutex  cache_mutex_;   ///< Guards the block cache
+    CacheBlock  blocks_[kNumBlocks];
+    u32         use_counter_;
+
+    DISALLOW_COPY_AND_ASSIGN(DiscImage);
+};
+
+} // namespace
+
+#endif // CORE_DVD_DISC_IMAGE_H_
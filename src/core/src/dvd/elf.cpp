@@ -270,8 +270,10 @@ bool ELF_LoadSection(FILE* f, u32 srcaddr, u32 dstaddr, u32 len)
     dstaddr = BSWAP32(dstaddr) & RAM_MASK;
     fread(&Mem_RAM[dstaddr], len, 1, f);
 
+#ifndef MEM_NATIVE_BE
     for(x = dstaddr; x < (dstaddr + len); x+=4)
         *(u32 *)&Mem_RAM[x] = BSWAP32(*(u32 *)&Mem_RAM[x]);
+#endif
 
     LOG_NOTICE(TDVD, "ELF %08X bytes copied to address %08X", BSWAP32(len), BSWAP32(dstaddr));
 
@@ -503,8 +505,10 @@ u32 ELF_CreateFileStructure(char *ELFFileName)
     //bswap the memory around
     //	MemSwap = (u32 *)&Mem_RAM[DataPos + DataSize];
     //	FileNames = (char *)(&Mem_RAM[RAM_24MB]);
+#ifndef MEM_NATIVE_BE
     for(; (u8*)FileNames < (u8*)&Mem_RAM[RAM_24MB]; FileNames+=4)
         *((u32 *)(FileNames)) = BSWAP32((*((u32 *)FileNames)));
+#endif
 
     return 0x80000000 + DataPos;
 }
@@ -33,17 +33,19 @@
 #include "hw/hw.h"
 #include "hle/hle.h"
 #include "gcm.h"
+#include "disc_image.h"
 #include "memory.h"
 #include "core.h"
 
 /// Frontend interface for DVD/ROM loading
 namespace dvd {
 
-FILE*   g_file_handle = NULL;
+DiscImage g_disc_image;
 FILE*   g_dump_file_handle = NULL;
 
 char	g_current_game_name[992];
 char	g_current_game_crc[7];
+char	g_current_game_id[7];
 
 //all filenames in the FST
 char *FileNames;
@@ -119,8 +121,8 @@ DEFRealDVDRead(GCMDVDRead)
 
     //LOG_NOTICE(TDVD, "GCMDVDRead");
 
-    //if the file handle is invalid then exit
-    if(g_file_handle == NULL)
+    //if the image is not open then exit
+    if(!g_disc_image.IsOpen())
         return 0;
 
     if(FilePtr == 0)
@@ -135,15 +137,12 @@ DEFRealDVDRead(GCMDVDRead)
     if(GCMFilePtr->ID != GCMFILEID)
         return 0;
 
-    //read from the file
-    fseek(g_file_handle, GCMFilePtr->FileData->DiskAddr + GCMFilePtr->CurPos, SEEK_SET);
-
     //if the length puts the cursor past the end of the file, then adjust the length
     if((GCMFilePtr->CurPos + Len) > GCMFilePtr->FileData->FileSize)
         Len = GCMFilePtr->FileData->FileSize - GCMFilePtr->CurPos;
 
-    //read from the file
-    ReadLen = fread(MemPtr, 1, Len, g_file_handle);
+    //read from the image
+    ReadLen = (DWORD)g_disc_image.Read(GCMFilePtr->FileData->DiskAddr + GCMFilePtr->CurPos, MemPtr, Len);
     if(Len != ReadLen) {
         LOG_ERROR(TDVD, "Reading invalid area of file!\n");
         return 0;
@@ -164,7 +163,7 @@ DEFRealDVDSeek(GCMDVDSeek)
 
     //LOG_NOTICE(TDVD, "GCMDVDSeek");
     
-    if(g_file_handle == NULL)
+    if(!g_disc_image.IsOpen())
         return 0;
 
     if(FilePtr == 0)
@@ -199,12 +198,7 @@ DEFRealDVDSeek(GCMDVDSeek)
     else if((u32)NewPos > GCMFilePtr->FileData->FileSize)
         NewPos = GCMFilePtr->FileData->FileSize;
 
-    //set the file pointer
-    fseek(g_file_handle, GCMFilePtr->FileData->DiskAddr + NewPos, SEEK_SET);
-    NewPos = ftell(g_file_handle);
-
     //adjust the struct
-    NewPos -= GCMFilePtr->FileData->DiskAddr;
     GCMFilePtr->CurPos = NewPos;
     return NewPos;
 }
@@ -216,7 +210,7 @@ DEFRealDVDClose(GCMDVDClose)
 
     LOG_NOTICE(TDVD, "GCMDVDClose");
 
-    if(g_file_handle == NULL) {
+    if(!g_disc_image.IsOpen()) {
         return 0;
     }
 
@@ -227,7 +221,7 @@ DEFRealDVDClose(GCMDVDClose)
     //if the special id, update the file handle to the first entry
     if(FilePtr == REALDVD_LOWLEVEL) {
         //cleanup
-        fclose(g_file_handle);
+        g_disc_image.Close();
 
         if(DumpGCMBlockReads) {
             fclose(g_dump_file_handle);
@@ -251,8 +245,6 @@ DEFRealDVDClose(GCMDVDClose)
         free(FST);
         free(LowLevelPtr);
         FST = NULL;
-
-        g_file_handle = NULL;
         return 0;
     }
     else
@@ -281,7 +273,7 @@ DEFRealDVDGetFileSize(GCMDVDGetFileSize)
 
     LOG_NOTICE(TDVD, "GCMDVDGetFileSize");
 
-    if(g_file_handle == NULL)
+    if(!g_disc_image.IsOpen())
         return 0;
 
     if(FilePtr == 0)
@@ -305,7 +297,7 @@ DEFRealDVDGetPos(GCMDVDGetPos)
 
     LOG_NOTICE(TDVD, "GCMDVDGetPos");
 
-    if(g_file_handle == NULL)
+    if(!g_disc_image.IsOpen())
         return 0;
 
     if(FilePtr == 0)
@@ -591,15 +583,15 @@ int LoadGCM(char *filename)
     GCMFileData *	BannerData;
     char *			FileSlash;
     char			Header[SIZE_OF_GCM_HEADER];
+    u32				DiscPos;
 
     //if a file is already open, fail
-    if(g_file_handle != NULL) {
+    if(g_disc_image.IsOpen()) {
         return E_ERR;
     }
 
     //open it up
-    g_file_handle = fopen(filename, "rb");
-    if (g_file_handle == NULL) {
+    if (!g_disc_image.Open(filename)) {
         LOG_ERROR(TDVD, "Failed to open %s!", filename);
         return E_ERR;
     }
@@ -629,24 +621,30 @@ int LoadGCM(char *filename)
     Memory_Open();
 
     //read the first 32 bytes into the root memory area
-    BytesRead = fread(&Mem_RAM[0], 1, 32, g_file_handle);
+    BytesRead = (DWORD)g_disc_image.Read(0, &Mem_RAM[0], 32);
 
     //get a copy of the CRC into the header
     memcpy(Header, &Mem_RAM[0], 32);
 
+    //the game code and maker code make up the game ID
+    memcpy(g_current_game_id, Header, 6);
+    g_current_game_id[6] = '\0';
+
     if(DumpGCMBlockReads) {
 // TODO
 //        WriteFile(DumpFileHandle, &Mem_RAM[0], 32, &BytesRead, 0);
     }
 
+#ifndef MEM_NATIVE_BE
     //swap the memory around
     for(i = 0; i < (32 >> 2); i++) {
         *(u32 *)(&Mem_RAM[i * 4]) = BSWAP32(*(u32 *)(&Mem_RAM[i * 4]));
     }
+#endif
 
     //read the game name, make sure the last byte is null terminated
     //0x400 - 0x20 = 3E0
-    BytesRead = fread(g_current_game_name, 1, 0x3E0, g_file_handle);
+    BytesRead = (DWORD)g_disc_image.Read(0x20, g_current_game_name, 0x3E0);
 
     if(DumpGCMBlockReads) {
 // TODO
@@ -676,20 +674,11 @@ int LoadGCM(char *filename)
     //see if we are in pal mode
     if(Memory_Read8(0x80000003) == (u8)'P') Memory_Write32(0x800000CC, 1);
 
-    //read the FST
-    fseek(g_file_handle, 0x424, SEEK_SET);
-    if (ftell(g_file_handle) != 0x424) {
-        fclose(g_file_handle);
-        g_file_handle = NULL;
-        return E_ERR;
-    }
-
     //get the FST info header
-    BytesRead = fread(&FSTInfo, 1, sizeof(FSTInfo), g_file_handle);
+    BytesRead = (DWORD)g_disc_image.Read(0x424, &FSTInfo, sizeof(FSTInfo));
     if(BytesRead != sizeof(FSTInfo))
     {
-        fclose(g_file_handle);
-        g_file_handle = NULL;
+        g_disc_image.Close();
         return E_ERR;
     }
 
@@ -706,19 +695,11 @@ int LoadGCM(char *filename)
     Memory_Write32(0x80000038, FSTInfo.MemLocation);
     Memory_Write32(0x8000003C, FSTInfo.MaxSize);
 
-    fseek(g_file_handle, FSTInfo.Offset + 8, SEEK_SET);
-    if (ftell(g_file_handle) != (FSTInfo.Offset + 8)) {
-        fclose(g_file_handle);
-        g_file_handle = NULL;
-        return E_ERR;
-    }
-
     //read 4 bytes for the number of files
-    BytesRead = fread(&FileCount, 1, 4, g_file_handle);
+    BytesRead = (DWORD)g_disc_image.Read(FSTInfo.Offset + 8, &FileCount, 4);
     if(BytesRead != 4)
     {
-        fclose(g_file_handle);
-        g_file_handle = NULL;
+        g_disc_image.Close();
         return E_ERR;
     }
 
@@ -728,12 +709,7 @@ int LoadGCM(char *filename)
     }
 
     //go back. the first entry is empty but tells the number of files
-    fseek(g_file_handle, FSTInfo.Offset, SEEK_SET);
-    if (ftell(g_file_handle) != FSTInfo.Offset) {
-        fclose(g_file_handle);
-        g_file_handle = NULL;
-        return E_ERR;
-    }
+    DiscPos = FSTInfo.Offset;
 
     //allocate memory for the FST info and filenames
     FileCount = BSWAP32(FileCount);
@@ -743,11 +719,11 @@ int LoadGCM(char *filename)
     memset(&GCMFSTData[FileCount], 0, sizeof(GCMFST));
 
     //read the data
-    BytesRead = fread(GCMFSTData, 1, foo, g_file_handle);
+    BytesRead = (DWORD)g_disc_image.Read(DiscPos, GCMFSTData, foo);
+    DiscPos += BytesRead;
     if(BytesRead != (foo))
     {
-        fclose(g_file_handle);
-        g_file_handle = NULL;
+        g_disc_image.Close();
         return E_ERR;
     }
 
@@ -774,11 +750,10 @@ int LoadGCM(char *filename)
 
     TempData = FSTInfo.Size - (FileCount * sizeof(GCMFST));
     //ReadFile(FileHandle, FileNames, TempData, &BytesRead, 0);
-    BytesRead = fread(FileNames, 1, TempData, g_file_handle);
+    BytesRead = (DWORD)g_disc_image.Read(DiscPos, FileNames, TempData);
     if(BytesRead != TempData)
     {
-        fclose(g_file_handle);
-        g_file_handle = NULL;
+        g_disc_image.Close();
         free(FileNames);
         free(GCMFSTData);
         return E_ERR;
@@ -811,8 +786,7 @@ int LoadGCM(char *filename)
 
     FST = (GCMFileData *)malloc(sizeof(GCMFileData));
     if (!FST) {
-        fclose(g_file_handle);
-        g_file_handle = NULL;
+        g_disc_image.Close();
         free(FileNames);
         free(GCMFSTData);
         return E_ERR;
@@ -828,10 +802,7 @@ int LoadGCM(char *filename)
     FST->FileCount = FileCount;
     FST->FileList = (GCMFileData *)malloc(FileCount * sizeof(GCMFileData));
     memset(FST->FileList, 0, FileCount * sizeof(GCMFileData));
-    size_t pos = ftell(g_file_handle);
-    fseek(g_file_handle, 0L, SEEK_END);
-    FST->FileSize = ftell(g_file_handle);
-    fseek(g_file_handle, pos, SEEK_SET);
+    FST->FileSize = (u32)g_disc_image.size();
     FST->DiskAddr = 0;
     FST->Filename = NULL;
     FST->IsDirectory = 1;
@@ -883,9 +854,8 @@ int LoadGCM(char *filename)
     //We only grab the first one....
     if(BannerData) {
         //read the banner
-        fseek(g_file_handle, BannerData->DiskAddr, SEEK_SET);
         if (BannerData->FileSize == sizeof(Banner)) {
-            BytesRead = fread(Banner, BannerData->FileSize, 1, g_file_handle);
+            BytesRead = (DWORD)g_disc_image.Read(BannerData->DiskAddr, Banner, BannerData->FileSize);
 
             if(DumpGCMBlockReads) {
 // TODO
@@ -895,7 +865,7 @@ int LoadGCM(char *filename)
             BannerCRC = GetBnrChecksum(Banner);
         } else if (BannerData->FileSize > sizeof(Banner) && (BannerData->FileSize - 0x1820) % 0x140 == 0x00) {
             //ReadFile(FileHandle, Banner2, BannerData->FileSize, &BytesRead, 0);
-            BytesRead = fread(Banner2, BannerData->FileSize, 1, g_file_handle);
+            BytesRead = (DWORD)g_disc_image.Read(BannerData->DiskAddr, Banner2, BannerData->FileSize);
 
             if(DumpGCMBlockReads) {
 // TODO
@@ -912,8 +882,7 @@ int LoadGCM(char *filename)
     HLE_GetGameCRC(g_current_game_crc, (u8 *)Header, BannerCRC);
 
     //load up the data for the apploader
-    fseek(g_file_handle, 0x2440, SEEK_SET);
-    BytesRead = fread(AppLoaderHeader, sizeof(AppLoaderHeader), 1, g_file_handle);
+    BytesRead = (DWORD)g_disc_image.Read(0x2440, AppLoaderHeader, sizeof(AppLoaderHeader));
 
     if(DumpGCMBlockReads) {
 // TODO
@@ -921,8 +890,7 @@ int LoadGCM(char *filename)
     }
 
     //load the image
-    fseek(g_file_handle, 0x2460, SEEK_SET);
-    BytesRead = fread(&Mem_RAM[0x81200000 & RAM_MASK], 1, BSWAP32(AppLoaderHeader[5]), g_file_handle);
+    BytesRead = (DWORD)g_disc_image.Read(0x2460, &Mem_RAM[0x81200000 & RAM_MASK], BSWAP32(AppLoaderHeader[5]));
 
     if(DumpGCMBlockReads) {
 // TODO
@@ -930,11 +898,13 @@ int LoadGCM(char *filename)
 //            &BytesRead, 0);
     }
 
+#ifndef MEM_NATIVE_BE
     //flip the memory around as needed
     for (i = 0; i < ((BytesRead >> 2) + 1); i++) {
         *(u32 *)(&Mem_RAM[(0x81200000 + (i * 4)) & RAM_MASK]) = 
             BSWAP32(*(u32 *)(&Mem_RAM[(0x81200000 + (i * 4)) & RAM_MASK]));
     }
+#endif
 
     Bootrom(FSTInfo.MemLocation);
     Flipper_Open(); // TODO: wrong place for this!!
@@ -954,7 +924,7 @@ int ReadGCMInfo(const char *filename, unsigned long *filesize, void *BannerBuffe
     char*    file_names = NULL;
     int      file_names_size;
     int      foo; // gotta admire ShizZy's creativity when naming variables
-    FILE*    file_handle;
+    DiscImage  disc;
     u8*      header_data[0x1000];
     int ret = E_ERR;
 
@@ -963,17 +933,17 @@ int ReadGCMInfo(const char *filename, unsigned long *filesize, void *BannerBuffe
     if (!Header)
         Header = &gcm_header;
 
-    // Open file
-    file_handle = fopen(filename, "rb");
-    if (file_handle == NULL) {
+    // Always open a private image, even for the running game. This is called from the game list
+    // thread, while the DI emulation may close or reopen g_disc_image at any time
+    if (!disc.Open(filename)) {
         return E_ERR;
     }
 
     if (filesize)
-        *filesize = common::FileSize(file_handle);
+        *filesize = (unsigned long)disc.size();
 
     // Read the GCM header, check magic word
-    read_count = fread(Header, 1, sizeof(GCMHeader), file_handle);
+    read_count = disc.Read(0, Header, sizeof(GCMHeader));
     if (read_count != sizeof(GCMHeader))
         goto cleanup;
 
@@ -984,20 +954,11 @@ int ReadGCMInfo(const char *filename, unsigned long *filesize, void *BannerBuffe
     // TODO(neobrain): Is this correct?
     Header->fst_header.MemLocation += RAM_24MB - 4*1024*1024; //last 4 megs of mem
 
-    fseek(file_handle, Header->fst_header.Offset + 8, SEEK_SET);
-    if (ftell(file_handle) != (Header->fst_header.Offset + 8))
-        goto cleanup;
-
     // Read 4 bytes for the number of files
-    read_count = fread(&gcm_file_count, 1, 4, file_handle);
+    read_count = disc.Read(Header->fst_header.Offset + 8, &gcm_file_count, 4);
     if (read_count != 4)
         goto cleanup;
 
-    // Go back. the first entry is empty but tells the number of files
-    fseek(file_handle, Header->fst_header.Offset, SEEK_SET);
-    if (ftell(file_handle) != Header->fst_header.Offset)
-        goto cleanup;
-
     // Allocate memory for the FST info and filenames
     gcm_file_count = BSWAP32(gcm_file_count);
     gcm_fst_data = new GCMFST[gcm_file_count+1];
@@ -1005,8 +966,8 @@ int ReadGCMInfo(const char *filename, unsigned long *filesize, void *BannerBuffe
     foo = gcm_file_count * sizeof(GCMFST);
     file_names = new char[Header->fst_header.Size - foo];
 
-    // Read the data
-    read_count = fread(gcm_fst_data, 1, foo, file_handle);
+    // Read the data, the first entry is empty but tells the number of files
+    read_count = disc.Read(Header->fst_header.Offset, gcm_fst_data, foo);
     if (read_count != foo)
         goto cleanup;
 
@@ -1017,7 +978,7 @@ int ReadGCMInfo(const char *filename, unsigned long *filesize, void *BannerBuffe
         gcm_fst_data[i].NameOffset = BSWAP32(gcm_fst_data[i].NameOffset);
     }
     file_names_size = Header->fst_header.Size - (gcm_file_count * sizeof(GCMFST));
-    read_count = fread(file_names, 1, file_names_size, file_handle);
+    read_count = disc.Read(Header->fst_header.Offset + foo, file_names, file_names_size);
     if (read_count != file_names_size)
         goto cleanup;
 
@@ -1028,8 +989,7 @@ int ReadGCMInfo(const char *filename, unsigned long *filesize, void *BannerBuffe
             // Found the entry, read it's data and exit
             if (BannerBuffer)
             {
-                fseek(file_handle, (gcm_fst_data[i].DiskAddr), SEEK_SET);
-                read_count = fread(BannerBuffer, 0x1960, 1, file_handle);
+                read_count = disc.Read(gcm_fst_data[i].DiskAddr, BannerBuffer, 0x1960);
             }
             break;
         }
@@ -1042,7 +1002,6 @@ int ReadGCMInfo(const char *filename, unsigned long *filesize, void *BannerBuffe
 cleanup:
     delete[] file_names;
     delete[] gcm_fst_data;
-    fclose(file_handle);
 
     return ret;
 }
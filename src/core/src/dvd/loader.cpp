@@ -37,6 +37,8 @@ int LoadBootableFile(char* filename) {
     char *PipeData;
     u32 FileLoaded = 1;
 
+    g_current_game_id[0] = '\0';
+
     if (!common::FileExists(filename)) {
         return E_ERR;
     }
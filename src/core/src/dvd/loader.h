@@ -81,6 +81,7 @@ int ReadGCMInfo(const char *filename, unsigned long *filesize, void *BannerBuffe
 
 extern char g_current_game_name[992];   ///< Currently loaded game name
 extern char g_current_game_crc[7];      ///< Currently loaded game checksum
+extern char g_current_game_id[7];       ///< Currently loaded game ID (e.g. GALE01), empty if none
 
 } // namespace
 
@@ -170,7 +170,7 @@ void HLE_DetectFunctions()
     for(Addr = 0x80002000; Addr < 0x81000000; Addr+= 4)
     {
         //see if we have something other than 0x00000000
-        if(*(u32 *)&Mem_RAM[Addr & RAM_MASK])
+        if(MEM_LOAD32(&Mem_RAM[Addr & RAM_MASK]))
         {
             //have a value, detect the function
             FuncSize = HLE_DetectFunctionSize(Addr);
@@ -508,7 +508,7 @@ u32 HLE_DetectFunctionSize(u32 addr)
     for(;;)
     {
         //get an opcode
-        OpCode = *(u32 *)&Mem_RAM[CurAddr & RAM_MASK];
+        OpCode = MEM_LOAD32(&Mem_RAM[CurAddr & RAM_MASK]);
         if(!OpCode)
             break;
         else if((OpCode & 0xFC000000) == 0x40000000)
@@ -539,7 +539,7 @@ u32 HLE_DetectFunctionSize(u32 addr)
             {
                 //straight branch, check for a mflr r0 immediately after which could indicate
                 //the start of another function
-                if(*(u32*)&Mem_RAM[(CurAddr + 4) & RAM_MASK] == 0x7C0802A6)
+                if(MEM_LOAD32(&Mem_RAM[(CurAddr + 4) & RAM_MASK]) == 0x7C0802A6)
                     break;
                 else if(((OpCode & 3) == 0) && (CurAddr + (s16)(OpCode & 0x3FFFFFC) < addr))
                     break;		//branch outside of the start without a return
@@ -553,7 +553,7 @@ u32 HLE_DetectFunctionSize(u32 addr)
             {
                 //rfi
                 //some map files indicate a nop after the rfi, if there is a nop then count it
-                if(*(u32 *)&Mem_RAM[(CurAddr + 4) & RAM_MASK] == 0x60000000)
+                if(MEM_LOAD32(&Mem_RAM[(CurAddr + 4) & RAM_MASK]) == 0x60000000)
                     CurAddr += 4;
 
                 break;
@@ -578,14 +578,14 @@ u32 HLE_GenerateFunctionCRC(u32 Addr, u32 FuncSize)
     //calculate 2 opcodes at a time
     for(; FuncSize > 7; FuncSize-=8)
     {
-        CurOp = *(u32 *)&Mem_RAM[Addr & RAM_MASK];
+        CurOp = MEM_LOAD32(&Mem_RAM[Addr & RAM_MASK]);
         CurOp = CurOp & hle_op_mask[CurOp >> 26];
         ulCRC ^= CurOp;
         ulCRC = crc32_table[3][((ulCRC) & 0xFF)] ^
             crc32_table[2][((ulCRC >> 8) & 0xFF)] ^
             crc32_table[1][((ulCRC >> 16) & 0xFF)] ^
             crc32_table[0][((ulCRC >> 24))];
-        CurOp = *(u32 *)&Mem_RAM[Addr & RAM_MASK];
+        CurOp = MEM_LOAD32(&Mem_RAM[Addr & RAM_MASK]);
         CurOp = CurOp & hle_op_mask[CurOp >> 26];
         ulCRC ^= CurOp;
         ulCRC = crc32_table[3][((ulCRC) & 0xFF)] ^
@@ -598,7 +598,7 @@ u32 HLE_GenerateFunctionCRC(u32 Addr, u32 FuncSize)
     //if anything left then handle it
     if(FuncSize)
     {
-        CurOp = *(u32 *)&Mem_RAM[Addr & RAM_MASK];
+        CurOp = MEM_LOAD32(&Mem_RAM[Addr & RAM_MASK]);
         CurOp = CurOp & hle_op_mask[CurOp >> 26];
         ulCRC ^= CurOp;
         ulCRC = crc32_table[3][((ulCRC) & 0xFF)] ^
@@ -625,7 +625,7 @@ void HLE_FindFuncsAndGenerateCRCs()
     for(Addr = 0x80002000; Addr < 0x81000000; Addr+= 4)
     {
         //see if we have something other than 0x00000000
-        if(*(u32 *)&Mem_RAM[Addr & RAM_MASK])
+        if(MEM_LOAD32(&Mem_RAM[Addr & RAM_MASK]))
         {
             //have a value, detect the function
             FuncSize = HLE_DetectFunctionSize(Addr);
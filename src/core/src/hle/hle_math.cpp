@@ -62,20 +62,19 @@ static inline void MTXRotTrig(MtxPtr _m, u32 _ax, f32 _sin, f32 _cos)
 
 HLE(PSMTXInverse)
 {
-	MtxPtr src = (MtxPtr)(&Mem_RAM[GPR(3) & RAM_MASK]);
-	MtxPtr inv = (MtxPtr)(&Mem_RAM[GPR(4) & RAM_MASK]);
-    MtxPtr m;
+	u8* src_ptr = &Mem_RAM[GPR(3) & RAM_MASK];
+	u8* inv_ptr = &Mem_RAM[GPR(4) & RAM_MASK];
+    Mtx src_mtx;
+    Mtx inv_mtx;
+    MtxPtr src = &src_mtx;
+    MtxPtr m = &inv_mtx;
     f32 det;
+    int i;
 
-//    BSwapData((u32*)src, SIZE_OF_MTX3X4);
-//    BSwapData((u32*)inv, SIZE_OF_MTX3X4);
-
-    if( src == inv )
-    {
-        m = mTmp;
-    }else{
-        m = inv;
-    }
+    // Work on copies in host order, so src and inv may be the same matrix and RAM layout
+    // (MEM_NATIVE_BE or not) doesn't matter
+    for(i = 0; i < 12; i++)
+        src->_u32[i >> 2][i & 3] = MEM_LOAD32(src_ptr + i * 4);
 
     det =   src->_f32[0][0]*src->_f32[1][1]*src->_f32[2][2] + src->_f32[0][1]*src->_f32[1][2]*src->_f32[2][0] + src->_f32[0][2]*src->_f32[1][0]*src->_f32[2][1]
           - src->_f32[2][0]*src->_f32[1][1]*src->_f32[0][2] - src->_f32[1][0]*src->_f32[0][1]*src->_f32[2][2] - src->_f32[0][0]*src->_f32[2][1]*src->_f32[1][2];
@@ -104,14 +103,9 @@ HLE(PSMTXInverse)
     m->_f32[1][3] = -m->_f32[1][0]*src->_f32[0][3] - m->_f32[1][1]*src->_f32[1][3] - m->_f32[1][2]*src->_f32[2][3];
     m->_f32[2][3] = -m->_f32[2][0]*src->_f32[0][3] - m->_f32[2][1]*src->_f32[1][3] - m->_f32[2][2]*src->_f32[2][3];
 
-    if( m == mTmp )
-    {
-        MTXCopy( mTmp,inv );
-    }
-
-//    BSwapData((u32*)src, SIZE_OF_MTX3X4);
-//    BSwapData((u32*)inv, SIZE_OF_MTX3X4);
-//	BSwapData((u32*)m, SIZE_OF_MTX3X4);
+    Memory_MarkWritten(GPR(4), SIZE_OF_MTX3X4);
+    for(i = 0; i < 12; i++)
+        MEM_STORE32(inv_ptr + i * 4, m->_u32[i >> 2][i & 3]);
 
     GPR(5) = 1;
 	return;
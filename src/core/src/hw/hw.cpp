@@ -14,30 +14,35 @@
 #include "hw_ai.h"
 #include "hw_di.h"
 #include "hw_cp.h"
+#include "hw_event.h"
 #include "powerpc/cpu_core_regs.h"
 
 ////////////////////////////////////////////////////////////
 
-// Desc: Update Flipper Hardware
+// Desc: Periodic poll for hardware that raises level interrupts
+// outside of the CPU thread's register writes (GP tokens, DSP HLE
+// mail, memory card EXI transfers). Also flushes the GX FIFO.
 //
 
-u32 EMU_FASTCALL Flipper_Update(void)
+static int FlipperEventPoll = EVENT_INVALID;
+
+static void Flipper_PollEvent(u32 userdata, s64 late)
 {
-	static u32 FlipCount = 0;
+	DSP_Update();
+	EXI_Update();
+	PE_Update();
+	GX_Update();
 
-	FlipCount++;
+	Event_Schedule(FlipperEventPoll, FLIPPER_POLL_TICKS);
+}
 
-	if(!(FlipCount & 0x7F))
-	{
-		FlipCount = 0;
-		{
-			DSP_Update();
-			EXI_Update();
-			VI_Update();
-			AI_Update();
-            PE_Update();
-		}
-	}
+// Desc: Update Flipper Hardware - runs any due hardware events
+//
+
+u32 EMU_FASTCALL Flipper_Update(void)
+{
+	if(ireg.TBR.TBR >= g_EventNextTick)
+		Event_Advance();
 
 	return PI_CheckForInterrupts();
 }
@@ -47,6 +52,8 @@ u32 EMU_FASTCALL Flipper_Update(void)
 
 void Flipper_Open(void)
 {
+	Event_Open();
+
 	CP_Open();
 	PE_Open();
 	PI_Open();
@@ -58,6 +65,9 @@ void Flipper_Open(void)
 	AI_Open();
 	DI_Open();
 	GX_Open();
+
+	FlipperEventPoll = Event_Register("Flipper_Poll", Flipper_PollEvent);
+	Event_Schedule(FlipperEventPoll, FLIPPER_POLL_TICKS);
 }
 
 // Desc: Shutdown Flipper Hardware
@@ -26,6 +26,7 @@
 
 #define BUS_CLOCK_SPEED				0x09A7EC80 // 162 MHz
 #define GEKKO_CLOCK_SPEED			0x1Cf7C580 // 486 MHz
+#define FLIPPER_POLL_TICKS			0x00000400 // Ticks between polls of level interrupts
 #define CONSOLE_TYPE_RETAIL1		0x00000001 // Console - Retail Version
 #define CONSOLE_TYPE_HW2_PB			0x00000002 // Console - HW2 Production Board
 #define CONSOLE_TYPE_LATEST_PB		0x00000003 // Console - Latest Production Board
@@ -6,6 +6,8 @@
 #include "hw_ai.h"
 #include "hw_pi.h"
 #include "hw_dsp.h"
+#include "hw_event.h"
+#include "powerpc/cpu_core.h"
 
 //
 
@@ -13,6 +15,7 @@ u8		AIRegisters[REG_SIZE];
 
 s32		g_AISampleRate;
 u32		AICRInterrupt = 0;
+static int		AIEventSample = EVENT_INVALID;
 
 ////////////////////////////////////////////////////////////
 // AI - Audio Interface
@@ -90,6 +93,11 @@ void EMU_FASTCALL AI_Write32(u32 addr, u32 data)
 			AI_SetSampleRate(32000);
 
 		AICRInterrupt = REGAI32(AI_CR) & (AI_CR_PSTAT | AI_CR_AIINTVLD);
+
+		if(!AICRInterrupt)
+			Event_Deschedule(AIEventSample);
+		else if(!Event_IsScheduled(AIEventSample))
+			Event_Schedule(AIEventSample, cpu->GetTicksPerSecond() / g_AISampleRate);
 		return;
 
 	case AI_IT:
@@ -105,7 +113,7 @@ void EMU_FASTCALL AI_Write32(u32 addr, u32 data)
 
 ////////////////////////////////////////////////////////////
 
-// Desc: Update AI Hardware
+// Desc: Update AI Hardware - sample counter event, runs once per sample
 //
 
 void AI_Update(void)
@@ -125,6 +133,14 @@ void AI_Update(void)
     }
 }
 
+static void AI_SampleEvent(u32 userdata, s64 late)
+{
+	AI_Update();
+
+	if(AICRInterrupt)
+		Event_Schedule(AIEventSample, cpu->GetTicksPerSecond() / g_AISampleRate);
+}
+
 // Desc: Initialize AI Hardware
 //
 
@@ -132,6 +148,9 @@ void AI_Open(void)
 {
     LOG_NOTICE(TAI, "initialized ok");
 	memset(&AIRegisters, 0, sizeof(AIRegisters));
+
+	AICRInterrupt = 0;
+	AIEventSample = Event_Register("AI_Sample", AI_SampleEvent);
 }
 
 ////////////////////////////////////////////////////////////
@@ -47,25 +47,39 @@ void DIProcessCmd()
 //		hw_di.DMALength -= dvd::RealDVDRead(REALDVD_LOWLEVEL, MEMPTR32(hw_di.DMAMemory), hw_di.CmdBuff[2]);
 
 		ReadLen = hw_di.CmdBuff[2];
-		NewMemPtr = hw_di.DMAMemory;
-		while(ReadLen >= 1024*1024)
-		{
-			hw_di.DMALength -= dvd::RealDVDRead(REALDVD_LOWLEVEL, (u32 *)DVDDataBuff, 1024*1024);
-
-			for(i = 0; i < 1024*1024; i+=4)
-				Memory_Write32(NewMemPtr + i, BSWAP32(*(u32 *)&DVDDataBuff[i]));
+		NewMemPtr = hw_di.DMAMemory & RAM_MASK;
+		if(NewMemPtr + ReadLen > RAM_SIZE)
+			ReadLen = RAM_SIZE - NewMemPtr;
 
-			NewMemPtr += 1024*1024;
-			ReadLen -= 1024*1024;
+		//read the word aligned part straight into RAM and swap it in place,
+		//the range is marked written once for the whole transfer
+		if(!(NewMemPtr & 3))
+		{
+			i = ReadLen & ~3;
+			Memory_MarkWritten(NewMemPtr, i);
+			i = dvd::RealDVDRead(REALDVD_LOWLEVEL, (u32 *)&Mem_RAM[NewMemPtr], i);
+			Memory_SwapRAM(NewMemPtr, i);
+
+			hw_di.DMALength -= i;
+			NewMemPtr += i;
+			ReadLen -= i;
 		}
 
-		hw_di.DMALength -= dvd::RealDVDRead(REALDVD_LOWLEVEL, (u32 *)DVDDataBuff, ReadLen);
+		//unaligned leftovers go through the bounce buffer
+		while(ReadLen)
+		{
+			u32 ChunkLen = (ReadLen < 1024*1024) ? ReadLen : 1024*1024;
 
-		for(i = 0; i < (ReadLen >> 2); i++)
-			Memory_Write32(NewMemPtr + (i * 4), BSWAP32(*(u32 *)&DVDDataBuff[(i * 4)]));
+			i = dvd::RealDVDRead(REALDVD_LOWLEVEL, (u32 *)DVDDataBuff, ChunkLen);
+			Memory_CopyToRAM(NewMemPtr, DVDDataBuff, i);
 
-		for(i = (i * 4); i < ReadLen; i++)
-			Memory_Write8(NewMemPtr + i, DVDDataBuff[i]);
+			hw_di.DMALength -= i;
+			if(i != ChunkLen)
+				break;
+
+			NewMemPtr += ChunkLen;
+			ReadLen -= ChunkLen;
+		}
 
 //		hw_di.DMALength -= dvd::RealDVDRead(REALDVD_LOWLEVEL, MEMPTR32(hw_di.DMAMemory), hw_di.CmdBuff[2]);
 //		cpu->CheckMemoryWrite(hw_di.DMAMemory, hw_di.CmdBuff[2]);
@@ -7,6 +7,7 @@
 #include "hw_dsp.h"
 #include "hw_pi.h"
 #include "hw_ai.h"
+#include "hw_event.h"
 #include "hle/hle_dsp.h"
 #include "powerpc/cpu_core_regs.h"
 
@@ -23,6 +24,7 @@ u32		mbox_dsp_cpu; /* from the dsp to the cpu */
 u32		dspDMALenENBSet = 0;
 u32		dspCSRDSPIntMask = 0;
 u32		dspCSRDSPInt = 0;
+static int		DSPEventDMA = EVENT_INVALID;
 
 u16		g_AR_INFO;
 u16		g_AR_MODE;
@@ -88,20 +90,12 @@ void AudioRam_DMA(u32 _type, u32 _maddr, u32 _aaddr, u32 _size)
 			if(_type & 0x80000000)
 			{
 				//ARAM to RAM
-				for(i = 0; i < (_size >> 2); i++)
-					Memory_Write32(_maddr + (i * 4), BSWAP32(*(u32 *)&ARAM[_aaddr + (i * 4)]));
-
-				for(i = i * 4; i < _size; i++)
-					Memory_Write8(_maddr + i, *(u32 *)&ARAM[_aaddr + i]);
+				Memory_CopyToRAM(_maddr, &ARAM[_aaddr], _size);
 			}
 			else
 			{
 				//RAM to ARAM
-				for(i = 0; i < (_size >> 2); i++)
-					*(u32 *)&ARAM[_aaddr + (i * 4)] = BSWAP32(Memory_Read32(_maddr + (i * 4)));
-
-				for(i = i * 4; i < _size; i++)
-					ARAM[_aaddr + i] = Memory_Read8(_maddr + i);
+				Memory_CopyFromRAM(&ARAM[_aaddr], _maddr, _size);
 			}
 
 			REGDSP32(DSP_AR_DMA_CNT) &= 0x80000000;								// Reset count register
@@ -316,6 +310,9 @@ void EMU_FASTCALL DSP_Write16(u32 addr, u32 data)
 		dspDMALenENBSet = (data & DSP_DMALEN_ENB);
 		if(data & DSP_DMALEN_ENB)
 		{
+			if(!Event_IsScheduled(DSPEventDMA))
+				Event_ScheduleAbsolute(DSPEventDMA, g_DSPDMATime);
+
 			//printf("AI DMA from RAM len = %08x? %08x\n",data,REGDSP32(DSP_DMA_ADDR));
 			//REGDSP16(DSP_DMA_CNT) = REGDSP16(DSP_DMA_LEN) & ~DSP_DMALEN_ENB;
 
@@ -324,6 +321,8 @@ void EMU_FASTCALL DSP_Write16(u32 addr, u32 data)
 			//PI_RequestInterrupt(PI_MASK_DSP);
 			//PI_RequestInterrupt(PI_MASK_DSP);
 		} else {
+			Event_Deschedule(DSPEventDMA);
+
 			//printf("Stop sample?\n");
 			//PI_ClearInterrupt(PI_MASK_DSP);
 		}
@@ -376,27 +375,31 @@ void EMU_FASTCALL DSP_Write32(u32 addr, u32 data)
 
 ////////////////////////////////////////////////////////////
 
-// Desc: Update DSP Hardware
+// Desc: DSP (AI) DMA event - raised once per DMA block while enabled
 //
 
-void DSP_Update(void)
+static void DSP_DMAEvent(u32 userdata, s64 late)
 {
-	// DSP DMA (interrupt)
+	if(!dspDMALenENBSet)
+		return;
 
-	if(!dspDMALenENBSet || (ireg.TBR.TBR < (u64)g_DSPDMATime))
-	{}
-	else
-	{
-		REGDSP16(DSP_DMA_CNT) = REGDSP16(DSP_DMA_LEN) & ~DSP_DMALEN_ENB;
-		g_DSPDMATime = cpu->GetTicks() + DSP_GetDMATime(REGDSP16(DSP_DMA_CNT) * 32, g_AISampleRate);
+	REGDSP16(DSP_DMA_CNT) = REGDSP16(DSP_DMA_LEN) & ~DSP_DMALEN_ENB;
+	g_DSPDMATime = cpu->GetTicks() + DSP_GetDMATime(REGDSP16(DSP_DMA_CNT) * 32, g_AISampleRate);
 
-		REGDSP16(DSP_CSR) |= DSP_CSR_AIDINT;
-		if(REGDSP16(DSP_CSR) & DSP_CSR_AIDINTMSK)
-		{
-			PI_RequestInterrupt(PI_MASK_DSP);
-		}
+	REGDSP16(DSP_CSR) |= DSP_CSR_AIDINT;
+	if(REGDSP16(DSP_CSR) & DSP_CSR_AIDINTMSK)
+	{
+		PI_RequestInterrupt(PI_MASK_DSP);
 	}
 
+	Event_ScheduleAbsolute(DSPEventDMA, g_DSPDMATime);
+}
+
+// Desc: Update DSP Hardware
+//
+
+void DSP_Update(void)
+{
 	if (!dspCSRDSPInt || !dspCSRDSPIntMask)
 		return;
 	else
@@ -423,6 +426,9 @@ void DSP_Open(void)
 
 	g_DSPDMATime = 0;
 	g_AISampleRate = 32000;
+	dspDMALenENBSet = 0;
+
+	DSPEventDMA = Event_Register("DSP_DMA", DSP_DMAEvent);
 	g_AR_INFO = 0;
 	g_AR_MODE = 1;
         g_AR_REFRESH = 156;
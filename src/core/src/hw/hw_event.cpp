@@ -0,0 +1,218 @@
+// hw_event.cpp
+// (c) 2005,2012 Gekko Team
+
+#include "common.h"
+#include "hw.h"
+#include "hw_event.h"
+#include "powerpc/cpu_core_regs.h"
+
+////////////////////////////////////////////////////////////
+// Event Scheduler
+// Hardware timing (scanlines, audio samples, DMA completion...) is
+// driven by events keyed on the time base register. Pending events
+// are kept in a binary min-heap ordered by their due tick, with at
+// most one pending instance per event type, so the CPU core only
+// has to compare ireg.TBR against g_EventNextTick per block instead
+// of polling every device.
+////////////////////////////////////////////////////////////
+
+typedef struct t_sEventType
+{
+	const char*		name;			// Name, for debugging
+	EventCallback	callback;		// Handler
+	u64				tick;			// Due tick when scheduled
+	u32				userdata;		// Passed to the handler
+	s32				heap_pos;		// Position in heap, or -1 if not scheduled
+} sEventType;
+
+static sEventType	EventTypes[EVENT_MAX_TYPES];
+static u32			EventNumTypes = 0;
+
+static s32			EventHeap[EVENT_MAX_TYPES];
+static u32			EventHeapSize = 0;
+
+u64					g_EventNextTick = ~U64(0);
+
+////////////////////////////////////////////////////////////
+
+// Desc: Heap helpers
+//
+
+static inline bool Event_Less(s32 a, s32 b)
+{
+	return EventTypes[EventHeap[a]].tick < EventTypes[EventHeap[b]].tick;
+}
+
+static inline void Event_Swap(s32 a, s32 b)
+{
+	s32 tmp = EventHeap[a];
+	EventHeap[a] = EventHeap[b];
+	EventHeap[b] = tmp;
+
+	EventTypes[EventHeap[a]].heap_pos = a;
+	EventTypes[EventHeap[b]].heap_pos = b;
+}
+
+static void Event_SiftUp(s32 pos)
+{
+	while(pos > 0)
+	{
+		s32 parent = (pos - 1) >> 1;
+		if(!Event_Less(pos, parent))
+			break;
+
+		Event_Swap(pos, parent);
+		pos = parent;
+	}
+}
+
+static void Event_SiftDown(s32 pos)
+{
+	for(;;)
+	{
+		s32 left = (pos << 1) + 1;
+		s32 right = left + 1;
+		s32 smallest = pos;
+
+		if(left < (s32)EventHeapSize && Event_Less(left, smallest))
+			smallest = left;
+		if(right < (s32)EventHeapSize && Event_Less(right, smallest))
+			smallest = right;
+		if(smallest == pos)
+			break;
+
+		Event_Swap(pos, smallest);
+		pos = smallest;
+	}
+}
+
+static inline void Event_UpdateNextTick(void)
+{
+	g_EventNextTick = EventHeapSize ? EventTypes[EventHeap[0]].tick : ~U64(0);
+}
+
+static void Event_Remove(int type)
+{
+	s32 pos = EventTypes[type].heap_pos;
+	s32 last = --EventHeapSize;
+
+	EventTypes[type].heap_pos = -1;
+
+	if(pos != last)
+	{
+		EventHeap[pos] = EventHeap[last];
+		EventTypes[EventHeap[pos]].heap_pos = pos;
+
+		Event_SiftUp(pos);
+		Event_SiftDown(EventTypes[EventHeap[pos]].heap_pos);
+	}
+}
+
+////////////////////////////////////////////////////////////
+
+// Desc: Register a new event type, returns its handle
+//
+
+int Event_Register(const char* name, EventCallback callback)
+{
+	if(EventNumTypes >= EVENT_MAX_TYPES)
+	{
+		LOG_ERROR(THW, "Event_Register: too many event types, can't register %s!\n", name);
+		return EVENT_INVALID;
+	}
+
+	sEventType* ev = &EventTypes[EventNumTypes];
+
+	ev->name = name;
+	ev->callback = callback;
+	ev->tick = 0;
+	ev->userdata = 0;
+	ev->heap_pos = -1;
+
+	return EventNumTypes++;
+}
+
+// Desc: Schedule an event relative to the current time base. An event
+// that is already pending is moved to the new time.
+//
+
+void Event_Schedule(int type, s64 ticks_from_now, u32 userdata)
+{
+	Event_ScheduleAbsolute(type, ireg.TBR.TBR + ticks_from_now, userdata);
+}
+
+void Event_ScheduleAbsolute(int type, u64 tick, u32 userdata)
+{
+	if(type < 0 || type >= (int)EventNumTypes)
+		return;
+
+	sEventType* ev = &EventTypes[type];
+
+	ev->tick = tick;
+	ev->userdata = userdata;
+
+	if(ev->heap_pos < 0)
+	{
+		ev->heap_pos = EventHeapSize;
+		EventHeap[EventHeapSize++] = type;
+		Event_SiftUp(ev->heap_pos);
+	}
+	else
+	{
+		Event_SiftUp(ev->heap_pos);
+		Event_SiftDown(ev->heap_pos);
+	}
+
+	Event_UpdateNextTick();
+}
+
+// Desc: Remove a pending event
+//
+
+void Event_Deschedule(int type)
+{
+	if(type < 0 || type >= (int)EventNumTypes || EventTypes[type].heap_pos < 0)
+		return;
+
+	Event_Remove(type);
+	Event_UpdateNextTick();
+}
+
+bool Event_IsScheduled(int type)
+{
+	if(type < 0 || type >= (int)EventNumTypes)
+		return false;
+
+	return EventTypes[type].heap_pos >= 0;
+}
+
+// Desc: Run all events that are due. Handlers may reschedule themselves.
+//
+
+void Event_Advance(void)
+{
+	u64 now = ireg.TBR.TBR;
+
+	while(EventHeapSize && EventTypes[EventHeap[0]].tick <= now)
+	{
+		int type = EventHeap[0];
+		sEventType* ev = &EventTypes[type];
+
+		Event_Remove(type);
+		ev->callback(ev->userdata, (s64)(now - ev->tick));
+	}
+
+	Event_UpdateNextTick();
+}
+
+// Desc: Reset Scheduler - must be called before any hardware registers events
+//
+
+void Event_Open(void)
+{
+	memset(EventTypes, 0, sizeof(EventTypes));
+	EventNumTypes = 0;
+	EventHeapSize = 0;
+
+	g_EventNextTick = ~U64(0);
+}
@@ -0,0 +1,37 @@
+// hw_event.h
+// (c) 2005,2012 Gekko Team
+
+#ifndef _HW_EVENT_H_
+#define _HW_EVENT_H_
+
+////////////////////////////////////////////////////////////
+
+#define EVENT_MAX_TYPES				32			// Max number of registered event types
+#define EVENT_INVALID				-1			// Returned for a failed registration
+
+// Desc: Event callback. userdata is the value passed on scheduling, late is
+// the number of ticks the event fired after its requested time.
+//
+
+typedef void (*EventCallback)(u32 userdata, s64 late);
+
+// Tick of the earliest pending event (ireg.TBR), checked by Flipper_Update.
+
+extern u64 g_EventNextTick;
+
+////////////////////////////////////////////////////////////
+
+void	Event_Open(void);
+
+int		Event_Register(const char* name, EventCallback callback);
+
+void	Event_Schedule(int type, s64 ticks_from_now, u32 userdata = 0);
+void	Event_ScheduleAbsolute(int type, u64 tick, u32 userdata = 0);
+void	Event_Deschedule(int type);
+bool	Event_IsScheduled(int type);
+
+void	Event_Advance(void);
+
+////////////////////////////////////////////////////////////
+
+#endif
@@ -44,7 +44,6 @@ void MX_Transfer(u32 addr)
 {
 	u32		offset;
 	time_t	CurTime;
-	u32		i;
 
 	switch((exi.cr[0] & EXI_CR_RW) >> 2)
 	{
@@ -59,17 +58,12 @@ void MX_Transfer(u32 addr)
 				}
 				if(offset == 0x20000100)
 				{
-					for(i = 0; i < 64; i+=4)
-						Memory_Write32(exi.mar[0] + i, BSWAP32(*(u32 *)&SRAM[i]));
+					Memory_CopyToRAM(exi.mar[0], SRAM, 64);
 //					memcpy(&RAM[exi.mar[0] & RAM_MASK], &SRAM[0], 64);
 				}
 				else if((offset >= 0x00000000) && (offset < 0x08000000))
 				{
-					for(i = 0; i < (exi.len[0] >> 2); i++)
-						Memory_Write32(exi.mar[0] + (i * 4), BSWAP32(*(u32 *)&IPLRom[(offset >> 6) + (i * 4)]));
-
-					for(i = (i*4); i < exi.len[0]; i++)
-						Memory_Write8(exi.mar[0] + i, *(u32 *)&IPLRom[(offset >> 6) + i]);
+					Memory_CopyToRAM(exi.mar[0], &IPLRom[offset >> 6], exi.len[0]);
 
 //					memcpy(&RAM[exi.mar[0] & RAM_MASK], &IPLRom[offset >> 6], exi.len[0]);
 				}
@@ -38,7 +38,6 @@ void MemCard_Transfer(u32 addr)
 {
 	u32			Channel;
 	u32			Offset;
-	u32			i;
 
 	if(addr == EXI_CR0)
 		Channel = 0;
@@ -53,11 +52,7 @@ void MemCard_Transfer(u32 addr)
 		case 0:		//read
 			Offset = MemCard_ConvertOffset(WriteBuff[0], WriteBuff[1]);
 			printf(".EXI: DMA Memory Card %c Read %04X bytes from MC %08X to RAM %08X\n", 'A' + Channel, exi.len[Channel], Offset, exi.mar[Channel]);
-			for(i = 0; i < (exi.len[Channel] >> 2); i++)
-				Memory_Write32((exi.mar[Channel] + (i * 4)), BSWAP32((*(u32 *)(&MemCardData[Channel][(Offset + (i * 4)) & MemCardSizeMask]))));
-
-			for(i = (i*4); i < exi.len[Channel]; i++)
-				Memory_Write8((exi.mar[Channel] + i), (*(u32 *)(&MemCardData[Channel][(Offset + i) & MemCardSizeMask])));
+			Memory_CopyToRAM(exi.mar[Channel], &MemCardData[Channel][Offset & MemCardSizeMask], exi.len[Channel]);
 
 			MemCardInterruptSet[Channel] = 1;
 			break;
@@ -66,17 +61,7 @@ void MemCard_Transfer(u32 addr)
 			Offset = MemCard_ConvertOffset(WriteBuff[0], WriteBuff[1]);
 //			printf(".EXI: DMA Memory Card %c Wrote %04X bytes from RAM %08X to MC %08X\n", 'A' + Channel, exi.len[Channel], exi.mar[Channel], Offset);
 
-			for(i = 0; i < (exi.len[Channel] >> 2); i++)
-			{
-				*(u32 *)&MemCardData[Channel][(Offset + (i * 4)) & MemCardSizeMask] =
-						BSWAP32(Memory_Read32((exi.mar[Channel] + (i * 4))));
-			}
-
-			for(i = (i*4); i < exi.len[Channel]; i++)
-			{
-				MemCardData[Channel][(Offset + i) & MemCardSizeMask] =
-					Memory_Read8(exi.mar[Channel] + i);
-			}
+			Memory_CopyFromRAM(&MemCardData[Channel][Offset & MemCardSizeMask], exi.mar[Channel], exi.len[Channel]);
 
 //			memcpy(&MemCardData[Channel][Offset & MemCardSizeMask], &RAM[exi.mar[Channel] & RAM_MASK], exi.len[Channel]);
 			MemCardInterruptSet[Channel] = 1;
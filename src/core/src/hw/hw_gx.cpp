@@ -25,17 +25,18 @@
 
 void EMU_FASTCALL GX_Fifo_Write8(u32 addr, u32 data)
 {
-    gp::g_fifo_buffer[gp::g_fifo_write_ptr++] = data;
+    gp::Fifo_Push8(data);
     if (!common::g_config->enable_multicore()) {
+        gp::Fifo_Flush();
         gp::Fifo_DecodeCommand();
     }
 }
 
 void EMU_FASTCALL GX_Fifo_Write16(u32 addr, u32 data)
 {
-    *(u16*)(gp::g_fifo_buffer + gp::g_fifo_write_ptr) = BSWAP16(data);
-    gp::g_fifo_write_ptr += 2;
+    gp::Fifo_Push16(data);
     if (!common::g_config->enable_multicore()) {
+        gp::Fifo_Flush();
         gp::Fifo_DecodeCommand();
     }
 }
@@ -43,8 +44,7 @@ void EMU_FASTCALL GX_Fifo_Write16(u32 addr, u32 data)
 void EMU_FASTCALL GX_Fifo_Write32(u32 addr, u32 data) {
     static u8 cmd = FIFO_GET8(0);
     
-    *(u32*)(gp::g_fifo_buffer + gp::g_fifo_write_ptr) = BSWAP32(data);
-    gp::g_fifo_write_ptr += 4;
+    gp::Fifo_Push32(data);
     
     /*if ((data == 0x45000002) && ((cmd & 0xf8) == 0x60)) {
 
@@ -56,6 +56,7 @@ void EMU_FASTCALL GX_Fifo_Write32(u32 addr, u32 data) {
         PE_Update();
     }*/
     if (!common::g_config->enable_multicore()) {
+        gp::Fifo_Flush();
         gp::Fifo_DecodeCommand();
     }
 }
@@ -73,6 +74,14 @@ u32 EMU_FASTCALL GX_Fifo_Read32(u32 addr)
 
 ////////////////////////////////////////////////////////////////////////////////
 
+// Desc: Update GX Hardware - hands a partially filled write-gather burst to the GP
+// thread, so it doesn't sit in the FIFO while the CPU stops writing
+//
+
+void GX_Update() {
+    gp::Fifo_Flush();
+}
+
 // Desc: Open GX Hardware
 //
 
@@ -6,6 +6,7 @@
 #include "hw_vi.h"
 #include "hw_pi.h"
 #include "hw_si.h"
+#include "hw_event.h"
 #include "powerpc/cpu_core.h"
 #include "powerpc/cpu_core_regs.h"
 
@@ -271,10 +272,10 @@ void VI_YCbCr2RGB(void)
 		Yb	= vi.xfbbuf[i+2];
 		V	= vi.xfbbuf[i+3];
 */
-		Ya	= vi.xfbbuf[i+3];
-		U	= vi.xfbbuf[i+2];
-		Yb	= vi.xfbbuf[i+1];
-		V	= vi.xfbbuf[i+0];
+		Ya	= vi.xfbbuf[MEM_SWIZZLE8(i+0)];
+		U	= vi.xfbbuf[MEM_SWIZZLE8(i+1)];
+		Yb	= vi.xfbbuf[MEM_SWIZZLE8(i+2)];
+		V	= vi.xfbbuf[MEM_SWIZZLE8(i+3)];
 
 		// Fixed Point YUV2 2 RGB Conversions
 		s32 C = Ya - 16;
@@ -300,55 +301,52 @@ void VI_YCbCr2RGB(void)
 	}
 }
 
-// Desc: Update VI hardware (Per Scanline)
+// Desc: Update VI hardware (Per Scanline) - scanline event handler
 //
 
+static int VIEventScanline = EVENT_INVALID;
+
 void VI_Update(void)
 {
-	if(ireg.TBR.TBR >= vi.timer)
-	{
-		// Reset Timer
-		vi.timer = ireg.TBR.TBR + vi.tickcount;
+	VI_SCANLINE++;
 
-		VI_SCANLINE++;
-
-		if( VI_SCANLINE == vi.vct[0] ||
-			VI_SCANLINE == vi.vct[1] ||
-			VI_SCANLINE == vi.vct[2] ||
-			VI_SCANLINE == vi.vct[3]
-			)
+	if( VI_SCANLINE == vi.vct[0] ||
+		VI_SCANLINE == vi.vct[1] ||
+		VI_SCANLINE == vi.vct[2] ||
+		VI_SCANLINE == vi.vct[3]
+		)
+	{
+		// Check VSync Interrupts
+
+		if(REGVI32(VI_DI0) & VI_DI_ENB)
+			REGVI32(VI_DI0) |= VI_DI_INT;
+		if(REGVI32(VI_DI1) & VI_DI_ENB)
+			REGVI32(VI_DI1) |= VI_DI_INT;
+		if(REGVI32(VI_DI2) & VI_DI_ENB)
+			REGVI32(VI_DI2) |= VI_DI_INT;
+		if(REGVI32(VI_DI3) & VI_DI_ENB)
+			REGVI32(VI_DI3) |= VI_DI_INT;
+
+		if((REGVI32(VI_DI0) | REGVI32(VI_DI1) | REGVI32(VI_DI2) | REGVI32(VI_DI3))
+			& VI_DI_ENB)
 		{
-			// Check VSync Interrupts
-
-			if(REGVI32(VI_DI0) & VI_DI_ENB)
-				REGVI32(VI_DI0) |= VI_DI_INT;
-			if(REGVI32(VI_DI1) & VI_DI_ENB)
-				REGVI32(VI_DI1) |= VI_DI_INT;
-			if(REGVI32(VI_DI2) & VI_DI_ENB)
-				REGVI32(VI_DI2) |= VI_DI_INT;
-			if(REGVI32(VI_DI3) & VI_DI_ENB)
-				REGVI32(VI_DI3) |= VI_DI_INT;
-
-			if((REGVI32(VI_DI0) | REGVI32(VI_DI1) | REGVI32(VI_DI2) | REGVI32(VI_DI3))
-				& VI_DI_ENB)
-			{
-				PI_RequestInterrupt(PI_MASK_VI);
-			}
+			PI_RequestInterrupt(PI_MASK_VI);
 		}
+	}
 
-		if(VI_SCANLINE > vi.vretrace)
-		{
-			VI_SCANLINE = 1;
+	if(VI_SCANLINE > vi.vretrace)
+	{
+		VI_SCANLINE = 1;
 
-			// Poll Joypads
+		// Poll Joypads
 
-			SI_Poll();
+		SI_Poll();
 
-			// Set Television Mode
+		// Set Television Mode
 
-			VI_SetMode();
+		VI_SetMode();
 
-			// Update Framebuffer (if enabled)
+		// Update Framebuffer (if enabled)
 #pragma todo(Reimplement enable framebuffer feature)
 //			if(cfg.enb_framebuffer)
 //			{
@@ -356,10 +354,17 @@ void VI_Update(void)
 //              OPENGL_DrawFramebuffer();
 //              OPENGL_Render();
 //            }
-		}
 	}
 }
 
+static void VI_ScanlineEvent(u32 userdata, s64 late)
+{
+	VI_Update();
+
+	// Keep the scanline rate exact, unless the time base jumped ahead
+	Event_Schedule(VIEventScanline, (late < vi.tickcount) ? (vi.tickcount - late) : vi.tickcount);
+}
+
 // Desc: Initialize VI Hardware
 //
 
@@ -376,7 +381,9 @@ void VI_Open(void)
 	vi.framerate = 30;
 	vi.vretrace = VI_NTSC_NON_INTER;
 	vi.tickcount = (((cpu->GetTicksPerSecond() / vi.framerate) / vi.vretrace));
-	vi.timer = 0;
+
+	VIEventScanline = Event_Register("VI_Scanline", VI_ScanlineEvent);
+	Event_Schedule(VIEventScanline, vi.tickcount);
 
 	// Point FB in RAM
 	vi.xfbbuf = &Mem_RAM[0];
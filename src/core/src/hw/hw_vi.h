@@ -65,7 +65,6 @@ typedef struct t_sVI
 	u16		vretrace;		// Lines Per Frame
 	u32		tickcount;		// Ticks per frame
 	u16		vct[4];			// Vertical Interrupt Position
-	u64		timer;			// Timer for Cycles left
 
 	u32		xfb_addr;		// Address of the external frame buffer.
 
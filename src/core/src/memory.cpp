@@ -4,6 +4,11 @@
 #include "common.h"
 #include "memory.h"
 #include "hw/hw.h"
+#include "mem_arena.h"
+
+#ifdef EMU_ARCHITECTURE_X64
+#include <emmintrin.h>
+#endif
 
 ////////////////////////////////////////////////////////////////////////////////
 // Memory
@@ -21,13 +26,30 @@
 
 #pragma push(align)
 #pragma align 4096
+#if EMU_PLATFORM == PLATFORM_WINDOWS
 u8 Mem_L2[L2_SIZE]; // L2 Cache
+#else
+u8 Mem_L2[L2_SIZE] __attribute__((aligned(4096))); // L2 Cache, page aligned for fastmem
+#endif
 //u8 Mem_RAM[RAM_SIZE]; // Ram 24mb
 //u8 *Mem_RAM = 0;
 //u8 Mem_RAM2[RAM2_SIZE]; // Ram2 64mb (Wii)
+#if EMU_PLATFORM == PLATFORM_WINDOWS
 u8 Mem_RAM[RAM2_SIZE]; // Ram2 64mb (Wii)
+#else
+u8 Mem_RAM[RAM2_SIZE] __attribute__((aligned(4096))); // Page aligned for the recompiler and fastmem
+#endif
 #pragma pop(align)
 
+u8 Mem_CodePages[CODE_PAGE_COUNT];
+void (*Memory_CodeWriteHandler)(u32 addr) = NULL;
+u32 Mem_PageWriteGen[WRITE_PAGE_COUNT];
+
+u8* Mem_Fastmem = NULL;
+const u32 Mem_FastmemRAMViews[FASTMEM_RAM_VIEWS] = { 0x00000000, 0x80000000, 0xC0000000 };
+
+static common::MemArena* g_fastmem_arena = NULL;
+
 ////////////////////////////////////////////////////////////////////////////////
 
 #include "hw/hw_pe.h"
@@ -110,6 +132,8 @@ void Memory_Open(void)
 
 	memset(Mem_RAM, 0, RAM_SIZE);
 	memset(Mem_L2, 0, L2_SIZE);
+	memset(Mem_CodePages, 0, sizeof(Mem_CodePages));
+	memset(Mem_PageWriteGen, 0, sizeof(Mem_PageWriteGen));
 
 	LOG_NOTICE(TMEM, "initialized ok");
 }
@@ -121,6 +145,252 @@ void Memory_Close(void)
 
 ////////////////////////////////////////////////////////////////////////////////
 
+// Fastmem
+//
+
+#define FASTMEM_SIZE				0x100000000ULL
+#define FASTMEM_ARENA_L2			RAM_SIZE
+
+// Desc: Reserve 4GB of host address space and map RAM and L2 into it at
+// their logical addresses. Mem_RAM and Mem_L2 are moved onto the same
+// shared memory, so the regular memory handlers see the same data.
+//
+
+bool Memory_InitFastmem(void)
+{
+#if EMU_PLATFORM != PLATFORM_WINDOWS && defined(EMU_ARCHITECTURE_X64)
+	if(Mem_Fastmem)
+		return true;
+
+	g_fastmem_arena = new common::MemArena();
+	if(!g_fastmem_arena->Create(RAM_SIZE + L2_SIZE))
+	{
+		delete g_fastmem_arena;
+		g_fastmem_arena = NULL;
+		return false;
+	}
+
+	// Carry over the current contents, then replace the static arrays
+	u8* ram = g_fastmem_arena->MapView(0, RAM_SIZE + L2_SIZE);
+	if(ram == NULL)
+	{
+		Memory_ShutdownFastmem();
+		return false;
+	}
+	memcpy(ram, Mem_RAM, RAM_SIZE);
+	memcpy(ram + FASTMEM_ARENA_L2, Mem_L2, L2_SIZE);
+	g_fastmem_arena->UnmapView(ram, RAM_SIZE + L2_SIZE);
+
+	if(g_fastmem_arena->MapView(0, RAM_SIZE, Mem_RAM) != Mem_RAM ||
+		g_fastmem_arena->MapView(FASTMEM_ARENA_L2, L2_SIZE, Mem_L2) != Mem_L2)
+	{
+		LOG_ERROR(TMEM, "fastmem: unable to remap main memory!");
+		Memory_ShutdownFastmem();
+		return false;
+	}
+
+	Mem_Fastmem = common::MemArena::ReserveAddressSpace(FASTMEM_SIZE);
+	if(Mem_Fastmem == NULL)
+	{
+		LOG_ERROR(TMEM, "fastmem: unable to reserve 4GB of address space!");
+		Memory_ShutdownFastmem();
+		return false;
+	}
+
+	for(int i = 0; i < FASTMEM_RAM_VIEWS; i++)
+	{
+		u8* base = Mem_Fastmem + Mem_FastmemRAMViews[i];
+		if(g_fastmem_arena->MapView(0, RAM_SIZE, base) != base)
+		{
+			Memory_ShutdownFastmem();
+			return false;
+		}
+	}
+	if(g_fastmem_arena->MapView(FASTMEM_ARENA_L2, L2_SIZE, Mem_Fastmem + FASTMEM_L2_BASE) == NULL)
+	{
+		Memory_ShutdownFastmem();
+		return false;
+	}
+
+	LOG_NOTICE(TMEM, "fastmem: guest address space mapped at %p", Mem_Fastmem);
+	return true;
+#else
+	return false;
+#endif
+}
+
+// Desc: Release the 4GB view. Mem_RAM and Mem_L2 stay on the shared memory,
+// which lives on until they are unmapped.
+//
+
+void Memory_ShutdownFastmem(void)
+{
+#if EMU_PLATFORM != PLATFORM_WINDOWS && defined(EMU_ARCHITECTURE_X64)
+	if(Mem_Fastmem)
+	{
+		common::MemArena::ReleaseAddressSpace(Mem_Fastmem, FASTMEM_SIZE);
+		Mem_Fastmem = NULL;
+	}
+	delete g_fastmem_arena;
+	g_fastmem_arena = NULL;
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Block Transfers
+//
+
+// Desc: Drop cached code in a RAM range before a DMA writes to it, once
+// per transfer instead of once per word. Also makes the pages writable
+// again for a recompiler that protects them.
+//
+
+void Memory_InvalidateCode(u32 addr, u32 size)
+{
+	addr &= RAM_MASK;
+	if(!size || !Memory_CodeWriteHandler)
+		return;
+	if(addr + size > RAM_SIZE)
+		size = RAM_SIZE - addr;
+
+	u32 last = (addr + size - 1) >> CODE_PAGE_SHIFT;
+	for(u32 i = addr >> CODE_PAGE_SHIFT; i <= last; i++)
+	{
+		if(Mem_CodePages[i])
+			Memory_CodeWriteHandler(i << CODE_PAGE_SHIFT);
+	}
+}
+
+// Desc: Record a DMA or HLE write to a RAM range before it happens, bumps
+// the write generation of every page in the range and drops cached code.
+//
+
+void Memory_MarkWritten(u32 addr, u32 size)
+{
+	addr &= RAM_MASK;
+	if(!size)
+		return;
+	if(addr + size > RAM_SIZE)
+		size = RAM_SIZE - addr;
+
+	u32 last = (addr + size - 1) >> WRITE_PAGE_SHIFT;
+	for(u32 i = addr >> WRITE_PAGE_SHIFT; i <= last; i++)
+		Mem_PageWriteGen[i]++;
+
+	Memory_InvalidateCode(addr, size);
+}
+
+// Desc: Sum of the write generations of the pages covering a RAM range.
+// Generations only ever count up, so the sum changes whenever any page of
+// the range is written.
+//
+
+u64 Memory_GetWriteGen(u32 addr, u32 size)
+{
+	addr &= RAM_MASK;
+	if(!size)
+		return 0;
+	if(addr + size > RAM_SIZE)
+		size = RAM_SIZE - addr;
+
+	u64 gen = 0;
+	u32 last = (addr + size - 1) >> WRITE_PAGE_SHIFT;
+	for(u32 i = addr >> WRITE_PAGE_SHIFT; i <= last; i++)
+		gen += Mem_PageWriteGen[i];
+	return gen;
+}
+
+// Desc: Convert guest byte ordered words that were read straight into
+// RAM (disc DMA) to the RAM layout, in place. addr and size are word
+// aligned, anything else has to go through Memory_CopyToRAM.
+//
+
+void Memory_SwapRAM(u32 addr, u32 size)
+{
+#ifndef MEM_NATIVE_BE
+	addr &= RAM_MASK;
+	if(addr + size > RAM_SIZE)
+		size = RAM_SIZE - addr;
+
+	u8* p = &Mem_RAM[addr];
+	u32 i = 0;
+
+#ifdef EMU_ARCHITECTURE_X64
+	// Head up to 16 byte alignment, then 4 words per SSE2 op
+	for(; i + 4 <= size && ((size_t)(p + i) & 15); i += 4)
+		*(u32 *)(p + i) = BSWAP32(*(u32 *)(p + i));
+
+	for(; i + 16 <= size; i += 16)
+	{
+		__m128i v = _mm_load_si128((__m128i *)(p + i));
+		v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+		v = _mm_shufflehi_epi16(_mm_shufflelo_epi16(v, 0xB1), 0xB1);
+		_mm_store_si128((__m128i *)(p + i), v);
+	}
+#endif
+
+	for(; i + 4 <= size; i += 4)
+		*(u32 *)(p + i) = BSWAP32(*(u32 *)(p + i));
+#endif
+}
+
+// Desc: Copy guest byte ordered data (ARAM, memory card, IPL) into RAM,
+// used by the DMA engines. The range is marked written.
+//
+
+void Memory_CopyToRAM(u32 addr, const void* src, u32 size)
+{
+	const u8* in = (const u8*)src;
+	u32 i;
+
+	addr &= RAM_MASK;
+	if(addr + size > RAM_SIZE)
+		size = RAM_SIZE - addr;
+
+	Memory_MarkWritten(addr, size);
+
+#ifdef MEM_NATIVE_BE
+	memcpy(&Mem_RAM[addr], in, size);
+#else
+	i = 0;
+	if(!(addr & 3))
+	{
+		for(; i + 4 <= size; i += 4)
+			*(u32 *)(&Mem_RAM[addr + i]) = BSWAP32(*(u32 *)&in[i]);
+	}
+	for(; i < size; i++)
+		Mem_RAM[MEM_SWIZZLE8(addr + i)] = in[i];
+#endif
+}
+
+// Desc: Copy RAM out to a guest byte ordered buffer
+//
+
+void Memory_CopyFromRAM(void* dst, u32 addr, u32 size)
+{
+	u8* out = (u8*)dst;
+
+	addr &= RAM_MASK;
+	if(addr + size > RAM_SIZE)
+		size = RAM_SIZE - addr;
+
+#ifdef MEM_NATIVE_BE
+	memcpy(out, &Mem_RAM[addr], size);
+#else
+	u32 i = 0;
+	if(!(addr & 3))
+	{
+		for(; i + 4 <= size; i += 4)
+			*(u32 *)&out[i] = BSWAP32(*(u32 *)(&Mem_RAM[addr + i]));
+	}
+	for(; i < size; i++)
+		out[i] = Mem_RAM[MEM_SWIZZLE8(addr + i)];
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 // Memory Reads
 //
 
@@ -133,7 +403,7 @@ u8 EMU_FASTCALL Memory_Read8(u32 addr)
 //		printf("Reading 0x803C4BDC: %02X\n", Mem_RAM[(0x803C4BDC ^ 3) & RAM_MASK]);
 
 	if( addr < 0xC8000000 )				// Logical RAM
-		return Mem_RAM[(addr ^ 3) & RAM_MASK];
+		return Mem_RAM[MEM_SWIZZLE8(addr) & RAM_MASK];
 	else if( addr >= 0xCC000000 && addr < 0xE0000000 )				// HW
 	{
 		return Flipper_Read8(addr);
@@ -146,7 +416,7 @@ u8 EMU_FASTCALL Memory_Read8(u32 addr)
 	else if( addr < 0xF0000000 )				// L2
 	{
 		//printf("Memory_Read8() L2 Accessed!\n");
-		return Mem_L2[(addr ^ 3) & L2_MASK];
+		return Mem_L2[MEM_SWIZZLE8(addr) & L2_MASK];
 	}else{								// IPL
 //		printf(".Memory: ERROR: IPL Memory_Read8(%08X) !\n", addr);
 		return 0;
@@ -165,12 +435,12 @@ u16 EMU_FASTCALL Memory_Read16(u32 addr)
 	if( addr < 0xC8000000 )				// Logical RAM
 	{
 		if(!(addr & 1))
-			return *(u16 *)(&Mem_RAM[(addr ^ 2) & RAM_MASK]);
+			return MEM_LOAD16(&Mem_RAM[MEM_SWIZZLE16(addr) & RAM_MASK]);
 		else
 		{
 			addr = addr & RAM_MASK;
-			return (u16)(Mem_RAM[(addr + 0) ^ 3] << 8) |
-				   (u16)(Mem_RAM[(addr + 1) ^ 3]);
+			return (u16)(Mem_RAM[MEM_SWIZZLE8(addr + 0)] << 8) |
+				   (u16)(Mem_RAM[MEM_SWIZZLE8(addr + 1)]);
 		}
 	}
 	else if( addr >= 0xCC000000 && addr < 0xE0000000 )				// HW
@@ -185,12 +455,12 @@ u16 EMU_FASTCALL Memory_Read16(u32 addr)
 	else if( addr < 0xF0000000 )				// L2
 	{
 		if(!(addr & 1))
-			return *(u16 *)(&Mem_L2[(addr ^ 2) & L2_MASK]);
+			return MEM_LOAD16(&Mem_L2[MEM_SWIZZLE16(addr) & L2_MASK]);
 		else
 		{
 			addr = addr & L2_MASK;
-			return (u16)(Mem_L2[(addr + 0) ^ 3] << 8) |
-				   (u16)(Mem_L2[(addr + 1) ^ 3]);
+			return (u16)(Mem_L2[MEM_SWIZZLE8(addr + 0)] << 8) |
+				   (u16)(Mem_L2[MEM_SWIZZLE8(addr + 1)]);
 		}
 	}
 	else
@@ -213,13 +483,13 @@ u32 EMU_FASTCALL Memory_Read32(u32 addr)
 	{
 		addr &= RAM_MASK;
 		if(!(addr & 3))
-			return *(u32 *)(&Mem_RAM[addr]);
+			return MEM_LOAD32(&Mem_RAM[addr]);
 		else
 		{
-			return ((u32)Mem_RAM[(addr + 0) ^ 3] << 24) |
-				   ((u32)Mem_RAM[(addr + 1) ^ 3] << 16) |
-				   ((u32)Mem_RAM[(addr + 2) ^ 3] << 8) |
-				   ((u32)Mem_RAM[(addr + 3) ^ 3]);
+			return ((u32)Mem_RAM[MEM_SWIZZLE8(addr + 0)] << 24) |
+				   ((u32)Mem_RAM[MEM_SWIZZLE8(addr + 1)] << 16) |
+				   ((u32)Mem_RAM[MEM_SWIZZLE8(addr + 2)] << 8) |
+				   ((u32)Mem_RAM[MEM_SWIZZLE8(addr + 3)]);
 		}
 	}
 	else if( addr >= 0xCC000000 && addr < 0xE0000000 )				// HW
@@ -234,14 +504,14 @@ u32 EMU_FASTCALL Memory_Read32(u32 addr)
 	else if( addr < 0xF0000000 )				// L2
 	{
 		if(!(addr & 3))
-			return *(u32 *)(&Mem_L2[addr & L2_MASK]);
+			return MEM_LOAD32(&Mem_L2[addr & L2_MASK]);
 		else
 		{
 			addr = addr & L2_MASK;
-			return ((u32)Mem_L2[(addr + 0) ^ 3] << 24) |
-				   ((u32)Mem_L2[(addr + 1) ^ 3] << 16) |
-				   ((u32)Mem_L2[(addr + 2) ^ 3] << 8) |
-				   ((u32)Mem_L2[(addr + 3) ^ 3]);
+			return ((u32)Mem_L2[MEM_SWIZZLE8(addr + 0)] << 24) |
+				   ((u32)Mem_L2[MEM_SWIZZLE8(addr + 1)] << 16) |
+				   ((u32)Mem_L2[MEM_SWIZZLE8(addr + 2)] << 8) |
+				   ((u32)Mem_L2[MEM_SWIZZLE8(addr + 3)]);
 		}
 	}
 	else
@@ -256,8 +526,8 @@ u32 EMU_FASTCALL Memory_Read32(u32 addr)
 u64 EMU_FASTCALL Memory_Read64(u32 addr)
 {
 	addr &= RAM_MASK;
-	return ((u64)(*(u32 *)(&Mem_RAM[addr])) << 32) |
-			(u64)(*(u32 *)(&Mem_RAM[addr + 4]));
+	return ((u64)(MEM_LOAD32(&Mem_RAM[addr])) << 32) |
+			(u64)(MEM_LOAD32(&Mem_RAM[addr + 4]));
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -280,7 +550,9 @@ void EMU_FASTCALL Memory_Write8(u32 addr, u32 data)
 	}
 */	if( addr < 0xC8000000 )				// Logical RAM
 	{
-		Mem_RAM[(addr ^ 3) & RAM_MASK] = data;
+		MEM_CHECK_CODE_WRITE(addr);
+		MEM_MARK_WRITE(addr);
+		Mem_RAM[MEM_SWIZZLE8(addr) & RAM_MASK] = data;
 		return;
 	}
 	if( addr >= 0xCC000000 && addr < 0xE0000000 )				// HW
@@ -296,7 +568,7 @@ void EMU_FASTCALL Memory_Write8(u32 addr, u32 data)
 	if( addr < 0xF0000000 )				// L2
 	{
 		//printf("Memory_Write8() L2 Accessed!\n");
-		Mem_L2[(addr ^ 3) & L2_MASK] = data;
+		Mem_L2[MEM_SWIZZLE8(addr) & L2_MASK] = data;
 		return;
 	}else{								// IPL
 //		printf(".Memory: ERROR: IPL Memory_Write8(%08X) !\n", addr);
@@ -321,13 +593,17 @@ void EMU_FASTCALL Memory_Write16(u32 addr, u32 data)
 	}
 */	if( addr < 0xC8000000 )				// Logical RAM
 	{
+		MEM_CHECK_CODE_WRITE(addr);
+		MEM_MARK_WRITE(addr);
 		if(!(addr & 1))
-			*(u16 *)(&Mem_RAM[(addr ^ 2) & RAM_MASK]) = data;
+			MEM_STORE16(&Mem_RAM[MEM_SWIZZLE16(addr) & RAM_MASK], data);
 		else
 		{
 			addr = addr & RAM_MASK;
-			Mem_RAM[(addr + 1) ^ 3] = (u8)data;
-			Mem_RAM[(addr + 0) ^ 3] = (u8)(data >> 8);
+			MEM_CHECK_CODE_WRITE(addr + 1);
+			MEM_MARK_WRITE(addr + 1);
+			Mem_RAM[MEM_SWIZZLE8(addr + 1)] = (u8)data;
+			Mem_RAM[MEM_SWIZZLE8(addr + 0)] = (u8)(data >> 8);
 		}
 		return;
 	}
@@ -344,12 +620,12 @@ void EMU_FASTCALL Memory_Write16(u32 addr, u32 data)
 	else if( addr < 0xF0000000 )				// L2
 	{
 		if(!(addr & 1))
-			*(u16 *)&Mem_L2[(addr ^ 2) & L2_MASK] = data;
+			MEM_STORE16(&Mem_L2[MEM_SWIZZLE16(addr) & L2_MASK], data);
 		else
 		{
 			addr = addr & L2_MASK;
-			Mem_L2[(addr + 1) ^ 3] = (u8)data;
-			Mem_L2[(addr + 0) ^ 3] = (u8)(data >> 8);
+			Mem_L2[MEM_SWIZZLE8(addr + 1)] = (u8)data;
+			Mem_L2[MEM_SWIZZLE8(addr + 0)] = (u8)(data >> 8);
 		}
 		return;
 	}
@@ -378,14 +654,18 @@ void EMU_FASTCALL Memory_Write32(u32 addr, u32 data)
 */	if( addr < 0xC8000000 )				// Logical RAM
 	{
 		addr &= RAM_MASK;
+		MEM_CHECK_CODE_WRITE(addr);
+		MEM_MARK_WRITE(addr);
 		if(!(addr & 3))
-			*(u32 *)(&Mem_RAM[addr]) = data;
+			MEM_STORE32(&Mem_RAM[addr], data);
 		else
 		{
-			Mem_RAM[(addr + 3) ^ 3] = (u8)data;
-			Mem_RAM[(addr + 2) ^ 3] = (u8)(data >> 8);
-			Mem_RAM[(addr + 1) ^ 3] = (u8)(data >> 16);
-			Mem_RAM[(addr + 0) ^ 3] = (u8)(data >> 24);
+			MEM_CHECK_CODE_WRITE(addr + 3);
+			MEM_MARK_WRITE(addr + 3);
+			Mem_RAM[MEM_SWIZZLE8(addr + 3)] = (u8)data;
+			Mem_RAM[MEM_SWIZZLE8(addr + 2)] = (u8)(data >> 8);
+			Mem_RAM[MEM_SWIZZLE8(addr + 1)] = (u8)(data >> 16);
+			Mem_RAM[MEM_SWIZZLE8(addr + 0)] = (u8)(data >> 24);
 		}
 
 		return;
@@ -403,14 +683,14 @@ void EMU_FASTCALL Memory_Write32(u32 addr, u32 data)
 	else if( addr < 0xF0000000 )				// L2
 	{
 		if(!(addr & 3))
-			*(u32 *)&Mem_L2[addr & L2_MASK] = data;
+			MEM_STORE32(&Mem_L2[addr & L2_MASK], data);
 		else
 		{
 			addr = addr & L2_MASK;
-			Mem_L2[(addr + 3) ^ 3] = (u8)data;
-			Mem_L2[(addr + 2) ^ 3] = (u8)(data >> 8);
-			Mem_L2[(addr + 1) ^ 3] = (u8)(data >> 16);
-			Mem_L2[(addr + 0) ^ 3] = (u8)(data >> 24);
+			Mem_L2[MEM_SWIZZLE8(addr + 3)] = (u8)data;
+			Mem_L2[MEM_SWIZZLE8(addr + 2)] = (u8)(data >> 8);
+			Mem_L2[MEM_SWIZZLE8(addr + 1)] = (u8)(data >> 16);
+			Mem_L2[MEM_SWIZZLE8(addr + 0)] = (u8)(data >> 24);
 		}
 		return;
 	}
@@ -426,7 +706,11 @@ void EMU_FASTCALL Memory_Write32(u32 addr, u32 data)
 void EMU_FASTCALL Memory_Write64(u32 addr, u64 data)
 {
 	addr &= RAM_MASK;
-	*(u32 *)(&Mem_RAM[addr]) = (u32)(data >> 32);
-	*(u32 *)(&Mem_RAM[addr + 4]) = (u32)data;
+	MEM_CHECK_CODE_WRITE(addr);
+	MEM_MARK_WRITE(addr);
+	MEM_CHECK_CODE_WRITE(addr + 7);
+	MEM_MARK_WRITE(addr + 7);
+	MEM_STORE32(&Mem_RAM[addr], (u32)(data >> 32));
+	MEM_STORE32(&Mem_RAM[addr + 4], (u32)data);
 	return;
 }
@@ -21,6 +21,15 @@
 #define REG_SIZE					0x100
 #define REG_MASK					0xFF
 
+#define FASTMEM_RAM_VIEWS			3
+#define FASTMEM_L2_BASE				0xE0000000
+
+#define CODE_PAGE_SHIFT				12
+#define CODE_PAGE_COUNT				(RAM_SIZE >> CODE_PAGE_SHIFT)
+
+#define WRITE_PAGE_SHIFT			12
+#define WRITE_PAGE_COUNT			(RAM_SIZE >> WRITE_PAGE_SHIFT)
+
 #define MEM8(X)						*MEMPTR8(X)
 #define MEM16(X)					*MEMPTR16(X)
 #define MEM32(X)					*MEMPTR32(X)
@@ -54,17 +63,78 @@
 #define DATA32(data)				BSWAP32(data)
 #define DATA64(data)				BSWAP64(data)
 
+// RAM byte order. By default RAM holds 32-bit words in host byte order, so
+// aligned word accesses are plain loads and byte/halfword addresses are
+// swizzled. MEM_NATIVE_BE keeps RAM in guest (big endian) byte order and
+// byteswaps on access instead, so guest data has the same layout in RAM as
+// on disc and DMA is a memcpy. Selected at build time by the MEM_NATIVE_BE
+// CMake option or the MemNativeBE MSBuild property.
+
+#ifndef MEM_NATIVE_BE
+//#define MEM_NATIVE_BE
+#endif
+
+#ifdef MEM_NATIVE_BE
+#define MEM_SWIZZLE8(X)				(X)
+#define MEM_SWIZZLE16(X)			(X)
+#define MEM_LOAD16(P)				BSWAP16(*(u16*)(P))
+#define MEM_LOAD32(P)				BSWAP32(*(u32*)(P))
+#define MEM_STORE16(P, V)			(*(u16*)(P) = BSWAP16((u16)(V)))
+#define MEM_STORE32(P, V)			(*(u32*)(P) = BSWAP32((u32)(V)))
+#define MEM_LOAD32_BYTES(P)			(*(u32*)(P))
+#else
+#define MEM_SWIZZLE8(X)				((X) ^ 3)
+#define MEM_SWIZZLE16(X)			((X) ^ 2)
+#define MEM_LOAD16(P)				(*(u16*)(P))
+#define MEM_LOAD32(P)				(*(u32*)(P))
+#define MEM_STORE16(P, V)			(*(u16*)(P) = (u16)(V))
+#define MEM_STORE32(P, V)			(*(u32*)(P) = (u32)(V))
+#define MEM_LOAD32_BYTES(P)			BSWAP32(*(u32*)(P))	// 4 bytes in guest order, as a host word
+#endif
+
+// The old x86 recompiler's inline assembly is written for word swapped RAM
+#if defined(MEM_NATIVE_BE) && !defined(EMU_IGNORE_RECOMPILER)
+#define EMU_IGNORE_RECOMPILER
+#endif
+
 extern u8 Mem_L2[L2_SIZE];
 //extern u8 Mem_RAM[RAM_SIZE];
 //extern u8 *Mem_RAM;
 //extern u8 Mem_RAM2[RAM2_SIZE];
 extern u8 Mem_RAM[RAM2_SIZE];
+
+// Pages holding cached code, a write to one of them calls Memory_CodeWriteHandler
+extern u8 Mem_CodePages[CODE_PAGE_COUNT];
+extern void (*Memory_CodeWriteHandler)(u32 addr);
+
+// Write generation of each RAM page, bumped by every CPU, DMA and HLE write
+// to the page. Caches of data built from RAM compare Memory_GetWriteGen
+// against the value they saw last time to tell if they need to look again.
+extern u32 Mem_PageWriteGen[WRITE_PAGE_COUNT];
+
+// Host view of the whole 32-bit Gekko address space, RAM and L2 are mapped
+// at their logical addresses and everything else is left unmapped
+extern u8* Mem_Fastmem;
+extern const u32 Mem_FastmemRAMViews[FASTMEM_RAM_VIEWS];
+
+#define MEM_CHECK_CODE_WRITE(X)		if(Mem_CodePages[((X) & RAM_MASK) >> CODE_PAGE_SHIFT]) Memory_CodeWriteHandler((X) & RAM_MASK)
+#define MEM_MARK_WRITE(X)			Mem_PageWriteGen[((X) & RAM_MASK) >> WRITE_PAGE_SHIFT]++
 		
 ////////////////////////////////////////////////////////////
 
 void Memory_Open(void);
 void Memory_Close(void);
 
+bool Memory_InitFastmem(void);
+void Memory_ShutdownFastmem(void);
+
+void Memory_InvalidateCode(u32 addr, u32 size);
+void Memory_MarkWritten(u32 addr, u32 size);
+u64 Memory_GetWriteGen(u32 addr, u32 size);
+void Memory_SwapRAM(u32 addr, u32 size);
+void Memory_CopyToRAM(u32 addr, const void* src, u32 size);
+void Memory_CopyFromRAM(void* dst, u32 addr, u32 size);
+
 //
 
 u8 EMU_FASTCALL Memory_Read8(u32 addr);
@@ -491,6 +491,33 @@ GekkoIntOp(Ops_Group63)
 #endif
 }
 
+// Desc: Returns the handler for an opcode with the group tables already
+// walked, so that callers caching the result skip the second dispatch
+//
+
+optable GekkoCPUInterpreter::ResolveOp(u32 op)
+{
+	u32 xo0 = (op >> 1) & 0x3FF;
+	u32 xo3 = (op >> 1) & 0x1F;
+	optable handler;
+
+	switch(op >> 26)
+	{
+		case 4:
+			handler = GekkoCPUOpsGroup4Table[xo3];
+			return (handler == GekkoInt(Ops_Group4XO0)) ? GekkoCPUOpsGroup4XO0Table[xo0] : handler;
+		case 19:	return GekkoCPUOpsGroup19Table[xo0];
+		case 31:	return GekkoCPUOpsGroup31Table[xo0];
+		case 59:	return GekkoCPUOpsGroup59Table[xo3];
+		case 63:
+			handler = GekkoCPUOpsGroup63Table[xo3];
+			return (handler == GekkoInt(Ops_Group63XO0)) ? GekkoCPUOpsGroup63XO0Table[xo0] : handler;
+	}
+	return GekkoCPUOpset[op >> 26];
+}
+
+////////////////////////////////////////////////////////////
+
 // Desc: Handle a CPU Exception
 //
 
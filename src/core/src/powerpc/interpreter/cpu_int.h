@@ -37,7 +37,7 @@
 #define PTR_PC		*pPC
 #endif
 */
-#define PTR_PC			*(u32*)(&Mem_RAM[ireg.PC & RAM_MASK]) //Memory_Read32(ireg.PC)
+#define PTR_PC			MEM_LOAD32(&Mem_RAM[ireg.PC & RAM_MASK]) //Memory_Read32(ireg.PC)
 
 ////////////////////////////////////////////////////////////
 
@@ -65,9 +65,6 @@ private:
 	static u32			LastNewStack[CPU_OPSTORE_COUNT * 64];
 	static u32			LastOpEntry;
 
-	static u32			branch;
-	static u32			exception;
-
 #define OPCODE_BRANCH	1
 #define OPCODE_RFI		2
 
@@ -81,8 +78,13 @@ private:
 	static GekkoIntOpDecl(Ops_Group63XO0);
 
 protected:
+	static u32			branch;
+	static u32			exception;
+
 	static GekkoF	Tick();
 
+	static optable	ResolveOp(u32 op);
+
 public:
 	GekkoF	ExecuteInstruction();
 
@@ -0,0 +1,232 @@
+////////////////////////////////////////////////////////////
+// TITLE:		Gekko PowerPC 750 / Gekko CPU
+// VERSION:		Cached Interpreter 0.1
+// FILE:		cpu_int_cached.cpp
+// DESC:		Interpreter running pre-decoded basic blocks
+// CREATED:		Feb. 12, 2013
+////////////////////////////////////////////////////////////
+// Copyright (c) 2013 Gekko Team
+////////////////////////////////////////////////////////////
+
+#include "common.h"
+
+#include "cpu_int_cached.h"
+#include "hw/hw.h"
+#include "powerpc/cpu_core_regs.h"
+
+u32*		GekkoCPUCachedInterpreter::BlockTable = NULL;
+std::vector<GekkoCPUCachedInterpreter::CachedBlock>	GekkoCPUCachedInterpreter::Blocks;
+std::vector<GekkoCPUCachedInterpreter::CachedInst>	GekkoCPUCachedInterpreter::Insts;
+std::vector<u32>	GekkoCPUCachedInterpreter::PageBlocks[CODE_PAGE_COUNT];
+
+////////////////////////////////////////////////////////////
+
+// Desc: Initialization
+//
+
+GekkoCPUCachedInterpreter::GekkoCPUCachedInterpreter()
+{
+	// One entry per RAM word, only touched pages get committed
+	BlockTable = (u32*)calloc(RAM_SIZE >> 2, sizeof(u32));
+	if(BlockTable == NULL)
+	{
+		LOG_ERROR(TPOWERPC, "Cached interpreter: unable to allocate the block table!\n");
+		return;
+	}
+
+	Memory_CodeWriteHandler = InvalidatePage;
+
+	LOG_NOTICE(TPOWERPC, "cached interpreter initialized ok");
+}
+
+GekkoCPUCachedInterpreter::~GekkoCPUCachedInterpreter()
+{
+	ClearCache();
+
+	Memory_CodeWriteHandler = NULL;
+
+	free(BlockTable);
+	BlockTable = NULL;
+}
+
+GekkoF GekkoCPUCachedInterpreter::Open(u32 entry_point)
+{
+	GekkoCPUInterpreter::Open(entry_point);
+	ClearCache();
+}
+
+////////////////////////////////////////////////////////////
+
+// Desc: Block cache management
+//
+
+void GekkoCPUCachedInterpreter::ClearCache()
+{
+	for(u32 page = 0; page < CODE_PAGE_COUNT; page++)
+		PageBlocks[page].clear();
+	memset(Mem_CodePages, 0, sizeof(Mem_CodePages));
+
+	if(BlockTable)
+		memset(BlockTable, 0, (RAM_SIZE >> 2) * sizeof(u32));
+
+	Blocks.clear();
+	Insts.clear();
+}
+
+// Desc: Drop all blocks overlapping the page holding addr, called by
+// Memory_Write* on a write to a page marked in Mem_CodePages
+//
+
+void GekkoCPUCachedInterpreter::InvalidatePage(u32 addr)
+{
+	u32 page = (addr & RAM_MASK) >> CODE_PAGE_SHIFT;
+	std::vector<u32>& list = PageBlocks[page];
+
+	for(u32 i = 0; i < list.size(); i++)
+	{
+		u32* entry = &BlockTable[Blocks[list[i]].start >> 2];
+
+		if(*entry == list[i] + 1)
+			*entry = 0;
+	}
+	list.clear();
+
+	Mem_CodePages[page] = 0;
+}
+
+// Desc: icbi, the game tells us it changed code behind our back (DMA)
+//
+
+void GekkoCPUCachedInterpreter::CachedICBI()
+{
+	u32 addr = rA ? (RRA + RRB) : RRB;
+
+	if(Mem_CodePages[(addr & RAM_MASK) >> CODE_PAGE_SHIFT])
+		InvalidatePage(addr);
+}
+
+////////////////////////////////////////////////////////////
+
+// Desc: Decode the block starting at pc. Blocks end after the first
+// branch class instruction or CACHED_MAX_BLOCK_INSTS instructions.
+//
+
+GekkoCPUCachedInterpreter::CachedBlock* GekkoCPUCachedInterpreter::DecodeBlock(u32 pc)
+{
+	if(Insts.size() + CACHED_MAX_BLOCK_INSTS > CACHED_MAX_INSTS)
+	{
+		LOG_NOTICE(TPOWERPC, "Cached interpreter: block cache full, flushing");
+		ClearCache();
+	}
+
+	CachedBlock block;
+	block.start = pc & RAM_MASK;
+	block.first = (u32)Insts.size();
+	block.count = 0;
+
+	u32 addr = block.start;
+	bool end = false;
+
+	while(!end && block.count < CACHED_MAX_BLOCK_INSTS && addr < RAM_SIZE)
+	{
+		CachedInst inst;
+		inst.opcode = MEM_LOAD32(&Mem_RAM[addr]);
+		inst.handler = ResolveOp(inst.opcode);
+
+		switch(inst.opcode >> 26)
+		{
+			case 16: case 17: case 18: case 19:		// Branches, sc, rfi
+				end = true;
+				break;
+
+			case 31:
+				if(((inst.opcode >> 1) & 0x3FF) == 982)
+					inst.handler = CachedICBI;
+				break;
+		}
+
+		Insts.push_back(inst);
+		block.count++;
+		addr += 4;
+	}
+
+	u32 index = (u32)Blocks.size();
+	Blocks.push_back(block);
+	BlockTable[block.start >> 2] = index + 1;
+
+	// Mark the pages so that stores to them drop the block
+	u32 last = (addr - 4) >> CODE_PAGE_SHIFT;
+	for(u32 page = block.start >> CODE_PAGE_SHIFT; page <= last; page++)
+	{
+		PageBlocks[page].push_back(index);
+		Mem_CodePages[page] = 1;
+	}
+
+	return &Blocks[index];
+}
+
+////////////////////////////////////////////////////////////
+
+// Desc: Execute until the next branch, same contract as the interpreter
+//
+
+GekkoF GekkoCPUCachedInterpreter::ExecuteInstruction(void)
+{
+	static int is_dec = 0;
+	u32 InstCount = 0;
+
+	// Single stepping and the debug dumps need the plain interpreter
+	if(step || DumpOp0 || PipeHandle || BlockTable == NULL)
+	{
+		GekkoCPUInterpreter::ExecuteInstruction();
+		return;
+	}
+
+	branch = 0;
+
+	do
+	{
+		u32 index = BlockTable[(ireg.PC & RAM_MASK) >> 2];
+		CachedBlock* block = index ? &Blocks[index - 1] : DecodeBlock(ireg.PC);
+
+		const CachedInst* inst = &Insts[block->first];
+		const CachedInst* end = inst + block->count;
+
+		do
+		{
+			opcode = inst->opcode;
+			inst->handler();
+			InstCount++;
+
+			if(branch)
+				break;
+
+			ireg.PC += 4;
+		} while(++inst != end);
+	} while(!branch);
+
+	ireg.TBR.TBR += InstCount;
+
+	if(DEC < InstCount)
+	{
+		is_dec = MSR_BIT_EE;
+	}
+
+	DEC -= InstCount;
+	ireg.IC += InstCount;
+
+	if(!(branch & OPCODE_RFI))
+	{
+		u32 Ret = Flipper_Update();
+
+		if(!Ret && (ireg.MSR & is_dec))
+		{
+			is_dec = 0;
+			cpu->Exception(GEX_DEC);
+		}
+
+		exception = 0;
+	}
+
+	branch = 0;
+}
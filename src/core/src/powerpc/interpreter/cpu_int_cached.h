@@ -0,0 +1,69 @@
+////////////////////////////////////////////////////////////
+// TITLE:		Gekko PowerPC 750 / Gekko CPU
+// VERSION:		Cached Interpreter 0.1
+// FILE:		cpu_int_cached.h
+// DESC:		Interpreter running pre-decoded basic blocks
+// CREATED:		Feb. 12, 2013
+////////////////////////////////////////////////////////////
+// Copyright (c) 2013 Gekko Team
+////////////////////////////////////////////////////////////
+
+#ifndef _GEKKO_INT_CACHED_H
+#define _GEKKO_INT_CACHED_H
+
+#include <vector>
+
+#include "memory.h"
+#include "powerpc/cpu_core.h"
+#include "powerpc/interpreter/cpu_int.h"
+
+#define CACHED_MAX_BLOCK_INSTS	64							// Max PowerPC instructions per block
+#define CACHED_MAX_INSTS		(1024*1024*2)				// Decoded instructions before the cache is flushed
+
+////////////////////////////////////////////////////////////
+
+// Desc: Interpreter that decodes each basic block once into a list of
+// resolved opcode handlers, looked up by PC on the next visit. Needs no
+// executable memory, so it is the fast core on hosts that can't JIT.
+// Blocks are dropped when their page is written through Memory_Write*
+// or when the game issues icbi on it.
+//
+
+class GekkoCPUCachedInterpreter : public GekkoCPUInterpreter
+{
+public:
+	GekkoCPUCachedInterpreter();
+	~GekkoCPUCachedInterpreter();
+
+	GekkoF	Open(u32 entry_point);
+	GekkoF	ExecuteInstruction();
+
+private:
+	typedef struct t_CachedInst
+	{
+		optable	handler;		// Handler with the group tables already resolved
+		u32		opcode;			// Raw instruction word, operands are decoded from it
+	} CachedInst;
+
+	typedef struct t_CachedBlock
+	{
+		u32		start;			// RAM offset of the first instruction
+		u32		count;			// Number of instructions
+		u32		first;			// Index of the first instruction in Insts
+	} CachedBlock;
+
+	static u32*		BlockTable;						// RAM word -> block index + 1, 0 if none
+	static std::vector<CachedBlock>	Blocks;
+	static std::vector<CachedInst>	Insts;
+	static std::vector<u32>			PageBlocks[CODE_PAGE_COUNT];
+
+	static CachedBlock*	DecodeBlock(u32 pc);
+	static void			ClearCache();
+	static void			InvalidatePage(u32 addr);
+
+	static void			CachedICBI();
+};
+
+////////////////////////////////////////////////////////////
+
+#endif
@@ -23,6 +23,28 @@
 #include "hw/hw_di.h"
 #include "hw/hw_cp.h"
 
+// Desc: Emit the write generation bump for a direct store to a known RAM
+// address, as MEM_MARK_WRITE does for stores through the memory handlers
+//
+
+static void RecMarkWrite(u8 *OutInstruction, u32 *OutSize, u32 Addr, u32 Size)
+{
+	u32 FirstPage = (Addr & RAM_MASK) >> WRITE_PAGE_SHIFT;
+	u32 LastPage = ((Addr + Size - 1) & RAM_MASK) >> WRITE_PAGE_SHIFT;
+
+	//inc dword [&Mem_PageWriteGen[page]]
+	*(u16 *)(&OutInstruction[0]) = 0x05FF;
+	*(u32 *)(&OutInstruction[2]) = (u32)&Mem_PageWriteGen[FirstPage];
+	*OutSize += 6;
+
+	if(LastPage != FirstPage)
+	{
+		*(u16 *)(&OutInstruction[6]) = 0x05FF;
+		*(u32 *)(&OutInstruction[8]) = (u32)&Mem_PageWriteGen[LastPage];
+		*OutSize += 6;
+	}
+}
+
 #pragma todo(Research if need to implement CP_WPAR_Write* directly into memory writes)
 static void EMU_FASTCALL GXCP_Write8(u32 Addr, u32 data)
 {
@@ -2860,6 +2882,9 @@ GekkoRecILOp(WRITEMEM8)
 						*(u8 *)(&((u8 *)OutInstruction)[*OutSize + 6]) = Instruction->X86InVal & 0xFF;
 						*OutSize += 7;
 				}
+
+				if(MemPtrVal == (u32)Mem_RAM)
+					RecMarkWrite(&((u8 *)OutInstruction)[*OutSize], OutSize, Instruction->X86OutVal, 1);
 			}
 			else if(Instruction->X86OutVal < 0xCC000000)
 			{
@@ -3245,6 +3270,9 @@ GekkoRecILOp(WRITEMEM16)
 							*OutSize += 9;
 						}
 				}
+
+				if(MemPtrVal == (u32)Mem_RAM)
+					RecMarkWrite(&((u8 *)OutInstruction)[*OutSize], OutSize, Instruction->X86OutVal, 2);
 			}
 			else if(Instruction->X86OutVal < 0xCC000000)
 			{
@@ -3657,6 +3685,9 @@ GekkoRecILOp(WRITEMEM32)
 							*OutSize += 10;
 						}
 				}
+
+				if(MemPtrVal == (u32)Mem_RAM)
+					RecMarkWrite(&((u8 *)OutInstruction)[*OutSize], OutSize, Instruction->X86OutVal, 4);
 			}
 			else if(Instruction->X86OutVal < 0xCC000000)
 			{
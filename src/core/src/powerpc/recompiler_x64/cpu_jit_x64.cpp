@@ -0,0 +1,730 @@
+////////////////////////////////////////////////////////////
+// TITLE:		Gekko PowerPC 750 / Gekko CPU
+// VERSION:		x86-64 Recompiler 0.1
+// FILE:		cpu_jit_x64.cpp
+// DESC:		x86-64 System V dynamic recompiler
+// CREATED:		Feb. 9, 2013
+////////////////////////////////////////////////////////////
+// Copyright (c) 2013 Gekko Team
+////////////////////////////////////////////////////////////
+
+#include "common.h"
+#include "cpu_jit_x64.h"
+
+#ifdef EMU_JIT_X64
+
+#include <pthread.h>
+#include <signal.h>
+#include <ucontext.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "hw/hw.h"
+#include "powerpc/cpu_core_regs.h"
+#include "x64_emitter.h"
+
+u8*			GekkoCPURecompilerX64::CodeArena = NULL;
+u8*			GekkoCPURecompilerX64::CodePtr = NULL;
+u32*		GekkoCPURecompilerX64::BlockTable = NULL;
+pthread_t	GekkoCPURecompilerX64::CPUThread;
+std::vector<GekkoCPURecompilerX64::JitBlock>	GekkoCPURecompilerX64::Blocks;
+std::vector<u32>	GekkoCPURecompilerX64::PageBlocks[JIT_RAM_PAGES];
+u8			GekkoCPURecompilerX64::PageProtected[JIT_RAM_PAGES];
+bool		GekkoCPURecompilerX64::SMCProtect = false;
+bool		GekkoCPURecompilerX64::Fastmem = false;
+std::map<u8*, GekkoCPURecompilerX64::FastmemSite>	GekkoCPURecompilerX64::FastmemSites;
+
+static struct sigaction	JitOldSegvAction;
+
+// Offsets into the register file, which rbx points at in compiled code
+
+#define JIT_OFS(X)		((s32)((u8*)&(X) - (u8*)&ireg))
+#define JIT_GPR(n)		JIT_OFS(ireg.gpr[n])
+#define JIT_PC			JIT_OFS(ireg.PC)
+
+////////////////////////////////////////////////////////////
+
+// Desc: SIGSEGV handler, catches writes to write protected code pages
+// and fastmem accesses to unmapped (MMIO) addresses. Faults that aren't
+// ours go to the previously installed handler.
+//
+
+static void JitSegvHandler(int sig, siginfo_t* info, void* context)
+{
+	if(GekkoCPURecompilerX64::HandleFault(info->si_addr, context))
+		return;
+
+	if(JitOldSegvAction.sa_flags & SA_SIGINFO)
+		JitOldSegvAction.sa_sigaction(sig, info, context);
+	else if(JitOldSegvAction.sa_handler != SIG_DFL && JitOldSegvAction.sa_handler != SIG_IGN)
+		JitOldSegvAction.sa_handler(sig);
+	else
+		sigaction(SIGSEGV, &JitOldSegvAction, NULL);	// Fault again and crash as usual
+}
+
+////////////////////////////////////////////////////////////
+
+// Desc: Initialization
+//
+
+GekkoCPU::CPUType GekkoCPURecompilerX64::GetCPUType()
+{
+	return GekkoCPU::DynaRec;
+}
+
+GekkoCPURecompilerX64::GekkoCPURecompilerX64()
+{
+	void* arena = mmap(NULL, JIT_ARENA_SIZE, PROT_READ | PROT_WRITE | PROT_EXEC,
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+	CodeArena = (arena == MAP_FAILED) ? NULL : (u8*)arena;
+	CodePtr = CodeArena;
+
+	// One entry per RAM word, only touched pages get committed
+	BlockTable = (u32*)calloc(RAM_SIZE >> 2, sizeof(u32));
+
+	if(CodeArena == NULL || BlockTable == NULL)
+	{
+		LOG_ERROR(TPOWERPC, "x86-64 recompiler: unable to allocate the code cache!\n");
+		return;
+	}
+
+	memset(PageProtected, 0, sizeof(PageProtected));
+	Memory_CodeWriteHandler = CodeWriteHandler;
+
+	// Code pages are protected at 4KB granularity, Mem_RAM is page aligned
+	SMCProtect = (sysconf(_SC_PAGESIZE) == JIT_PAGE_SIZE) && !((size_t)Mem_RAM & (JIT_PAGE_SIZE - 1));
+
+	Fastmem = common::g_config->enable_fastmem() && Memory_InitFastmem();
+	if(common::g_config->enable_fastmem() && !Fastmem)
+		LOG_ERROR(TPOWERPC, "x86-64 recompiler: fastmem unavailable, using the memory handlers\n");
+
+	if(SMCProtect || Fastmem)
+	{
+		struct sigaction sa;
+		memset(&sa, 0, sizeof(sa));
+		sa.sa_sigaction = JitSegvHandler;
+		sa.sa_flags = SA_SIGINFO;
+		sigemptyset(&sa.sa_mask);
+		sigaction(SIGSEGV, &sa, &JitOldSegvAction);
+	}
+
+	if(!SMCProtect)
+		LOG_ERROR(TPOWERPC, "x86-64 recompiler: self modifying code detection unavailable!\n");
+
+	LOG_NOTICE(TPOWERPC, "x86-64 recompiler initialized ok");
+}
+
+GekkoCPURecompilerX64::~GekkoCPURecompilerX64()
+{
+	ClearCache();
+
+	Memory_CodeWriteHandler = NULL;
+
+	if(SMCProtect || Fastmem)
+		sigaction(SIGSEGV, &JitOldSegvAction, NULL);
+
+	if(Fastmem)
+		Memory_ShutdownFastmem();
+	Fastmem = false;
+
+	if(CodeArena)
+		munmap(CodeArena, JIT_ARENA_SIZE);
+	free(BlockTable);
+
+	CodeArena = CodePtr = NULL;
+	BlockTable = NULL;
+}
+
+GekkoF GekkoCPURecompilerX64::Open(u32 entry_point)
+{
+	GekkoCPUInterpreter::Open(entry_point);
+	ClearCache();
+}
+
+////////////////////////////////////////////////////////////
+
+// Desc: Code cache management
+//
+
+void GekkoCPURecompilerX64::ClearCache()
+{
+	for(u32 page = 0; page < JIT_RAM_PAGES; page++)
+	{
+		if(PageProtected[page])
+		{
+			SetPageAccess(page, PROT_READ | PROT_WRITE);
+			PageProtected[page] = 0;
+		}
+		PageBlocks[page].clear();
+	}
+	memset(Mem_CodePages, 0, sizeof(Mem_CodePages));
+	FastmemSites.clear();
+
+	if(BlockTable)
+		memset(BlockTable, 0, (RAM_SIZE >> 2) * sizeof(u32));
+
+	Blocks.clear();
+	CodePtr = CodeArena;
+}
+
+// Desc: Change the protection of a RAM page in Mem_RAM and all its
+// fastmem mirrors
+//
+
+void GekkoCPURecompilerX64::SetPageAccess(u32 page, int prot)
+{
+	u32 offset = page << JIT_PAGE_SHIFT;
+
+	mprotect(&Mem_RAM[offset], JIT_PAGE_SIZE, prot);
+
+	if(Fastmem)
+	{
+		for(int i = 0; i < FASTMEM_RAM_VIEWS; i++)
+			mprotect(Mem_Fastmem + Mem_FastmemRAMViews[i] + offset, JIT_PAGE_SIZE, prot);
+	}
+}
+
+void GekkoCPURecompilerX64::ProtectPage(u32 page)
+{
+	Mem_CodePages[page] = 1;
+
+	if(!SMCProtect || PageProtected[page])
+		return;
+
+	SetPageAccess(page, PROT_READ);
+	PageProtected[page] = 1;
+}
+
+// Desc: Drop all blocks overlapping a page and make it writable again
+//
+
+void GekkoCPURecompilerX64::InvalidatePage(u32 page)
+{
+	std::vector<u32>& list = PageBlocks[page];
+
+	for(u32 i = 0; i < list.size(); i++)
+	{
+		JitBlock* block = &Blocks[list[i]];
+		u32* entry = &BlockTable[(block->start & RAM_MASK) >> 2];
+
+		if(*entry == list[i] + 1)
+			*entry = 0;
+	}
+	list.clear();
+
+	Mem_CodePages[page] = 0;
+
+	if(PageProtected[page])
+	{
+		SetPageAccess(page, PROT_READ | PROT_WRITE);
+		PageProtected[page] = 0;
+	}
+}
+
+// Desc: Memory_CodeWriteHandler, a store or DMA through the memory
+// handlers is about to write to a page holding compiled code
+//
+
+void GekkoCPURecompilerX64::CodeWriteHandler(u32 addr)
+{
+	InvalidatePage((addr & RAM_MASK) >> JIT_PAGE_SHIFT);
+}
+
+bool GekkoCPURecompilerX64::HandleFault(void* address, void* context)
+{
+	// Only compiled code writes guest RAM without going through the memory
+	// handlers, faults on other threads are someone else's
+	if(!pthread_equal(pthread_self(), CPUThread))
+		return false;
+
+	// Write to a protected code page, through Mem_RAM or a fastmem mirror
+	if(SMCProtect)
+	{
+		size_t offset = (u8*)address - Mem_RAM;
+
+		for(int i = 0; Fastmem && offset >= RAM_SIZE && i < FASTMEM_RAM_VIEWS; i++)
+			offset = (u8*)address - (Mem_Fastmem + Mem_FastmemRAMViews[i]);
+
+		if(offset < RAM_SIZE && PageProtected[offset >> JIT_PAGE_SHIFT])
+		{
+			InvalidatePage((u32)(offset >> JIT_PAGE_SHIFT));
+			return true;
+		}
+	}
+
+	// Fastmem access to an unmapped address, send this site down the slow
+	// path for good and resume there
+	if(Fastmem && (size_t)((u8*)address - Mem_Fastmem) < 0x100000000ULL)
+	{
+		ucontext_t* uc = (ucontext_t*)context;
+#if EMU_PLATFORM == PLATFORM_MACOSX
+		u8* rip = (u8*)uc->uc_mcontext->__ss.__rip;
+#else
+		u8* rip = (u8*)uc->uc_mcontext.gregs[REG_RIP];
+#endif
+		std::map<u8*, FastmemSite>::iterator it = FastmemSites.find(rip);
+		if(it == FastmemSites.end())
+			return false;
+
+		X64Emitter::PatchJump(it->second.slot, it->second.slow);
+#if EMU_PLATFORM == PLATFORM_MACOSX
+		uc->uc_mcontext->__ss.__rip = (u64)it->second.slow;
+#else
+		uc->uc_mcontext.gregs[REG_RIP] = (greg_t)it->second.slow;
+#endif
+		return true;
+	}
+
+	return false;
+}
+
+////////////////////////////////////////////////////////////
+
+// Desc: Run an instruction through the interpreter
+//
+
+void GekkoCPURecompilerX64::CompileFallback(X64Emitter& e, u32 pc, u32 op)
+{
+	e.MOV_MemImm(JIT_PC, pc);
+	e.MOV_RegImm64(X64_ECX, (u64)&opcode);
+	e.MOV_IndImm(X64_ECX, op);
+	e.CALL((void*)ResolveOp(op));
+}
+
+// Desc: Load or store through the fastmem view. edi holds the effective
+// address and esi the data to store, loads return the value in eax.
+// Misaligned accesses take the slow path, since RAM is stored in
+// 32-bit words.
+//
+
+void GekkoCPURecompilerX64::CompileFastAccess(X64Emitter& e, u32 opcd, bool store)
+{
+	u8* slot = e.NOP5();
+	u8* misaligned = NULL;
+
+	e.MOV_RegReg(X64_EAX, X64_EDI);
+#ifdef MEM_NATIVE_BE
+	// Guest byte order, any alignment is a single host access plus a
+	// byte swap. Stores swap a copy so the slow path still has the value.
+	switch(opcd)
+	{
+		case 36:
+			e.MOV_RegReg(X64_ECX, X64_ESI);
+			e.BSWAP_Reg(X64_ECX);
+			break;
+		case 44:
+			e.MOV_RegReg(X64_ECX, X64_ESI);
+			e.ROL16_RegImm(X64_ECX, 8);
+			break;
+	}
+
+	// The only instruction that can fault on an MMIO address
+	u8* access = e.GetCodePtr();
+	switch(opcd)
+	{
+		case 32:	e.MOV_RegFast(X64_EAX, X64_EAX); e.BSWAP_Reg(X64_EAX); break;
+		case 34:	e.MOVZX8_RegFast(X64_EAX, X64_EAX); break;
+		case 40:	e.MOVZX16_RegFast(X64_EAX, X64_EAX); e.ROL16_RegImm(X64_EAX, 8); break;
+		case 42:	e.MOVZX16_RegFast(X64_EAX, X64_EAX); e.ROL16_RegImm(X64_EAX, 8); e.MOVSX16(X64_EAX, X64_EAX); break;
+		case 36:	e.MOV_FastReg(X64_EAX, X64_ECX); break;
+		case 38:	e.MOV8_FastReg(X64_EAX, X64_ESI); break;
+		case 44:	e.MOV16_FastReg(X64_EAX, X64_ECX); break;
+	}
+#else
+	switch(opcd)
+	{
+		case 32: case 36:									// 32-bit
+			e.TEST_RegImm(X64_EAX, 3);
+			misaligned = e.JNE();
+			break;
+		case 40: case 42: case 44:							// 16-bit
+			e.TEST_RegImm(X64_EAX, 1);
+			misaligned = e.JNE();
+			e.ALU_RegImm(X64_ALU_XOR, X64_EAX, 2);
+			break;
+		case 34: case 38:									// 8-bit
+			e.ALU_RegImm(X64_ALU_XOR, X64_EAX, 3);
+			break;
+	}
+
+	// The only instruction that can fault on an MMIO address
+	u8* access = e.GetCodePtr();
+	switch(opcd)
+	{
+		case 32:	e.MOV_RegFast(X64_EAX, X64_EAX); break;
+		case 34:	e.MOVZX8_RegFast(X64_EAX, X64_EAX); break;
+		case 40:	e.MOVZX16_RegFast(X64_EAX, X64_EAX); break;
+		case 42:	e.MOVSX16_RegFast(X64_EAX, X64_EAX); break;
+		case 36:	e.MOV_FastReg(X64_EAX, X64_ESI); break;
+		case 38:	e.MOV8_FastReg(X64_EAX, X64_ESI); break;
+		case 44:	e.MOV16_FastReg(X64_EAX, X64_ESI); break;
+	}
+#endif
+	if(store)
+	{
+		// Bump the page's write generation like Memory_Write* does
+		e.MOV_RegReg(X64_EAX, X64_EDI);
+		e.ALU_RegImm(X64_ALU_AND, X64_EAX, RAM_MASK);
+		e.SHR_RegImm(X64_EAX, WRITE_PAGE_SHIFT);
+		e.MOV_RegImm64(X64_EDX, (u64)Mem_PageWriteGen);
+		e.INC_IndIdx4(X64_EDX, X64_EAX);
+	}
+	u8* done = e.JMP();
+
+	FastmemSite site;
+	site.slot = slot;
+	site.slow = e.GetCodePtr();
+	FastmemSites[access] = site;
+
+	if(misaligned)
+		e.SetJumpTarget(misaligned);
+
+	switch(opcd)
+	{
+		case 32:	e.CALL((void*)Memory_Read32); break;
+		case 34:	e.CALL((void*)Memory_Read8); e.MOVZX8(X64_EAX, X64_EAX); break;
+		case 40:	e.CALL((void*)Memory_Read16); e.MOVZX16(X64_EAX, X64_EAX); break;
+		case 42:	e.CALL((void*)Memory_Read16); e.MOVSX16(X64_EAX, X64_EAX); break;
+		case 36:	e.CALL((void*)Memory_Write32); break;
+		case 38:	e.CALL((void*)Memory_Write8); break;
+		case 44:	e.CALL((void*)Memory_Write16); break;
+	}
+	e.SetJumpTarget(done);
+}
+
+// Desc: Leave the block if the last instruction branched or raised an
+// exception, count is the number of instructions executed so far
+//
+
+void GekkoCPURecompilerX64::CompileBranchCheck(X64Emitter& e, u32 count, std::vector<u8*>& exits)
+{
+	e.MOV_RegImm64(X64_ECX, (u64)&branch);
+	e.MOV_RegImm(X64_EAX, count);
+	e.CMP_IndImm8(X64_ECX, 0);
+	exits.push_back(e.JNE());
+}
+
+// Desc: Compile one instruction, returns true if it ends the block
+//
+
+bool GekkoCPURecompilerX64::CompileInstruction(X64Emitter& e, u32 pc, u32 op, u32 count, std::vector<u8*>& exits)
+{
+	u32 opcd = op >> 26;
+	u32 rd = (op >> 21) & 0x1F;			// also rS
+	u32 ra = (op >> 16) & 0x1F;
+	u32 rb = (op >> 11) & 0x1F;
+	u32 simm = (u32)(s32)(s16)(op & 0xFFFF);
+	u32 uimm = op & 0xFFFF;
+
+	switch(opcd)
+	{
+		// Branches and system calls end the block
+
+		case 16: case 17: case 18:
+			CompileFallback(e, pc, op);
+			e.MOV_RegImm(X64_EAX, count + 1);
+			exits.push_back(e.JMP());
+			return true;
+
+		// Only bclr, bcctr and rfi branch, the condition register ops,
+		// mcrf and isync go through the interpreter like any other op
+
+		case 19:
+		{
+			u32 xo = (op >> 1) & 0x3FF;
+			if(xo != 16 && xo != 528 && xo != 50)
+				break;
+
+			CompileFallback(e, pc, op);
+			e.MOV_RegImm(X64_EAX, count + 1);
+			exits.push_back(e.JMP());
+			return true;
+		}
+
+		// Integer immediate
+
+		case 14:	// addi
+		case 15:	// addis
+		{
+			u32 imm = (opcd == 15) ? (uimm << 16) : simm;
+			if(ra)
+			{
+				e.MOV_RegMem(X64_EAX, JIT_GPR(ra));
+				e.ALU_RegImm(X64_ALU_ADD, X64_EAX, imm);
+				e.MOV_MemReg(JIT_GPR(rd), X64_EAX);
+			}
+			else
+				e.MOV_MemImm(JIT_GPR(rd), imm);
+			return false;
+		}
+
+		case 24:	// ori
+		case 25:	// oris
+		case 26:	// xori
+		case 27:	// xoris
+		{
+			u32 imm = (opcd & 1) ? (uimm << 16) : uimm;
+			e.MOV_RegMem(X64_EAX, JIT_GPR(rd));
+			e.ALU_RegImm((opcd < 26) ? X64_ALU_OR : X64_ALU_XOR, X64_EAX, imm);
+			e.MOV_MemReg(JIT_GPR(ra), X64_EAX);
+			return false;
+		}
+
+		case 21:	// rlwinm
+		{
+			if(op & 1)
+				break;
+
+			u32 mb = (op >> 6) & 0x1F;
+			u32 me = (op >> 1) & 0x1F;
+			u32 mask = ((u32)-1 >> mb) ^ ((me >= 31) ? 0 : ((u32)-1) >> (me + 1));
+			if(mb > me)
+				mask = ~mask;
+
+			e.MOV_RegMem(X64_EAX, JIT_GPR(rd));
+			if(rb)
+				e.ROL_RegImm(X64_EAX, (u8)rb);
+			e.ALU_RegImm(X64_ALU_AND, X64_EAX, mask);
+			e.MOV_MemReg(JIT_GPR(ra), X64_EAX);
+			return false;
+		}
+
+		// Integer register, without Rc/OE
+
+		case 31:
+		{
+			if(op & 1)
+				break;
+
+			switch((op >> 1) & 0x3FF)
+			{
+				case 266:	// add
+					e.MOV_RegMem(X64_EAX, JIT_GPR(ra));
+					e.ALU_RegMem(X64_ALU_ADD, X64_EAX, JIT_GPR(rb));
+					e.MOV_MemReg(JIT_GPR(rd), X64_EAX);
+					return false;
+				case 40:	// subf
+					e.MOV_RegMem(X64_EAX, JIT_GPR(rb));
+					e.ALU_RegMem(X64_ALU_SUB, X64_EAX, JIT_GPR(ra));
+					e.MOV_MemReg(JIT_GPR(rd), X64_EAX);
+					return false;
+				case 235:	// mullw
+					e.MOV_RegMem(X64_EAX, JIT_GPR(ra));
+					e.IMUL_RegMem(X64_EAX, JIT_GPR(rb));
+					e.MOV_MemReg(JIT_GPR(rd), X64_EAX);
+					return false;
+				case 104:	// neg
+					e.MOV_RegMem(X64_EAX, JIT_GPR(ra));
+					e.NEG_Reg(X64_EAX);
+					e.MOV_MemReg(JIT_GPR(rd), X64_EAX);
+					return false;
+				case 28:	// and
+				case 444:	// or
+				case 316:	// xor
+				case 124:	// nor
+				{
+					u32 xo = (op >> 1) & 0x3FF;
+					e.MOV_RegMem(X64_EAX, JIT_GPR(rd));
+					e.ALU_RegMem((xo == 28) ? X64_ALU_AND : (xo == 316) ? X64_ALU_XOR : X64_ALU_OR,
+						X64_EAX, JIT_GPR(rb));
+					if(xo == 124)
+						e.NOT_Reg(X64_EAX);
+					e.MOV_MemReg(JIT_GPR(ra), X64_EAX);
+					return false;
+				}
+				case 60:	// andc
+				case 412:	// orc
+					e.MOV_RegMem(X64_EAX, JIT_GPR(rb));
+					e.NOT_Reg(X64_EAX);
+					e.ALU_RegMem((((op >> 1) & 0x3FF) == 60) ? X64_ALU_AND : X64_ALU_OR,
+						X64_EAX, JIT_GPR(rd));
+					e.MOV_MemReg(JIT_GPR(ra), X64_EAX);
+					return false;
+			}
+			break;
+		}
+
+		// Integer load/store, update forms are the odd opcodes
+
+		case 32: case 33: case 34: case 35: case 40: case 41: case 42: case 43:
+		case 36: case 37: case 38: case 39: case 44: case 45:
+		{
+			bool update = (opcd & 1) != 0;
+			bool store = (opcd >= 36 && opcd <= 39) || opcd >= 44;
+
+			// Invalid forms are left to the interpreter
+			if(update && (ra == 0 || (!store && ra == rd)))
+				break;
+
+			if(ra)
+			{
+				e.MOV_RegMem(X64_EDI, JIT_GPR(ra));
+				e.ALU_RegImm(X64_ALU_ADD, X64_EDI, simm);
+			}
+			else
+				e.MOV_RegImm(X64_EDI, simm);
+
+			// ebp is callee saved, keep the effective address in it for the update
+			if(update)
+				e.MOV_RegReg(X64_EBP, X64_EDI);
+
+			if(store)
+				e.MOV_RegMem(X64_ESI, JIT_GPR(rd));
+
+			if(Fastmem)
+			{
+				CompileFastAccess(e, opcd & ~1, store);
+				if(!store)
+					e.MOV_MemReg(JIT_GPR(rd), X64_EAX);
+			}
+			else if(store)
+			{
+				switch(opcd & ~1)
+				{
+					case 36:	e.CALL((void*)Memory_Write32); break;
+					case 38:	e.CALL((void*)Memory_Write8); break;
+					case 44:	e.CALL((void*)Memory_Write16); break;
+				}
+			}
+			else
+			{
+				switch(opcd & ~1)
+				{
+					case 32:	e.CALL((void*)Memory_Read32); break;
+					case 34:	e.CALL((void*)Memory_Read8); e.MOVZX8(X64_EAX, X64_EAX); break;
+					case 40:	e.CALL((void*)Memory_Read16); e.MOVZX16(X64_EAX, X64_EAX); break;
+					case 42:	e.CALL((void*)Memory_Read16); e.MOVSX16(X64_EAX, X64_EAX); break;
+				}
+				e.MOV_MemReg(JIT_GPR(rd), X64_EAX);
+			}
+
+			if(update)
+				e.MOV_MemReg(JIT_GPR(ra), X64_EBP);
+			return false;
+		}
+	}
+
+	// Everything else goes through the interpreter
+	CompileFallback(e, pc, op);
+	CompileBranchCheck(e, count + 1, exits);
+	return false;
+}
+
+// Desc: Compile the block starting at pc
+//
+
+GekkoCPURecompilerX64::JitCode GekkoCPURecompilerX64::CompileBlock(u32 pc)
+{
+	if((u32)(CodeArena + JIT_ARENA_SIZE - CodePtr) < JIT_MAX_BLOCK_CODE)
+	{
+		LOG_NOTICE(TPOWERPC, "x86-64 recompiler: code cache full, flushing");
+		ClearCache();
+	}
+
+	X64Emitter e(CodePtr);
+	std::vector<u8*> exits;
+	u32 addr = pc;
+	u32 count = 0;
+	bool end = false;
+
+	e.Prologue();
+	e.MOV_RegImm64(X64_EBX, (u64)&ireg);
+	if(Fastmem)
+		e.MOV_R12Imm64((u64)Mem_Fastmem);
+
+	while(!end && count < JIT_MAX_BLOCK_INSTS)
+	{
+		u32 op = MEM_LOAD32(&Mem_RAM[addr & RAM_MASK]);
+
+		end = CompileInstruction(e, addr, op, count, exits);
+		count++;
+		addr += 4;
+	}
+
+	// Fell off the end of the block without branching
+	if(!end)
+	{
+		e.MOV_MemImm(JIT_PC, addr);
+		e.MOV_RegImm(X64_EAX, count);
+	}
+
+	for(u32 i = 0; i < exits.size(); i++)
+		e.SetJumpTarget(exits[i]);
+	e.Epilogue();
+
+	JitBlock block;
+	block.start = pc;
+	block.count = count;
+	block.code = (JitCode)CodePtr;
+
+	u32 index = (u32)Blocks.size();
+	Blocks.push_back(block);
+	BlockTable[(pc & RAM_MASK) >> 2] = index + 1;
+	CodePtr = e.GetCodePtr();
+
+	// Write protect the code so that modifying it drops the block
+	u32 first = (pc & RAM_MASK) >> JIT_PAGE_SHIFT;
+	u32 last = ((addr - 4) & RAM_MASK) >> JIT_PAGE_SHIFT;
+	for(u32 page = first; ; page = (page + 1) % JIT_RAM_PAGES)
+	{
+		PageBlocks[page].push_back(index);
+		ProtectPage(page);
+		if(page == last)
+			break;
+	}
+
+	return block.code;
+}
+
+////////////////////////////////////////////////////////////
+
+// Desc: Execute one block
+//
+
+GekkoF GekkoCPURecompilerX64::ExecuteInstruction(void)
+{
+	static u32 is_dec = 0;
+
+	if(step || CodeArena == NULL || BlockTable == NULL)
+	{
+		GekkoCPUInterpreter::ExecuteInstruction();
+		return;
+	}
+
+	CPUThread = pthread_self();
+
+	u32 index = BlockTable[(ireg.PC & RAM_MASK) >> 2];
+	JitCode code = (index && Blocks[index - 1].start == ireg.PC) ? Blocks[index - 1].code :
+		CompileBlock(ireg.PC);
+
+	branch = 0;
+	u32 InstCount = code();
+
+	ireg.TBR.TBR += InstCount;
+
+	if(DEC < InstCount)
+		is_dec = MSR_BIT_EE;
+
+	DEC -= InstCount;
+	ireg.IC += InstCount;
+
+	// Blocks always end on a branch or after JIT_MAX_BLOCK_INSTS, so
+	// hardware is serviced at about the same rate as the interpreter
+	if(!(branch & OPCODE_RFI))
+	{
+		u32 Ret = Flipper_Update();
+
+		if(!Ret && (ireg.MSR & is_dec))
+		{
+			is_dec = 0;
+			cpu->Exception(GEX_DEC);
+		}
+
+		exception = 0;
+	}
+
+	branch = 0;
+}
+
+#endif // EMU_JIT_X64
@@ -0,0 +1,111 @@
+////////////////////////////////////////////////////////////
+// TITLE:		Gekko PowerPC 750 / Gekko CPU
+// VERSION:		x86-64 Recompiler 0.1
+// FILE:		cpu_jit_x64.h
+// DESC:		x86-64 System V dynamic recompiler
+// CREATED:		Feb. 9, 2013
+////////////////////////////////////////////////////////////
+// Copyright (c) 2013 Gekko Team
+////////////////////////////////////////////////////////////
+
+#ifndef _GEKKO_JIT_X64_H
+#define _GEKKO_JIT_X64_H
+
+#include "common.h"
+
+// The x86-64 recompiler needs mmap/mprotect and SIGSEGV to run, so it is
+// only available on 64-bit POSIX hosts.
+
+#if defined(EMU_ARCHITECTURE_X64) && (EMU_PLATFORM == PLATFORM_LINUX || EMU_PLATFORM == PLATFORM_MACOSX)
+#define EMU_JIT_X64
+#endif
+
+#ifdef EMU_JIT_X64
+
+#include <map>
+#include <vector>
+#include <pthread.h>
+
+#include "memory.h"
+#include "powerpc/cpu_core.h"
+#include "powerpc/interpreter/cpu_int.h"
+
+#define JIT_ARENA_SIZE			(1024*1024*32)				// Executable code arena
+#define JIT_MAX_BLOCK_INSTS		64							// Max PowerPC instructions per block
+#define JIT_MAX_BLOCK_CODE		(JIT_MAX_BLOCK_INSTS * 128)	// Worst case host code per block
+#define JIT_PAGE_SHIFT			CODE_PAGE_SHIFT				// SMC detection granularity (4KB), same as Mem_CodePages
+#define JIT_PAGE_SIZE			(1 << JIT_PAGE_SHIFT)
+#define JIT_RAM_PAGES			(RAM_SIZE >> JIT_PAGE_SHIFT)
+
+////////////////////////////////////////////////////////////
+
+class X64Emitter;
+
+// Desc: Recompiles basic blocks of PowerPC code to x86-64. Integer ALU
+// and load/store instructions are emitted natively, anything else calls
+// straight into the interpreter's opcode handlers, so the interpreter
+// stays the reference implementation. Guest pages holding compiled code
+// are write protected; a write to one of them invalidates its blocks.
+// With fastmem, loads and stores access the host view of the guest
+// address space directly. A site that faults (MMIO) is patched to jump
+// to its slow path from then on.
+//
+
+class GekkoCPURecompilerX64 : public GekkoCPUInterpreter
+{
+public:
+	GekkoCPURecompilerX64();
+	~GekkoCPURecompilerX64();
+
+	CPUType	GetCPUType();
+	GekkoF	Open(u32 entry_point);
+	GekkoF	ExecuteInstruction();
+
+	static bool	HandleFault(void* address, void* context);
+
+private:
+	typedef u32 (*JitCode)(void);
+
+	typedef struct t_JitBlock
+	{
+		u32		start;			// PowerPC address of the first instruction, RAM mirrors
+								// share a table entry so this has to match PC exactly
+		u32		count;			// Number of PowerPC instructions
+		JitCode	code;			// Host code, returns the number of instructions executed
+	} JitBlock;
+
+	typedef struct t_FastmemSite
+	{
+		u8*		slot;			// NOP5 at the start of the access, patched into a jmp
+		u8*		slow;			// Slow path calling Memory_Read*/Write*
+	} FastmemSite;
+
+	static u8*		CodeArena;
+	static u8*		CodePtr;
+	static u32*		BlockTable;						// RAM word -> block index + 1, 0 if none
+	static pthread_t	CPUThread;					// Thread running compiled code
+	static std::vector<JitBlock>	Blocks;
+	static std::vector<u32>			PageBlocks[JIT_RAM_PAGES];
+	static u8		PageProtected[JIT_RAM_PAGES];
+	static bool		SMCProtect;
+	static bool		Fastmem;
+	static std::map<u8*, FastmemSite>	FastmemSites;	// Faulting host instruction -> site
+
+	JitCode	CompileBlock(u32 pc);
+	bool	CompileInstruction(X64Emitter& e, u32 pc, u32 op, u32 count, std::vector<u8*>& exits);
+	void	CompileFallback(X64Emitter& e, u32 pc, u32 op);
+	void	CompileBranchCheck(X64Emitter& e, u32 count, std::vector<u8*>& exits);
+	void	CompileFastAccess(X64Emitter& e, u32 opcd, bool store);
+
+	static void		ClearCache();
+	static void		SetPageAccess(u32 page, int prot);
+	static void		ProtectPage(u32 page);
+	static void		InvalidatePage(u32 page);
+	static void		CodeWriteHandler(u32 addr);
+};
+
+////////////////////////////////////////////////////////////
+
+#endif // EMU_JIT_X64
+
+#endif
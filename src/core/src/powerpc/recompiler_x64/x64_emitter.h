@@ -0,0 +1,304 @@
+////////////////////////////////////////////////////////////
+// TITLE:		Gekko PowerPC 750 / Gekko CPU
+// VERSION:		x86-64 Recompiler 0.1
+// FILE:		x64_emitter.h
+// DESC:		Minimal x86-64 code emitter
+// CREATED:		Feb. 9, 2013
+////////////////////////////////////////////////////////////
+// Copyright (c) 2013 Gekko Team
+////////////////////////////////////////////////////////////
+
+#ifndef _GEKKO_X64_EMITTER_H
+#define _GEKKO_X64_EMITTER_H
+
+#include "common.h"
+
+////////////////////////////////////////////////////////////
+
+// Only the low 8 registers are used, so no REX prefix is needed
+// for 32-bit operations.
+
+typedef enum
+{
+	X64_EAX = 0,
+	X64_ECX = 1,
+	X64_EDX = 2,
+	X64_EBX = 3,
+	X64_ESP = 4,
+	X64_EBP = 5,
+	X64_ESI = 6,
+	X64_EDI = 7
+} X64Reg;
+
+// /n extension of the 0x81 (op r32, imm32) group
+
+typedef enum
+{
+	X64_ALU_ADD = 0,
+	X64_ALU_OR = 1,
+	X64_ALU_AND = 4,
+	X64_ALU_SUB = 5,
+	X64_ALU_XOR = 6,
+	X64_ALU_CMP = 7
+} X64AluOp;
+
+// Desc: Writes x86-64 instructions to a code buffer. Memory operands
+// are [rbx + disp32], rbx holds the base of the register file, or
+// [r12 + r64] for guest memory, r12 holds the fastmem base.
+//
+
+class X64Emitter
+{
+public:
+	X64Emitter(u8* code) : start(code), ptr(code) {}
+
+	u8*		GetCodePtr() { return ptr; }
+	u32		GetSize() { return (u32)(ptr - start); }
+
+	// Stack frame, keeps rsp 16 byte aligned for calls
+
+	void	Prologue()
+	{
+		Write8(0x53);										// push rbx
+		Write8(0x55);										// push rbp
+		Write8(0x41); Write8(0x54);							// push r12
+	}
+
+	void	Epilogue()
+	{
+		Write8(0x41); Write8(0x5C);							// pop r12
+		Write8(0x5D);										// pop rbp
+		Write8(0x5B);										// pop rbx
+		Write8(0xC3);										// ret
+	}
+
+	// Moves
+
+	void	MOV_RegMem(X64Reg dst, s32 disp)					// mov r32, [rbx+disp]
+	{
+		Write8(0x8B); Write8(0x80 | (dst << 3) | X64_EBX); Write32(disp);
+	}
+
+	void	MOV_MemReg(s32 disp, X64Reg src)					// mov [rbx+disp], r32
+	{
+		Write8(0x89); Write8(0x80 | (src << 3) | X64_EBX); Write32(disp);
+	}
+
+	void	MOV_MemImm(s32 disp, u32 imm)						// mov dword [rbx+disp], imm32
+	{
+		Write8(0xC7); Write8(0x80 | X64_EBX); Write32(disp); Write32(imm);
+	}
+
+	void	MOV_RegImm(X64Reg dst, u32 imm)						// mov r32, imm32
+	{
+		Write8(0xB8 + dst); Write32(imm);
+	}
+
+	void	MOV_RegImm64(X64Reg dst, u64 imm)					// mov r64, imm64
+	{
+		Write8(0x48); Write8(0xB8 + dst); Write64(imm);
+	}
+
+	void	MOV_RegReg(X64Reg dst, X64Reg src)					// mov r32, r32
+	{
+		Write8(0x89); Write8(0xC0 | (src << 3) | dst);
+	}
+
+	void	MOV_IndImm(X64Reg base, u32 imm)					// mov dword [r64], imm32
+	{
+		Write8(0xC7); Write8(base); Write32(imm);
+	}
+
+	void	MOV_R12Imm64(u64 imm)								// mov r12, imm64
+	{
+		Write8(0x49); Write8(0xBC); Write64(imm);
+	}
+
+	// Guest memory, [r12 + idx]. idx must have been written as 32 bits so
+	// that its upper half is zero.
+
+	void	MOV_RegFast(X64Reg dst, X64Reg idx)					// mov r32, [r12+idx]
+	{
+		Write8(0x41); Write8(0x8B); WriteFastModRM(dst, idx);
+	}
+
+	void	MOVZX8_RegFast(X64Reg dst, X64Reg idx)				// movzx r32, byte [r12+idx]
+	{
+		Write8(0x41); Write8(0x0F); Write8(0xB6); WriteFastModRM(dst, idx);
+	}
+
+	void	MOVZX16_RegFast(X64Reg dst, X64Reg idx)				// movzx r32, word [r12+idx]
+	{
+		Write8(0x41); Write8(0x0F); Write8(0xB7); WriteFastModRM(dst, idx);
+	}
+
+	void	MOVSX16_RegFast(X64Reg dst, X64Reg idx)				// movsx r32, word [r12+idx]
+	{
+		Write8(0x41); Write8(0x0F); Write8(0xBF); WriteFastModRM(dst, idx);
+	}
+
+	void	MOV_FastReg(X64Reg idx, X64Reg src)					// mov [r12+idx], r32
+	{
+		Write8(0x41); Write8(0x89); WriteFastModRM(src, idx);
+	}
+
+	void	MOV16_FastReg(X64Reg idx, X64Reg src)				// mov [r12+idx], r16
+	{
+		Write8(0x66); Write8(0x41); Write8(0x89); WriteFastModRM(src, idx);
+	}
+
+	void	MOV8_FastReg(X64Reg idx, X64Reg src)				// mov [r12+idx], r8 (REX selects sil/dil)
+	{
+		Write8(0x41); Write8(0x88); WriteFastModRM(src, idx);
+	}
+
+	void	MOVZX8(X64Reg dst, X64Reg src)						// movzx r32, r8
+	{
+		Write8(0x0F); Write8(0xB6); Write8(0xC0 | (dst << 3) | src);
+	}
+
+	void	MOVZX16(X64Reg dst, X64Reg src)						// movzx r32, r16
+	{
+		Write8(0x0F); Write8(0xB7); Write8(0xC0 | (dst << 3) | src);
+	}
+
+	void	MOVSX16(X64Reg dst, X64Reg src)						// movsx r32, r16
+	{
+		Write8(0x0F); Write8(0xBF); Write8(0xC0 | (dst << 3) | src);
+	}
+
+	// Arithmetic
+
+	void	ALU_RegReg(X64AluOp op, X64Reg dst, X64Reg src)		// op r32, r32
+	{
+		static const u8 opcodes[8] = {0x01, 0x09, 0x11, 0x19, 0x21, 0x29, 0x31, 0x39};
+		Write8(opcodes[op]); Write8(0xC0 | (src << 3) | dst);
+	}
+
+	void	ALU_RegImm(X64AluOp op, X64Reg dst, u32 imm)		// op r32, imm32
+	{
+		Write8(0x81); Write8(0xC0 | (op << 3) | dst); Write32(imm);
+	}
+
+	void	ALU_RegMem(X64AluOp op, X64Reg dst, s32 disp)		// op r32, [rbx+disp]
+	{
+		static const u8 opcodes[8] = {0x03, 0x0B, 0x13, 0x1B, 0x23, 0x2B, 0x33, 0x3B};
+		Write8(opcodes[op]); Write8(0x80 | (dst << 3) | X64_EBX); Write32(disp);
+	}
+
+	void	IMUL_RegMem(X64Reg dst, s32 disp)					// imul r32, [rbx+disp]
+	{
+		Write8(0x0F); Write8(0xAF); Write8(0x80 | (dst << 3) | X64_EBX); Write32(disp);
+	}
+
+	void	TEST_RegImm(X64Reg dst, u32 imm)					// test r32, imm32
+	{
+		Write8(0xF7); Write8(0xC0 | dst); Write32(imm);
+	}
+
+	void	SHR_RegImm(X64Reg dst, u8 imm)						// shr r32, imm8
+	{
+		Write8(0xC1); Write8(0xE8 | dst); Write8(imm);
+	}
+
+	void	ROL_RegImm(X64Reg dst, u8 imm)						// rol r32, imm8
+	{
+		Write8(0xC1); Write8(0xC0 | dst); Write8(imm);
+	}
+
+	void	ROL16_RegImm(X64Reg dst, u8 imm)					// rol r16, imm8
+	{
+		Write8(0x66); Write8(0xC1); Write8(0xC0 | dst); Write8(imm);
+	}
+
+	void	BSWAP_Reg(X64Reg dst)								// bswap r32
+	{
+		Write8(0x0F); Write8(0xC8 + dst);
+	}
+
+	void	NOT_Reg(X64Reg dst)									// not r32
+	{
+		Write8(0xF7); Write8(0xD0 | dst);
+	}
+
+	void	NEG_Reg(X64Reg dst)									// neg r32
+	{
+		Write8(0xF7); Write8(0xD8 | dst);
+	}
+
+	void	INC_IndIdx4(X64Reg base, X64Reg idx)				// inc dword [r64 + r64*4]
+	{
+		Write8(0xFF); Write8(0x04); Write8(0x80 | (idx << 3) | base);
+	}
+
+	void	CMP_IndImm8(X64Reg base, u8 imm)					// cmp dword [r64], imm8
+	{
+		Write8(0x83); Write8(0x38 | base); Write8(imm);
+	}
+
+	// Control flow
+
+	void	CALL_Reg(X64Reg reg)								// call r64
+	{
+		Write8(0xFF); Write8(0xD0 | reg);
+	}
+
+	void	CALL(const void* func)								// mov rax, func; call rax
+	{
+		MOV_RegImm64(X64_EAX, (u64)func);
+		CALL_Reg(X64_EAX);
+	}
+
+	u8*		JNE()												// jne rel32, returns fixup
+	{
+		Write8(0x0F); Write8(0x85); Write32(0);
+		return ptr;
+	}
+
+	u8*		JMP()												// jmp rel32, returns fixup
+	{
+		Write8(0xE9); Write32(0);
+		return ptr;
+	}
+
+	// Desc: Points a jump returned by JNE/JMP at the current position
+	//
+
+	void	SetJumpTarget(u8* fixup)
+	{
+		*(s32*)(fixup - 4) = (s32)(ptr - fixup);
+	}
+
+	// Desc: 5 byte nop that PatchJump can later turn into a jmp
+	//
+
+	u8*		NOP5()
+	{
+		Write8(0x0F); Write8(0x1F); Write8(0x44); Write8(0x00); Write8(0x00);
+		return ptr - 5;
+	}
+
+	static void	PatchJump(u8* site, u8* target)					// overwrite a NOP5 with jmp rel32
+	{
+		*(s32*)(site + 1) = (s32)(target - (site + 5));
+		site[0] = 0xE9;
+	}
+
+private:
+	inline void Write8(u8 v) { *ptr++ = v; }
+	inline void Write32(u32 v) { *(u32*)ptr = v; ptr += 4; }
+	inline void Write64(u64 v) { *(u64*)ptr = v; ptr += 8; }
+
+	inline void WriteFastModRM(X64Reg reg, X64Reg idx)
+	{
+		Write8((reg << 3) | 4);								// mod 00, rm = SIB
+		Write8((idx << 3) | 4);								// scale 1, base = r12 (REX.B)
+	}
+
+	u8*		start;
+	u8*		ptr;
+};
+
+////////////////////////////////////////////////////////////
+
+#endif
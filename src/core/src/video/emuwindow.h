@@ -46,6 +46,8 @@ public:
         int     res_height;
     };
 
+    virtual ~EmuWindow() {}
+
     /// Swap buffers to display the next frame
     virtual void SwapBuffers() = 0;
 
@@ -88,7 +90,6 @@ protected:
             __DATE__);
         window_title_ = window_title;
     }
-    virtual ~EmuWindow() {}
 
     std::string window_title_;          ///< Current window title, should be used by window impl.
 
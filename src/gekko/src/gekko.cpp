@@ -43,6 +43,7 @@
 #include "video/opengl.h"
 #endif
 #include "emuwindow/emuwindow_glfw.h"
+#include "emuwindow/emuwindow_headless.h"
 
 #include "gekko.h"
 #include "fifo_player.h"
@@ -72,7 +73,17 @@ int __cdecl main(int argc, char **argv) {
     config_manager.ReloadConfig(NULL);
     core::SetConfigManager(&config_manager);
 
-    EmuWindow_GLFW* emu_window = new EmuWindow_GLFW;
+    // The null and software renderers don't need a GPU, don't ask for a window or GL context
+    EmuWindow* emu_window;
+    switch (common::g_config->current_renderer()) {
+    case common::Config::RENDERER_NULL:
+    case common::Config::RENDERER_SOFTWARE:
+        emu_window = new EmuWindow_Headless;
+        break;
+    default:
+        emu_window = new EmuWindow_GLFW;
+        break;
+    }
 
     if (E_OK != core::Init(emu_window)) {
         LOG_ERROR(TMASTER, "core initialization failed, exiting...");
@@ -115,9 +126,7 @@ int __cdecl main(int argc, char **argv) {
     video_core::Start(emu_window);
     core::SetState(core::SYS_RUNNING);
 
-    fifo_player::FPFile file;
-    fifo_player::Load("/home/tony/20_frames.gff", file);
-    fifo_player::PlayFile(file);
+    fifo_player::PlayFile("/home/tony/20_frames.gff");
 
     // TODO: Wait for video core to finish - PlayFile should handle this
     while (1);
@@ -85,7 +85,7 @@ void GDisAsmView::OnCPUStepped()
     model->setRowCount(100);
     while(true)
     {
-        u32 opcode = *(u32*)(&Mem_RAM[curInstAddr & RAM_MASK]);
+        u32 opcode = MEM_LOAD32(&Mem_RAM[curInstAddr & RAM_MASK]);
 
         char out1[64];
         char out2[128];
@@ -1,10 +1,11 @@
+#include <QFile>
 #include <QFileDialog>
 
 #include "gfx_fifo_player.hxx"
 
 #include "fifo_player.h"
 
-GGfxFifoPlayerControl::GGfxFifoPlayerControl(QWidget* parent) : QDockWidget(parent), last_recording(NULL)
+GGfxFifoPlayerControl::GGfxFifoPlayerControl(QWidget* parent) : QDockWidget(parent)
 {
     ui.setupUi(this);
 
@@ -23,15 +24,23 @@ void GGfxFifoPlayerControl::OnStartStopRecordingClicked()
 {
     if (!fifo_player::IsRecording())
     {
+        // Frames are written out while recording, so the file has to be picked up front
+        QString filename = QFileDialog::getSaveFileName(this, tr("Record Fifo log"), QString(), QString());
+        if (filename.isEmpty())
+            return;
+
+        // TODO: Adjust parameters
+        if (!fifo_player::StartRecording(filename.toLocal8Bit().data()))
+            return;
+
+        last_recording = filename;
         ui.saveRecordingButton->setEnabled(false);
         ui.playbackGroup->setEnabled(false);
         ui.startStopRecordingButton->setText(tr("Stop"));
-        // TODO: Adjust parameters
-        fifo_player::StartRecording();
     }
     else
     {
-        last_recording = &fifo_player::EndRecording();
+        fifo_player::EndRecording();
         // TODO: Do other stuff
 
         ui.startStopRecordingButton->setText(tr("Start"));
@@ -42,10 +51,12 @@ void GGfxFifoPlayerControl::OnStartStopRecordingClicked()
 
 void GGfxFifoPlayerControl::OnSaveRecordingClicked()
 {
-    // TODO
-    QString filename = QFileDialog::getOpenFileName(this, tr("Save Fifo log"), QString(), QString());
-    if (filename.size())
-        fifo_player::Save(filename.toLatin1().data(), (fifo_player::FPFile&)*last_recording);
+    QString filename = QFileDialog::getSaveFileName(this, tr("Save Fifo log"), QString(), QString());
+    if (filename.size() && filename != last_recording)
+    {
+        QFile::remove(filename);
+        QFile::copy(last_recording, filename);
+    }
     ui.playbackGroup->setEnabled(true);
 }
 
@@ -55,20 +66,16 @@ void GGfxFifoPlayerControl::OnStartPlaybackClicked()
     {
         case PLAYBACK_SOURCE_LAST_RECORDING:
         {
-            fifo_player::PlayFile((fifo_player::FPFile&)*last_recording);
+            if (last_recording.isEmpty() || !fifo_player::PlayFile(last_recording.toLocal8Bit().data()))
+                return;
             break;
         }
 
         case PLAYBACK_SOURCE_FROM_FILE:
         {
-            QString filename = QFileDialog::getOpenFileName(this, tr("Save Fifo log"), QString(), QString());
-            if (filename.size())
-            {
-                fifo_player::FPFile file;
-                fifo_player::Load(filename.toLatin1().data(), file);
-                fifo_player::PlayFile(file);
+            QString filename = QFileDialog::getOpenFileName(this, tr("Load Fifo log"), QString(), QString());
+            if (filename.size() && fifo_player::PlayFile(filename.toLocal8Bit().data()))
                 break;
-            }
             else return;
         }
     }
@@ -2,12 +2,9 @@
 #define _GEKKO_GFX_FIFO_PLAYER_HXX_
 
 #include <QDockWidget>
+#include <QString>
 #include "ui_gfx_fifo_player.h"
 
-namespace fifo_player {
-    struct FPFile;
-}
-
 class GGfxFifoPlayerControl : public QDockWidget
 {
     Q_OBJECT
@@ -30,7 +27,7 @@ private:
 
     Ui::GfxFifoPlayerControl ui;
 
-    const fifo_player::FPFile* last_recording;
+    QString last_recording; ///< File the last recording was written to
 };
 
 #endif // _GEKKO_GFX_FIFO_PLAYER_HXX_
@@ -49,6 +49,8 @@ namespace gp {
 
 BPMemory g_bp_regs; ///< BP memory/registers
 
+u8 g_prefetch_units = 0; ///< Texture units whose TexImage0/3 changed since they were prefetched
+
 /// Sets the scissor box
 void BP_SetScissorBox() {
     // The scissor rectangle specifies an area of the screen outside of which all primitives are 
@@ -89,6 +91,35 @@ void BP_SetLinePointSize() {
     video_core::g_renderer->SetLinePointSize(line_width, point_size);
 }
 
+/// Returns the texture unit of a TexImage0/TexImage3 register, -1 for any other register
+static inline int BP_GetTexImageUnit(u8 addr) {
+    switch (addr & 0xDC) {
+    case BP_REG_TX_SETIMAGE0:
+    case BP_REG_TX_SETIMAGE3:
+    case BP_REG_TX_SETIMAGE0_4:
+    case BP_REG_TX_SETIMAGE3_4:
+        return (addr & 3) | ((addr & 0x20) >> 3);
+    }
+    return -1;
+}
+
+/**
+ * Starts decoding the textures of units that were set up since the last prefetch. Waits for the
+ * game to move on to another register, so that a texture is only prefetched once both its
+ * TexImage0 and TexImage3 are written
+ */
+static void BP_PrefetchTextures() {
+    for (int num = 0; num < kGCMaxActiveTextures; num++) {
+        if (g_prefetch_units & (1 << num)) {
+            int set = (num & 4) >> 2;
+            int index = num & 3;
+            video_core::g_texture_manager->Prefetch(num, g_bp_regs.tex[set].image_0[index],
+                g_bp_regs.tex[set].image_3[index]);
+        }
+    }
+    g_prefetch_units = 0;
+}
+
 /// Write a BP register
 void BP_RegisterWrite(u8 addr, u32 data) {
     LOG_DEBUG(TGP, "BP_LOAD [%02x] = %08x", addr, data);
@@ -102,12 +133,23 @@ void BP_RegisterWrite(u8 addr, u32 data) {
             addr != BP_REG_TEXINVALIDATE && addr != BP_REG_TEXMODESYNC) {
         return;
     }
+    // Draw primitives batched up with the old register state
+    VertexManager_Flush();
+
 	// Write data to bp memory
     g_bp_regs.mem[addr] = data;
 
     // Write to renderer
     video_core::g_renderer->WriteBP(addr, data);
 
+    // Look ahead at texture setup, the draw using the texture usually comes much later
+    int tex_image_unit = BP_GetTexImageUnit(addr);
+    if (tex_image_unit >= 0) {
+        g_prefetch_units |= 1 << tex_image_unit;
+    } else if (g_prefetch_units) {
+        BP_PrefetchTextures();
+    }
+
     // Adjust GX globals accordingly
     switch(addr) {
     case BP_REG_GENMODE: // GEN_MODE
@@ -169,7 +211,6 @@ void BP_RegisterWrite(u8 addr, u32 data) {
             video_core::g_renderer->SwapBuffers();
             if (fifo_player::IsRecording())
                 fifo_player::FrameFinished();
-            Fifo_Reset();
             GX_PE_FINISH = 1;
             video_core::g_current_frame++;
             video_core::g_texture_manager->Purge();
@@ -326,9 +367,12 @@ void BP_RegisterWrite(u8 addr, u32 data) {
 
 /// Load a texture
 void BP_LoadTexture() {
+    // Too late to prefetch anything, the textures are needed now
+    g_prefetch_units = 0;
+
     for (int num = 0; num < kGCMaxActiveTextures; num++) {
         int set = (num & 4) >> 2;
-        int index = num & 7;
+        int index = num & 3;
         for (int stage = 0; stage < kGCMaxTevStages; stage++) {
             if (g_bp_regs.tevorder[stage >> 1].get_texmap(stage) == num) {
                 video_core::g_texture_manager->UpdateData(num, g_bp_regs.tex[set].image_0[index],
@@ -345,6 +389,7 @@ void BP_LoadTexture() {
 /// Initialize BP
 void BP_Init() {
     memset(&g_bp_regs, 0, sizeof(g_bp_regs));
+    g_prefetch_units = 0;
 
     // Clear EFB on startup with alpha of 1.0f
     // TODO(ShizZy): Remove hard coded EFB rect size (still need a video_core or renderer interface
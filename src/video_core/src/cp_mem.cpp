@@ -25,6 +25,8 @@
 #include "common.h"
 #include "cp_mem.h"
 #include "video_core.h"
+#include "vertex_loader.h"
+#include "vertex_manager.h"
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 // Graphics Processor namespace
@@ -39,8 +41,17 @@ void CP_RegisterWrite(u8 addr, u32 data) {
     if (g_cp_regs.mem[addr] == data) {
         return;
     }
+    // Vertices are decoded as they come in, array bases and strides don't affect batched ones
+    if (addr < CP_REG_ARRAY_BASE) {
+        VertexManager_Flush();
+    }
     g_cp_regs.mem[addr] = data;
 
+    // Vertex formats are looked up per VAT, the VCD is shared by all of them
+    if (addr >= CP_REG_VCD_LO && addr < CP_REG_ARRAY_BASE) {
+        VertexLoader_InvalidateFormats((addr < CP_REG_VAT_A) ? 0xFF : (1 << (addr & 7)));
+    }
+
     switch (addr) {
     // Map all 8 CP_REG_VCD_LO registers to the base register
     case CP_REG_VCD_LO + 0:
@@ -98,6 +109,7 @@ void CP_RegisterWrite(u8 addr, u32 data) {
 /// Initialize CP
 void CP_Init() {
     memset(&g_cp_regs, 0, sizeof(g_cp_regs));
+    VertexLoader_InvalidateFormats(0xFF);
 }
 
 } // namespace
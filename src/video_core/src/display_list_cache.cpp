@@ -0,0 +1,459 @@
+/**
+ * Copyright (C) 2005-2012 Gekko Emulator
+ *
+ * @file    display_list_cache.cpp
+ * @author  ShizZy <shizzy247@gmail.com>
+ * @date    2013-02-27
+ * @brief   Cache of parsed and decoded display lists
+ *
+ * @section LICENSE
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details at
+ * http://www.gnu.org/copyleft/gpl.html
+ *
+ * Official project repository can be found at:
+ * http://code.google.com/p/gekko-gc-emu/
+ */
+
+#include <vector>
+
+#include "common.h"
+#include "hash.h"
+#include "hash_container.h"
+#include "memory.h"
+
+#include "vertex_loader.h"
+#include "vertex_manager.h"
+#include "display_list_cache.h"
+#include "fifo.h"
+#include "bp_mem.h"
+#include "cp_mem.h"
+#include "xf_mem.h"
+
+namespace gp {
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Display list cache
+//
+// Games build most of their static geometry into display lists once and call them frame after
+// frame. Executing a list from RAM assembles every byte through the RAM swizzle and decodes every
+// vertex again on every call. Instead, the second time a list is called with unchanged contents it
+// is recorded: parsed once into the register writes and primitives it is made of, with the
+// vertices of the primitives already decoded. Later calls replay the recording, register writes go
+// straight to the BP/CP/XF handlers and the decoded vertices are copied into the vertex manager.
+//
+// Vertices with indexed components read CP vertex arrays outside of the list, primitives using
+// them keep their vertex data and are decoded again on every replay. XF indexed loads, texture
+// loads and the like still read RAM at replay time, as they are register writes.
+//
+// Parsing depends on the vertex formats the list starts out with, so the VCD/VAT registers are
+// part of the key. RAM writes are caught with the page write generations: until the pages of a
+// list are written to it is replayed as is, afterwards it is hashed again and dropped if its
+// contents changed.
+
+static const u32 kMaxCachedBytes = 64 * 1024 * 1024;    ///< Recorded data kept before starting over
+
+/// Key of a display list, its location and the vertex formats it is called with
+struct DisplayListKey {
+    u32 addr;
+    u32 size;
+    u32 vcd_lo;
+    u32 vcd_hi;
+    u32 vat_a[8];
+    u32 vat_b[8];
+    u32 vat_c[8];
+};
+
+/// Recorded display list command
+struct DisplayListOp {
+    enum Type {
+        kCPLoad,            ///< addr - register, data - value
+        kXFLoad,            ///< addr - register, count - register count, data - offset into regs
+        kXFIndexedLoad,     ///< addr - register, count - register count, data - array index
+        kBPLoad,            ///< data - address (upper 8 bits) and value
+        kPrimitive,         ///< count - vertex count, data - byte offset into vertices
+        kRawPrimitive,      ///< count - vertex count, data - offset of the vertex data into bytes
+        kCall,              ///< addr - display list address, data - display list size
+        kInvalidateVertexCache  ///< Clears the vertex reuse table
+    };
+    u8  type;
+    u8  cmd;                ///< Command byte, holds the primitive type and VAT of primitives
+    u16 count;
+    u32 addr;
+    u32 data;
+};
+
+/// Cached display list
+struct DisplayList {
+    DisplayListKey  key;
+    u64             write_gen;      ///< Write generation of the list pages when last looked at
+    common::Hash64  hash;           ///< Hash of the list contents, valid once recorded
+    bool            recorded;       ///< True if ops holds a recording of the list
+    bool            cacheable;      ///< False if the list can't be recorded (runs past its end)
+    u32             cached_bytes;   ///< Memory held by the recording
+
+    std::vector<DisplayListOp>  ops;        ///< Recorded commands
+    std::vector<u32>            regs;       ///< XF register data
+    std::vector<u8>             vertices;   ///< Decoded vertices, in their compact layout
+    std::vector<u8>             bytes;      ///< List contents, kept if there are raw primitives
+};
+
+typedef HashContainer_STLMap<common::Hash64, DisplayList> DisplayListCache;
+
+DisplayListCache*   g_dl_cache = NULL;      ///< Display lists seen so far, by key hash
+u32                 g_dl_cached_bytes = 0;  ///< Memory held by all recordings
+int                 g_dl_call_depth = 0;    ///< Display lists currently being executed
+std::vector<u8>     g_dl_scratch;           ///< List contents, for hashing
+
+static inline u16 _read_16(const u8* ptr) {
+    return (ptr[0] << 8) | ptr[1];
+}
+
+static inline u32 _read_32(const u8* ptr) {
+    return (ptr[0] << 24) | (ptr[1] << 16) | (ptr[2] << 8) | ptr[3];
+}
+
+/**
+ * Hashes the contents of a display list
+ * @param addr RAM address of the display list
+ * @param size Size of the display list in bytes
+ * @return Hash of the display list
+ */
+static common::Hash64 DisplayListCache_Hash(u32 addr, u32 size) {
+    g_dl_scratch.resize(size);
+    Memory_CopyFromRAM(&g_dl_scratch[0], addr, size);
+    return common::GetHash64(&g_dl_scratch[0], size, 0);
+}
+
+/**
+ * Throws away the recording of a display list
+ * @param dl Display list
+ */
+static void DisplayListCache_Drop(DisplayList* dl) {
+    g_dl_cached_bytes -= dl->cached_bytes;
+    dl->cached_bytes = 0;
+    dl->recorded = false;
+    std::vector<DisplayListOp>().swap(dl->ops);
+    std::vector<u32>().swap(dl->regs);
+    std::vector<u8>().swap(dl->vertices);
+    std::vector<u8>().swap(dl->bytes);
+}
+
+/**
+ * Executes a recorded display list command
+ * @param dl Display list the command belongs to
+ * @param op Command
+ */
+static void DisplayListCache_Execute(DisplayList* dl, const DisplayListOp& op) {
+    g_cur_cmd = op.cmd;
+    g_cur_vat = op.cmd & 0x7;
+
+    switch (op.type) {
+    case DisplayListOp::kCPLoad:
+        CP_RegisterWrite((u8)op.addr, op.data);
+        break;
+
+    case DisplayListOp::kXFLoad:
+        XF_Load(op.count, op.addr, &dl->regs[op.data]);
+        break;
+
+    case DisplayListOp::kXFIndexedLoad:
+        XF_LoadIndexed(GP_OPMASK(op.cmd) - GP_OPMASK(GP_LOAD_IDX_A), (u16)op.data, (u8)op.count,
+            (u16)op.addr);
+        break;
+
+    case DisplayListOp::kBPLoad:
+        BP_RegisterWrite(op.data >> 24, op.data & 0x00FFFFFF);
+        break;
+
+    case DisplayListOp::kPrimitive:
+        VertexLoader_DrawVertices((GXPrimitive)(op.cmd & 0xF8), op.count, 
+            &dl->vertices[0] + op.data);
+        break;
+
+    case DisplayListOp::kRawPrimitive:
+        {
+            // Decode as if the vertex data was in the FIFO
+            u8* last_read_ptr = g_fifo_read_ptr;
+            bool last_dl_active = g_dl_active;
+
+            g_fifo_read_ptr = &dl->bytes[0] + op.data;
+            g_dl_active = false;
+            VertexLoader_DecodePrimitive((GXPrimitive)(op.cmd & 0xF8), op.count);
+            g_fifo_read_ptr = last_read_ptr;
+            g_dl_active = last_dl_active;
+        }
+        break;
+
+    case DisplayListOp::kCall:
+        DisplayListCache_Call(op.addr, op.data);
+        break;
+
+    case DisplayListOp::kInvalidateVertexCache:
+        VertexManager_InvalidateVertexCache();
+        break;
+    }
+}
+
+/**
+ * Records a display list while executing it
+ * @param dl Display list to record
+ */
+static void DisplayListCache_Record(DisplayList* dl) {
+    const u32 addr = dl->key.addr;
+    const u32 size = dl->key.size;
+    bool has_raw_primitives = false;
+
+    dl->bytes.resize(size);
+    Memory_CopyFromRAM(&dl->bytes[0], addr, size);
+    dl->hash = common::GetHash64(&dl->bytes[0], size, 0);
+
+    u32 offset = 0;
+    while (offset < size) {
+        const u8* cmd = &dl->bytes[offset];
+        u32 avail = size - offset;
+        u32 length = 1;
+        DisplayListOp op;
+
+        op.cmd = cmd[0];
+        op.count = 0;
+        op.addr = 0;
+        op.data = 0;
+
+        switch (GP_OPMASK(op.cmd)) {
+        case GP_OPMASK(GP_NOP):
+            offset++;
+            continue;
+
+        case GP_OPMASK(GP_INVALIDATE_VERTEX_CACHE):
+            op.type = DisplayListOp::kInvalidateVertexCache;
+            break;
+
+        case GP_OPMASK(GP_LOAD_CP_REG):
+            length = 6;
+            if (avail >= length) {
+                op.type = DisplayListOp::kCPLoad;
+                op.addr = cmd[1];
+                op.data = _read_32(cmd + 2);
+            }
+            break;
+
+        case GP_OPMASK(GP_LOAD_XF_REG):
+            length = 5;
+            if (avail >= length) {
+                u32 temp = _read_32(cmd + 1);
+                op.type = DisplayListOp::kXFLoad;
+                op.count = (u16)((temp >> 16) + 1);
+                op.addr = temp & 0xFFFF;
+                op.data = (u32)dl->regs.size();
+                length += op.count * 4;
+
+                _ASSERT_MSG(TGP, op.count <= 64, "LOAD_XF_REG invalid length=%d!", op.count);
+                if (avail >= length) {
+                    for (int i = 0; i < op.count; i++) {
+                        dl->regs.push_back(_read_32(cmd + 5 + i * 4));
+                    }
+                }
+            }
+            break;
+
+        case GP_OPMASK(GP_LOAD_IDX_A):
+        case GP_OPMASK(GP_LOAD_IDX_B):
+        case GP_OPMASK(GP_LOAD_IDX_C):
+        case GP_OPMASK(GP_LOAD_IDX_D):
+            length = 5;
+            if (avail >= length) {
+                u16 data = _read_16(cmd + 3);
+                op.type = DisplayListOp::kXFIndexedLoad;
+                op.data = _read_16(cmd + 1);
+                op.count = (data >> 12) + 1;
+                op.addr = data & 0xFFF;
+            }
+            break;
+
+        case GP_OPMASK(GP_CALL_DISPLAYLIST):
+            length = 9;
+            if (avail >= length) {
+                op.type = DisplayListOp::kCall;
+                op.addr = _read_32(cmd + 1) & RAM_MASK;
+                op.data = _read_32(cmd + 5);
+            }
+            break;
+
+        case GP_OPMASK(GP_LOAD_BP_REG):
+            length = 5;
+            if (avail >= length) {
+                op.type = DisplayListOp::kBPLoad;
+                op.data = _read_32(cmd + 1);
+            }
+            break;
+
+        case GP_OPMASK(GP_DRAW_QUADS):
+        case GP_OPMASK(GP_DRAW_TRIANGLES):
+        case GP_OPMASK(GP_DRAW_TRIANGLESTRIP):
+        case GP_OPMASK(GP_DRAW_TRIANGLEFAN):
+        case GP_OPMASK(GP_DRAW_LINES):
+        case GP_OPMASK(GP_DRAW_LINESTRIP):
+        case GP_OPMASK(GP_DRAW_POINTS):
+            length = 3;
+            if (avail >= length) {
+                op.count = _read_16(cmd + 1);
+                g_cur_vat = op.cmd & 0x7;
+                length += op.count * VertexLoader_GetVertexSize(g_cur_vat);
+            }
+            if (avail >= length) {
+                size_t first = dl->vertices.size();
+                dl->vertices.resize(first + op.count * VertexLoader_GetDecodedVertexSize());
+
+                if (op.count != 0 && VertexLoader_DecodeVertices(cmd + 3, op.count,
+                    &dl->vertices[first])) {
+                    op.type = DisplayListOp::kPrimitive;
+                    op.data = (u32)first;
+                } else {
+                    dl->vertices.resize(first);
+                    op.type = DisplayListOp::kRawPrimitive;
+                    op.data = offset + 3;
+                    has_raw_primitives = true;
+                }
+            }
+            break;
+
+        default:
+            _ASSERT_MSG(TGP, 0, "GP Fifo has been corrupted. Continue?");
+            offset++;
+            continue;
+        }
+
+        // A command running past the end of the list reads whatever follows it in RAM, leave that
+        // to the interpreter and don't bother with this list again
+        if (avail < length) {
+            DisplayListCache_Drop(dl);
+            dl->cacheable = false;
+            Fifo_RunDisplayList(addr, offset, size);
+            return;
+        }
+        dl->ops.push_back(op);
+        DisplayListCache_Execute(dl, dl->ops.back());
+        offset += length;
+    }
+
+    if (!has_raw_primitives) {
+        std::vector<u8>().swap(dl->bytes);
+    }
+    dl->recorded = true;
+    dl->cached_bytes = (u32)(dl->ops.capacity() * sizeof(DisplayListOp) +
+        dl->regs.capacity() * sizeof(u32) + dl->vertices.capacity() +
+        dl->bytes.capacity());
+    g_dl_cached_bytes += dl->cached_bytes;
+
+    LOG_DEBUG(TGP, "Recorded display list %08x size=%08x: %d commands, %d vertex bytes", addr,
+        size, (int)dl->ops.size(), (int)dl->vertices.size());
+}
+
+/**
+ * Executes a display list through the cache
+ * @param addr RAM address of the display list
+ * @param size Size of the display list in bytes
+ */
+static void DisplayListCache_Run(u32 addr, u32 size) {
+    DisplayListKey key;
+    key.addr = addr;
+    key.size = size;
+    key.vcd_lo = g_cp_regs.vcd_lo[0]._u32;
+    key.vcd_hi = g_cp_regs.vcd_hi[0]._u32;
+    for (int i = 0; i < 8; i++) {
+        key.vat_a[i] = g_cp_regs.vat_reg_a[i]._u32;
+        key.vat_b[i] = g_cp_regs.vat_reg_b[i]._u32;
+        key.vat_c[i] = g_cp_regs.vat_reg_c[i]._u32;
+    }
+    common::Hash64 key_hash = common::GetHash64((const u8*)&key, sizeof(key), 0);
+    DisplayList* dl = g_dl_cache->FetchFromHash(key_hash);
+    u64 write_gen = Memory_GetWriteGen(addr, size);
+
+    // First call, lists that are only called once aren't worth recording
+    if (dl == NULL || memcmp(&key, &dl->key, sizeof(key)) != 0) {
+        if (dl != NULL) {
+            DisplayListCache_Drop(dl);
+        }
+        DisplayList new_dl;
+        new_dl.key = key;
+        new_dl.write_gen = write_gen;
+        new_dl.hash = 0;
+        new_dl.recorded = false;
+        new_dl.cacheable = true;
+        new_dl.cached_bytes = 0;
+        g_dl_cache->Update(key_hash, new_dl);
+
+        Fifo_RunDisplayList(addr, 0, size);
+        return;
+    }
+
+    // Written to since last time, find out if the contents actually changed
+    if (write_gen != dl->write_gen) {
+        dl->write_gen = write_gen;
+        dl->cacheable = true;
+
+        if (!dl->recorded || DisplayListCache_Hash(addr, size) != dl->hash) {
+            DisplayListCache_Drop(dl);
+            Fifo_RunDisplayList(addr, 0, size);
+            return;
+        }
+    }
+
+    if (!dl->cacheable) {
+        Fifo_RunDisplayList(addr, 0, size);
+    } else if (!dl->recorded) {
+        DisplayListCache_Record(dl);
+    } else {
+        for (size_t i = 0; i < dl->ops.size(); i++) {
+            DisplayListCache_Execute(dl, dl->ops[i]);
+        }
+    }
+}
+
+/**
+ * Executes a display list, replaying it from the cache if it has been called before
+ * @param addr RAM address of the display list
+ * @param size Size of the display list in bytes
+ */
+void DisplayListCache_Call(u32 addr, u32 size) {
+    // Lists reaching past the end of RAM are garbage, don't let them near the cache
+    if (size == 0 || size > (RAM_SIZE - addr)) {
+        Fifo_RunDisplayList(addr, 0, size);
+        return;
+    }
+
+    // Only start over when no recording is being replayed
+    if (g_dl_call_depth == 0 && g_dl_cached_bytes > kMaxCachedBytes) {
+        LOG_DEBUG(TGP, "Display list cache full (%d lists), starting over", g_dl_cache->Size());
+        delete g_dl_cache;
+        g_dl_cache = new DisplayListCache();
+        g_dl_cached_bytes = 0;
+    }
+    g_dl_call_depth++;
+    DisplayListCache_Run(addr, size);
+    g_dl_call_depth--;
+}
+
+/// Initialize the display list cache
+void DisplayListCache_Init() {
+    g_dl_cache = new DisplayListCache();
+    g_dl_cached_bytes = 0;
+    g_dl_call_depth = 0;
+}
+
+/// Shutdown the display list cache
+void DisplayListCache_Shutdown() {
+    delete g_dl_cache;
+    g_dl_cache = NULL;
+    std::vector<u8>().swap(g_dl_scratch);
+}
+
+} // namespace
@@ -0,0 +1,50 @@
+/**
+ * Copyright (C) 2005-2012 Gekko Emulator
+ *
+ * @file    display_list_cache.h
+ * @author  ShizZy <shizzy247@gmail.com>
+ * @date    2013-02-27
+ * @brief   Cache of parsed and decoded display lists
+ *
+ * @section LICENSE
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details at
+ * http://www.gnu.org/copyleft/gpl.html
+ *
+ * Official project repository can be found at:
+ * http://code.google.com/p/gekko-gc-emu/
+ */
+
+#ifndef VIDEO_CORE_DISPLAY_LIST_CACHE_H_
+#define VIDEO_CORE_DISPLAY_LIST_CACHE_H_
+
+#include "common.h"
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Display list cache
+
+namespace gp {
+
+/**
+ * Executes a display list, replaying it from the cache if it has been called before
+ * @param addr RAM address of the display list
+ * @param size Size of the display list in bytes
+ */
+void DisplayListCache_Call(u32 addr, u32 size);
+
+/// Initialize the display list cache
+void DisplayListCache_Init();
+
+/// Shutdown the display list cache
+void DisplayListCache_Shutdown();
+
+} // namespace
+
+#endif // VIDEO_CORE_DISPLAY_LIST_CACHE_H_
@@ -23,12 +23,17 @@
  */
 
 #include "common.h"
+#include "atomic.h"
+#include "config.h"
+#include "mem_arena.h"
 #include "memory.h"
 #include "std_mutex.h"
 #include "core.h"
 
 #include "video_core.h"
 #include "vertex_loader.h"
+#include "vertex_manager.h"
+#include "display_list_cache.h"
 #include "fifo.h"
 #include "fifo_player.h"
 #include "bp_mem.h"
@@ -45,18 +50,30 @@ GPFuncPtr g_exec_op[0x20];      ///< GPOpcode table
 u8 g_cur_cmd = 0;               ///< Current command to be executed
 u8 g_cur_vat = 0;               ///< Current vertex attribute table
 
-u32 volatile g_fifo_write_ptr;  ///< FIFO write location
+u32 volatile g_fifo_write_ptr;  ///< FIFO write position (CPU thread)
+u32 volatile g_fifo_publish_ptr;///< FIFO write position visible to the GP thread
+u32 volatile g_fifo_read_pos;   ///< FIFO position consumed by the GP thread
 u8* volatile g_fifo_read_ptr;   ///< FIFO read location
-u8* volatile g_fifo_end_ptr;    ///< End of the primary FIFO buffer
 
 u8* volatile g_dl_read_ptr;     ///< Display list read location
 
-u8 g_fifo_buffer[FIFO_SIZE];    ///< Primary FIFO buffer storage - Don't use directly
+u8* g_fifo_buffer = NULL;       ///< FIFO ring storage, followed by its mirror - Don't use directly
+bool g_fifo_os_mirror;          ///< True if the mirror is a second mapping of the ring
+u32 g_fifo_mirror_size;         ///< Bytes of the ring start copied to the mirror (no OS mirror)
+common::MemArena g_fifo_arena;  ///< Shared memory backing the mirrored ring
 
-u32 volatile g_reset_fifo;      ///< Used to synchronize CPU-GPU threads
+u32 volatile g_gp_waiting;      ///< Set while the GP thread is parked waiting for data
+u32 volatile g_gp_seen_ptr;     ///< Last publish pointer the GP thread has looked at
+u32 g_fifo_ready_end;           ///< FIFO position up to which commands are known to be complete
+u32 g_fifo_scan_need;           ///< Bytes needed at the read pointer before scanning again
+SDL_mutex*  g_gp_wait_mutex;    ///< Mutex protecting the GP thread wait
+SDL_cond*   g_gp_wait_cond;     ///< Signaled when new data is published to a waiting GP thread
+u32 volatile g_cpu_waiting;     ///< Set while the CPU thread is parked waiting for FIFO space
+SDL_cond*   g_cpu_wait_cond;    ///< Signaled when a waiting CPU thread should check for space
 
 u32 g_dl_read_addr;             ///< Display list read address     
 u32 g_dl_read_offset;           ///< Display list read offset
+bool g_dl_active = false;       ///< True while commands are read from a display list
 
 u8 (*Fifo_Pop8)();              ///< Pointer to FIFO 8-bit pop method (DL or FIFO)            
 u16 (*Fifo_Pop16)();            ///< Pointer to FIFO 16-bit pop method (DL or FIFO)   
@@ -108,7 +125,7 @@ static inline u32 __fifo_pop_32() {
  */
 inline u8 __displaylist_pop_8() {
     u32 ret2 = g_dl_read_addr + g_dl_read_offset;
-	u32 res = Mem_RAM[(ret2+0) ^ 3];
+	u32 res = Mem_RAM[MEM_SWIZZLE8(ret2+0)];
     g_dl_read_offset+=1;
     return res;
 }
@@ -119,8 +136,8 @@ inline u8 __displaylist_pop_8() {
  */
 static inline u16 __displaylist_pop_16() {
     u32 ret2 = g_dl_read_addr + g_dl_read_offset;
-    u16 res = (Mem_RAM[(ret2+0) ^ 3] << 8) |
-              (Mem_RAM[(ret2+1) ^ 3]);
+    u16 res = (Mem_RAM[MEM_SWIZZLE8(ret2+0)] << 8) |
+              (Mem_RAM[MEM_SWIZZLE8(ret2+1)]);
 
 
     g_dl_read_offset+=2;
@@ -141,10 +158,10 @@ static inline u32 __displaylist_pop_24() {
  */
 static inline u32 __displaylist_pop_32() {
     u32 res = g_dl_read_addr + g_dl_read_offset;
-    res = (Mem_RAM[(res+0) ^ 3] << 24) |
-          (Mem_RAM[(res+1) ^ 3] << 16) |
-          (Mem_RAM[(res+2) ^ 3] << 8) |
-          (Mem_RAM[(res+3) ^ 3]);
+    res = (Mem_RAM[MEM_SWIZZLE8(res+0)] << 24) |
+          (Mem_RAM[MEM_SWIZZLE8(res+1)] << 16) |
+          (Mem_RAM[MEM_SWIZZLE8(res+2)] << 8) |
+          (Mem_RAM[MEM_SWIZZLE8(res+3)]);
 
     g_dl_read_offset+=4;
     return res;
@@ -156,6 +173,7 @@ static inline void _set_fifo_read_normal() {
     Fifo_Pop16 = __fifo_pop_16;
     Fifo_Pop24 = __fifo_pop_24;
     Fifo_Pop32 = __fifo_pop_32;
+    g_dl_active = false;
 }
 
 /// Sets the GP in display list read mode
@@ -164,6 +182,7 @@ static inline void _set_fifo_read_displaylists() {
     Fifo_Pop16 = __displaylist_pop_16;
     Fifo_Pop24 = __displaylist_pop_24;
     Fifo_Pop32 = __displaylist_pop_32;
+    g_dl_active = true;
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -258,19 +277,9 @@ GP_OPCODE(CALL_DISPLAYLIST) {
 	u32 addr = Fifo_Pop32() & RAM_MASK;
     u32 size = Fifo_Pop32();
 
-    g_dl_read_addr = addr;
-    g_dl_read_offset = 0;
     LOG_DEBUG(TGP, "CALL_DISPLAYLIST: addr=%08x size=%08x", addr, size);
 
-    _set_fifo_read_displaylists();
-
-    while (g_dl_read_offset < size) {
-        g_cur_cmd = Fifo_Pop8();
-        g_cur_vat = g_cur_cmd & 0x7;
-        g_exec_op[GP_OPMASK(g_cur_cmd)]();
-    }
-
-    _set_fifo_read_normal();
+    DisplayListCache_Call(addr, size);
 
     LOG_DEBUG(TGP, "CALL_DISPLAYLIST finished", addr, size);
 }
@@ -278,6 +287,7 @@ GP_OPCODE(CALL_DISPLAYLIST) {
 /// invalidate vertex cache
 GP_OPCODE(INVALIDATE_VERTEX_CACHE) {
     LOG_DEBUG(TGP, "INVALIDATE_VERTEX_CACHE");
+    VertexManager_InvalidateVertexCache();
 }
 
 /// load bp register with data
@@ -336,230 +346,340 @@ GP_OPCODE(DRAW_POINTS) {
 	VertexLoader_DecodePrimitive(GX_POINTS, count);
 }
 
+/**
+ * Executes a display list straight from RAM
+ * @param addr RAM address of the display list
+ * @param offset Offset of the first command to execute
+ * @param size Size of the display list in bytes
+ */
+void Fifo_RunDisplayList(u32 addr, u32 offset, u32 size) {
+    // Restore whatever called us when done, replayed display lists may call this in turn
+    u32 last_addr = g_dl_read_addr;
+    u32 last_offset = g_dl_read_offset;
+    bool last_active = g_dl_active;
+
+    g_dl_read_addr = addr;
+    g_dl_read_offset = offset;
+
+    _set_fifo_read_displaylists();
+
+    while (g_dl_read_offset < size) {
+        g_cur_cmd = Fifo_Pop8();
+        g_cur_vat = g_cur_cmd & 0x7;
+        g_exec_op[GP_OPMASK(g_cur_cmd)]();
+    }
+
+    g_dl_read_addr = last_addr;
+    g_dl_read_offset = last_offset;
+    if (last_active) {
+        _set_fifo_read_displaylists();
+    } else {
+        _set_fifo_read_normal();
+    }
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 // FIFO flow control
 
+/**
+ * Makes the data that wrapped around the end of the ring readable from the mirror, when the 
+ * mirror isn't a second mapping of the ring
+ * @param bytes_in_fifo Number of published bytes starting at the read pointer
+ */
+static void Fifo_MirrorWrap(u32 bytes_in_fifo) {
+    u32 end = (g_fifo_read_ptr - g_fifo_buffer) + bytes_in_fifo;
+
+    if (end > FIFO_SIZE && (end - FIFO_SIZE) > g_fifo_mirror_size) {
+        memcpy(g_fifo_buffer + FIFO_SIZE + g_fifo_mirror_size, g_fifo_buffer + g_fifo_mirror_size, 
+            (end - FIFO_SIZE) - g_fifo_mirror_size);
+        g_fifo_mirror_size = end - FIFO_SIZE;
+    }
+}
+
+/**
+ * Gets the size of a GP command
+ * @param cmd Command bytes
+ * @param avail Number of bytes available at cmd
+ * @return Size of the command. If more than avail, the command is incomplete and this is the
+ * number of bytes needed to tell its size or the command's size if that could be told already.
+ */
+static u32 Fifo_GetCommandSize(const u8* cmd, u32 avail) {
+    switch (GP_OPMASK(cmd[0])) {
+    case GP_OPMASK(GP_NOP):
+    case GP_OPMASK(GP_INVALIDATE_VERTEX_CACHE):
+        return 1;
+
+    case GP_OPMASK(GP_LOAD_CP_REG):
+        return 6;
+
+    case GP_OPMASK(GP_LOAD_XF_REG):
+        if (avail < 5) {
+            return 5;
+        }
+        return 5 + 4 * (((cmd[1] << 8) | cmd[2]) + 1);
+
+    case GP_OPMASK(GP_LOAD_IDX_A):
+    case GP_OPMASK(GP_LOAD_IDX_B):
+    case GP_OPMASK(GP_LOAD_IDX_C):
+    case GP_OPMASK(GP_LOAD_IDX_D):
+    case GP_OPMASK(GP_LOAD_BP_REG):
+        return 5;
+
+    case GP_OPMASK(GP_CALL_DISPLAYLIST):
+        return 9;
+
+    default:
+        if (cmd[0] & 0x80) { // Draw command
+            if (avail < 3) {
+                return 3;
+            }
+            return 3 + ((cmd[1] << 8) | cmd[2]) * VertexLoader_GetVertexSize(cmd[0] & 0x7);
+        }
+        return 1; // Corrupted, leave it to GPOPCODE_UNKNOWN
+    }
+}
+
+/**
+ * Sizes as many of the published commands at the read pointer as possible in one go. Stops 
+ * after commands that may change the vertex format, the size of the draws that follow them isn't
+ * known until they have been executed.
+ * @param bytes_in_fifo Number of published bytes starting at the read pointer
+ */
+static void Fifo_ScanCommands(u32 bytes_in_fifo) {
+    const u8* cmd = g_fifo_read_ptr;
+    u32 offset = 0;
+
+    g_fifo_scan_need = 0;
+    while (offset < bytes_in_fifo) {
+        u32 size = Fifo_GetCommandSize(cmd + offset, bytes_in_fifo - offset);
+        if (size > bytes_in_fifo - offset) {
+            g_fifo_scan_need = size;
+            break;
+        }
+        const u8* next = cmd + offset;
+        offset += size;
+
+        if (GP_OPMASK(next[0]) == GP_OPMASK(GP_LOAD_CP_REG)) {
+            if (next[1] >= CP_REG_VCD_LO && next[1] < CP_REG_ARRAY_BASE) {
+                break;
+            }
+        } else if (GP_OPMASK(next[0]) == GP_OPMASK(GP_CALL_DISPLAYLIST)) {
+            break;
+        }
+    }
+    g_fifo_ready_end = g_fifo_read_pos + offset;
+}
+
 /// Returns true if the current command in the FIFO is ready to be decoded
 bool Fifo_NextCommandReady() {
-    static int last_required_size = -1;
+    u32 bytes_in_fifo = g_gp_seen_ptr - g_fifo_read_pos;
 
     // We haven't started (at the beginning), or something went terrible wrong...
-    if (g_fifo_read_ptr == (g_fifo_buffer + g_fifo_write_ptr)) {
+    if (bytes_in_fifo == 0) {
         return false;
     }
-    // Otherwise, read_ptr < write_ptr:
-    uintptr_t bytes_in_fifo = (g_fifo_buffer + g_fifo_write_ptr) - g_fifo_read_ptr;
+    if (!g_fifo_os_mirror) {
+        Fifo_MirrorWrap(bytes_in_fifo);
+    }
 
-    // Last size still right...
-	if ((last_required_size != -1) && (last_required_size > (s32)bytes_in_fifo)) {
-	    return false;
+    // Size the next run of commands once the last one has been executed, and no sooner than the
+    // first command of it can be complete
+    u32 bytes_ready = g_fifo_ready_end - g_fifo_read_pos;
+    if (bytes_ready == 0 || bytes_ready > bytes_in_fifo) {
+        if (bytes_in_fifo < g_fifo_scan_need) {
+            return false;
+        }
+        Fifo_ScanCommands(bytes_in_fifo);
+        if (g_fifo_ready_end == g_fifo_read_pos) {
+            return false;
+        }
     }
 
     // Get current command and vat
     g_cur_cmd = FIFO_GET8(0);
     g_cur_vat = g_cur_cmd & 0x7;
+    return true;
+}
 
-    // Determine opcode size
-    switch(GP_OPMASK(g_cur_cmd))
-    {
-    case 0: // NOP
-        last_required_size = -1;
-        return true;
-    
-    case 1: // LOAD_CP
-        if(bytes_in_fifo >= 6) {
-            last_required_size = -1;
-            return true;
-        }
-        last_required_size = 6;
-        break; 
-    
-    case 2: // LOAD XF
-        if (bytes_in_fifo >= 5) { // if header is present
-            u32 temp = FIFO_GET32(1);
-	        u16 size  = 4 * ((temp >> 16) + 1);
-            size += 5;
-            if(bytes_in_fifo >= size)
-            {
-                last_required_size = -1;
-                return true;
-            }
-            else {
-                last_required_size = size;
-            }
-        } else {
-            last_required_size = 5;
-        }
-        break;
-
-    case 4: // LOAD IDX A
-    case 5: // " B
-    case 6: // " C 
-    case 7: // " D
-        if (bytes_in_fifo >= 5) {
-            last_required_size = -1;
-            return true;
-        }
-        last_required_size = 5;
-        break; 
-
-    case 8: // CALL_DL
-        if (bytes_in_fifo >= 9) {
-            last_required_size = -1;
-            return true;
-        }
-        last_required_size = 9;
-        break; 
+/**
+ * Gets the size of a complete GP command
+ * @param read_ptr Command bytes
+ * @return Size of the command
+ */
+int Fifo_GetCommandLength(u8* read_ptr) {
+    return Fifo_GetCommandSize(read_ptr, 0xFFFFFFFF);
+}
 
-    case 9: // INVALID_VTX_CACHE
-        last_required_size = -1;
-        return true;
+/// Publishes data written by the CPU to the GP thread, waking it up if it is waiting
+void Fifo_Flush() {
+    if (g_fifo_publish_ptr != g_fifo_write_ptr) {
+        common::AtomicStoreRelease(g_fifo_publish_ptr, g_fifo_write_ptr);
+    }
+    // Only bother the GP thread if it is parked and hasn't seen this data yet
+    if (common::AtomicLoad(g_gp_waiting) && 
+        (common::AtomicLoad(g_gp_seen_ptr) != g_fifo_publish_ptr)) {
+        SDL_LockMutex(g_gp_wait_mutex);
+        SDL_CondSignal(g_gp_wait_cond);
+        SDL_UnlockMutex(g_gp_wait_mutex);
+    }
+}
 
-    case 0xC: // LOAD BP
-        if (bytes_in_fifo >= 5) {
-            last_required_size = -1;
-            return true;
-        }
-        last_required_size = 5;
-        return false; 
-
-    default: 		
-        if(g_cur_cmd & 0x80) { // Draw command
-            if(bytes_in_fifo >= 3) {    // See if header exists
-                u16 numverts = FIFO_GET16(1);
-                u16 vertsize = VertexLoader_GetVertexSize();
-                u16 size = 3;
-
-                size += numverts * vertsize;
-                if(bytes_in_fifo >= size) {
-                    last_required_size = -1;
-                    return true;
-                } else {
-                    last_required_size = size;
-                }
-            } else {
-                last_required_size = 3;
-            }
-        }
-        return false;
+/// Fixes up a push that ran past the end of the ring, when the mirror isn't mapped by the OS
+void Fifo_WrapWrite(u32 offset, u32 size) {
+    if (!g_fifo_os_mirror) {
+        memcpy(g_fifo_buffer, g_fifo_buffer + FIFO_SIZE, (offset + size) - FIFO_SIZE);
     }
-    return false;
 }
 
-int Fifo_GetCommandLength(u8* read_ptr)
-{
-#define GET8(ptr)      (*ptr)
-#define GET16(ptr)     (BSWAP16(*((u16*)(ptr))))
-#define GET32(ptr)     (BSWAP32(*((u32*)(ptr))))
-
-    u8 cmd = *read_ptr++;
-    int command_size = 0;
-
-    switch (GP_OPMASK(cmd))
-    {
-    case 0: // NOP
-    case 9: // INVALID_VTX_CACHE
-//    case GP_OPMASK(GX_CMD_UNKNOWN_METRICS): // TODO 
-        command_size = 1;
-        break;
-
-    case 0xC: // LOAD BP
-        command_size = 5;
-        break;
-
-    case 1: // LOAD_CP
-        command_size = 6;
-        break;
-
-    case 4: // LOAD IDX A
-    case 5: // " B
-    case 6: // " C
-    case 7: // " D
-        command_size = 5;
-        break;
-
-    case 8: // CALL_DL
-        // TODO: return full size?
-        command_size = 9;
-        break;
-
-    case 2: // LOAD XF
-        {
-            command_size = 1 + 4;
-            u32 Cmd2 = GET32(read_ptr);
-            int transfer_size = ((Cmd2 >> 16) & 15) + 1;
-            command_size += transfer_size * 4;
-        }
-        break;
+/**
+ * Checks if the ring has room for a push
+ * @param size Number of bytes to be written
+ * @return True if size bytes can be written without overwriting unread data
+ */
+static inline bool Fifo_HasSpace(u32 size) {
+    return (g_fifo_write_ptr + size - common::AtomicLoadAcquire(g_fifo_read_pos)) <= FIFO_SIZE;
+}
 
-    default:
-        if(g_cur_cmd & 0x80) // Draw command
-        {
-            command_size = 1 + 2;
-            u16 numVertices = GET16(read_ptr);
-            command_size += numVertices * VertexLoader_GetVertexSize();
+/**
+ * Drops the unread FIFO data when the GP can't make progress, because the command at the read
+ * pointer is larger than the whole ring. Must only be called while the GP isn't decoding.
+ */
+static void Fifo_DropUnread() {
+    LOG_ERROR(TGP, "GP FIFO overflow, command does not fit into %d bytes! Dropping %u bytes",
+        FIFO_SIZE, g_fifo_write_ptr - g_fifo_read_pos);
+
+    g_fifo_read_ptr     = g_fifo_buffer + (g_fifo_write_ptr & FIFO_MASK);
+    g_fifo_ready_end    = g_fifo_write_ptr;
+    g_fifo_scan_need    = 0;
+    g_fifo_mirror_size  = 0;
+    common::AtomicStoreRelease(g_fifo_read_pos, g_fifo_write_ptr);
+}
+
+/// Blocks the CPU thread until the GP thread has freed up FIFO space for size bytes
+void Fifo_WaitForSpace(u32 size) {
+    // Make sure the GP thread has everything there is to work on
+    Fifo_Flush();
+
+    if (!common::g_config->enable_multicore()) {
+        while (!Fifo_HasSpace(size)) {
+            if (!Fifo_DecodeCommand()) {
+                Fifo_DropUnread();
+            }
         }
-        else
-        {
-            // TODO: Error or sth
+        return;
+    }
+    SDL_LockMutex(g_gp_wait_mutex);
+
+    // Full barrier, so either we see the space freed up or the GP thread sees us waiting
+    common::AtomicOr(g_cpu_waiting, 1);
+
+    while (!Fifo_HasSpace(size)) {
+        // A parked GP thread that has seen all data can only be waiting on a command that is
+        // larger than the whole ring. It stays parked until we publish more, so its read state
+        // is ours to reset while we hold the mutex.
+        if (common::AtomicLoad(g_gp_waiting) && 
+            (common::AtomicLoad(g_gp_seen_ptr) == g_fifo_publish_ptr)) {
+            Fifo_DropUnread();
+            break;
         }
-        break;
+        SDL_CondWait(g_cpu_wait_cond, g_gp_wait_mutex);
     }
-    return command_size;
+    common::AtomicStore(g_cpu_waiting, 0);
+
+    SDL_UnlockMutex(g_gp_wait_mutex);
 }
 
-/// Called at end of frame to reset FIFO
-void Fifo_Reset() {
-    if (g_fifo_write_ptr > FIFO_TAIL_END) {
+/// Blocks the GP thread until the CPU publishes new FIFO data
+void Fifo_WaitForData() {
+    SDL_LockMutex(g_gp_wait_mutex);
 
-        // Move FIFO to beginning
-        g_fifo_write_ptr    = 0;
-        g_fifo_read_ptr     = g_fifo_buffer;
-        memset(g_fifo_buffer, 0, FIFO_SIZE);
+    // Full barrier, so either we see the new publish pointer or Fifo_Flush sees us waiting
+    common::AtomicOr(g_gp_waiting, 1);
 
-        g_reset_fifo = 0;
+    // A CPU thread waiting for space has to find out that none is coming until it publishes more
+    if (common::AtomicLoad(g_cpu_waiting)) {
+        SDL_CondSignal(g_cpu_wait_cond);
     }
-}
+    while (common::AtomicLoadAcquire(g_fifo_publish_ptr) == g_gp_seen_ptr) {
+        SDL_CondWait(g_gp_wait_cond, g_gp_wait_mutex);
+    }
+    common::AtomicStore(g_gp_waiting, 0);
 
-/// Decodes current FIFO command
-void Fifo_DecodeCommand() {
+    SDL_UnlockMutex(g_gp_wait_mutex);
+}
 
-    int bytes_in_fifo = g_fifo_write_ptr - (g_fifo_read_ptr - g_fifo_buffer);
+/**
+ * Decodes current FIFO command
+ * @return True if a command was decoded, false if the FIFO holds no complete command
+ */
+bool Fifo_DecodeCommand() {
+    g_gp_seen_ptr = common::AtomicLoadAcquire(g_fifo_publish_ptr);
 
-    if (bytes_in_fifo < 1) {
-        if (!g_reset_fifo) {
-            return;
-        }
-    }
-    _ASSERT_MSG(TGP, g_fifo_write_ptr >=  (g_fifo_read_ptr - g_fifo_buffer), 
+    _ASSERT_MSG(TGP, (g_gp_seen_ptr - g_fifo_read_pos) <= FIFO_SIZE, 
         "GP decoding read_ptr > wrote_ptr, this should never happen!");
         
     // Get the next GP opcode and decode it
     if (Fifo_NextCommandReady()) {
+        u8* cmd_start = g_fifo_read_ptr;
+
         // TODO: Display list handling...
         if (GP_OPMASK(g_cur_cmd) != 8 && fifo_player::IsRecording())
         {
             fifo_player::Write(g_fifo_read_ptr, Fifo_GetCommandLength(g_fifo_read_ptr));
         }
         g_exec_op[GP_OPMASK(Fifo_Pop8())]();
+
+        // Commands are read contiguously through the mirror, move back into the ring afterwards
+        if (g_fifo_read_ptr >= (g_fifo_buffer + FIFO_SIZE)) {
+            g_fifo_read_ptr -= FIFO_SIZE;
+            g_fifo_mirror_size = 0;
+        }
+        // Full barrier, so either we see the CPU thread waiting or it sees the space freed up
+        common::AtomicAdd(g_fifo_read_pos, (u32)((g_fifo_read_ptr - cmd_start) & FIFO_MASK));
+        if (common::AtomicLoad(g_cpu_waiting)) {
+            SDL_LockMutex(g_gp_wait_mutex);
+            SDL_CondSignal(g_cpu_wait_cond);
+            SDL_UnlockMutex(g_gp_wait_mutex);
+        }
+        return true;
     }
-    return;
+    return false;
 }
 
 /// Initialize GP FIFO
 void Fifo_Init() {
     _set_fifo_read_normal();
 
+    // Map the ring twice back to back, so nothing ever has to care about the wrap. Fall back
+    // to copying the wrapped part into a plain buffer's mirror if the OS can't do it.
+    g_fifo_os_mirror    = false;
+    if (g_fifo_arena.Create(FIFO_SIZE)) {
+        g_fifo_buffer   = g_fifo_arena.MapMirrored();
+        g_fifo_os_mirror = (g_fifo_buffer != NULL);
+    }
+    if (!g_fifo_os_mirror) {
+        LOG_WARNING(TGP, "Unable to map mirrored GP FIFO, using a copied mirror");
+        g_fifo_arena.Release();
+        g_fifo_buffer   = new u8[FIFO_SIZE * 2];
+    }
+    g_fifo_mirror_size  = 0;
+
     // FIFO pointers
     g_fifo_write_ptr    = 0;
+    g_fifo_publish_ptr  = 0;
+    g_fifo_read_pos     = 0;
     g_fifo_read_ptr     = g_fifo_buffer;
+    g_fifo_ready_end    = 0;
+    g_fifo_scan_need    = 0;
 
-    g_reset_fifo        = 0;
-
-    // Zero FIFO memory
-	memset(g_fifo_buffer, 0, FIFO_SIZE);
+    // GP thread wake-up
+    g_gp_waiting        = 0;
+    g_gp_seen_ptr       = 0;
+    g_gp_wait_mutex     = SDL_CreateMutex();
+    g_gp_wait_cond      = SDL_CreateCond();
+    g_cpu_waiting       = 0;
+    g_cpu_wait_cond     = SDL_CreateCond();
 
-    g_reset_fifo = 0;
     g_dl_read_addr = 0;
     g_dl_read_offset = 0;
 
@@ -590,6 +710,17 @@ void Fifo_Init() {
 
 /// Shutdown GP FIFO
 void Fifo_Shutdown() {
+    SDL_DestroyCond(g_cpu_wait_cond);
+    SDL_DestroyCond(g_gp_wait_cond);
+    SDL_DestroyMutex(g_gp_wait_mutex);
+
+    if (g_fifo_os_mirror) {
+        g_fifo_arena.UnmapMirrored(g_fifo_buffer);
+        g_fifo_arena.Release();
+    } else {
+        delete[] g_fifo_buffer;
+    }
+    g_fifo_buffer = NULL;
 }
 
 } // namespace
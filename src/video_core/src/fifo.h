@@ -41,9 +41,10 @@ typedef void(*GPFuncPtr)(void); ///< Function pointer GP opcodes
 #define GP_SETOP(n, op)         g_exec_op[n] = (GPFuncPtr)op
 
 // FIFO information
-#define FIFO_SIZE           (128 * 1024 * 1024)         // 128mb
-#define FIFO_TAIL_END       (120 * 1024 * 1024)         // First 120mb of FIFO
+#define FIFO_SIZE           (8 * 1024 * 1024)           // 8mb ring, must be a power of two
 #define FIFO_MASK           (FIFO_SIZE - 1)             // Mask
+#define FIFO_BURST_SIZE     32                          // Write-gather burst size, CPU data is handed
+                                                        // to the GP thread in chunks of this size
 
 /// Get last byte from FIFO
 #define FIFO_GET8(ofs)      *(gp::g_fifo_read_ptr + ofs)
@@ -86,43 +87,103 @@ namespace gp {
 extern u8 g_cur_cmd;                        ///< Current command to be executed
 extern u8 g_cur_vat;                        ///< Current vertex attribute table
 
-extern u32 volatile g_fifo_write_ptr;       ///< FIFO write location
+// FIFO positions are free running byte counts, the ring offset is (position & FIFO_MASK)
+extern u32 volatile g_fifo_write_ptr;       ///< FIFO write position (CPU thread)
+extern u32 volatile g_fifo_publish_ptr;     ///< FIFO write position visible to the GP thread
+extern u32 volatile g_fifo_read_pos;        ///< FIFO position consumed by the GP thread
 extern u8* volatile g_fifo_read_ptr;        ///< FIFO read location
-extern SDL_mutex*  g_fifo_write_ptr_mutex;  ///< Mutex for accessing g_fifo_write_ptr
 
-extern u8 g_fifo_buffer[FIFO_SIZE];         ///< Primary FIFO buffer storage - Don't use directly
+extern u32 g_dl_read_addr;                  ///< Display list read address
+extern u32 g_dl_read_offset;                ///< Display list read offset
+extern bool g_dl_active;                    ///< True while commands are read from a display list
+
+/// FIFO ring storage, FIFO_SIZE bytes followed by a mirror of the ring so that commands can be
+/// read (and pushes written) contiguously across the wrap - Don't use directly
+extern u8* g_fifo_buffer;
 
 extern u8 (*Fifo_Pop8)();                   ///< Pointer to FIFO 8-bit pop method (DL or FIFO) 
 extern u16 (*Fifo_Pop16)();                 ///< Pointer to FIFO 16-bit pop method (DL or FIFO)
 extern u32 (*Fifo_Pop24)();                 ///< Pointer to FIFO 24-bit pop method (DL or FIFO)
 extern u32 (*Fifo_Pop32)();                 ///< Pointer to FIFO 32-bit pop method (DL or FIFO)
 
+/// Publishes data written by the CPU to the GP thread, waking it up if it is waiting
+void Fifo_Flush();
+
+/// Publish a full write-gather burst to the GP thread
+static inline void Fifo_CheckBurst() {
+    if ((g_fifo_write_ptr - g_fifo_publish_ptr) >= FIFO_BURST_SIZE) {
+        Fifo_Flush();
+    }
+}
+
+/// Blocks the CPU thread until the GP thread has freed up FIFO space for size bytes
+void Fifo_WaitForSpace(u32 size);
+
+/// Fixes up a push that ran past the end of the ring, when the mirror isn't mapped by the OS
+void Fifo_WrapWrite(u32 offset, u32 size);
+
+/**
+ * Starts a push into the FIFO
+ * @param size Number of bytes to be written
+ * @return Ring offset to write the data to
+ */
+static inline u32 Fifo_BeginWrite(u32 size) {
+    if ((g_fifo_write_ptr + size - g_fifo_read_pos) > FIFO_SIZE) {
+        Fifo_WaitForSpace(size);
+    }
+    return g_fifo_write_ptr & FIFO_MASK;
+}
+
+/**
+ * Finishes a push into the FIFO
+ * @param offset Ring offset returned by Fifo_BeginWrite
+ * @param size Number of bytes written
+ */
+static inline void Fifo_EndWrite(u32 offset, u32 size) {
+    if ((offset + size) > FIFO_SIZE) {
+        Fifo_WrapWrite(offset, size);
+    }
+    g_fifo_write_ptr += size;
+    Fifo_CheckBurst();
+}
+
 /// Push 8-bit byte into the FIFO
 static inline void Fifo_Push8(u8 data) {
-    g_fifo_buffer[g_fifo_write_ptr] = data;
-    g_fifo_write_ptr++;
+    u32 offset = Fifo_BeginWrite(1);
+    g_fifo_buffer[offset] = data;
+    Fifo_EndWrite(offset, 1);
 }
 
 /// Push 16-bit halfword into the FIFO
 static inline void Fifo_Push16(u16 data) {
-    *(u16*)(g_fifo_buffer + g_fifo_write_ptr) = BSWAP16(data);
-    g_fifo_write_ptr += 2;
+    u32 offset = Fifo_BeginWrite(2);
+    *(u16*)(g_fifo_buffer + offset) = BSWAP16(data);
+    Fifo_EndWrite(offset, 2);
 }
 
 /// Push 32-bit word into the FIFO
 static inline void Fifo_Push32(u32 data) {
-    *(u32*)(g_fifo_buffer + g_fifo_write_ptr) = BSWAP32(data);
-    g_fifo_write_ptr += 4;
+    u32 offset = Fifo_BeginWrite(4);
+    *(u32*)(g_fifo_buffer + offset) = BSWAP32(data);
+    Fifo_EndWrite(offset, 4);
 }
 
-/// Called by CPU core to catch up
-void Fifo_Synchronize();
+/// Blocks the GP thread until the CPU publishes new FIFO data
+void Fifo_WaitForData();
 
-/// Decodes current FIFO command
-void Fifo_DecodeCommand();
+/**
+ * Executes a display list straight from RAM
+ * @param addr RAM address of the display list
+ * @param offset Offset of the first command to execute
+ * @param size Size of the display list in bytes
+ */
+void Fifo_RunDisplayList(u32 addr, u32 offset, u32 size);
 
-/// Called at end of frame to reset FIFO
-void Fifo_Reset();
+/**
+ * Decodes current FIFO command
+ * @return True if a command was decoded, false if the FIFO holds no complete command
+ */
+bool Fifo_DecodeCommand();
 
 /// Initialize GP FIFO
 void Fifo_Init();
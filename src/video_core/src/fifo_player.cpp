@@ -26,9 +26,12 @@
 #include <SDL.h>
 
 #include <stdio.h>
+#include <deque>
 #include <vector>
 
 #include "memory.h"
+#include "lz4_block.h"
+#include "mapped_file.h"
 
 #include "fifo_player.h"
 #include "video_core.h"
@@ -40,171 +43,404 @@
 
 namespace fifo_player {
 
+/// Finished frames waiting for the writer before FrameFinished blocks the GP thread
+static const size_t kMaxQueuedChunks = 8;
+
+/// Largest chunk playback accepts, so a corrupt size can't make it allocate gigabytes
+static const u32 kMaxChunkSize = 256 * 1024 * 1024;
+
+/// Chunk of data handed to the writer thread
+struct Chunk
+{
+    std::vector<u8> data;
+    u32 num_elements;
+    bool is_state;                      ///< Initial register state rather than a frame
+};
+
 bool is_recording = false;
 
-// TODO: Move these into a FPFile struct ASAP!
-FPFile current_file;
+FILE* record_file = NULL;
+u64 record_offset = 0;                  ///< Offset the next chunk is written at
+bool record_failed = false;             ///< A write failed, the file is incomplete
+
+SDL_Thread* writer_thread = NULL;
+SDL_mutex* writer_mutex = NULL;
+SDL_cond* writer_cond = NULL;           ///< Signalled when a chunk is queued or taken
+std::deque<Chunk*> writer_queue;
+bool writer_quit = false;
+
+// Only touched by the writer thread while recording
+std::vector<FPFrameIndexEntry> frame_index;
+u64 state_offset = 0;
+std::vector<u8> compressed_data;
 
-FPFrameInfo* current_frame_info = NULL;
+// Only touched by the GP thread
+Chunk* current_frame = NULL;
+size_t last_register_write = 0;         ///< Offset of the frame's last element if it's a register
+                                        ///< write that can be extended, 0 otherwise
 
 bool IsRecording()
 {
     return is_recording;
 }
 
-// NOTE: Should be called from GPU thread to make sure register states are consistent!
-void StartRecording()
+/// Appends data to the file being recorded, remembers the failure instead of stopping
+static void WriteToFile(const void* data, size_t size)
+{
+    if (!record_failed && fwrite(data, size, 1, record_file) != 1)
+    {
+        LOG_ERROR(TGP, "FIFO recording: write failed, the log will be incomplete");
+        record_failed = true;
+    }
+    record_offset += size;
+}
+
+/// Compresses a chunk and appends it to the file, run on the writer thread
+static void WriteChunk(const Chunk& chunk)
 {
-    memset(&current_file.file_header, 0, sizeof(FPFileHeader));
-    current_file.frame_info.clear();
-    current_file.element_info.clear();
-    current_file.raw_data.clear();
+    if (chunk.data.size() > kMaxChunkSize)
+        LOG_ERROR(TGP, "FIFO recording: frame of %d bytes is too large to be played back",
+            (int)chunk.data.size());
+
+    compressed_data.resize(common::LZ4CompressBound(chunk.data.size()));
+    size_t compressed_size = common::LZ4Compress(chunk.data.empty() ? NULL : &chunk.data[0],
+        chunk.data.size(), &compressed_data[0]);
+
+    if (chunk.is_state)
+    {
+        state_offset = record_offset;
+    }
+    else
+    {
+        FPFrameIndexEntry entry;
+        entry.chunk_offset = record_offset;
+        entry.num_elements = chunk.num_elements;
+        frame_index.push_back(entry);
+    }
+    FPChunkHeader header;
+    header.raw_size = chunk.data.size();
+    header.compressed_size = compressed_size;
+    WriteToFile(&header, sizeof(header));
+    WriteToFile(&compressed_data[0], compressed_size);
+}
+
+/// Writer thread main loop, writes queued chunks until the queue is drained and it's told to quit
+static int WriterThread(void*)
+{
+    SDL_LockMutex(writer_mutex);
+    for (;;)
+    {
+        while (writer_queue.empty() && !writer_quit)
+            SDL_CondWait(writer_cond, writer_mutex);
 
-    current_file.file_header.magic_num = FIFO_PLAYER_MAGIC_NUM;
-    current_file.file_header.version = FIFO_PLAYER_VERSION;
-    // TODO: size and checksum
+        if (writer_queue.empty())
+            break;
 
-    current_file.frame_info.resize(1);
-    current_frame_info = &current_file.frame_info.back();
+        Chunk* chunk = writer_queue.front();
+        writer_queue.pop_front();
+        SDL_CondBroadcast(writer_cond);
+        SDL_UnlockMutex(writer_mutex);
+
+        WriteChunk(*chunk);
+        delete chunk;
+
+        SDL_LockMutex(writer_mutex);
+    }
+    SDL_UnlockMutex(writer_mutex);
+    return 0;
+}
+
+/// Hands a chunk over to the writer thread, waits if the writer is too far behind
+static void SubmitChunk(Chunk* chunk)
+{
+    SDL_LockMutex(writer_mutex);
+    while (writer_queue.size() >= kMaxQueuedChunks)
+        SDL_CondWait(writer_cond, writer_mutex);
+
+    writer_queue.push_back(chunk);
+    SDL_CondBroadcast(writer_cond);
+    SDL_UnlockMutex(writer_mutex);
+}
+
+/// Starts a new element in the current frame, returns the offset of its data
+static size_t BeginElement(u8 type, u32 size)
+{
+    FPElementHeader header;
+    memset(&header, 0, sizeof(header));
+    header.type = type;
+    header.size = size;
+
+    std::vector<u8>& data = current_frame->data;
+    data.insert(data.end(), (u8*)&header, (u8*)(&header + 1));
+    current_frame->num_elements++;
+    return data.size();
+}
+
+static void NewFrame()
+{
+    current_frame = new Chunk;
+    current_frame->num_elements = 0;
+    current_frame->is_state = false;
+    last_register_write = 0;
+}
+
+// NOTE: Should be called from GPU thread to make sure register states are consistent!
+bool StartRecording(const char* filename)
+{
+    if (is_recording)
+        EndRecording();
+
+    record_file = fopen(filename, "wb");
+    if (record_file == NULL)
+    {
+        LOG_ERROR(TGP, "FIFO recording: unable to open %s", filename);
+        return false;
+    }
+    record_offset = 0;
+    record_failed = false;
+    frame_index.clear();
+    state_offset = 0;
+
+    FPFileHeader header;
+    header.magic_num = FIFO_PLAYER_MAGIC_NUM;
+    header.version = FIFO_PLAYER_VERSION;
+    header.header_size = sizeof(FPFileHeader);
+    WriteToFile(&header, sizeof(header));
+
+    writer_mutex = SDL_CreateMutex();
+    writer_cond = SDL_CreateCond();
+    writer_quit = false;
+    writer_thread = SDL_CreateThread(WriterThread, "FifoRecordWriter", NULL);
+    if (writer_thread == NULL)
+    {
+        LOG_ERROR(TGP, "FIFO recording: unable to create writer thread: %s", SDL_GetError());
+        SDL_DestroyCond(writer_cond);
+        SDL_DestroyMutex(writer_mutex);
+        fclose(record_file);
+        record_file = NULL;
+        return false;
+    }
 
     // TODO: Record initial mem state => Mem_RAM
+    Chunk* state = new Chunk;
+    state->num_elements = 0;
+    state->is_state = true;
+    state->data.insert(state->data.end(), (u8*)&gp::g_bp_regs, (u8*)(&gp::g_bp_regs + 1));
+    state->data.insert(state->data.end(), (u8*)&gp::g_cp_regs, (u8*)(&gp::g_cp_regs + 1));
+    state->data.insert(state->data.end(), (u8*)&gp::g_xf_regs, (u8*)(&gp::g_xf_regs + 1));
+    SubmitChunk(state);
 
-    // TODO: Check if this works correctly
-    current_file.file_header.initial_bpmem_data_offset = current_file.raw_data.size();
-    current_file.raw_data.insert(current_file.raw_data.end(), (u8*)&gp::g_bp_regs, (u8*)(&gp::g_bp_regs + 1));
-    current_file.file_header.initial_cpmem_data_offset = current_file.raw_data.size();
-    current_file.raw_data.insert(current_file.raw_data.end(), (u8*)&gp::g_cp_regs, (u8*)(&gp::g_cp_regs + 1));
-    current_file.file_header.initial_xfmem_data_offset = current_file.raw_data.size();
-    current_file.raw_data.insert(current_file.raw_data.end(), (u8*)&gp::g_xf_regs, (u8*)(&gp::g_xf_regs + 1));
+    NewFrame();
 
     is_recording = true;
-    LOG_NOTICE(TGP, "FIFO recording started");
+    LOG_NOTICE(TGP, "FIFO recording started: %s", filename);
+    return true;
 }
 
 void Write(u8* data, int size)
 {
-    FPElementInfo element;
-    element.type = FPElementInfo::REGISTER_WRITE;
-    element.size = size;
-    element.offset = current_file.raw_data.size();
-    current_file.element_info.push_back(element);
+    std::vector<u8>& frame_data = current_frame->data;
+
+    // Register writes are pushed to the FIFO as plain bytes on playback, so consecutive ones can
+    // share an element
+    if (last_register_write == 0)
+        last_register_write = BeginElement(FPElementHeader::REGISTER_WRITE, 0);
 
-    current_file.raw_data.insert(current_file.raw_data.end(), data, data + size);
+    FPElementHeader* header =
+        (FPElementHeader*)&frame_data[last_register_write - sizeof(FPElementHeader)];
+    header->size += size;
+    frame_data.insert(frame_data.end(), data, data + size);
 }
 
 void MemUpdate(u32 address, u8* data, u32 size)
 {
-    FPElementInfo element;
-    element.type = FPElementInfo::MEMORY_UPDATE;
-    element.size = sizeof(FPMemUpdateInfo) + size;
-    element.offset = current_file.raw_data.size();
-    current_file.element_info.push_back(element);
+    BeginElement(FPElementHeader::MEMORY_UPDATE, sizeof(FPMemUpdateInfo) + size);
+    last_register_write = 0;
 
     FPMemUpdateInfo update_info;
     update_info.addr = address;
     update_info.size = size;
-    current_file.raw_data.insert(current_file.raw_data.end(), (u8*)&update_info, (u8*)(&update_info+1));
-    current_file.raw_data.insert(current_file.raw_data.end(), data, data + size);
+
+    std::vector<u8>& frame_data = current_frame->data;
+    frame_data.insert(frame_data.end(), (u8*)&update_info, (u8*)(&update_info + 1));
+    frame_data.insert(frame_data.end(), data, data + size);
 }
 
 void FrameFinished()
 {
-    current_frame_info->num_elements = current_file.element_info.size() - current_frame_info->base_element;
-
-    current_file.frame_info.resize(current_file.frame_info.size()+1);
-    current_frame_info = &current_file.frame_info.back();
-
-    current_frame_info->base_element = current_file.element_info.size();
+    SubmitChunk(current_frame);
+    NewFrame();
 }
 
-const FPFile& EndRecording()
+void EndRecording()
 {
-    FrameFinished();
-    while (current_file.frame_info.back().base_element == current_file.element_info.size() && !current_file.frame_info.empty())
-        current_file.frame_info.pop_back();
+    if (!is_recording)
+        return;
 
-    current_file.file_header.num_frames = current_file.frame_info.size();
-    current_file.file_header.num_elements = current_file.element_info.size();
-    current_file.file_header.num_raw_data_bytes = current_file.raw_data.size();
-    current_file.file_header.frame_info_offset = sizeof(FPFileHeader);
-    current_file.file_header.element_info_offset = current_file.file_header.frame_info_offset + current_file.file_header.num_frames * sizeof(FPFrameInfo);
-    current_file.file_header.raw_data_offset = current_file.file_header.element_info_offset + current_file.file_header.num_elements * sizeof(FPElementInfo);
+    if (current_frame->num_elements != 0)
+        SubmitChunk(current_frame);
+    else
+        delete current_frame;
+    current_frame = NULL;
+
+    SDL_LockMutex(writer_mutex);
+    writer_quit = true;
+    SDL_CondBroadcast(writer_cond);
+    SDL_UnlockMutex(writer_mutex);
+    SDL_WaitThread(writer_thread, NULL);
+    writer_thread = NULL;
+    SDL_DestroyCond(writer_cond);
+    SDL_DestroyMutex(writer_mutex);
+
+    // Drop trailing empty frames
+    while (!frame_index.empty() && frame_index.back().num_elements == 0)
+        frame_index.pop_back();
+
+    FPFileFooter footer;
+    footer.index_offset = record_offset;
+    footer.state_offset = state_offset;
+    footer.num_frames = frame_index.size();
+    footer.version = FIFO_PLAYER_VERSION;
+    footer.magic_num = FIFO_PLAYER_MAGIC_NUM;
+    if (!frame_index.empty())
+        WriteToFile(&frame_index[0], frame_index.size() * sizeof(FPFrameIndexEntry));
+    WriteToFile(&footer, sizeof(footer));
+
+    if (fclose(record_file) != 0)
+        record_failed = true;
+    record_file = NULL;
 
     is_recording = false;
-    LOG_NOTICE(TGP, "FIFO recording ended: %d frames\n", current_file.frame_info.size());
+    LOG_NOTICE(TGP, "FIFO recording ended: %d frames, %d bytes%s", footer.num_frames,
+        (int)record_offset, record_failed ? " (incomplete)" : "");
 
-    return current_file;
+    frame_index.clear();
+    std::vector<u8>().swap(compressed_data);
 }
 
-void Save(const char* filename, FPFile& in)
+/**
+ * Decompresses a chunk of a mapped log
+ * @param file Mapped log
+ * @param offset Offset of the chunk's FPChunkHeader
+ * @param out Receives the chunk data
+ * @return True on success, false if the chunk is out of bounds or corrupt
+ */
+static bool ReadChunk(const common::MappedFile& file, u64 offset, std::vector<u8>& out)
 {
-    // TODO: Error checking...
-    FILE* file = fopen(filename, "wb");
+    if (offset > file.size() || file.size() - offset < sizeof(FPChunkHeader))
+        return false;
+
+    FPChunkHeader header;
+    memcpy(&header, file.data() + offset, sizeof(header));
+    offset += sizeof(header);
+    if (file.size() - offset < header.compressed_size)
+        return false;
 
-    fwrite(&in.file_header, sizeof(FPFileHeader), 1, file);
-    fwrite(&(*in.frame_info.begin()), in.file_header.num_frames * sizeof(FPFrameInfo), 1, file);
-    fwrite(&(*in.element_info.begin()), in.file_header.num_elements * sizeof(FPElementInfo), 1, file);
-    fwrite(&(*in.raw_data.begin()), in.raw_data.size(), 1, file);
+    // LZ4 can't compress better than 255:1
+    if (header.raw_size > kMaxChunkSize || header.raw_size / 255 > header.compressed_size)
+        return false;
 
-    fclose(file);
+    out.resize(header.raw_size);
+    if (header.raw_size == 0)
+        return true;
+
+    return common::LZ4Decompress(file.data() + offset, header.compressed_size, &out[0],
+        header.raw_size);
 }
 
-void Load(const char* filename, FPFile& out)
+/// Pushes the elements of a frame to the FIFO
+static bool PlayFrame(const std::vector<u8>& frame_data, u32 num_elements)
 {
-    // TODO: Error checking...
-    FILE* file = fopen(filename, "rb");
-    int objects_read = 0;
-
-    objects_read = fread(&out.file_header, sizeof(FPFileHeader), 1, file);
-    if (objects_read != 1)
+    size_t offset = 0;
+    for (u32 i = 0; i < num_elements; ++i)
     {
-        // TODO: Error message
-        return;
+        FPElementHeader header;
+        if (frame_data.size() - offset < sizeof(header))
+            return false;
+        memcpy(&header, &frame_data[offset], sizeof(header));
+        offset += sizeof(header);
+        if (frame_data.size() - offset < header.size)
+            return false;
+
+        const u8* data = &frame_data[0] + offset;
+        switch (header.type)
+        {
+            case FPElementHeader::REGISTER_WRITE:
+            {
+                for (u32 byte = 0; byte < header.size; ++byte)
+                    gp::Fifo_Push8(data[byte]);
+
+                break;
+            }
+
+            case FPElementHeader::MEMORY_UPDATE:
+            {
+                // TODO: Wait for GPU thread to catch up before doing this
+                FPMemUpdateInfo update_info;
+                if (header.size < sizeof(update_info))
+                    return false;
+                memcpy(&update_info, data, sizeof(update_info));
+                if (header.size - sizeof(update_info) < update_info.size ||
+                    update_info.size > RAM_SIZE - (update_info.addr & RAM_MASK))
+                    return false;
+                Memory_MarkWritten(update_info.addr, update_info.size);
+                memcpy(&Mem_RAM[update_info.addr & RAM_MASK], data + sizeof(update_info),
+                    update_info.size);
+
+                break;
+            }
+
+            default:
+                return false;
+        }
+        offset += header.size;
     }
-    if (out.file_header.magic_num != FIFO_PLAYER_MAGIC_NUM)
+    return true;
+}
+
+bool PlayFrames(const char* filename, u32 first_frame, u32 num_frames)
+{
+    common::MappedFile file;
+    if (!file.Open(filename))
+        return false;
+
+    FPFileHeader header;
+    FPFileFooter footer;
+    if (file.size() < sizeof(header) + sizeof(footer))
     {
-        // TODO: Error message
-        return;
+        LOG_ERROR(TGP, "FIFO playback: %s is too small to be a FIFO log", filename);
+        return false;
     }
-    if (out.file_header.version != FIFO_PLAYER_VERSION)
+    memcpy(&header, file.data(), sizeof(header));
+    memcpy(&footer, file.data() + file.size() - sizeof(footer), sizeof(footer));
+    if (header.magic_num != FIFO_PLAYER_MAGIC_NUM)
     {
-        // TODO: Error message
-        return;
+        LOG_ERROR(TGP, "FIFO playback: %s isn't a FIFO log", filename);
+        return false;
     }
-
-    out.frame_info.resize(out.file_header.num_frames);
-    fseek(file, out.file_header.frame_info_offset, SEEK_SET);
-    objects_read = fread(&(*out.frame_info.begin()), out.file_header.num_frames * sizeof(FPFrameInfo), 1, file);
-    if (objects_read != 1)
+    if (header.version != FIFO_PLAYER_VERSION)
     {
-        // TODO: Error message
-        return;
+        LOG_ERROR(TGP, "FIFO playback: %s is version %d, only version %d is supported", filename,
+            header.version, FIFO_PLAYER_VERSION);
+        return false;
     }
-
-    out.element_info.resize(out.file_header.num_elements);
-    fseek(file, out.file_header.element_info_offset, SEEK_SET);
-    objects_read = fread(&(*out.element_info.begin()), out.file_header.num_elements * sizeof(FPElementInfo), 1, file);
-    if (objects_read != 1)
+    u64 index_end = footer.index_offset + (u64)footer.num_frames * sizeof(FPFrameIndexEntry);
+    if (footer.magic_num != FIFO_PLAYER_MAGIC_NUM || footer.version != FIFO_PLAYER_VERSION ||
+        footer.index_offset > file.size() || index_end > file.size() - sizeof(footer))
     {
-        // TODO: Error message
-        return;
+        LOG_ERROR(TGP, "FIFO playback: %s wasn't finished or is corrupt", filename);
+        return false;
     }
 
-    out.raw_data.resize(out.file_header.num_raw_data_bytes);
-    fseek(file, out.file_header.raw_data_offset, SEEK_SET);
-    objects_read = fread(&(*out.raw_data.begin()), out.file_header.num_raw_data_bytes * sizeof(u8), 1, file);
-    if (objects_read != 1)
+    std::vector<u8> chunk_data;
+    if (!ReadChunk(file, footer.state_offset, chunk_data) ||
+        chunk_data.size() != sizeof(gp::BPMemory) + sizeof(gp::CPMemory) + sizeof(gp::XFMemory))
     {
-        // TODO: Error message
-        return;
+        LOG_ERROR(TGP, "FIFO playback: %s has a corrupt register state", filename);
+        return false;
     }
 
-    fclose(file);
-}
-
-void PlayFile(FPFile& in)
-{
-    gp::BPMemory* bpmem = (gp::BPMemory*)&(*(in.raw_data.begin() + in.file_header.initial_bpmem_data_offset));
+    gp::BPMemory* bpmem = (gp::BPMemory*)&chunk_data[0];
     for (unsigned int i = 0; i < sizeof(gp::BPMemory) / sizeof(u32); ++i)
     {
         // TODO: This is dangerous since it e.g. triggers EFB copy requests!
@@ -212,49 +448,44 @@ void PlayFile(FPFile& in)
         gp::Fifo_Push32((i << 24) | (bpmem->mem[i] & 0x00FFFFFF));
     }
 
-
-    gp::CPMemory* cpmem = (gp::CPMemory*)&(*(in.raw_data.begin() + in.file_header.initial_cpmem_data_offset));
+    gp::CPMemory* cpmem = (gp::CPMemory*)&chunk_data[sizeof(gp::BPMemory)];
     for (unsigned int i = 0; i < sizeof(gp::CPMemory) / sizeof(u32); ++i)
     {
         gp::Fifo_Push8(GP_LOAD_CP_REG);
-        gp::Fifo_Push8(i << 24);
+        gp::Fifo_Push8((u8)i);
         gp::Fifo_Push32(cpmem->mem[i]);
     }
 
-    gp::XFMemory* xfmem = (gp::XFMemory*)&(*(in.raw_data.begin() + in.file_header.initial_xfmem_data_offset));
     // TODO: Push XF regs
 
+    if (first_frame >= footer.num_frames)
+        return true;
+    if (num_frames > footer.num_frames - first_frame)
+        num_frames = footer.num_frames - first_frame;
+
+    // Frames are found through the index, only the ones played are touched
+    const u8* index = file.data() + footer.index_offset;
+
     // TODO: Loop over all frames but wait until the last frame has been processed before pushing the first one again
-    std::vector<FPFrameInfo>::iterator frame;
-    for (frame = in.frame_info.begin(); frame != in.frame_info.end(); ++frame)
+    for (u32 frame = first_frame; frame < first_frame + num_frames; ++frame)
     {
-        std::vector<FPElementInfo>::iterator element;
-        for (element = in.element_info.begin() + frame->base_element; element != in.element_info.begin() + frame->base_element + frame->num_elements; ++element)
+        FPFrameIndexEntry entry;
+        memcpy(&entry, index + frame * sizeof(FPFrameIndexEntry), sizeof(entry));
+
+        if (!ReadChunk(file, entry.chunk_offset, chunk_data) ||
+            !PlayFrame(chunk_data, entry.num_elements))
         {
-            switch (element->type)
-            {
-                case FPElementInfo::REGISTER_WRITE:
-                {
-                    std::vector<u8>::iterator byte;
-                    for (byte = in.raw_data.begin() + element->offset; byte != in.raw_data.begin() + element->offset + element->size; ++byte)
-                        gp::Fifo_Push8(*byte);
-
-                    break;
-                }
-
-                case FPElementInfo::MEMORY_UPDATE:
-                {
-                    // TODO: Wait for GPU thread to catch up before doing this
-                    FPMemUpdateInfo* update_info = (FPMemUpdateInfo*)&(*(in.raw_data.begin() + element->offset));
-                    memcpy(&Mem_RAM[update_info->addr & RAM_MASK], &*(in.raw_data.begin() + element->offset + 2), update_info->size);
-
-                    break;
-                }
-            }
+            LOG_ERROR(TGP, "FIFO playback: frame %d of %s is corrupt", frame, filename);
+            return false;
         }
         // TODO: Flush WGP once we have accurate fifo emulation
     }
+    return true;
 }
 
+bool PlayFile(const char* filename)
+{
+    return PlayFrames(filename, 0, 0xFFFFFFFF);
+}
 
 } // namespace
@@ -25,78 +25,83 @@
 #ifndef VIDEO_CORE_FIFO_PLAYER_H_
 #define VIDEO_CORE_FIFO_PLAYER_H_
 
-#include <vector>
 #include "common.h"
 
 #define FIFO_PLAYER_MAGIC_NUM   0xF1F0
-#define FIFO_PLAYER_VERSION     0x0004
-
-#define FPFE_REGISTER_WRITE 0
-#define FPFE_MEMORY_UPDATE 1
+#define FIFO_PLAYER_VERSION     0x0005
 
 namespace fifo_player {
 
-#pragma pack(push, 4) // TODO: Change to 1?
+// File layout (all offsets are from the start of the file):
+//
+//   FPFileHeader
+//   FPChunkHeader + LZ4 block    Initial BP, CP and XF register state
+//   FPChunkHeader + LZ4 block    Elements of a frame, one chunk per frame
+//   ...
+//   FPFrameIndexEntry[]          Where each frame's chunk is, for seeking
+//   FPFileFooter                 Where the index is, last in the file
+//
+// Chunks are written as frames are finished, the index and footer when recording ends. A frame's
+// data is a list of elements, each an FPElementHeader followed by its data.
+
+#pragma pack(push, 4)
 struct FPFileHeader {
     u16 magic_num;                  // 0x0
     u16 version;                    // 0x2
-    u32 size;                       // 0x4
-    u32 checksum;                   // 0x8
-
-    u32 num_frames;                 // 0xC
-    u32 num_elements;               // 0x10
-    u32 num_raw_data_bytes;         // 0x14
-    u32 frame_info_offset;          // 0x18
-    u32 element_info_offset;        // 0x1C
-    u32 raw_data_offset;            // 0x20
-
-    u32 initial_bpmem_data_offset;  // 0x24
-    u32 initial_cpmem_data_offset;  // 0x28
-    u32 initial_xfmem_data_offset;  // 0x2C
+    u32 header_size;                // 0x4
+};
+
+struct FPChunkHeader {
+    u32 raw_size;                   // 0x0 Size of the chunk's data, decompressed
+    u32 compressed_size;            // 0x4 Size of the LZ4 block that follows
+};
+
+struct FPFrameIndexEntry {
+    u64 chunk_offset;               // 0x0 Offset of the frame's FPChunkHeader
+    u32 num_elements;               // 0x8
 };
 
-struct FPFrameInfo {
-    u32 base_element; // first element that belongs to this frame
-    u32 num_elements;
+struct FPFileFooter {
+    u64 index_offset;               // 0x0 Offset of the FPFrameIndexEntry list
+    u64 state_offset;               // 0x8 Offset of the initial state's FPChunkHeader
+    u32 num_frames;                 // 0x10
+    u16 version;                    // 0x14 Same as in the header, a file without a valid footer
+    u16 magic_num;                  // 0x16 wasn't finished
 };
 
-// NOTE: Consecutive frame elements with the same type are assumed to have contiguously stored data! (Important to optimize playback of register writes)
-struct FPElementInfo {
+// NOTE: Consecutive register writes are merged into one element, so the element data can be
+// pushed to the FIFO in one go
+struct FPElementHeader {
     enum Type {
         REGISTER_WRITE = 0xAB,
         MEMORY_UPDATE = 0xCD,
     };
-    u8 type;
-    u32 size; // TODO: Does this need to be u32?
-    u32 offset; // offset to raw fifo data from base raw_data pointer
+    u8 type;                        // 0x0
+    u8 padding[3];                  // 0x1
+    u32 size;                       // 0x4 Size of the data that follows
 };
 
-struct FPMemUpdateInfo
-{
+struct FPMemUpdateInfo {
     u32 addr;
     u32 size;
     // followed by raw data
 };
-
 #pragma pack(pop)
 
-struct FPFile
-{
-    FPFileHeader file_header;
-    std::vector<FPFrameInfo> frame_info;
-    std::vector<FPElementInfo> element_info;
-    std::vector<u8> raw_data; // TODO: Should split this into initial state and actual raw data
-};
-
-
 // Status query
 bool IsRecording();
 
 // configuration
 void SetExpandDisplayLists(bool expand); // TODO
 
-// recording
-void StartRecording();
+/**
+ * Starts recording GP data to a file. Frames are compressed and written by a background thread
+ * as they are finished, so recordings aren't limited by memory.
+ * NOTE: Should be called from GPU thread to make sure register states are consistent!
+ * @param filename Name of the file to record to
+ * @return True on success
+ */
+bool StartRecording(const char* filename);
 
 void Write(u8* data, int size);
 
@@ -104,16 +109,26 @@ void MemUpdate(u32 address, u8* data, u32 size);
 
 void FrameFinished();
 
-const FPFile& EndRecording();
-
-// file handling
-void Save(const char* filename, FPFile& in);
+/// Stops recording, waits for all frames to be written and finishes the file
+void EndRecording();
 
-void Load(const char* filename, FPFile& out);
+/**
+ * Plays back frames of a recording. The file is mapped rather than read, only the frames being
+ * played are decompressed.
+ * @param filename Name of the recording
+ * @param first_frame First frame to play
+ * @param num_frames Number of frames to play, clamped to the frames in the file
+ * @return True on success, false if the file isn't a complete recording of this version
+ */
+bool PlayFrames(const char* filename, u32 first_frame, u32 num_frames);
 
-// playback
-void PlayFile(FPFile& in);
+/**
+ * Plays back a whole recording
+ * @param filename Name of the recording
+ * @return True on success, false if the file isn't a complete recording of this version
+ */
+bool PlayFile(const char* filename);
 
 } // namespace
 
-#endif // VIDEO_CORE_FIFO_PLAYER_H_
\ No newline at end of file
+#endif // VIDEO_CORE_FIFO_PLAYER_H_
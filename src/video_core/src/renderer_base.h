@@ -85,9 +85,10 @@ public:
      * @param prim Primitive type (e.g. GX_TRIANGLES)
      * @param count Number of vertices to be drawn (used for appropriate memory management, only)
      * @param vbo Pointer to VBO, which will be set by API in this function
-     * @param vbo_offset Offset into VBO to use (in bytes)
+     * @param vbo_offset Offset of the primitive into the current batch (in vertices, laid out
+     * as VertexLoader_GetLayout says for the current vertex state)
      */
-    virtual void BeginPrimitive(GXPrimitive prim, int count, GXVertex** vbo, u32 vbo_offset) = 0;
+    virtual void BeginPrimitive(GXPrimitive prim, int count, u8** vbo, u32 vbo_offset) = 0;
 
     /**
      * Set the current vertex state (format and count of each vertex component)
@@ -101,8 +102,15 @@ public:
      */
     virtual void VertexPosition_UseIndexXF(u8 index) = 0;
 
-    /// End a primitive (signal renderer to draw it)
-    virtual void EndPrimitive(u32 vbo_offset, u32 vertex_num) = 0;
+    /**
+     * Draws a batch of primitives from the previously decoded vertex array
+     * @param prim Primitive type the batch is drawn as (GX_TRIANGLES, GX_LINES or GX_POINTS)
+     * @param vertex_num Number of vertices in the batch
+     * @param indices Index list of the batch, relative to the first vertex of the batch
+     * @param index_num Number of indices
+     */
+    virtual void DrawPrimitives(GXPrimitive prim, u32 vertex_num, const u32* indices, 
+        int index_num) = 0;
    
     /// Sets the render viewport location, width, and height
     virtual void SetViewport(int x, int y, int width, int height) = 0;
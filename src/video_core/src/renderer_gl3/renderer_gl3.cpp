@@ -37,6 +37,7 @@
 
 #include "renderer_gl3.h"
 #include "shader_interface.h"
+#include "stream_buffer.h"
 #include "texture_interface.h"
 #include "utils.h"
 
@@ -60,13 +61,14 @@ RendererGL3::RendererGL3() {
     memset(&vertex_state_, 0, sizeof(vertex_state_));
     resolution_width_ = 640;
     resolution_height_ = 480;
-    vbo_handle_ = 0;
+    vertex_buffer_ = NULL;
+    index_buffer_ = NULL;
+    vbo_map_ = NULL;
+    bound_vertex_array_ = 0;
     last_mode_ = 0;
     blend_mode_ = 0;
     render_window_ = NULL;
     uniform_manager_ = NULL;
-    prim_type_ = (GXPrimitive)0;
-    gl_prim_type_ = 0;
     uniform_manager_ = new UniformManager();
     texture_interface_ = new TextureInterface(this);
     shader_interface_ = new ShaderInterface(this);
@@ -118,38 +120,21 @@ void RendererGL3::VertexPosition_UseIndexXF(u8 index) {
  * @param prim Primitive type (e.g. GX_TRIANGLES)
  * @param count Number of vertices to be drawn (used for appropriate memory management, only)
  * @param vbo Pointer to VBO, which will be set by API in this function
- * @param vbo_offset Offset into VBO to use (in bytes)
+ * @param vbo_offset Offset of the primitive into the current batch (in vertices, laid out as
+ * VertexLoader_GetLayout says for the current vertex state)
  */
-void RendererGL3::BeginPrimitive(GXPrimitive prim, int count, GXVertex** vbo, u32 vbo_offset) {
-    // GL_QUADS is only suppported in compatibility mode. This is emulated in software by
-    // converting to triangles (therefore, it should never be used). Alternatively, it works 
-    // pretty well to emulate GX_QUADS via GL_LINES_ADJACENCY in a geometry shader.
-    static GLenum gl_types[8] = {GL_QUADS, 0, GL_TRIANGLES, GL_TRIANGLE_STRIP, 
-        GL_TRIANGLE_FAN, GL_LINES,  GL_LINE_STRIP, GL_POINTS};
-
-    // Set the renderer primitive type
-    prim_type_ = prim;
-    gl_prim_type_ = gl_types[(prim >> 3) - 16];
-
+void RendererGL3::BeginPrimitive(GXPrimitive prim, int count, u8** vbo, u32 vbo_offset) {
     // If no data sent, we are done here
     if (0 == count) {
         return;
     }
-    // Update shader(s)
-    video_core::g_shader_manager->Bind();
-    uniform_manager_->ApplyChanges();
-
-    // Bind pointers to buffers
-    glBindBuffer(GL_ARRAY_BUFFER, vbo_handle_);
-
-    // Map CPU to GPU mem
-    static GLbitfield access_flags = GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT |
-        GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_FLUSH_EXPLICIT_BIT;
-    *vbo = (GXVertex*)glMapBufferRange(GL_ARRAY_BUFFER, (vbo_offset * sizeof(GXVertex)), 
-        (count * sizeof(GXVertex)), access_flags);
-    if (vbo == NULL) {
-        LOG_ERROR(TVIDEO, "Unable to map vertex buffer object to system mem!");
+    // Room for a full batch is reserved with its first primitive, what isn't used by the time the
+    // batch is drawn goes to the next one
+    if (vbo_map_ == NULL) {
+        vbo_map_ = vertex_buffer_->Map(VBO_MAX_BATCH_VERTS * vertex_layout_.stride, 
+            vertex_layout_.stride);
     }
+    *vbo = vbo_map_ + vbo_offset * vertex_layout_.stride;
 }
 
 /**
@@ -158,65 +143,129 @@ void RendererGL3::BeginPrimitive(GXPrimitive prim, int count, GXVertex** vbo, u3
  */
 void RendererGL3::SetVertexState(const gp::VertexState& vertex_state) {
     vertex_state_ = vertex_state;
+    gp::VertexLoader_GetLayout(vertex_state, &vertex_layout_);
 }
 
-/// Draws a primitive from the previously decoded vertex array
-void RendererGL3::EndPrimitive(u32 vbo_offset, u32 vertex_num) {
-
+/**
+ * Gets the vertex array object for a vertex state, creating it on first use
+ * @param vertex_state Vertex state to get the VAO of
+ * @return GL handle of the VAO
+ */
+GLuint RendererGL3::GetVertexArray(const gp::VertexState& vertex_state) {
     static GLuint gl_types[5] = {GL_UNSIGNED_BYTE, GL_BYTE, GL_UNSIGNED_SHORT, GL_SHORT, GL_FLOAT};
-    static GLuint gl_types_size[5] = {1, 1, 2, 2, 4};
 
-    // Do nothing if no data sent
-    if (vertex_num == 0) {
-        return;
+    // Attribute layout only depends on the presence, count and type of the position, normal and
+    // texcoords, 5 bits each
+    const gp::VertexComponent* components[2 + kGCMaxActiveTextures] = { 
+        &vertex_state.pos, &vertex_state.nrm 
+    };
+    for (int i = 0; i < kGCMaxActiveTextures; i++) {
+        components[2 + i] = &vertex_state.tex[i];
+    }
+    u64 key = 0;
+    for (int i = 0; i < 2 + kGCMaxActiveTextures; i++) {
+        key = (key << 5) | ((components[i]->attr_type != GX_NONE) << 4) | 
+            ((components[i]->comp_count & 1) << 3) | (components[i]->comp_type & 7);
+    }
+    std::map<u64, GLuint>::iterator it = vertex_arrays_.find(key);
+    if (it != vertex_arrays_.end()) {
+        return it->second;
     }
-	glBindBuffer(GL_ARRAY_BUFFER, vbo_handle_);
-    glUnmapBuffer(GL_ARRAY_BUFFER);
+    GLuint vao;
+    glGenVertexArrays(1, &vao);
+    glBindVertexArray(vao);
+    bound_vertex_array_ = vao;
+
+    glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer_->handle());
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_buffer_->handle());
+
+    // Vertices only hold the components of their vertex state, missing ones are left disabled
+    gp::VertexLayout layout;
+    gp::VertexLoader_GetLayout(vertex_state, &layout);
+    const GLsizei stride = layout.stride;
 
     // Position
     glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, gl_types[vertex_state_.pos.comp_type], GL_FALSE, sizeof(GXVertex), 
-        reinterpret_cast<void*>(0));
+    glVertexAttribPointer(0, 3, gl_types[vertex_state.pos.comp_type], GL_FALSE, stride, 
+        reinterpret_cast<void*>(layout.position));
     // Color 0
     glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_FALSE, sizeof(GXVertex), 
-        reinterpret_cast<void*>(12));
+    glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_FALSE, stride, 
+        reinterpret_cast<void*>(layout.color[0]));
     // Color 1
     glEnableVertexAttribArray(2);
-    glVertexAttribPointer(2, 4, GL_UNSIGNED_BYTE, GL_FALSE, sizeof(GXVertex), 
-        reinterpret_cast<void*>(16));
+    glVertexAttribPointer(2, 4, GL_UNSIGNED_BYTE, GL_FALSE, stride, 
+        reinterpret_cast<void*>(layout.color[1]));
     // Normal
-    glEnableVertexAttribArray(3);
-    glVertexAttribPointer(3, 4, gl_types[vertex_state_.nrm.comp_type], GL_FALSE, sizeof(GXVertex), 
-        reinterpret_cast<void*>(20));
-    // TexCoords
-    for (int i = 0; i < gp::g_xf_regs.num_texgen.num_texgens; i++) {
-        glEnableVertexAttribArray(i + 4);
-        glVertexAttribPointer(i + 4, 4, gl_types[vertex_state_.tex[i].comp_type], GL_FALSE, 
-            sizeof(GXVertex), reinterpret_cast<void*>(56 + (i * 8)));
-	}
+    if (layout.normal != gp::kNoVertexComponent) {
+        glEnableVertexAttribArray(3);
+        glVertexAttribPointer(3, 4, gl_types[vertex_state.nrm.comp_type], GL_FALSE, stride, 
+            reinterpret_cast<void*>(layout.normal));
+    }
+    // TexCoords, only S and T are read
+    for (int i = 0; i < kGCMaxActiveTextures; i++) {
+        if (layout.texcoords[i] != gp::kNoVertexComponent) {
+            glEnableVertexAttribArray(i + 4);
+            glVertexAttribPointer(i + 4, 2, gl_types[vertex_state.tex[i].comp_type], GL_FALSE, 
+                stride, reinterpret_cast<void*>(layout.texcoords[i]));
+        }
+    }
     // Position matrix index
     glEnableVertexAttribArray(12);
-    glVertexAttribPointer(12, 4, GL_UNSIGNED_BYTE, GL_FALSE, sizeof(GXVertex), 
-        reinterpret_cast<void*>(120));
+    glVertexAttribPointer(12, 4, GL_UNSIGNED_BYTE, GL_FALSE, stride, 
+        reinterpret_cast<void*>(layout.matrix_indices));
     // Texture coord 0-3 matrix index
     glEnableVertexAttribArray(13);
-    glVertexAttribPointer(13, 4, GL_UNSIGNED_BYTE, GL_FALSE, sizeof(GXVertex), 
-        reinterpret_cast<void*>(124));
+    glVertexAttribPointer(13, 4, GL_UNSIGNED_BYTE, GL_FALSE, stride, 
+        reinterpret_cast<void*>(layout.matrix_indices + 4));
     // Texture coord 4-7 matrix index
     glEnableVertexAttribArray(14);
-    glVertexAttribPointer(14, 4, GL_UNSIGNED_BYTE, GL_FALSE, sizeof(GXVertex), 
-        reinterpret_cast<void*>(128));
+    glVertexAttribPointer(14, 4, GL_UNSIGNED_BYTE, GL_FALSE, stride, 
+        reinterpret_cast<void*>(layout.matrix_indices + 8));
+
+    vertex_arrays_[key] = vao;
+    return vao;
+}
 
-    glDrawArrays(gl_prim_type_, vbo_offset, vertex_num);
+/**
+ * Draws a batch of primitives from the previously decoded vertex array
+ * @param prim Primitive type the batch is drawn as (GX_TRIANGLES, GX_LINES or GX_POINTS)
+ * @param vertex_num Number of vertices in the batch
+ * @param indices Index list of the batch, relative to the first vertex of the batch
+ * @param index_num Number of indices
+ */
+void RendererGL3::DrawPrimitives(GXPrimitive prim, u32 vertex_num, const u32* indices, 
+    int index_num) {
 
-    _ASSERT_MSG(TVIDEO, (vbo_offset < VBO_MAX_VERTS), 
-        "VBO is full! There is either a bug or it must be > %dMB!", 
-        (VBO_SIZE / 1048576));
+    // Hand the decoded vertices over to the GPU
+    if (vbo_map_ == NULL) {
+        return;
+    }
+    GLint base_vertex = vertex_buffer_->Unmap(vertex_num * vertex_layout_.stride) / 
+        vertex_layout_.stride;
+    vbo_map_ = NULL;
+
+    // Do nothing if no data sent
+    if (index_num == 0) {
+        return;
+    }
+    // Update shader(s)
+    video_core::g_shader_manager->Bind();
+    uniform_manager_->ApplyChanges();
 
-	for (int i = 0; i < 15; i++) { 
-		glDisableVertexAttribArray(i);
-	}
+    GLuint vao = GetVertexArray(vertex_state_);
+    if (vao != bound_vertex_array_) {
+        glBindVertexArray(vao);
+        bound_vertex_array_ = vao;
+    }
+    // Indices go to their own stream buffer, the VAO already points at it
+    u8* index_map = index_buffer_->Map(index_num * sizeof(u32), sizeof(u32));
+    memcpy(index_map, indices, index_num * sizeof(u32));
+    u32 index_offset = index_buffer_->Unmap(index_num * sizeof(u32));
+
+    glDrawElementsBaseVertex(prim == GX_TRIANGLES ? GL_TRIANGLES : 
+        (prim == GX_LINES ? GL_LINES : GL_POINTS), index_num, GL_UNSIGNED_INT, 
+        reinterpret_cast<void*>(index_offset), base_vertex);
 }
 
 /// Sets the renderer viewport location, width, and height
@@ -579,6 +628,19 @@ void RendererGL3::ShutDown() {
     // ------------------
     glDeleteFramebuffers(MAX_FRAMEBUFFERS, fbo_);
 
+    // Vertex buffer stuff
+    // -------------------
+    glBindVertexArray(0);
+    for (std::map<u64, GLuint>::iterator it = vertex_arrays_.begin(); it != vertex_arrays_.end(); 
+        ++it) {
+        glDeleteVertexArrays(1, &it->second);
+    }
+    vertex_arrays_.clear();
+    delete vertex_buffer_;
+    delete index_buffer_;
+    vertex_buffer_ = NULL;
+    index_buffer_ = NULL;
+
     // TODO(ShizZy): There is a lot more stuff we should be cleaning up here...
 }
 
@@ -680,9 +742,11 @@ void RendererGL3::Init() {
     // Initialize primary VBO
     // ----------------------
 
-    glGenBuffers(1, &vbo_handle_);
-    glBindBuffer(GL_ARRAY_BUFFER, vbo_handle_);
-    glBufferData(GL_ARRAY_BUFFER, VBO_SIZE, NULL, GL_DYNAMIC_DRAW);
+    vertex_buffer_ = new StreamBuffer(GL_ARRAY_BUFFER, VBO_SIZE);
+    index_buffer_ = new StreamBuffer(GL_ELEMENT_ARRAY_BUFFER, IBO_SIZE);
+    if (!vertex_buffer_->persistent()) {
+        LOG_NOTICE(TVIDEO, "GL_ARB_buffer_storage not supported, mapping stream buffers per draw");
+    }
 
     // Initialize everything else
     // --------------------------
@@ -25,6 +25,8 @@
 #ifndef VIDEO_CORE_RENDERER_GL3_H_
 #define VIDEO_CORE_RENDERER_GL3_H_
 
+#include <map>
+
 #include <GL/glew.h>
 
 #include "common.h"
@@ -33,8 +35,10 @@
 #include "renderer_base.h"
 #include "uniform_manager.h"
 
-#define VBO_MAX_VERTS               (VBO_SIZE / sizeof(GXVertex))     
+class StreamBuffer;
+
 #define MAX_FRAMEBUFFERS            2
+#define IBO_SIZE                    (1024 * 1024 * 4)
 #define MAX_CACHED_TEXTURES         0x1000000
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -72,9 +76,10 @@ public:
      * @param prim Primitive type (e.g. GX_TRIANGLES)
      * @param count Number of vertices to be drawn (used for appropriate memory management, only)
      * @param vbo Pointer to VBO, which will be set by API in this function
-     * @param vbo_offset Offset into VBO to use (in bytes)
+     * @param vbo_offset Offset of the primitive into the current batch (in vertices, laid out
+     * as VertexLoader_GetLayout says for the current vertex state)
      */
-    void BeginPrimitive(GXPrimitive prim, int count, GXVertex** vbo, u32 vbo_offset);
+    void BeginPrimitive(GXPrimitive prim, int count, u8** vbo, u32 vbo_offset);
 
     /**
      * Set the current vertex state (format and count of each vertex component)
@@ -88,8 +93,14 @@ public:
      */
     void VertexPosition_UseIndexXF(u8 index);
 
-    /// End a primitive (signal renderer to draw it)
-    void EndPrimitive(u32 vbo_offset, u32 vertex_num);
+    /**
+     * Draws a batch of primitives from the previously decoded vertex array
+     * @param prim Primitive type the batch is drawn as (GX_TRIANGLES, GX_LINES or GX_POINTS)
+     * @param vertex_num Number of vertices in the batch
+     * @param indices Index list of the batch, relative to the first vertex of the batch
+     * @param index_num Number of indices
+     */
+    void DrawPrimitives(GXPrimitive prim, u32 vertex_num, const u32* indices, int index_num);
 
     /// Sets the renderer viewport location, width, and height
     void SetViewport(int x, int y, int width, int height);
@@ -210,6 +221,13 @@ private:
     /// Updates the framerate
     void UpdateFramerate();
 
+    /**
+     * Gets the vertex array object for a vertex state, creating it on first use
+     * @param vertex_state Vertex state to get the VAO of
+     * @return GL handle of the VAO
+     */
+    GLuint GetVertexArray(const gp::VertexState& vertex_state);
+
     int resolution_width_;
     int resolution_height_;
 
@@ -222,14 +240,18 @@ private:
     // Vertex buffer stuff
     // -------------------
 
-    GLuint      vbo_handle_;                        ///< Handle of vertex buffer object
-    GXPrimitive prim_type_;                         ///< GX primitive type (e.g. GX_QUADS)
-    GLuint      gl_prim_type_;                      ///< OpenGL primitive type (e.g. GL_TRIANGLES)
+    StreamBuffer*   vertex_buffer_;                 ///< Decoded vertices
+    StreamBuffer*   index_buffer_;                  ///< Batch index lists
+    u8*             vbo_map_;                       ///< Space of the current batch, or NULL
+
+    std::map<u64, GLuint>   vertex_arrays_;         ///< VAOs by vertex attribute layout
+    GLuint                  bound_vertex_array_;    ///< Currently bound VAO
     
     // Vertex format stuff
     // -------------------
 
-    gp::VertexState vertex_state_;
+    gp::VertexState     vertex_state_;
+    gp::VertexLayout    vertex_layout_;             ///< Layout of vertices with vertex_state_
 
     // Video core stuff
     // ----------------
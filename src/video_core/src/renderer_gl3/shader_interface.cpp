@@ -23,6 +23,9 @@
  */
 
 #include "file_utils.h"
+#include "hash.h"
+#include "misc_utils.h"
+#include "video_core.h"
 #include "shader_interface.h"
 
 // Default shader header prefixed on all shaders. Contains minimum shader version and required 
@@ -34,8 +37,18 @@ static const char __default_shader_header[] = {
     "#extension GL_ARB_uniform_buffer_object : enable\n"
 };
 
+// Header of the generic shader, which reads all of its setup from the _GENERIC_UBO block
+static const char __generic_shader_header[] = {
+    "#define _DEF_GENERIC\n"
+};
+
+/// Frames to wait before asking for the link status of a program the driver can't report on
+static const int kAsyncCompileFrames = 2;
+
 ShaderInterface::ShaderInterface(RendererGL3* parent) {
     parent_ = parent;
+    generic_ = NULL;
+    compiler_threads_set_ = false;
 
     std::string vs_path = std::string(common::g_config->program_dir()) + 
         std::string("sys/shaders/default.vs");
@@ -48,6 +61,9 @@ ShaderInterface::ShaderInterface(RendererGL3* parent) {
 }
 
 ShaderInterface::~ShaderInterface() {
+    if (NULL != generic_) {
+        Delete(generic_);
+    }
 }
 
 /**
@@ -58,73 +74,254 @@ ShaderInterface::~ShaderInterface() {
  */
 ShaderManager::CacheEntry::BackendData* ShaderInterface::Create(const char* vs_header, 
     const char* fs_header) {
+    BackendData* backend_data = CompileProgram(vs_header, fs_header);
+    FinishProgram(backend_data);
+    return backend_data;
+}
 
-    BackendData*    backend_data    = new BackendData();
-    GLuint          vs_id           = glCreateShader(GL_VERTEX_SHADER);
-    GLuint          fs_id           = glCreateShader(GL_FRAGMENT_SHADER);
-    GLint           res             = 0;
+/**
+ * Start creating a new shader in the backend renderer without waiting for it to compile
+ * @param vs_header Vertex shader header definitions
+ * @param fs_header Fragment shader header definitions
+ * @return a pointer to CacheEntry::BackendData with renderer-specific shader data, which
+ * can't be bound or saved before IsReady returns true for it
+ */
+ShaderManager::CacheEntry::BackendData* ShaderInterface::CreateAsync(const char* vs_header, 
+    const char* fs_header) {
+    // Let the driver use as many compiler threads as it likes
+    if (!compiler_threads_set_) {
+#ifdef GL_ARB_parallel_shader_compile // Not in older GLEW headers, e.g. the bundled 1.6.0
+        if (GLEW_ARB_parallel_shader_compile) {
+            glMaxShaderCompilerThreadsARB(0xFFFFFFFF);
+        }
+#endif
+        compiler_threads_set_ = true;
+    }
+    BackendData* backend_data = CompileProgram(vs_header, fs_header);
+    backend_data->frame_created_ = video_core::g_current_frame;
+    return backend_data;
+}
+
+/**
+ * Checks if a shader started by CreateAsync has finished compiling
+ * @param backend_data Renderer-specific shader data of the shader
+ * @return True if the shader can be used
+ */
+bool ShaderInterface::IsReady(ShaderManager::CacheEntry::BackendData* backend_data) {
+    BackendData* data = static_cast<BackendData*>(backend_data);
+
+    if (data->ready_) {
+        return true;
+    }
+#ifdef GL_ARB_parallel_shader_compile
+    if (GLEW_ARB_parallel_shader_compile) {
+        GLint res = 0;
+        glGetProgramiv(data->program_, GL_COMPLETION_STATUS_ARB, &res);
+        if (res == GL_FALSE) {
+            return false;
+        }
+    } else
+#endif
+    if (video_core::g_current_frame - data->frame_created_ < kAsyncCompileFrames) {
+        return false;
+    }
+    FinishProgram(data);
+    return true;
+}
+
+/**
+ * Binds the generic shader to the backend renderer, set up for the current draw state
+ * @param state Shader state for the generic shader
+ */
+void ShaderInterface::BindGeneric(const ShaderManager::GenericState& state) {
+    // Compiled once, the only shader compile the GP thread waits on
+    if (NULL == generic_) {
+        generic_ = static_cast<BackendData*>(Create(__generic_shader_header, 
+            __generic_shader_header));
+    }
+    parent_->uniform_manager_->SetGenericState(state);
+    Bind(generic_);
+}
+
+/**
+ * Submits the compile and link of a program, without querying anything that would wait on the
+ * driver to finish it
+ * @param vs_header Vertex shader header definitions
+ * @param fs_header Fragment shader header definitions
+ * @return Renderer-specific shader data of the program
+ */
+ShaderInterface::BackendData* ShaderInterface::CompileProgram(const char* vs_header, 
+    const char* fs_header) {
 
+    BackendData*    backend_data    = new BackendData();
     const char*     vs_source[]     = {__default_shader_header, vs_header, __vs_base_src_.c_str()};
     const char*     fs_source[]     = {__default_shader_header, fs_header, __fs_base_src_.c_str()};
 
-    // Compile Vertex Shader
-    glShaderSource(vs_id, 3, vs_source, NULL);
-    glCompileShader(vs_id);
-    glGetShaderiv(vs_id, GL_COMPILE_STATUS, &res);
+    backend_data->vs_id_ = glCreateShader(GL_VERTEX_SHADER);
+    backend_data->fs_id_ = glCreateShader(GL_FRAGMENT_SHADER);
+
+    glShaderSource(backend_data->vs_id_, 3, vs_source, NULL);
+    glCompileShader(backend_data->vs_id_);
+    glShaderSource(backend_data->fs_id_, 3, fs_source, NULL);
+    glCompileShader(backend_data->fs_id_);
+
+    // Create the program
+    backend_data->program_ = glCreateProgram();
+    glAttachShader(backend_data->program_, backend_data->vs_id_);
+    glAttachShader(backend_data->program_, backend_data->fs_id_);
+    if (GLEW_ARB_get_program_binary) {
+        glProgramParameteri(backend_data->program_, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+    glLinkProgram(backend_data->program_);
+
+    // Setup dual-source blending
+    glBindFragDataLocationIndexed(backend_data->program_, 0, 0, "col0");
+    glBindFragDataLocationIndexed(backend_data->program_, 0, 1, "col1");
+
+    return backend_data;
+}
+
+/**
+ * Checks the result of a compile started by CompileProgram and gets the program ready for use,
+ * waits for the driver if it isn't done yet
+ * @param data Renderer-specific shader data of the program
+ */
+void ShaderInterface::FinishProgram(BackendData* data) {
+    GLint res = 0;
+
+    // Vertex shader
+    glGetShaderiv(data->vs_id_, GL_COMPILE_STATUS, &res);
     if (res == GL_FALSE) {
-	    glGetShaderiv(vs_id, GL_INFO_LOG_LENGTH, &res);
+	    glGetShaderiv(data->vs_id_, GL_INFO_LOG_LENGTH, &res);
 	    char* log = new char[res];
-	    glGetShaderInfoLog(vs_id, res, &res, log);
+	    glGetShaderInfoLog(data->vs_id_, res, &res, log);
         _ASSERT_MSG(TVIDEO, 0, "Vertex shader failed to compile! Error(s):\n%s", log);
         delete [] log;
     }
-    // Compile Fragment Shader
-    glShaderSource(fs_id, 3, fs_source, NULL);
-    glCompileShader(fs_id);
-    glGetShaderiv(fs_id, GL_COMPILE_STATUS, &res);
+    // Fragment shader
+    glGetShaderiv(data->fs_id_, GL_COMPILE_STATUS, &res);
     if (res == GL_FALSE) {
-	    glGetShaderiv(fs_id, GL_INFO_LOG_LENGTH, &res);
+	    glGetShaderiv(data->fs_id_, GL_INFO_LOG_LENGTH, &res);
 	    char* log = new char[res];
-	    glGetShaderInfoLog(fs_id, res, &res, log);
+	    glGetShaderInfoLog(data->fs_id_, res, &res, log);
         _ASSERT_MSG(TVIDEO, 0, "Fragment shader failed to compile! Error(s):\n%s", log);
         delete [] log;
     }
-    // Create the program
-    backend_data->program_ = glCreateProgram();
-    glAttachShader(backend_data->program_, vs_id);
-    glAttachShader(backend_data->program_, fs_id);
-    glLinkProgram(backend_data->program_);
-    glGetShaderiv(backend_data->program_, GL_LINK_STATUS, &res);
+    // Program
+    glGetProgramiv(data->program_, GL_LINK_STATUS, &res);
     if (res == GL_FALSE) {
-	    glGetShaderiv(backend_data->program_, GL_INFO_LOG_LENGTH, &res);
+	    glGetProgramiv(data->program_, GL_INFO_LOG_LENGTH, &res);
 	    char* log = new char[res];
-	    glGetShaderInfoLog(backend_data->program_, res, &res, log);
+	    glGetProgramInfoLog(data->program_, res, &res, log);
         _ASSERT_MSG(TVIDEO, 0, "Shader program linker failed! Error(s):\n%s", log);
         delete [] log;
     }
-    // Setup dual-source blending
-    glBindFragDataLocationIndexed(backend_data->program_, 0, 0, "col0");
-    glBindFragDataLocationIndexed(backend_data->program_, 0, 1, "col1");
-
     // Cleanup
-    glDeleteShader(vs_id);
-    glDeleteShader(fs_id);
+    glDeleteShader(data->vs_id_);
+    glDeleteShader(data->fs_id_);
+    data->vs_id_ = 0;
+    data->fs_id_ = 0;
 
-    parent_->uniform_manager_->AttachShader(backend_data->program_);
+    AttachProgram(data->program_);
+    data->ready_ = true;
+}
 
-    if (parent_->uniform_manager_->ubo_fs_handle_ == 0) {
-        parent_->uniform_manager_->Init(backend_data->program_);
+/**
+ * Create a shader in the backend renderer from a binary returned by GetBinary
+ * @param binary Shader binary
+ * @param size Size of the binary in bytes
+ * @return a pointer to CacheEntry::BackendData with renderer-specific shader data, NULL if
+ * the binary was rejected
+ */
+ShaderManager::CacheEntry::BackendData* ShaderInterface::CreateFromBinary(const u8* binary,
+    size_t size) {
+    GLint res = 0;
+    GLenum format;
+
+    if (!GLEW_ARB_get_program_binary || size <= sizeof(format)) {
+        return NULL;
+    }
+    memcpy(&format, binary, sizeof(format));
+
+    GLuint program = glCreateProgram();
+    glProgramBinary(program, format, binary + sizeof(format), (GLsizei)(size - sizeof(format)));
+    glGetProgramiv(program, GL_LINK_STATUS, &res);
+    if (res == GL_FALSE) {
+        // Usually the driver was updated since the binary was saved
+        glDeleteProgram(program);
+        return NULL;
     }
+    BackendData* backend_data = new BackendData();
+    backend_data->program_ = program;
+    backend_data->ready_ = true;
+
+    AttachProgram(backend_data->program_);
 
     return backend_data;
 }
 
+/**
+ * Gets the binary of a shader, for the on-disk shader cache
+ * @param backend_data Renderer-specific shader data of the shader
+ * @param binary Result shader binary, the GL binary format followed by the program binary
+ * @return True on success, false if the driver can't save program binaries
+ */
+bool ShaderInterface::GetBinary(const ShaderManager::CacheEntry::BackendData* backend_data,
+    std::vector<u8>& binary) {
+    const BackendData* data = static_cast<const BackendData*>(backend_data);
+    GLint length = 0;
+    GLenum format = 0;
+
+    if (!GLEW_ARB_get_program_binary) {
+        return false;
+    }
+    glGetProgramiv(data->program_, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) {
+        return false;
+    }
+    binary.resize(sizeof(format) + length);
+    glGetProgramBinary(data->program_, length, &length, &format, &binary[sizeof(format)]);
+    memcpy(&binary[0], &format, sizeof(format));
+    binary.resize(sizeof(format) + length);
+    return true;
+}
+
+/**
+ * Gets a tag identifying what the shader binaries were built with: the GL driver and the base
+ * shader source
+ * @return String tag
+ */
+std::string ShaderInterface::GetBinaryTag() {
+    std::string base_src = std::string(__default_shader_header) + __vs_base_src_ + __fs_base_src_;
+    common::Hash64 base_hash = common::GetHash64((const u8*)base_src.c_str(), 
+        (int)base_src.size(), 0);
+
+    return common::FormatStr("%s;%s;%s;%016llx", glGetString(GL_VENDOR), glGetString(GL_RENDERER),
+        glGetString(GL_VERSION), (unsigned long long)base_hash);
+}
+
+/**
+ * Hooks a newly linked program up to the uniform manager
+ * @param program GL handle to the program
+ */
+void ShaderInterface::AttachProgram(GLuint program) {
+    parent_->uniform_manager_->AttachShader(program);
+
+    if (parent_->uniform_manager_->uniform_buffer_ == NULL) {
+        parent_->uniform_manager_->Init(program);
+    }
+}
+
 /**
  * Delete a shader from the backend renderer
  * @param backend_data Renderer-specific shader data used by renderer to remove it
  */
 void ShaderInterface::Delete(ShaderManager::CacheEntry::BackendData* backend_data) {
     BackendData* data = static_cast<BackendData*>(backend_data);
+    if (!data->ready_) {
+        glDeleteShader(data->vs_id_);
+        glDeleteShader(data->fs_id_);
+    }
     glDeleteShader(data->program_);
     delete backend_data;
 }
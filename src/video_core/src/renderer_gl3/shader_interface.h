@@ -48,6 +48,56 @@ public:
      */
     ShaderManager::CacheEntry::BackendData* Create(const char* vs_header, const char* fs_header);
 
+    /**
+     * Start creating a new shader in the backend renderer without waiting for it to compile
+     * @param vs_header Vertex shader header definitions
+     * @param fs_header Fragment shader header definitions
+     * @return a pointer to CacheEntry::BackendData with renderer-specific shader data, which
+     * can't be bound or saved before IsReady returns true for it
+     */
+    ShaderManager::CacheEntry::BackendData* CreateAsync(const char* vs_header, 
+        const char* fs_header);
+
+    /**
+     * Checks if a shader started by CreateAsync has finished compiling. With
+     * GL_ARB_parallel_shader_compile the driver is asked, otherwise the link status is first
+     * queried a few frames later, by when a driver compiling on its own threads is done
+     * @param backend_data Renderer-specific shader data of the shader
+     * @return True if the shader can be used
+     */
+    bool IsReady(ShaderManager::CacheEntry::BackendData* backend_data);
+
+    /**
+     * Binds the generic shader to the backend renderer, set up for the current draw state
+     * @param state Shader state for the generic shader
+     */
+    void BindGeneric(const ShaderManager::GenericState& state);
+
+    /**
+     * Create a shader in the backend renderer from a binary returned by GetBinary
+     * @param binary Shader binary
+     * @param size Size of the binary in bytes
+     * @return a pointer to CacheEntry::BackendData with renderer-specific shader data, NULL if
+     * the binary was rejected
+     */
+    ShaderManager::CacheEntry::BackendData* CreateFromBinary(const u8* binary, size_t size);
+
+    /**
+     * Gets the binary of a shader, for the on-disk shader cache
+     * @param backend_data Renderer-specific shader data of the shader
+     * @param binary Result shader binary, the GL binary format followed by the program binary
+     * @return True on success, false if the driver can't save program binaries
+     */
+    bool GetBinary(const ShaderManager::CacheEntry::BackendData* backend_data,
+        std::vector<u8>& binary);
+
+    /**
+     * Gets a tag identifying what the shader binaries were built with: the GL driver and the base
+     * shader source
+     * @return String tag
+     */
+    std::string GetBinaryTag();
+
     /**
      * Delete a shader from the backend renderer
      * @param backend_data Renderer-specific shader data used by renderer to remove it
@@ -63,20 +113,49 @@ public:
 
 private:
 
-    RendererGL3* parent_;
-
-    std::string __vs_base_src_;
-    std::string __fs_base_src_;
-
     class BackendData : public ShaderManager::CacheEntry::BackendData {
     public:
-        BackendData() : program_(0) {
+        BackendData() : program_(0), vs_id_(0), fs_id_(0), ready_(false), frame_created_(0) {
         }
         ~BackendData() {
         }
-        GLuint program_;      ///< GL handle to the compiled shader program
+        GLuint program_;        ///< GL handle to the compiled shader program
+        GLuint vs_id_;          ///< Vertex shader, until the program is finished
+        GLuint fs_id_;          ///< Fragment shader, until the program is finished
+        bool   ready_;          ///< Program is linked and attached to the uniform manager
+        int    frame_created_;  ///< Frame the compile was started on
     };
 
+    /**
+     * Submits the compile and link of a program, without querying anything that would wait on
+     * the driver to finish it
+     * @param vs_header Vertex shader header definitions
+     * @param fs_header Fragment shader header definitions
+     * @return Renderer-specific shader data of the program
+     */
+    BackendData* CompileProgram(const char* vs_header, const char* fs_header);
+
+    /**
+     * Checks the result of a compile started by CompileProgram and gets the program ready for use,
+     * waits for the driver if it isn't done yet
+     * @param data Renderer-specific shader data of the program
+     */
+    void FinishProgram(BackendData* data);
+
+    /**
+     * Hooks a newly linked program up to the uniform manager
+     * @param program GL handle to the program
+     */
+    void AttachProgram(GLuint program);
+
+    RendererGL3* parent_;
+
+    std::string __vs_base_src_;
+    std::string __fs_base_src_;
+
+    BackendData*    generic_;               ///< Generic shader, created when first needed
+    bool            compiler_threads_set_;  ///< Parallel compile thread count was requested
+
     DISALLOW_COPY_AND_ASSIGN(ShaderInterface);
 };
 
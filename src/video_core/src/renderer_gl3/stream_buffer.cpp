@@ -0,0 +1,142 @@
+/**
+ * Copyright (C) 2005-2012 Gekko Emulator
+ *
+ * @file    stream_buffer.cpp
+ * @author  ShizZy <shizzy247@gmail.com>
+ * @date    2013-02-26
+ * @brief   Ring buffer for streaming per-draw data (vertices, indices, uniforms) to the GPU
+ *
+ * @section LICENSE
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details at
+ * http://www.gnu.org/copyleft/gpl.html
+ *
+ * Official project repository can be found at:
+ * http://code.google.com/p/gekko-gc-emu/
+ */
+
+#include "stream_buffer.h"
+
+StreamBuffer::StreamBuffer(GLenum target, u32 size) {
+    target_         = target;
+    size_           = size;
+    segment_size_   = size / kNumSegments;
+#ifdef GL_ARB_buffer_storage // Not in older GLEW headers, e.g. the bundled 1.6.0
+    persistent_     = (GLEW_ARB_buffer_storage != 0);
+#else
+    persistent_     = false;
+#endif
+    persistent_ptr_ = NULL;
+    position_       = 0;
+    mapped_offset_  = 0;
+    mapped_size_    = 0;
+    fenced_segment_ = 0;
+    memset(fences_, 0, sizeof(fences_));
+
+    glGenBuffers(1, &handle_);
+    glBindBuffer(target_, handle_);
+
+#ifdef GL_ARB_buffer_storage
+    if (persistent_) {
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(target_, size_, NULL, flags);
+        persistent_ptr_ = (u8*)glMapBufferRange(target_, 0, size_, flags);
+        if (persistent_ptr_ == NULL) {
+            LOG_ERROR(TVIDEO, "Unable to map stream buffer persistently, mapping per draw");
+            glDeleteBuffers(1, &handle_);
+            glGenBuffers(1, &handle_);
+            glBindBuffer(target_, handle_);
+            persistent_ = false;
+        }
+    }
+#endif
+    if (!persistent_) {
+        glBufferData(target_, size_, NULL, GL_STREAM_DRAW);
+    }
+}
+
+StreamBuffer::~StreamBuffer() {
+    for (int i = 0; i < kNumSegments; i++) {
+        if (fences_[i]) {
+            glDeleteSync(fences_[i]);
+        }
+    }
+    if (persistent_) {
+        glBindBuffer(target_, handle_);
+        glUnmapBuffer(target_);
+    }
+    glDeleteBuffers(1, &handle_);
+}
+
+/// Put fences behind the segments that have been written since the last fence
+void StreamBuffer::FenceSegments(int end_segment) {
+    for (int i = fenced_segment_; i < end_segment; i++) {
+        if (fences_[i]) {
+            glDeleteSync(fences_[i]);
+        }
+        fences_[i] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+    fenced_segment_ = std::max(fenced_segment_, end_segment);
+}
+
+/// Wait for the GPU to finish with the segments a range of the buffer falls in
+void StreamBuffer::WaitSegments(u32 start, u32 size) {
+    int end_segment = GetSegment(start + size - 1);
+
+    for (int i = GetSegment(start); i <= end_segment; i++) {
+        if (fences_[i]) {
+            glClientWaitSync(fences_[i], GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+            glDeleteSync(fences_[i]);
+            fences_[i] = 0;
+        }
+    }
+}
+
+/// Reserve space for writing
+u8* StreamBuffer::Map(u32 size, u32 alignment) {
+    _ASSERT_MSG(TVIDEO, (size > 0 && size < size_), "Stream buffer reservation of %d bytes!", size);
+
+    // Segments behind us are only read by draws that have been issued by now
+    FenceSegments(GetSegment(position_));
+
+    u32 offset = ((position_ + alignment - 1) / alignment) * alignment;
+    if (offset + size > size_) {
+        FenceSegments(kNumSegments);
+        fenced_segment_ = 0;
+        offset = 0;
+    }
+    WaitSegments(offset, size);
+
+    mapped_offset_ = offset;
+    mapped_size_ = size;
+    if (persistent_) {
+        return persistent_ptr_ + offset;
+    }
+    // The fences make sure the range isn't in use anymore, so no need for the driver to sync
+    glBindBuffer(target_, handle_);
+    return (u8*)glMapBufferRange(target_, offset, size, GL_MAP_WRITE_BIT |
+        GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_FLUSH_EXPLICIT_BIT);
+}
+
+/// Commit the space reserved by the last Map call
+u32 StreamBuffer::Unmap(u32 used_size) {
+    _ASSERT_MSG(TVIDEO, (used_size <= mapped_size_), "Stream buffer overrun (%d of %d bytes)!",
+        used_size, mapped_size_);
+
+    if (!persistent_) {
+        glBindBuffer(target_, handle_);
+        if (used_size) {
+            glFlushMappedBufferRange(target_, 0, used_size);
+        }
+        glUnmapBuffer(target_);
+    }
+    position_ = mapped_offset_ + used_size;
+    return mapped_offset_;
+}
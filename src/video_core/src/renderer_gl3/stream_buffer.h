@@ -0,0 +1,118 @@
+/**
+ * Copyright (C) 2005-2012 Gekko Emulator
+ *
+ * @file    stream_buffer.h
+ * @author  ShizZy <shizzy247@gmail.com>
+ * @date    2013-02-26
+ * @brief   Ring buffer for streaming per-draw data (vertices, indices, uniforms) to the GPU
+ *
+ * @section LICENSE
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details at
+ * http://www.gnu.org/copyleft/gpl.html
+ *
+ * Official project repository can be found at:
+ * http://code.google.com/p/gekko-gc-emu/
+ */
+
+#ifndef VIDEO_CORE_RENDERER_GL3_STREAM_BUFFER_H_
+#define VIDEO_CORE_RENDERER_GL3_STREAM_BUFFER_H_
+
+#include <algorithm>
+
+#include <GL/glew.h>
+
+#include "common.h"
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// GL3 stream buffer
+
+/**
+ * @brief Buffer object that is written front to back and wraps around when full. The buffer is
+ * split into segments, a fence is put behind each segment once the draws reading it are issued,
+ * and a segment is only written again after its fence has passed, so the GPU never has to be
+ * synchronized with otherwise. With GL_ARB_buffer_storage the buffer is mapped once, persistent
+ * and coherent, for its whole lifetime. Without it each allocation is mapped unsynchronized.
+ */
+class StreamBuffer {
+public:
+    static const int kNumSegments = 8;  ///< Number of fenced segments the buffer is split into
+
+    /**
+     * Create a stream buffer
+     * @param target Target the buffer is bound to (e.g. GL_ARRAY_BUFFER)
+     * @param size Size of the buffer in bytes
+     */
+    StreamBuffer(GLenum target, u32 size);
+    ~StreamBuffer();
+
+    /**
+     * Reserve space for writing, the space can't be used by the GPU until it's committed
+     * @param size Number of bytes to reserve (must be less than the buffer size)
+     * @param alignment Alignment of the offset of the space, doesn't have to be a power of 2
+     * @return Pointer to the reserved space
+     */
+    u8* Map(u32 size, u32 alignment);
+
+    /**
+     * Commit the space reserved by the last Map call
+     * @param used_size Number of bytes written, may be less than the reserved size
+     * @return Offset of the committed data in the buffer (in bytes)
+     */
+    u32 Unmap(u32 used_size);
+
+    /// Returns the GL handle of the buffer
+    GLuint handle() const { return handle_; }
+
+    /// Returns true if the buffer is persistently mapped
+    bool persistent() const { return persistent_; }
+
+private:
+
+    /**
+     * Gets the segment an offset falls in
+     * @param offset Offset into the buffer (in bytes)
+     * @return Segment index
+     */
+    int GetSegment(u32 offset) const {
+        return std::min((int)(offset / segment_size_), kNumSegments - 1);
+    }
+
+    /**
+     * Put fences behind the segments that have been written since the last fence
+     * @param end_segment Segment to stop at, it isn't fenced itself
+     */
+    void FenceSegments(int end_segment);
+
+    /**
+     * Wait for the GPU to finish with the segments a range of the buffer falls in
+     * @param start Start offset of the range (in bytes)
+     * @param size Size of the range (in bytes)
+     */
+    void WaitSegments(u32 start, u32 size);
+
+    GLenum  target_;
+    GLuint  handle_;
+    u32     size_;
+    u32     segment_size_;
+    bool    persistent_;            ///< Mapped once with GL_ARB_buffer_storage
+    u8*     persistent_ptr_;        ///< Pointer to the persistent mapping
+
+    u32     position_;              ///< Offset where the next reservation goes
+    u32     mapped_offset_;         ///< Offset of the current reservation
+    u32     mapped_size_;           ///< Size of the current reservation
+    int     fenced_segment_;        ///< First segment that doesn't have a fence put behind it yet
+
+    GLsync  fences_[kNumSegments];  ///< Fence of each segment, or 0 if the GPU is done with it
+
+    DISALLOW_COPY_AND_ASSIGN(StreamBuffer);
+};
+
+#endif // VIDEO_CORE_RENDERER_GL3_STREAM_BUFFER_H_
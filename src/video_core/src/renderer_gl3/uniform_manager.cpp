@@ -32,20 +32,24 @@
 #include "cp_mem.h"
 #include "xf_mem.h"
 
+#include "stream_buffer.h"
 #include "uniform_manager.h"
 
 UniformManager::UniformManager() {
-    ubo_fs_handle_ = 0;
-    ubo_vs_handle_ = 0;
+    uniform_buffer_ = NULL;
     ubo_fs_block_index_ = 0;
     ubo_vs_block_index_ = 0;
-    last_invalid_region_xf_ = 0;
-    last_invalid_region_nrm_ = 0;
-    memset(invalid_regions_xf_, 0, sizeof(invalid_regions_xf_));
-    memset(invalid_regions_nrm_, 0, sizeof(invalid_regions_nrm_));
+    ubo_alignment_ = 256;
+    dirty_ = true;
     memset(&staged_uniform_data_, 0, sizeof(staged_uniform_data_));
     memset(&__uniform_data_, 0, sizeof(__uniform_data_));
     memset(&konst_, 0, sizeof(konst_));
+    memset(&generic_state_, 0, sizeof(generic_state_));
+    memset(&staged_generic_state_, 0, sizeof(staged_generic_state_));
+}
+
+UniformManager::~UniformManager() {
+    delete uniform_buffer_;
 }
 
 /**
@@ -245,25 +249,18 @@ void UniformManager::WriteXF(u16 addr, int length, u32* data) {
 
         u32* _ubo_mem = (u32*)__uniform_data_.vs_ubo.tf_mem;
 
-        // Invalidate region in UBO if a change is detected
+        // Reupload the UBO if a change is detected
         if (common::GetHash64((u8*)data, bytelen, 0) != 
             common::GetHash64((u8*)&_ubo_mem[addr], bytelen, 0)) {
 
-            // Update data block
-            memcpy(&_ubo_mem[addr], data, bytelen);
-
-            // Invalidate GPU data block region
-            invalid_regions_xf_[last_invalid_region_xf_].offset = (addr << 2);
-            invalid_regions_xf_[last_invalid_region_xf_].length = bytelen;
-
-            _ASSERT_MSG(TGP, (last_invalid_region_xf_ < kMaxUniformRegions), 
-                "XF uniform region (0x%08X) is outside bounds!", last_invalid_region_xf_);
             _ASSERT_MSG(TGP, (addr < gp::kXFMemSize), 
                 "XF memory update adrress (0x%04X) is outside bounds!", addr);
             _ASSERT_MSG(TGP, ((addr + (bytelen >> 2)) < gp::kXFMemSize), 
                 "XF memory update size (0x%04X) is outside bounds!", bytelen);
 
-            last_invalid_region_xf_++;
+            // Update data block
+            memcpy(&_ubo_mem[addr], data, bytelen);
+            dirty_ = true;
         }
 
     // Normal mem
@@ -284,18 +281,13 @@ void UniformManager::WriteXF(u16 addr, int length, u32* data) {
             _normal_mem[(i * 4) + 2] = data[(i * 3) + 2];
             _normal_mem[(i * 4) + 3] = 0;
         }
-        // Invalidate region in UBO if a change is detected
+        // Reupload the UBO if a change is detected
         if (common::GetHash64((u8*)_normal_mem, bytelen, 0) != 
             common::GetHash64((u8*)&_ubo_mem[addr], bytelen, 0)) {
 
             // Update data block
             memcpy(&_ubo_mem[addr], _normal_mem, bytelen);
-
-            // Invalidate GPU data block region
-            invalid_regions_nrm_[last_invalid_region_nrm_].offset = (addr << 2);
-            invalid_regions_nrm_[last_invalid_region_nrm_].length = bytelen;
-
-            last_invalid_region_nrm_++;
+            dirty_ = true;
         }
 
     // Lighting mem
@@ -376,78 +368,73 @@ void UniformManager::UpdateStagedData() {
     }
 }
 
+/// Upload all uniform blocks to the stream buffer and bind them
+void UniformManager::UploadBlocks() {
+    // Each block starts at a bindable offset
+    u32 align = ubo_alignment_;
+    u32 vs_offset = 0;
+    u32 fs_offset = ((sizeof(__uniform_data_.vs_ubo) + align - 1) / align) * align;
+    u32 generic_offset = ((fs_offset + sizeof(__uniform_data_.fs_ubo) + align - 1) / align) * align;
+    u32 size = generic_offset + sizeof(generic_state_);
+
+    u8* dst = uniform_buffer_->Map(size, align);
+    memcpy(dst + vs_offset, &__uniform_data_.vs_ubo, sizeof(__uniform_data_.vs_ubo));
+    memcpy(dst + fs_offset, &__uniform_data_.fs_ubo, sizeof(__uniform_data_.fs_ubo));
+    memcpy(dst + generic_offset, &generic_state_, sizeof(generic_state_));
+    u32 offset = uniform_buffer_->Unmap(size);
+
+    GLuint handle = uniform_buffer_->handle();
+    glBindBufferRange(GL_UNIFORM_BUFFER, 0, handle, offset + fs_offset, 
+        sizeof(__uniform_data_.fs_ubo));
+    glBindBufferRange(GL_UNIFORM_BUFFER, 1, handle, offset + vs_offset, 
+        sizeof(__uniform_data_.vs_ubo));
+    glBindBufferRange(GL_UNIFORM_BUFFER, 2, handle, offset + generic_offset, 
+        sizeof(generic_state_));
+}
+
 /// Apply any uniform changes to the shader
 void UniformManager::ApplyChanges() {
 
     this->UpdateStagedData(); // Grabs latest data to update
 
-    // Update invalid regions vertex shader UBO
-    // ----------------------------------------
+    // Blocks aren't patched in place. When anything changed, all blocks are written out to a new
+    // spot in the stream buffer and bound there, so the GPU never waits on blocks still in use and
+    // the bound blocks are never older than the last write, which keeps them from being
+    // overwritten once the stream buffer wraps around
 
-    glBindBuffer(GL_UNIFORM_BUFFER, ubo_vs_handle_);
     if (!(__uniform_data_.vs_ubo.state == staged_uniform_data_.vs_ubo.state)) {
         __uniform_data_.vs_ubo.state = staged_uniform_data_.vs_ubo.state;
-        glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(UniformStruct_VertexState), 
-            &__uniform_data_.vs_ubo.state);
-    }
-    for (int i = 0; i < last_invalid_region_xf_; i++) {
-        const u32* data = (const u32*)__uniform_data_.vs_ubo.tf_mem;
-        glBufferSubData(GL_UNIFORM_BUFFER, 
-            invalid_regions_xf_[i].offset + sizeof(UniformStruct_VertexState), 
-            invalid_regions_xf_[i].length, 
-            &data[invalid_regions_xf_[i].offset >> 2]);
+        dirty_ = true;
     }
-    last_invalid_region_xf_ = 0;
-
-    for (int i = 0; i < last_invalid_region_nrm_; i++) {
-        const u32* data = (const u32*)__uniform_data_.vs_ubo.nrm_mem;
-        glBufferSubData(GL_UNIFORM_BUFFER, 
-            invalid_regions_nrm_[i].offset + sizeof(UniformStruct_VertexState) + sizeof(__uniform_data_.vs_ubo.tf_mem), 
-            invalid_regions_nrm_[i].length, 
-            &data[invalid_regions_nrm_[i].offset >> 2]);
-    }
-    last_invalid_region_nrm_ = 0;
-
-    // Update invalid regions fragment shader UBO
-    // ------------------------------------------
-
-    glBindBuffer(GL_UNIFORM_BUFFER, ubo_fs_handle_);
-    if (!(__uniform_data_.fs_ubo.tev_state == 
-        staged_uniform_data_.fs_ubo.tev_state) || 
-        !(__uniform_data_.fs_ubo.tev_stages[0] == 
-        staged_uniform_data_.fs_ubo.tev_stages[0])) {
-
+    if (!(__uniform_data_.fs_ubo.tev_state == staged_uniform_data_.fs_ubo.tev_state)) {
         __uniform_data_.fs_ubo.tev_state = staged_uniform_data_.fs_ubo.tev_state;
-        __uniform_data_.fs_ubo.tev_stages[0] = 
-            staged_uniform_data_.fs_ubo.tev_stages[0];
-
-        glBufferSubData(GL_UNIFORM_BUFFER, 0, 
-            sizeof(UniformStruct_TevState) + sizeof(UniformStruct_TevStageParams), 
-            &__uniform_data_.fs_ubo);
+        dirty_ = true;
     }
-
-    // Iterate through each stage of UBO data, upload to GPU memory if a change is detected, 
-    // otherwise ignore. If _COMBINE_BP_UBO_WRITES is defined, sequentially changes will be combined
-    // when uploaded. Otherwise, they will be uploaed individually.
-    for (int stage = 1; stage < kGCMaxTevStages; stage++) {
-
-        // No change found
-        if ((staged_uniform_data_.fs_ubo.tev_stages[stage] == 
-            __uniform_data_.fs_ubo.tev_stages[stage]) || (stage >= kGCMaxTevStages)) {
-            continue;
-
-        // Change found
-        } else {
+    for (int stage = 0; stage < kGCMaxTevStages; stage++) {
+        if (!(__uniform_data_.fs_ubo.tev_stages[stage] == 
+            staged_uniform_data_.fs_ubo.tev_stages[stage])) {
             __uniform_data_.fs_ubo.tev_stages[stage] = 
                 staged_uniform_data_.fs_ubo.tev_stages[stage];
-
-            int byte_offset = sizeof(UniformStruct_TevState) + 
-                (stage * sizeof(UniformStruct_TevStageParams));
-
-            glBufferSubData(GL_UNIFORM_BUFFER, byte_offset, sizeof(UniformStruct_TevStageParams), 
-	            &__uniform_data_.fs_ubo.tev_stages[stage]);
+            dirty_ = true;
         }
     }
+    // Generic shader state only changes while the generic shader is in use
+    if (memcmp(&generic_state_, &staged_generic_state_, sizeof(generic_state_))) {
+        generic_state_ = staged_generic_state_;
+        dirty_ = true;
+    }
+    if (dirty_) {
+        UploadBlocks();
+        dirty_ = false;
+    }
+}
+
+/**
+ * Stage the state of the generic shader, it's uploaded with the next ApplyChanges
+ * @param state Generic shader state from the shader manager
+ */
+void UniformManager::SetGenericState(const ShaderManager::GenericState& state) {
+    staged_generic_state_ = state;
 }
 
 /**
@@ -455,23 +442,23 @@ void UniformManager::ApplyChanges() {
  * @param shader Compiled GLSL shader program
  */
 void UniformManager::AttachShader(GLuint shader) {
-    glUniformBlockBinding(shader, ubo_fs_block_index_, 0);
-    glUniformBlockBinding(shader, ubo_vs_block_index_, 1);
+    // Block indices are looked up per program, the generic shader has an extra block
+    glUniformBlockBinding(shader, glGetUniformBlockIndex(shader, "_FS_UBO"), 0);
+    glUniformBlockBinding(shader, glGetUniformBlockIndex(shader, "_VS_UBO"), 1);
+
+    GLuint generic_block_index = glGetUniformBlockIndex(shader, "_GENERIC_UBO");
+    if (generic_block_index != GL_INVALID_INDEX) {
+        glUniformBlockBinding(shader, generic_block_index, 2);
+    }
 }
 
 /// Initialize the Uniform Manager
 void UniformManager::Init(GLuint default_shader) {
-    // Initialize BP UBO(s)
     ubo_fs_block_index_ = glGetUniformBlockIndex(default_shader, "_FS_UBO");
-    glGenBuffers(1, &ubo_fs_handle_);
-    glBindBuffer(GL_UNIFORM_BUFFER, ubo_fs_handle_);
-    glBufferData(GL_UNIFORM_BUFFER, sizeof(__uniform_data_.fs_ubo), NULL, GL_DYNAMIC_DRAW);
-    glBindBufferBase(GL_UNIFORM_BUFFER, 0, ubo_fs_handle_);
-
-    // Initialize XF UBO
     ubo_vs_block_index_ = glGetUniformBlockIndex(default_shader, "_VS_UBO");
-    glGenBuffers(1, &ubo_vs_handle_);
-    glBindBuffer(GL_UNIFORM_BUFFER, ubo_vs_handle_);
-    glBufferData(GL_UNIFORM_BUFFER, sizeof(__uniform_data_.vs_ubo), NULL, GL_DYNAMIC_DRAW);
-    glBindBufferBase(GL_UNIFORM_BUFFER, 1, ubo_vs_handle_);
+
+    // All UBOs are streamed, they get bound to their spot with the first ApplyChanges
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &ubo_alignment_);
+    uniform_buffer_ = new StreamBuffer(GL_UNIFORM_BUFFER, kStreamBufferSize);
+    dirty_ = true;
 }
@@ -30,6 +30,7 @@
 #include "common.h"
 #include "xf_mem.h"
 #include "gx_types.h"
+#include "shader_manager.h"
 
 /// Struct to represent a Vec4 in GLSL
 struct Vec4 {
@@ -59,21 +60,16 @@ struct Vec4 {
     }
 };
 
+class StreamBuffer;
+
 class UniformManager {
 
 public:
 
-    static const int kMaxUniformRegions = 1024;     ///< Maximum number of regions to invalidate
+    static const u32 kStreamBufferSize = 1024 * 1024 * 8; ///< Size of the uniform stream buffer
 
     UniformManager();
-    ~UniformManager() {}
-
-    /// Struct to represent a memory region in a UBO
-    struct UniformRegion {
-        u8* start_addr;
-        int length;
-        int offset;
-    };
+    ~UniformManager();
 
     // Uniform structures - These are structs used in the shader
     // ---------------------------------------------------------
@@ -249,6 +245,12 @@ public:
     */
     void WriteXF(u16 addr, int length, u32* data);
 
+    /**
+     * Stage the state of the generic shader, it's uploaded with the next ApplyChanges
+     * @param state Generic shader state from the shader manager
+     */
+    void SetGenericState(const ShaderManager::GenericState& state);
+
     /// Updates the uniform changes
     void ApplyChanges();
 
@@ -261,19 +263,15 @@ public:
     /// Initialize the shader manager
     void Init(GLuint default_shader);
 
-    GLuint	ubo_fs_handle_;         ///< Fragment shader UBO handle
-    GLuint	ubo_vs_handle_;         ///< Vertex shader UBO handle
+    StreamBuffer* uniform_buffer_;  ///< Stream buffer all UBOs are uploaded to, NULL until Init
 
     GLuint  ubo_fs_block_index_;    ///< Fragment shader UBO block index
     GLuint  ubo_vs_block_index_;    ///< Vertex shader UBO block index
 
 private:
 
-    /**
-     * Internal function to invalidate a region of the UBO
-     * @param region Uniform region to invalidate with function call
-     */
-    void InvalidateRegion(UniformRegion region);
+    /// Upload all uniform blocks to the stream buffer and bind them
+    void UploadBlocks();
 
     /// Updates any staged data to be written in the next uniform data upload
     void UpdateStagedData();
@@ -284,12 +282,14 @@ private:
      */
     Vec4 GetTevKonst(int sel);
 
-    int             last_invalid_region_xf_;
-    int             last_invalid_region_nrm_;
-    UniformRegion   invalid_regions_xf_[kMaxUniformRegions];
-    UniformRegion   invalid_regions_nrm_[kMaxUniformRegions];
+    GLint   ubo_alignment_;         ///< Offset alignment required for binding a UBO range
+
+    bool    dirty_;                 ///< UBOs have changed since they were last uploaded
 
     Vec4 konst_[4];
+
+    ShaderManager::GenericState generic_state_;         ///< Generic shader state on the GPU
+    ShaderManager::GenericState staged_generic_state_;  ///< Generic shader state to upload
 };
 
 #endif // VIDEO_CORE_UNIFORM_MANAGER_H_
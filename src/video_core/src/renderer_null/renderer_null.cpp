@@ -0,0 +1,163 @@
+/**
+ * Copyright (C) 2005-2012 Gekko Emulator
+ *
+ * @file    renderer_null.cpp
+ * @author  ShizZy <shizzy247@gmail.com>
+ * @date    2013-02-26
+ * @brief   Renderer that accepts and discards everything, for running the GP without a GPU
+ *
+ * @section LICENSE
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details at
+ * http://www.gnu.org/copyleft/gpl.html
+ *
+ * Official project repository can be found at:
+ * http://code.google.com/p/gekko-gc-emu/
+ */
+
+#include <algorithm>
+
+#include "SDL.h"
+
+#include "common.h"
+
+#include "video_core.h"
+#include "vertex_manager.h"
+
+#include "renderer_null.h"
+
+/// RendererNull constructor
+RendererNull::RendererNull() {
+    vbo_ = NULL;
+    last_report_ticks_ = 0;
+    memset(&stats_, 0, sizeof(stats_));
+    shader_interface_ = new ShaderInterface(this);
+    texture_interface_ = new TextureInterface(this);
+}
+
+/// RendererNull destructor
+RendererNull::~RendererNull() {
+    delete shader_interface_;
+    delete texture_interface_;
+    delete[] vbo_;
+}
+
+/**
+ * Write data to BP for renderer internal use (e.g. direct to shader)
+ * @param addr BP register address
+ * @param data Value to write to BP register
+ */
+void RendererNull::WriteBP(u8 addr, u32 data) {
+    stats_.bp_writes++;
+}
+
+/**
+ * Write data to CP for renderer internal use (e.g. direct to shader)
+ * @param addr CP register address
+ * @param data Value to write to CP register
+ */
+void RendererNull::WriteCP(u8 addr, u32 data) {
+    stats_.cp_writes++;
+}
+
+/**
+ * Write data to XF for renderer internal use (e.g. direct to shader)
+ * @param addr XF address
+ * @param length Length (in 32-bit words) to write to XF
+ * @param data Data buffer to write to XF
+ */
+void RendererNull::WriteXF(u16 addr, int length, u32* data) {
+    stats_.xf_writes++;
+}
+
+/**
+ * Begin renderering of a primitive
+ * @param prim Primitive type (e.g. GX_TRIANGLES)
+ * @param count Number of vertices to be drawn (used for appropriate memory management, only)
+ * @param vbo Pointer to VBO, which will be set by API in this function
+ * @param vbo_offset Offset of the primitive into the current batch (in vertices, laid out as
+ * VertexLoader_GetLayout says for the current vertex state)
+ */
+void RendererNull::BeginPrimitive(GXPrimitive prim, int count, u8** vbo, u32 vbo_offset) {
+    if (0 == count) {
+        return;
+    }
+    // Vertices are still decoded to memory, that's part of the work being measured
+    *vbo = vbo_ + vbo_offset * sizeof(GXVertex);
+    stats_.primitives++;
+}
+
+/**
+ * Draws a batch of primitives from the previously decoded vertex array
+ * @param prim Primitive type the batch is drawn as (GX_TRIANGLES, GX_LINES or GX_POINTS)
+ * @param vertex_num Number of vertices in the batch
+ * @param indices Index list of the batch, relative to the first vertex of the batch
+ * @param index_num Number of indices
+ */
+void RendererNull::DrawPrimitives(GXPrimitive prim, u32 vertex_num, const u32* indices,
+    int index_num) {
+    // Shader selection is part of the front-end work, the shader manager hashes its state here
+    video_core::g_shader_manager->Bind();
+
+    stats_.draws++;
+    stats_.vertices += vertex_num;
+    stats_.indices += index_num;
+}
+
+/// Swap buffers (render frame)
+void RendererNull::SwapBuffers() {
+    stats_.frames++;
+    current_frame_++;
+
+    if (stats_.frames >= kStatsReportFrames) {
+        ReportStats();
+    }
+}
+
+/**
+ * Blits the EFB to the external framebuffer (XFB)
+ * @param src_rect Source rectangle in EFB to copy
+ * @param dst_rect Destination rectangle in EFB to copy to
+ */
+void RendererNull::CopyToXFB(const Rect& src_rect, const Rect& dst_rect) {
+    stats_.efb_copies++;
+}
+
+/// Logs the work counted since the last report and resets the counters
+void RendererNull::ReportStats() {
+    u32 ticks = SDL_GetTicks();
+    u32 elapsed = std::max<u32>(ticks - last_report_ticks_, 1);
+    f32 frames = (f32)stats_.frames;
+
+    current_fps_ = 1000.0f * stats_.frames / elapsed;
+
+    LOG_NOTICE(TVIDEO, "%.1f fps, per frame: %.1f draws, %.1f primitives, %.1f vertices, "
+        "%.1f indices, %.1f BP/%.1f CP/%.1f XF writes, %.1f EFB copies, %.1f new shaders, "
+        "%.1f new textures", current_fps_, stats_.draws / frames, stats_.primitives / frames,
+        stats_.vertices / frames, stats_.indices / frames, stats_.bp_writes / frames,
+        stats_.cp_writes / frames, stats_.xf_writes / frames, stats_.efb_copies / frames,
+        stats_.shaders_created / frames, stats_.textures_created / frames);
+
+    memset(&stats_, 0, sizeof(stats_));
+    last_report_ticks_ = ticks;
+}
+
+/// Initialize the renderer
+void RendererNull::Init() {
+    vbo_ = new u8[VBO_MAX_BATCH_VERTS * sizeof(GXVertex)];
+    last_report_ticks_ = SDL_GetTicks();
+    LOG_NOTICE(TVIDEO, "Null renderer initialized, nothing will be drawn");
+}
+
+/// Shutdown the renderer
+void RendererNull::ShutDown() {
+    delete[] vbo_;
+    vbo_ = NULL;
+}
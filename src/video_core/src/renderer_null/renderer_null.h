@@ -0,0 +1,295 @@
+/**
+ * Copyright (C) 2005-2012 Gekko Emulator
+ *
+ * @file    renderer_null.h
+ * @author  ShizZy <shizzy247@gmail.com>
+ * @date    2013-02-26
+ * @brief   Renderer that accepts and discards everything, for running the GP without a GPU
+ *
+ * @section LICENSE
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details at
+ * http://www.gnu.org/copyleft/gpl.html
+ *
+ * Official project repository can be found at:
+ * http://code.google.com/p/gekko-gc-emu/
+ */
+
+#ifndef VIDEO_CORE_RENDERER_NULL_H_
+#define VIDEO_CORE_RENDERER_NULL_H_
+
+#include "common.h"
+#include "gx_types.h"
+#include "renderer_base.h"
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Null Renderer
+
+/**
+ * @brief Renderer without any output. Everything the GP front-end produces (register writes,
+ * decoded vertices, shaders, decoded textures) is accepted and thrown away, only counted, so the
+ * FIFO, vertex loader and shader/texture managers can be run and timed without a GL context.
+ */
+class RendererNull : virtual public RendererBase {
+public:
+
+    /// Work counters, reset with every report
+    struct Stats {
+        u32 bp_writes;          ///< BP register writes
+        u32 cp_writes;          ///< CP register writes
+        u32 xf_writes;          ///< XF writes (registers and memory loads)
+        u32 primitives;         ///< GX primitives decoded
+        u32 draws;              ///< Batches drawn
+        u32 vertices;           ///< Vertices decoded
+        u32 indices;            ///< Indices drawn
+        u32 shaders_created;    ///< Shaders generated by the shader manager
+        u32 textures_created;   ///< Textures decoded by the texture manager
+        u32 efb_copies;         ///< EFB copies to textures or the XFB
+        u32 frames;             ///< Frames swapped
+    };
+
+    static const int kStatsReportFrames = 300;  ///< Number of frames between stats reports
+
+    RendererNull();
+    ~RendererNull();
+
+    /**
+     * Write data to BP for renderer internal use (e.g. direct to shader)
+     * @param addr BP register address
+     * @param data Value to write to BP register
+     */
+    void WriteBP(u8 addr, u32 data);
+
+    /**
+     * Write data to CP for renderer internal use (e.g. direct to shader)
+     * @param addr CP register address
+     * @param data Value to write to CP register
+     */
+    void WriteCP(u8 addr, u32 data);
+
+    /**
+     * Write data to XF for renderer internal use (e.g. direct to shader)
+     * @param addr XF address
+     * @param length Length (in 32-bit words) to write to XF
+     * @param data Data buffer to write to XF
+     */
+    void WriteXF(u16 addr, int length, u32* data);
+
+    /**
+     * Begin renderering of a primitive
+     * @param prim Primitive type (e.g. GX_TRIANGLES)
+     * @param count Number of vertices to be drawn (used for appropriate memory management, only)
+     * @param vbo Pointer to VBO, which will be set by API in this function
+     * @param vbo_offset Offset of the primitive into the current batch (in vertices, laid out
+     * as VertexLoader_GetLayout says for the current vertex state)
+     */
+    void BeginPrimitive(GXPrimitive prim, int count, u8** vbo, u32 vbo_offset);
+
+    /**
+     * Set the current vertex state (format and count of each vertex component)
+     * @param vertex_state VertexState structure of the current vertex state
+     */
+    void SetVertexState(const gp::VertexState& vertex_state) {}
+
+    /**
+     * Used to signal to the render that a region in XF is required by a primitive
+     * @param index Vector index in XF memory that is required
+     */
+    void VertexPosition_UseIndexXF(u8 index) {}
+
+    /**
+     * Draws a batch of primitives from the previously decoded vertex array
+     * @param prim Primitive type the batch is drawn as (GX_TRIANGLES, GX_LINES or GX_POINTS)
+     * @param vertex_num Number of vertices in the batch
+     * @param indices Index list of the batch, relative to the first vertex of the batch
+     * @param index_num Number of indices
+     */
+    void DrawPrimitives(GXPrimitive prim, u32 vertex_num, const u32* indices, int index_num);
+
+    /// Sets the renderer viewport location, width, and height
+    void SetViewport(int x, int y, int width, int height) {}
+
+    /// Swap buffers (render frame)
+    void SwapBuffers();
+
+    /// Sets the renderer depthrange, znear and zfar
+    void SetDepthRange(double znear, double zfar) {}
+
+    /// Sets the renderer depth test mode
+    void SetDepthMode() {}
+
+    /// Sets the renderer generation mode
+    void SetGenerationMode() {}
+
+    /**
+     * Sets the renderer blend mode
+     * @param pe_cmode_0 BPPECMode0 register to user for blend settings
+     * @param pe_cmode_1 BPPECMode1 register to user for blend settings
+     * @param blend_mode_ Forces blend mode to update
+     */
+    void SetBlendMode(const gp::BPPECMode0& pe_cmode_0, const gp::BPPECMode1& pe_cmode_1,
+        bool force_update) {}
+
+    /**
+     * Sets the renderer logic op mode
+     * @param pe_cmode_0 BPPECMode0 register to user for blend settings
+     */
+    void SetLogicOpMode(const gp::BPPECMode0& pe_cmode_0) {}
+
+    /**
+     * Sets the renderer dither mode
+     * @param pe_cmode_0 BPPECMode0 register to user for blend settings
+     */
+    void SetDitherMode(const gp::BPPECMode0& pe_cmode_0) {}
+
+    /**
+     * Sets the renderer color mask mode
+     * @param pe_cmode_0 BPPECMode0 register to user for blend settings
+     */
+    void SetColorMask(const gp::BPPECMode0& pe_cmode_0) {}
+
+    /* Sets the scissor box
+     * @param rect Renderer rectangle to set scissor box to
+     */
+    void SetScissorBox(const Rect& rect) {}
+
+    /**
+     * Sets the line and point size
+     * @param line_width Line width to use
+     * @param point_size Point size to use
+     */
+    void SetLinePointSize(f32 line_width, f32 point_size) {}
+
+    /**
+     * Blits the EFB to the external framebuffer (XFB)
+     * @param src_rect Source rectangle in EFB to copy
+     * @param dst_rect Destination rectangle in EFB to copy to
+     */
+    void CopyToXFB(const Rect& src_rect, const Rect& dst_rect);
+
+    /**
+     * Clear the screen
+     * @param rect Screen rectangle to clear
+     * @param enable_color Enable color clearing
+     * @param enable_alpha Enable alpha clearing
+     * @param enable_z Enable depth clearing
+     * @param color Clear color
+     * @param z Clear depth
+     */
+    void Clear(const Rect& rect, bool enable_color, bool enable_alpha, bool enable_z,
+        u32 color, u32 z) {}
+
+    /**
+     * Set a specific render mode
+     * @param flag Render flags mode to enable
+     */
+    void SetMode(kRenderMode flags) {}
+
+    /**
+     * Restore the render mode
+     * @param pe_cmode_0 BPPECMode0 register to user for blend settings
+     */
+    void RestoreMode(const gp::BPPECMode0& pe_cmode_0) {}
+
+    /// Reset the full renderer API to the NULL state
+    void ResetRenderState() {}
+
+    /// Restore the full renderer API state - As the game set it
+    void RestoreRenderState() {}
+
+    /**
+     * Set the emulator window to use for renderer
+     * @param window EmuWindow handle to emulator window to use for rendering
+     */
+    void SetWindow(EmuWindow* window) {}
+
+    /// Initialize the renderer
+    void Init();
+
+    /// Shutdown the renderer
+    void ShutDown();
+
+    /// Returns the work counted since the last report
+    const Stats& stats() const { return stats_; }
+
+private:
+
+    /// Shader interface that generates nothing, the shader manager still builds the headers
+    class ShaderInterface : virtual public ShaderManager::BackendInterface {
+    public:
+        ShaderInterface(RendererNull* parent) : parent_(parent) {}
+        ~ShaderInterface() {}
+
+        ShaderManager::CacheEntry::BackendData* Create(const char* vs_header,
+            const char* fs_header) {
+            parent_->stats_.shaders_created++;
+            return NULL;
+        }
+        ShaderManager::CacheEntry::BackendData* CreateAsync(const char* vs_header,
+            const char* fs_header) {
+            return Create(vs_header, fs_header);
+        }
+        bool IsReady(ShaderManager::CacheEntry::BackendData* backend_data) { return true; }
+        void BindGeneric(const ShaderManager::GenericState& state) {}
+        ShaderManager::CacheEntry::BackendData* CreateFromBinary(const u8* binary, size_t size) {
+            return NULL;
+        }
+        bool GetBinary(const ShaderManager::CacheEntry::BackendData* backend_data,
+            std::vector<u8>& binary) {
+            return false;
+        }
+        std::string GetBinaryTag() { return "null"; }
+        void Delete(ShaderManager::CacheEntry::BackendData* backend_data) {}
+        void Bind(const ShaderManager::CacheEntry::BackendData* backend_data) {}
+
+    private:
+        RendererNull* parent_;
+
+        DISALLOW_COPY_AND_ASSIGN(ShaderInterface);
+    };
+
+    /// Texture interface that uploads nothing, the texture manager still decodes the textures
+    class TextureInterface : virtual public TextureManager::BackendInterface {
+    public:
+        TextureInterface(RendererNull* parent) : parent_(parent) {}
+        ~TextureInterface() {}
+
+        TextureManager::CacheEntry::BackendData* Create(int active_texture_unit,
+            const TextureManager::CacheEntry& cache_entry, u8* raw_data) {
+            parent_->stats_.textures_created++;
+            return NULL;
+        }
+        void Delete(TextureManager::CacheEntry::BackendData* backend_data) {}
+        void CopyEFB(const Rect& src_rect, const Rect& dst_rect,
+            const TextureManager::CacheEntry::BackendData* backend_data) {
+            parent_->stats_.efb_copies++;
+        }
+        void Bind(int active_texture_unit,
+            const TextureManager::CacheEntry::BackendData* backend_data) {}
+        void UpdateParameters(int active_texture_unit, const gp::BPTexMode0& tex_mode_0,
+            const gp::BPTexMode1& tex_mode_1) {}
+
+    private:
+        RendererNull* parent_;
+
+        DISALLOW_COPY_AND_ASSIGN(TextureInterface);
+    };
+
+    /// Logs the work counted since the last report and resets the counters
+    void ReportStats();
+
+    u8*         vbo_;               ///< Vertex storage for one batch
+    Stats       stats_;
+    u32         last_report_ticks_; ///< SDL ticks at the last stats report
+
+    DISALLOW_COPY_AND_ASSIGN(RendererNull);
+};
+
+#endif // VIDEO_CORE_RENDERER_NULL_H_
@@ -0,0 +1,408 @@
+/**
+ * Copyright (C) 2005-2012 Gekko Emulator
+ *
+ * @file    pixel_pipeline.cpp
+ * @author  ShizZy <shizzy247@gmail.com>
+ * @date    2013-02-27
+ * @brief   Per-pixel stages of the software renderer: texturing, TEV, alpha test, Z and blending
+ *
+ * @section LICENSE
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details at
+ * http://www.gnu.org/copyleft/gpl.html
+ *
+ * Official project repository can be found at:
+ * http://code.google.com/p/gekko-gc-emu/
+ */
+
+#include <algorithm>
+#include <cmath>
+
+#include "pixel_pipeline.h"
+
+namespace pixel_pipeline {
+
+/// Texture coordinates are clamped to this many texels before conversion to integer
+static const f32 kMaxTexelCoord = 1048576.0f;
+
+/// Brings a texel coordinate into the texture according to the wrap mode
+static inline int WrapCoord(int coord, int size, int mode) {
+    switch (mode) {
+    case 1: // Repeat
+        coord %= size;
+        return (coord < 0) ? coord + size : coord;
+    case 2: // Mirror
+        coord %= (size * 2);
+        if (coord < 0) {
+            coord += size * 2;
+        }
+        return (coord < size) ? coord : (size * 2 - 1 - coord);
+    default: // Clamp
+        return CLAMP(coord, 0, size - 1);
+    }
+}
+
+/// Converts a normalized texture coordinate to fixed point texels with 8 fractional bits
+static inline int TexelCoord(f32 coord, int size) {
+    f32 texel = coord * size * 256.0f;
+    texel = CLAMP(texel, -kMaxTexelCoord * 256.0f, kMaxTexelCoord * 256.0f);
+    return (int)floorf(texel);
+}
+
+/**
+ * Samples a texture map
+ * @param sampler Texture map to sample
+ * @param coord Normalized texture coordinate
+ * @param out Result texel (RGBA, 0-255)
+ */
+void SampleTexture(const SoftSampler& sampler, const f32* coord, s16* out) {
+    const SoftTexture* texture = sampler.texture;
+
+    if (NULL == texture || texture->width_ <= 0 || texture->height_ <= 0) {
+        out[0] = out[1] = out[2] = out[3] = 255;
+        return;
+    }
+    int width = texture->width_;
+    int height = texture->height_;
+    int s = TexelCoord(coord[0], width);
+    int t = TexelCoord(coord[1], height);
+    const u8* texels = &texture->texels_[0];
+
+    if (!sampler.linear) {
+        const u8* texel = &texels[(WrapCoord(t >> 8, height, sampler.wrap_t) * width +
+            WrapCoord(s >> 8, width, sampler.wrap_s)) * 4];
+        for (int i = 0; i < 4; i++) {
+            out[i] = texel[i];
+        }
+        return;
+    }
+    // Texel centers are at .5, so the four nearest texels are found half a texel back
+    s -= 128;
+    t -= 128;
+    int frac_s = s & 0xFF;
+    int frac_t = t & 0xFF;
+    int s0 = WrapCoord(s >> 8, width, sampler.wrap_s);
+    int s1 = WrapCoord((s >> 8) + 1, width, sampler.wrap_s);
+    int t0 = WrapCoord(t >> 8, height, sampler.wrap_t) * width;
+    int t1 = WrapCoord((t >> 8) + 1, height, sampler.wrap_t) * width;
+
+    const u8* texel00 = &texels[(t0 + s0) * 4];
+    const u8* texel10 = &texels[(t0 + s1) * 4];
+    const u8* texel01 = &texels[(t1 + s0) * 4];
+    const u8* texel11 = &texels[(t1 + s1) * 4];
+    int weight00 = (256 - frac_s) * (256 - frac_t);
+    int weight10 = frac_s * (256 - frac_t);
+    int weight01 = (256 - frac_s) * frac_t;
+    int weight11 = frac_s * frac_t;
+
+    for (int i = 0; i < 4; i++) {
+        out[i] = (s16)((texel00[i] * weight00 + texel10[i] * weight10 + texel01[i] * weight01 +
+            texel11[i] * weight11 + 0x8000) >> 16);
+    }
+}
+
+/// Returns component comp (0-2) of TEV color input sel
+static inline int TevColorInput(int sel, int comp, const s16 regs[4][4], const s16* tex,
+    const s16* ras, const s16* konst) {
+    switch (sel) {
+    case 0: case 2: case 4: case 6:
+        return regs[sel >> 1][comp];
+    case 1: case 3: case 5: case 7:
+        return regs[sel >> 1][3];
+    case 8: return tex[comp];
+    case 9: return tex[3];
+    case 10: return ras[comp];
+    case 11: return ras[3];
+    case 12: return 255;
+    case 13: return 128;
+    case 14: return konst[comp];
+    default: return 0;
+    }
+}
+
+/// Returns TEV alpha input sel
+static inline int TevAlphaInput(int sel, const s16 regs[4][4], const s16* tex, const s16* ras,
+    const s16* konst) {
+    switch (sel) {
+    case 0: case 1: case 2: case 3:
+        return regs[sel][3];
+    case 4: return tex[3];
+    case 5: return ras[3];
+    case 6: return konst[3];
+    default: return 0;
+    }
+}
+
+/**
+ * One TEV operation, d + (a * (1 - c) + b * c) with bias, subtract and scale. The a, b and c
+ * inputs are used as 8-bit values, d with the full 11-bit range of the registers
+ */
+static inline s16 TevCombine(int a, int b, int c, int d, int bias, int sub, int shift,
+    int clamp) {
+    static const int kBias[4] = { 0, 128, -128, 0 };
+    a &= 0xFF;
+    b &= 0xFF;
+    c &= 0xFF;
+    c += c >> 7;
+
+    int lerp = ((a << 8) + (b - a) * c + 128) >> 8;
+    int result = d + (sub ? -lerp : lerp) + kBias[bias];
+
+    switch (shift) {
+    case 1: result *= 2; break;
+    case 2: result *= 4; break;
+    case 3: result >>= 1; break;
+    }
+    return clamp ? (s16)CLAMP(result, 0, 255) : (s16)CLAMP(result, -1024, 1023);
+}
+
+/// Alpha compare function
+static inline bool AlphaCompare(int comp, int val, int ref) {
+    switch (comp) {
+    case 0: return false;
+    case 1: return val < ref;
+    case 2: return val == ref;
+    case 3: return val <= ref;
+    case 4: return val > ref;
+    case 5: return val != ref;
+    case 6: return val >= ref;
+    default: return true;
+    }
+}
+
+/// Z compare function
+static inline bool DepthCompare(int func, u32 z, u32 dst) {
+    switch (func) {
+    case 0: return false;
+    case 1: return z < dst;
+    case 2: return z == dst;
+    case 3: return z <= dst;
+    case 4: return z > dst;
+    case 5: return z != dst;
+    case 6: return z >= dst;
+    default: return true;
+    }
+}
+
+/// Z test and update, returns false if the fragment is rejected
+static inline bool DepthTest(const gp::BPPEZMode& zmode, u32 z, u32* depth) {
+    if (!zmode.test_enable) {
+        return true;
+    }
+    if (!DepthCompare(zmode.function, z, *depth)) {
+        return false;
+    }
+    if (zmode.update_enable) {
+        *depth = z;
+    }
+    return true;
+}
+
+/**
+ * Gets a blend factor (0-255)
+ * @param factor Blend factor of BPPECMode0 (GX_BL_SRCCLR is GX_BL_DSTCLR as source factor)
+ * @param is_src True for the source factor
+ * @param src Source color
+ * @param dst Destination color
+ * @param comp Component the factor is for
+ * @param efb_alpha True if the EFB has an alpha channel
+ */
+static inline int BlendFactor(int factor, bool is_src, const int* src, const int* dst, int comp,
+    bool efb_alpha) {
+    switch (factor) {
+    case GX_BL_ZERO:        return 0;
+    case GX_BL_ONE:         return 255;
+    case GX_BL_SRCCLR:      return is_src ? dst[comp] : src[comp];
+    case GX_BL_INVSRCCLR:   return 255 - (is_src ? dst[comp] : src[comp]);
+    case GX_BL_SRCALPHA:    return src[3];
+    case GX_BL_INVSRCALPHA: return 255 - src[3];
+    case GX_BL_DSTALPHA:    return efb_alpha ? dst[3] : 255;
+    default:                return efb_alpha ? 255 - dst[3] : 0;
+    }
+}
+
+/// Logic operation on one 8-bit component
+static inline int LogicOp(int op, int src, int dst) {
+    switch (op) {
+    case 0:  return 0;
+    case 1:  return src & dst;
+    case 2:  return src & ~dst;
+    case 3:  return src;
+    case 4:  return ~src & dst;
+    case 5:  return dst;
+    case 6:  return src ^ dst;
+    case 7:  return src | dst;
+    case 8:  return ~(src | dst);
+    case 9:  return ~(src ^ dst);
+    case 10: return ~dst;
+    case 11: return src | ~dst;
+    case 12: return ~src;
+    case 13: return ~src | dst;
+    case 14: return ~(src & dst);
+    default: return 0xFF;
+    }
+}
+
+/// Quantizes a color to the EFB pixel format, stored back in 8-bit components
+static inline void EFBFormat(int format, int* color) {
+    switch (format) {
+    case gp::kPixelFormat_RGBA6_Z24:
+        for (int i = 0; i < 4; i++) {
+            color[i] = (color[i] & 0xFC) | (color[i] >> 6);
+        }
+        break;
+    case gp::kPixelFormat_RGB565_Z16:
+        color[0] = (color[0] & 0xF8) | (color[0] >> 5);
+        color[1] = (color[1] & 0xFC) | (color[1] >> 6);
+        color[2] = (color[2] & 0xF8) | (color[2] >> 5);
+        color[3] = 0xFF;
+        break;
+    default:
+        color[3] = 0xFF;
+        break;
+    }
+}
+
+/**
+ * Runs a fragment through TEV, alpha test, Z test and blending and writes it to the EFB. Only
+ * reads the draw state, so any number of tiles may be shaded at once
+ * @param state Draw the fragment belongs to
+ * @param fragment Interpolated fragment
+ * @param color EFB color of the pixel (RGBA8)
+ * @param depth EFB depth of the pixel (24-bit)
+ */
+void ShadeFragment(const SoftDrawState& state, const SoftFragment& fragment, u8* color,
+    u32* depth) {
+    static const s16 kZero[4] = { 0, 0, 0, 0 };
+    const ShaderManager::GenericState& generic = state.generic;
+    bool early_z = (state.zcontrol.z_comploc != 0);
+
+    if (early_z && !DepthTest(state.zmode, fragment.depth, depth)) {
+        return;
+    }
+
+    // TEV
+    // ---
+
+    s16 regs[4][4];
+    memcpy(regs, state.registers, sizeof(regs));
+
+    for (int stage = 0; stage <= generic.fragment[0]; stage++) {
+        const ShaderManager::GenericState::Stage& gen = generic.stages[stage];
+        const gp::BPTevCombiner& combiner = state.combiner[stage];
+        const s16* konst = state.konst[stage];
+        s16 tex[4] = { 255, 255, 255, 255 };
+        const s16* ras;
+
+        if (gen.texture[0] >= 0) {
+            const f32* texcoord = fragment.texcoords[gen.texture[1] & 7];
+            SampleTexture(state.samplers[gen.texture[0] & 7], texcoord, tex);
+        }
+        switch (gen.texture[2]) {
+        case 1: ras = fragment.colors[1]; break;
+        case 7: ras = kZero; break;
+        default: ras = fragment.colors[0]; break;
+        }
+
+        // Inputs are all read before the results of the stage are written
+        s16 result[4];
+        for (int comp = 0; comp < 3; comp++) {
+            result[comp] = TevCombine(
+                TevColorInput(gen.color_sel[0], comp, regs, tex, ras, konst),
+                TevColorInput(gen.color_sel[1], comp, regs, tex, ras, konst),
+                TevColorInput(gen.color_sel[2], comp, regs, tex, ras, konst),
+                TevColorInput(gen.color_sel[3], comp, regs, tex, ras, konst),
+                combiner.color.bias, combiner.color.sub, combiner.color.shift, gen.dest[2]);
+        }
+        result[3] = TevCombine(
+            TevAlphaInput(gen.alpha_sel[0], regs, tex, ras, konst),
+            TevAlphaInput(gen.alpha_sel[1], regs, tex, ras, konst),
+            TevAlphaInput(gen.alpha_sel[2], regs, tex, ras, konst),
+            TevAlphaInput(gen.alpha_sel[3], regs, tex, ras, konst),
+            combiner.alpha.bias, combiner.alpha.sub, combiner.alpha.shift, gen.dest[3]);
+
+        regs[gen.dest[0]][0] = result[0];
+        regs[gen.dest[0]][1] = result[1];
+        regs[gen.dest[0]][2] = result[2];
+        regs[gen.dest[1]][3] = result[3];
+    }
+
+    // The final result wraps to 8 bits
+    int src[4];
+    src[0] = regs[generic.output[2]][0] & 0xFF;
+    src[1] = regs[generic.output[2]][1] & 0xFF;
+    src[2] = regs[generic.output[2]][2] & 0xFF;
+    src[3] = regs[generic.output[3]][3] & 0xFF;
+
+    // Alpha test
+    // ----------
+
+    bool pass0 = AlphaCompare(generic.fragment[1], src[3], state.alpha_func.ref0);
+    bool pass1 = AlphaCompare(generic.fragment[2], src[3], state.alpha_func.ref1);
+    bool pass;
+
+    switch (generic.fragment[3]) {
+    case 0: pass = pass0 && pass1; break;
+    case 1: pass = pass0 || pass1; break;
+    case 2: pass = pass0 != pass1; break;
+    default: pass = pass0 == pass1; break;
+    }
+    if (!pass) {
+        return;
+    }
+    if (!early_z && !DepthTest(state.zmode, fragment.depth, depth)) {
+        return;
+    }
+
+    // Blending
+    // --------
+
+    const gp::BPPECMode0& cmode0 = state.cmode0;
+    bool efb_alpha = state.zcontrol.is_efb_alpha_enabled();
+    int dst[4] = { color[0], color[1], color[2], color[3] };
+    int out[4];
+
+    if (cmode0.blend_enable || cmode0.subtract) {
+        for (int comp = 0; comp < 4; comp++) {
+            if (cmode0.subtract) {
+                out[comp] = std::max(dst[comp] - src[comp], 0);
+                continue;
+            }
+            int src_factor = BlendFactor(cmode0.src_factor, true, src, dst, comp, efb_alpha);
+            int dst_factor = BlendFactor(cmode0.dst_factor, false, src, dst, comp, efb_alpha);
+            src_factor += src_factor >> 7;
+            dst_factor += dst_factor >> 7;
+            out[comp] = std::min((src[comp] * src_factor + dst[comp] * dst_factor + 128) >> 8,
+                255);
+        }
+    } else if (cmode0.logicop_enable) {
+        for (int comp = 0; comp < 4; comp++) {
+            out[comp] = LogicOp(cmode0.logic_mode, src[comp], dst[comp]) & 0xFF;
+        }
+    } else {
+        memcpy(out, src, sizeof(out));
+    }
+    // Destination alpha replaces the alpha written, it doesn't take part in blending
+    if (generic.output[1]) {
+        out[3] = state.cmode1.alpha;
+    }
+    EFBFormat(generic.output[0], out);
+
+    if (cmode0.color_update) {
+        color[0] = (u8)out[0];
+        color[1] = (u8)out[1];
+        color[2] = (u8)out[2];
+    }
+    if (cmode0.alpha_update || !efb_alpha) {
+        color[3] = (u8)out[3];
+    }
+}
+
+} // namespace
@@ -0,0 +1,114 @@
+/**
+ * Copyright (C) 2005-2012 Gekko Emulator
+ *
+ * @file    pixel_pipeline.h
+ * @author  ShizZy <shizzy247@gmail.com>
+ * @date    2013-02-27
+ * @brief   Per-pixel stages of the software renderer: texturing, TEV, alpha test, Z and blending
+ *
+ * @section LICENSE
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details at
+ * http://www.gnu.org/copyleft/gpl.html
+ *
+ * Official project repository can be found at:
+ * http://code.google.com/p/gekko-gc-emu/
+ */
+
+#ifndef VIDEO_CORE_RENDERER_SOFT_PIXEL_PIPELINE_H_
+#define VIDEO_CORE_RENDERER_SOFT_PIXEL_PIPELINE_H_
+
+#include <vector>
+
+#include "common.h"
+#include "gx_types.h"
+#include "bp_mem.h"
+#include "shader_manager.h"
+#include "texture_manager.h"
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Software renderer pixel pipeline
+
+/// Texture of the software renderer, decoded to RGBA8 in RAM
+class SoftTexture : public TextureManager::CacheEntry::BackendData {
+public:
+    SoftTexture(int width, int height) : width_(width), height_(height),
+        texels_(width * height * 4, 0xFF) {
+        is_depth_copy_ = false;
+        is_intensity_copy_ = false;
+    }
+    ~SoftTexture() {}
+
+    int             width_;
+    int             height_;
+    bool            is_depth_copy_;     ///< EFB copy of the Z buffer
+    bool            is_intensity_copy_; ///< EFB copy converted to intensity (I4, I8, IA4, IA8)
+    std::vector<u8> texels_;            ///< RGBA8 texels, top row first
+};
+
+/// Texture map state a draw samples with
+struct SoftSampler {
+    const SoftTexture*  texture;    ///< Bound texture, NULL if none
+    u8                  wrap_s;     ///< 0 - clamp, 1 - repeat, 2 - mirror
+    u8                  wrap_t;
+    u8                  linear;     ///< Bilinear filtering (magnification filter)
+    u8                  pad;
+};
+
+/**
+ * Everything the pixel stages read, captured when a draw is submitted. Tiles are rasterized long
+ * after the registers have moved on, so nothing may be read from the GP registers directly
+ */
+struct SoftDrawState {
+    ShaderManager::GenericState generic;            ///< TEV stage, alpha compare and output setup
+    gp::BPTevCombiner   combiner[kGCMaxTevStages];  ///< Bias, subtract, shift of each stage
+    s16                 konst[kGCMaxTevStages][4];  ///< Konst color selected by each stage (RGBA)
+    s16                 registers[4][4];            ///< TEV PREV, REG0, REG1, REG2 (RGBA)
+    gp::BPAlphaFunc     alpha_func;
+    gp::BPPEZMode       zmode;
+    gp::BPPECMode0      cmode0;
+    gp::BPPECMode1      cmode1;
+    gp::BPPEControl     zcontrol;
+    SoftSampler         samplers[kGCMaxTextureMaps];
+    Rect                scissor;                    ///< Scissor box in EFB pixels, x1/y1 exclusive
+    int                 num_texcoords;              ///< Texture coordinates to interpolate (1-8)
+};
+
+/// Values interpolated at a pixel center
+struct SoftFragment {
+    u32 depth;                                  ///< 24-bit depth
+    s16 colors[kGCMaxVertexColors][4];          ///< Rasterized color channels (RGBA, 0-255)
+    f32 texcoords[kGCMaxActiveTextures][2];     ///< Normalized texture coordinates
+};
+
+namespace pixel_pipeline {
+
+/**
+ * Runs a fragment through TEV, alpha test, Z test and blending and writes it to the EFB. Only
+ * reads the draw state, so any number of tiles may be shaded at once
+ * @param state Draw the fragment belongs to
+ * @param fragment Interpolated fragment
+ * @param color EFB color of the pixel (RGBA8)
+ * @param depth EFB depth of the pixel (24-bit)
+ */
+void ShadeFragment(const SoftDrawState& state, const SoftFragment& fragment, u8* color,
+    u32* depth);
+
+/**
+ * Samples a texture map
+ * @param sampler Texture map to sample
+ * @param coord Normalized texture coordinate
+ * @param out Result texel (RGBA, 0-255)
+ */
+void SampleTexture(const SoftSampler& sampler, const f32* coord, s16* out);
+
+} // namespace
+
+#endif // VIDEO_CORE_RENDERER_SOFT_PIXEL_PIPELINE_H_
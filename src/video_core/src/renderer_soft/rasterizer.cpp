@@ -0,0 +1,443 @@
+/**
+ * Copyright (C) 2005-2012 Gekko Emulator
+ *
+ * @file    rasterizer.cpp
+ * @author  ShizZy <shizzy247@gmail.com>
+ * @date    2013-02-27
+ * @brief   Tile binning triangle rasterizer of the software renderer
+ *
+ * @section LICENSE
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details at
+ * http://www.gnu.org/copyleft/gpl.html
+ *
+ * Official project repository can be found at:
+ * http://code.google.com/p/gekko-gc-emu/
+ */
+
+#include <algorithm>
+#include <cmath>
+
+#include "rasterizer.h"
+
+#if defined(EMU_ARCHITECTURE_X64) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define RASTERIZER_SSE2
+#include <emmintrin.h>
+#endif
+
+/// Half a pixel in subpixel units, pixels are sampled at their centers
+static const int kHalfPixel = 1 << (Rasterizer::kSubpixelBits - 1);
+
+Rasterizer::Rasterizer(int num_threads) {
+    efb_color_.resize(kGCEFBWidth * kGCEFBHeight * 4, 0);
+    efb_depth_.resize(kGCEFBWidth * kGCEFBHeight, 0);
+    triangles_.resize(kMaxTriangles);
+    num_triangles_ = 0;
+
+    // There always is a current draw state
+    draw_states_.push_back(new SoftDrawState());
+    num_draw_states_ = 1;
+
+    mutex_ = SDL_CreateMutex();
+    work_cond_ = SDL_CreateCond();
+    done_cond_ = SDL_CreateCond();
+    flush_count_ = 0;
+    num_active_tiles_ = 0;
+    next_tile_ = 0;
+    tiles_done_ = 0;
+    quit_ = false;
+
+    for (int i = 1; i < num_threads; i++) {
+        SDL_Thread* thread = SDL_CreateThread(WorkerEntry, "Rasterizer", this);
+        if (thread == NULL) {
+            LOG_ERROR(TVIDEO, "Unable to create rasterizer thread: %s", SDL_GetError());
+            break;
+        }
+        workers_.push_back(thread);
+    }
+}
+
+Rasterizer::~Rasterizer() {
+    SDL_LockMutex(mutex_);
+    quit_ = true;
+    SDL_CondBroadcast(work_cond_);
+    SDL_UnlockMutex(mutex_);
+
+    for (size_t i = 0; i < workers_.size(); i++) {
+        SDL_WaitThread(workers_[i], NULL);
+    }
+    SDL_DestroyCond(done_cond_);
+    SDL_DestroyCond(work_cond_);
+    SDL_DestroyMutex(mutex_);
+
+    for (size_t i = 0; i < draw_states_.size(); i++) {
+        delete draw_states_[i];
+    }
+}
+
+/// Returns the number of drawing threads to use on this machine, one core is left to the CPU
+int Rasterizer::DefaultThreadCount() {
+    return std::max(SDL_GetCPUCount() - 1, 1);
+}
+
+/// Sets the draw state of the triangles that follow
+void Rasterizer::SetDrawState(const SoftDrawState& state) {
+    if (0 == memcmp(draw_states_[num_draw_states_ - 1], &state, sizeof(SoftDrawState))) {
+        return;
+    }
+    if (num_draw_states_ == kMaxDrawStates) {
+        Flush();
+    }
+    if (num_draw_states_ == (int)draw_states_.size()) {
+        draw_states_.push_back(new SoftDrawState);
+    }
+    *draw_states_[num_draw_states_++] = state;
+}
+
+/// Sets up the plane of an attribute from its values at the three vertices
+void Rasterizer::SetupPlane(Plane& plane, const f32* x, const f32* y, f32 inv_area, f32 v0, f32 v1,
+    f32 v2) {
+    f32 d1 = v1 - v0;
+    f32 d2 = v2 - v0;
+    plane.a = (d1 * (y[2] - y[0]) - d2 * (y[1] - y[0])) * inv_area;
+    plane.b = (d2 * (x[1] - x[0]) - d1 * (x[2] - x[0])) * inv_area;
+    plane.c = v0 - plane.a * x[0] - plane.b * y[0];
+}
+
+/// Sets up a triangle and bins it
+void Rasterizer::DrawTriangle(const SoftVertex& v0, const SoftVertex& v1, const SoftVertex& v2) {
+    const SoftVertex* v[3] = { &v0, &v1, &v2 };
+    s32 x[3];
+    s32 y[3];
+
+    // Snap to the subpixel grid, garbage positions (including NaN) are dropped
+    for (int i = 0; i < 3; i++) {
+        if (!(fabsf(v[i]->x) <= kMaxCoord && fabsf(v[i]->y) <= kMaxCoord)) {
+            return;
+        }
+        x[i] = (s32)floorf(v[i]->x * (1 << kSubpixelBits) + 0.5f);
+        y[i] = (s32)floorf(v[i]->y * (1 << kSubpixelBits) + 0.5f);
+    }
+    s64 area = (s64)(x[1] - x[0]) * (y[2] - y[0]) - (s64)(x[2] - x[0]) * (y[1] - y[0]);
+    if (0 == area) {
+        return;
+    }
+    // Wind the triangle so the inside of all edges is positive
+    if (area < 0) {
+        std::swap(v[1], v[2]);
+        std::swap(x[1], x[2]);
+        std::swap(y[1], y[2]);
+        area = -area;
+    }
+    if (num_triangles_ == kMaxTriangles) {
+        Flush();
+    }
+    const SoftDrawState* state = draw_states_[num_draw_states_ - 1];
+    Triangle& triangle = triangles_[num_triangles_];
+
+    // Bounding box of the pixel centers that may be covered, within the scissor box
+    const int kPixel = 1 << kSubpixelBits;
+    triangle.min_x = (std::min(x[0], std::min(x[1], x[2])) - kHalfPixel + kPixel - 1) >>
+        kSubpixelBits;
+    triangle.min_y = (std::min(y[0], std::min(y[1], y[2])) - kHalfPixel + kPixel - 1) >>
+        kSubpixelBits;
+    triangle.max_x = (std::max(x[0], std::max(x[1], x[2])) - kHalfPixel) >> kSubpixelBits;
+    triangle.max_y = (std::max(y[0], std::max(y[1], y[2])) - kHalfPixel) >> kSubpixelBits;
+    triangle.min_x = std::max(triangle.min_x, std::max(state->scissor.x0_, 0));
+    triangle.min_y = std::max(triangle.min_y, std::max(state->scissor.y0_, 0));
+    triangle.max_x = std::min(triangle.max_x, std::min(state->scissor.x1_, kGCEFBWidth) - 1);
+    triangle.max_y = std::min(triangle.max_y, std::min(state->scissor.y1_, kGCEFBHeight) - 1);
+    if (triangle.min_x > triangle.max_x || triangle.min_y > triangle.max_y) {
+        return;
+    }
+    triangle.state = state;
+
+    // Edge functions, evaluated at pixel centers. Pixels exactly on an edge only belong to the
+    // triangle if it's a top or a left edge, other edges are biased to exclude them
+    for (int i = 0; i < 3; i++) {
+        int j = (i + 1) % 3;
+        s32 a = y[i] - y[j];
+        s32 b = x[j] - x[i];
+        s64 c = (s64)x[i] * y[j] - (s64)x[j] * y[i];
+        bool top_left = (a > 0) || (a == 0 && b > 0);
+
+        triangle.edge_a[i] = a * kPixel;
+        triangle.edge_b[i] = b * kPixel;
+        triangle.edge_c[i] = (s32)(c + (s64)(a + b) * kHalfPixel - (top_left ? 0 : 1));
+    }
+
+    // Attribute planes, in pixels with the snapped positions
+    f32 fx[3];
+    f32 fy[3];
+    for (int i = 0; i < 3; i++) {
+        fx[i] = (f32)x[i] / kPixel;
+        fy[i] = (f32)y[i] / kPixel;
+    }
+    f32 inv_area = (f32)(kPixel * kPixel) / (f32)area;
+
+    SetupPlane(triangle.z, fx, fy, inv_area, v[0]->z, v[1]->z, v[2]->z);
+    SetupPlane(triangle.inv_w, fx, fy, inv_area, v[0]->inv_w, v[1]->inv_w, v[2]->inv_w);
+    for (int i = 0; i < kGCMaxVertexColors; i++) {
+        for (int comp = 0; comp < 4; comp++) {
+            SetupPlane(triangle.colors[i][comp], fx, fy, inv_area,
+                v[0]->colors[i][comp] * v[0]->inv_w, v[1]->colors[i][comp] * v[1]->inv_w,
+                v[2]->colors[i][comp] * v[2]->inv_w);
+        }
+    }
+    for (int i = 0; i < state->num_texcoords; i++) {
+        for (int comp = 0; comp < 2; comp++) {
+            SetupPlane(triangle.texcoords[i][comp], fx, fy, inv_area,
+                v[0]->texcoords[i][comp] * v[0]->inv_w, v[1]->texcoords[i][comp] * v[1]->inv_w,
+                v[2]->texcoords[i][comp] * v[2]->inv_w);
+        }
+    }
+    BinTriangle(num_triangles_++);
+}
+
+/// Bins a triangle into the tiles its edges touch
+void Rasterizer::BinTriangle(u32 index) {
+    const Triangle& triangle = triangles_[index];
+
+    for (int tile_y = triangle.min_y / kTileSize; tile_y <= triangle.max_y / kTileSize; tile_y++) {
+        for (int tile_x = triangle.min_x / kTileSize; tile_x <= triangle.max_x / kTileSize;
+            tile_x++) {
+            int x0 = tile_x * kTileSize;
+            int y0 = tile_y * kTileSize;
+            bool outside = false;
+
+            // The tile is skipped if its corner furthest inside an edge is still outside of it
+            for (int i = 0; i < 3 && !outside; i++) {
+                int x = (triangle.edge_a[i] > 0) ? x0 + kTileSize - 1 : x0;
+                int y = (triangle.edge_b[i] > 0) ? y0 + kTileSize - 1 : y0;
+                outside = (triangle.edge_c[i] + triangle.edge_a[i] * x +
+                    triangle.edge_b[i] * y) < 0;
+            }
+            if (!outside) {
+                bins_[tile_y * kTilesX + tile_x].push_back(index);
+            }
+        }
+    }
+}
+
+/// Draws everything binned so far
+void Rasterizer::Flush() {
+    if (0 == num_triangles_) {
+        return;
+    }
+    active_tiles_.clear();
+    for (int tile = 0; tile < kNumTiles; tile++) {
+        if (!bins_[tile].empty()) {
+            active_tiles_.push_back(tile);
+        }
+    }
+
+    SDL_LockMutex(mutex_);
+    num_active_tiles_ = (int)active_tiles_.size();
+    next_tile_ = 0;
+    tiles_done_ = 0;
+    flush_count_++;
+    SDL_CondBroadcast(work_cond_);
+    SDL_UnlockMutex(mutex_);
+
+    // This thread draws tiles as well, then waits for the workers to finish theirs
+    DrawTiles();
+
+    SDL_LockMutex(mutex_);
+    while (tiles_done_ < num_active_tiles_) {
+        SDL_CondWait(done_cond_, mutex_);
+    }
+    num_active_tiles_ = 0;
+    SDL_UnlockMutex(mutex_);
+
+    for (size_t i = 0; i < active_tiles_.size(); i++) {
+        bins_[active_tiles_[i]].clear();
+    }
+    num_triangles_ = 0;
+
+    // Keep the current draw state for the triangles that follow
+    std::swap(draw_states_[0], draw_states_[num_draw_states_ - 1]);
+    num_draw_states_ = 1;
+}
+
+/// Entry point of the worker threads
+int Rasterizer::WorkerEntry(void* data) {
+    static_cast<Rasterizer*>(data)->Run();
+    return 0;
+}
+
+/// Worker thread loop
+void Rasterizer::Run() {
+    SDL_LockMutex(mutex_);
+    u32 flush_count = flush_count_;
+
+    while (!quit_) {
+        if (flush_count == flush_count_) {
+            SDL_CondWait(work_cond_, mutex_);
+            continue;
+        }
+        flush_count = flush_count_;
+        SDL_UnlockMutex(mutex_);
+        DrawTiles();
+        SDL_LockMutex(mutex_);
+    }
+    SDL_UnlockMutex(mutex_);
+}
+
+/// Draws tiles until all tiles of the current flush are taken
+void Rasterizer::DrawTiles() {
+    SDL_LockMutex(mutex_);
+    while (next_tile_ < num_active_tiles_) {
+        int tile = active_tiles_[next_tile_++];
+        SDL_UnlockMutex(mutex_);
+
+        DrawTile(tile);
+
+        SDL_LockMutex(mutex_);
+        if (++tiles_done_ == num_active_tiles_) {
+            SDL_CondSignal(done_cond_);
+        }
+    }
+    SDL_UnlockMutex(mutex_);
+}
+
+/// Draws all triangles binned into a tile
+void Rasterizer::DrawTile(int tile) {
+    const std::vector<u32>& bin = bins_[tile];
+    int x0 = (tile % kTilesX) * kTileSize;
+    int y0 = (tile / kTilesX) * kTileSize;
+    int x1 = std::min(x0 + kTileSize, kGCEFBWidth) - 1;
+    int y1 = std::min(y0 + kTileSize, kGCEFBHeight) - 1;
+
+    for (size_t i = 0; i < bin.size(); i++) {
+        DrawTriangleRect(triangles_[bin[i]], x0, y0, x1, y1);
+    }
+}
+
+/// Draws the part of a triangle that falls in a rectangle
+void Rasterizer::DrawTriangleRect(const Triangle& triangle, int x0, int y0, int x1, int y1) {
+    x0 = std::max(x0, triangle.min_x);
+    y0 = std::max(y0, triangle.min_y);
+    x1 = std::min(x1, triangle.max_x);
+    y1 = std::min(y1, triangle.max_y);
+    if (x0 > x1 || y0 > y1) {
+        return;
+    }
+    s32 row[3];
+    for (int i = 0; i < 3; i++) {
+        row[i] = triangle.edge_c[i] + triangle.edge_a[i] * x0 + triangle.edge_b[i] * y0;
+    }
+
+#ifdef RASTERIZER_SSE2
+    // Edge functions of four neighboring pixels, a pixel is covered if none of them is negative
+    __m128i offset[3];
+    __m128i step[3];
+    for (int i = 0; i < 3; i++) {
+        s32 a = triangle.edge_a[i];
+        offset[i] = _mm_setr_epi32(0, a, a * 2, a * 3);
+        step[i] = _mm_set1_epi32(a * 4);
+    }
+    for (int y = y0; y <= y1; y++) {
+        __m128i edge0 = _mm_add_epi32(_mm_set1_epi32(row[0]), offset[0]);
+        __m128i edge1 = _mm_add_epi32(_mm_set1_epi32(row[1]), offset[1]);
+        __m128i edge2 = _mm_add_epi32(_mm_set1_epi32(row[2]), offset[2]);
+
+        for (int x = x0; x <= x1; x += 4) {
+            __m128i sign = _mm_or_si128(_mm_or_si128(edge0, edge1), edge2);
+            int mask = ~_mm_movemask_ps(_mm_castsi128_ps(sign)) & 0xF;
+
+            if (x1 - x < 3) {
+                mask &= (1 << (x1 - x + 1)) - 1;
+            }
+            for (int i = 0; mask; i++, mask >>= 1) {
+                if (mask & 1) {
+                    ShadePixel(triangle, x + i, y);
+                }
+            }
+            edge0 = _mm_add_epi32(edge0, step[0]);
+            edge1 = _mm_add_epi32(edge1, step[1]);
+            edge2 = _mm_add_epi32(edge2, step[2]);
+        }
+        for (int i = 0; i < 3; i++) {
+            row[i] += triangle.edge_b[i];
+        }
+    }
+#else
+    for (int y = y0; y <= y1; y++) {
+        s32 edge0 = row[0];
+        s32 edge1 = row[1];
+        s32 edge2 = row[2];
+
+        for (int x = x0; x <= x1; x++) {
+            if ((edge0 | edge1 | edge2) >= 0) {
+                ShadePixel(triangle, x, y);
+            }
+            edge0 += triangle.edge_a[0];
+            edge1 += triangle.edge_a[1];
+            edge2 += triangle.edge_a[2];
+        }
+        for (int i = 0; i < 3; i++) {
+            row[i] += triangle.edge_b[i];
+        }
+    }
+#endif
+}
+
+/// Interpolates the attributes of a pixel and runs it through the pixel pipeline
+void Rasterizer::ShadePixel(const Triangle& triangle, int x, int y) {
+    SoftFragment fragment;
+    f32 fx = x + 0.5f;
+    f32 fy = y + 0.5f;
+
+    f32 z = CLAMP(triangle.z.Get(fx, fy), 0.0f, 16777215.0f);
+    fragment.depth = std::min((u32)(z + 0.5f), 0xFFFFFFu);
+
+    f32 w = 1.0f / triangle.inv_w.Get(fx, fy);
+    for (int i = 0; i < kGCMaxVertexColors; i++) {
+        for (int comp = 0; comp < 4; comp++) {
+            f32 value = CLAMP(triangle.colors[i][comp].Get(fx, fy) * w, 0.0f, 255.0f);
+            fragment.colors[i][comp] = (s16)(value + 0.5f);
+        }
+    }
+    for (int i = 0; i < triangle.state->num_texcoords; i++) {
+        fragment.texcoords[i][0] = triangle.texcoords[i][0].Get(fx, fy) * w;
+        fragment.texcoords[i][1] = triangle.texcoords[i][1].Get(fx, fy) * w;
+    }
+
+    int offset = y * kGCEFBWidth + x;
+    pixel_pipeline::ShadeFragment(*triangle.state, fragment, &efb_color_[offset * 4],
+        &efb_depth_[offset]);
+}
+
+/// Fills a rectangle of the EFB
+void Rasterizer::Clear(const Rect& rect, bool enable_color, bool enable_alpha, bool enable_z,
+    u32 color, u32 z) {
+    Flush();
+
+    int x0 = std::max(rect.x0_, 0);
+    int y0 = std::max(rect.y0_, 0);
+    int x1 = std::min(rect.x1_, kGCEFBWidth);
+    int y1 = std::min(rect.y1_, kGCEFBHeight);
+    u8 rgba[4] = { (u8)(color >> 16), (u8)(color >> 8), (u8)color, (u8)(color >> 24) };
+
+    for (int y = y0; y < y1; y++) {
+        for (int x = x0; x < x1; x++) {
+            int offset = y * kGCEFBWidth + x;
+            if (enable_color) {
+                memcpy(&efb_color_[offset * 4], rgba, 3);
+            }
+            if (enable_alpha) {
+                efb_color_[offset * 4 + 3] = rgba[3];
+            }
+            if (enable_z) {
+                efb_depth_[offset] = z & 0xFFFFFF;
+            }
+        }
+    }
+}
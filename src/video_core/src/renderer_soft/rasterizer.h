@@ -0,0 +1,224 @@
+/**
+ * Copyright (C) 2005-2012 Gekko Emulator
+ *
+ * @file    rasterizer.h
+ * @author  ShizZy <shizzy247@gmail.com>
+ * @date    2013-02-27
+ * @brief   Tile binning triangle rasterizer of the software renderer
+ *
+ * @section LICENSE
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details at
+ * http://www.gnu.org/copyleft/gpl.html
+ *
+ * Official project repository can be found at:
+ * http://code.google.com/p/gekko-gc-emu/
+ */
+
+#ifndef VIDEO_CORE_RENDERER_SOFT_RASTERIZER_H_
+#define VIDEO_CORE_RENDERER_SOFT_RASTERIZER_H_
+
+#include <vector>
+
+#include "SDL.h"
+
+#include "common.h"
+#include "gx_types.h"
+
+#include "pixel_pipeline.h"
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Software rasterizer
+
+/// Vertex as it enters the rasterizer, after clipping and the viewport transform
+struct SoftVertex {
+    f32 x;                                      ///< EFB position in pixels
+    f32 y;
+    f32 z;                                      ///< 24-bit depth
+    f32 inv_w;                                  ///< 1/w, for perspective correct interpolation
+    f32 colors[kGCMaxVertexColors][4];          ///< Color channels (RGBA, 0-255)
+    f32 texcoords[kGCMaxActiveTextures][2];     ///< Texture coordinates
+};
+
+/**
+ * @brief Rasterizes triangles into the EFB, held in RAM. Triangles are not drawn when they are
+ * submitted but set up and binned into the screen tiles they touch. On a flush the tiles are handed
+ * out to a pool of worker threads, each tile is drawn by one thread, its triangles in submission
+ * order, so the result doesn't depend on the number of threads or on their timing. Coverage is
+ * found with edge functions in fixed point (4 bits of subpixel precision, top-left fill rule), four
+ * pixels at a time.
+ */
+class Rasterizer {
+public:
+    static const int kTileSize      = 32;       ///< Width and height of a tile in pixels
+    static const int kTilesX        = (kGCEFBWidth + kTileSize - 1) / kTileSize;
+    static const int kTilesY        = (kGCEFBHeight + kTileSize - 1) / kTileSize;
+    static const int kNumTiles      = kTilesX * kTilesY;
+    static const int kMaxTriangles  = 0x4000;   ///< Triangles binned before they are drawn
+    static const int kMaxDrawStates = 0x400;    ///< Draw states captured before they are drawn
+    static const int kSubpixelBits  = 4;        ///< Fractional bits of the vertex positions
+
+    /**
+     * Maximum distance of a vertex from the EFB origin in pixels. Clipping keeps the vertices near
+     * the EFB, anything past this is dropped so the edge functions can't overflow
+     */
+    static const int kMaxCoord      = 1024;
+
+    /**
+     * Create the rasterizer and start its workers
+     * @param num_threads Number of threads drawing tiles, the thread that flushes counts as one
+     */
+    Rasterizer(int num_threads);
+    ~Rasterizer();
+
+    /// Returns the number of drawing threads to use on this machine
+    static int DefaultThreadCount();
+
+    /**
+     * Sets the draw state of the triangles that follow
+     * @param state Draw state, copied
+     */
+    void SetDrawState(const SoftDrawState& state);
+
+    /**
+     * Sets up a triangle and bins it, culling is up to the caller
+     * @param v0 First vertex
+     * @param v1 Second vertex
+     * @param v2 Third vertex
+     */
+    void DrawTriangle(const SoftVertex& v0, const SoftVertex& v1, const SoftVertex& v2);
+
+    /// Draws everything binned so far, returns once the EFB is up to date
+    void Flush();
+
+    /**
+     * Fills a rectangle of the EFB, flushes first
+     * @param rect EFB rectangle, x1/y1 exclusive
+     * @param enable_color Write color
+     * @param enable_alpha Write alpha
+     * @param enable_z Write depth
+     * @param color Color (ARGB8)
+     * @param z Depth (24-bit)
+     */
+    void Clear(const Rect& rect, bool enable_color, bool enable_alpha, bool enable_z, u32 color,
+        u32 z);
+
+    /// Returns the EFB color buffer (RGBA8, top row first), only valid after a flush
+    const u8* efb_color() const { return &efb_color_[0]; }
+
+    /// Returns the EFB depth buffer (24-bit, top row first), only valid after a flush
+    const u32* efb_depth() const { return &efb_depth_[0]; }
+
+    /// Returns the number of threads drawing tiles
+    int num_threads() const { return (int)workers_.size() + 1; }
+
+private:
+
+    /// Plane of an attribute over the screen, value = a * x + b * y + c
+    struct Plane {
+        f32 a;
+        f32 b;
+        f32 c;
+
+        inline f32 Get(f32 x, f32 y) const { return a * x + b * y + c; }
+    };
+
+    /// Triangle after setup
+    struct Triangle {
+        const SoftDrawState* state;
+        int     min_x;          ///< Bounding box in pixels, inclusive, within the scissor box
+        int     min_y;
+        int     max_x;
+        int     max_y;
+        s32     edge_a[3];      ///< Edge function steps per pixel in x
+        s32     edge_b[3];      ///< Edge function steps per pixel in y
+        s32     edge_c[3];      ///< Edge functions at the center of pixel (0, 0)
+        Plane   z;
+        Plane   inv_w;
+        Plane   colors[kGCMaxVertexColors][4];          ///< Color channels divided by w
+        Plane   texcoords[kGCMaxActiveTextures][2];     ///< Texture coordinates divided by w
+    };
+
+    /**
+     * Sets up the plane of an attribute from its values at the three vertices
+     * @param plane Result plane
+     * @param x Vertex x positions in pixels
+     * @param y Vertex y positions in pixels
+     * @param inv_area 1 / twice the area of the triangle (in pixels)
+     * @param v0 Value at the first vertex
+     * @param v1 Value at the second vertex
+     * @param v2 Value at the third vertex
+     */
+    static void SetupPlane(Plane& plane, const f32* x, const f32* y, f32 inv_area, f32 v0, f32 v1,
+        f32 v2);
+
+    /// Entry point of the worker threads
+    static int WorkerEntry(void* data);
+
+    /// Worker thread loop
+    void Run();
+
+    /// Draws tiles until all tiles of the current flush are taken
+    void DrawTiles();
+
+    /**
+     * Draws all triangles binned into a tile
+     * @param tile Tile index
+     */
+    void DrawTile(int tile);
+
+    /**
+     * Draws the part of a triangle that falls in a rectangle
+     * @param triangle Triangle to draw
+     * @param x0 Left of the rectangle in pixels, inclusive
+     * @param y0 Top of the rectangle in pixels, inclusive
+     * @param x1 Right of the rectangle in pixels, inclusive
+     * @param y1 Bottom of the rectangle in pixels, inclusive
+     */
+    void DrawTriangleRect(const Triangle& triangle, int x0, int y0, int x1, int y1);
+
+    /**
+     * Interpolates the attributes of a pixel and runs it through the pixel pipeline
+     * @param triangle Triangle the pixel is covered by
+     * @param x Pixel x
+     * @param y Pixel y
+     */
+    void ShadePixel(const Triangle& triangle, int x, int y);
+
+    /**
+     * Bins a triangle into the tiles its edges touch
+     * @param index Index of the triangle
+     */
+    void BinTriangle(u32 index);
+
+    std::vector<u8>         efb_color_;         ///< EFB color (RGBA8)
+    std::vector<u32>        efb_depth_;         ///< EFB depth (24-bit)
+
+    std::vector<Triangle>   triangles_;         ///< Triangles binned since the last flush
+    int                     num_triangles_;
+    std::vector<SoftDrawState*> draw_states_;   ///< Draw states, the last one is the current one
+    int                     num_draw_states_;
+    std::vector<u32>        bins_[kNumTiles];   ///< Triangles touching each tile, in order
+    std::vector<int>        active_tiles_;      ///< Tiles with triangles in the current flush
+
+    std::vector<SDL_Thread*> workers_;
+    SDL_mutex*              mutex_;
+    SDL_cond*               work_cond_;         ///< Signaled when a flush starts
+    SDL_cond*               done_cond_;         ///< Signaled when the last tile is done
+    u32                     flush_count_;       ///< Incremented with every flush
+    int                     num_active_tiles_;  ///< Tiles to draw in the current flush
+    int                     next_tile_;         ///< Next entry of active_tiles_ to hand out
+    int                     tiles_done_;
+    bool                    quit_;
+
+    DISALLOW_COPY_AND_ASSIGN(Rasterizer);
+};
+
+#endif // VIDEO_CORE_RENDERER_SOFT_RASTERIZER_H_
@@ -0,0 +1,1061 @@
+/**
+ * Copyright (C) 2005-2012 Gekko Emulator
+ *
+ * @file    renderer_soft.cpp
+ * @author  ShizZy <shizzy247@gmail.com>
+ * @date    2013-02-27
+ * @brief   Software renderer, draws the EFB and XFB in RAM on the CPU
+ *
+ * @section LICENSE
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details at
+ * http://www.gnu.org/copyleft/gpl.html
+ *
+ * Official project repository can be found at:
+ * http://code.google.com/p/gekko-gc-emu/
+ */
+
+#include <algorithm>
+#include <cmath>
+
+#include "SDL.h"
+
+#include "common.h"
+#include "config.h"
+#include "file_utils.h"
+#include "misc_utils.h"
+
+#include "video_core.h"
+#include "vertex_manager.h"
+#include "bp_mem.h"
+#include "cp_mem.h"
+#include "xf_mem.h"
+#include "utils.h"
+
+#include "renderer_soft.h"
+
+/// Smallest w a vertex may have before it's clipped, keeps the perspective divide finite
+static const f32 kMinClipW = 1e-6f;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Transform and lighting helpers, these mirror the generic path of default.vs
+
+static inline f32 Dot3(const f32* a, const f32* b) {
+    return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+static inline void Normalize3(f32* v) {
+    f32 length = sqrtf(Dot3(v, v));
+    if (length > 0.0f) {
+        v[0] /= length;
+        v[1] /= length;
+        v[2] /= length;
+    }
+}
+
+/// Clamps a color component to 0-1, NaN (e.g. from a light with no attenuation) comes out 0
+static inline f32 ClampColor(f32 value) {
+    return (value > 1.0f) ? 1.0f : ((value >= 0.0f) ? value : 0.0f);
+}
+
+/**
+ * Reads vertex components as decoded by the vertex loader
+ * @param data Components, packed in their native format
+ * @param type Component type (GX_U8, GX_S8, GX_U16, GX_S16 or GX_F32)
+ * @param count Number of components to read
+ * @param out Result components
+ */
+static inline void ReadComponents(const void* data, int type, int count, f32* out) {
+    for (int i = 0; i < count; i++) {
+        switch (type) {
+        case GX_U8:  out[i] = (f32)((const u8*)data)[i]; break;
+        case GX_S8:  out[i] = (f32)((const s8*)data)[i]; break;
+        case GX_U16: out[i] = (f32)((const u16*)data)[i]; break;
+        case GX_S16: out[i] = (f32)((const s16*)data)[i]; break;
+        default:     out[i] = ((const f32*)data)[i]; break;
+        }
+    }
+}
+
+/**
+ * Decodes a vertex color
+ * @param format Color format (GX_RGB565 ... GX_RGBA8), anything else is white
+ * @param color Color bytes as decoded by the vertex loader
+ * @param out Result color (RGBA, 0-1)
+ */
+static void VertexColor(int format, const u8* color, f32* out) {
+    switch (format) {
+    case GX_RGB565:
+        out[0] = (f32)(color[1] >> 3) / 31.0f;
+        out[1] = (f32)(((color[1] & 0x7) << 3) | (color[0] >> 5)) / 63.0f;
+        out[2] = (f32)(color[0] & 0x1F) / 31.0f;
+        out[3] = 1.0f;
+        break;
+    case GX_RGB8:
+        out[0] = color[0] / 255.0f;
+        out[1] = color[1] / 255.0f;
+        out[2] = color[2] / 255.0f;
+        out[3] = 1.0f;
+        break;
+    case GX_RGBX8:
+        out[0] = color[3] / 255.0f;
+        out[1] = color[2] / 255.0f;
+        out[2] = color[1] / 255.0f;
+        out[3] = 1.0f;
+        break;
+    case GX_RGBA4:
+        out[0] = (f32)(color[1] >> 4) / 15.0f;
+        out[1] = (f32)(color[1] & 0xF) / 15.0f;
+        out[2] = (f32)(color[0] >> 4) / 15.0f;
+        out[3] = (f32)(color[0] & 0xF) / 15.0f;
+        break;
+    case GX_RGBA6:
+        out[0] = (f32)(color[0] >> 2) / 63.0f;
+        out[1] = (f32)(((color[0] & 0x3) << 4) | (color[1] >> 4)) / 63.0f;
+        out[2] = (f32)(((color[1] & 0xF) << 2) | (color[2] >> 6)) / 63.0f;
+        out[3] = (f32)(color[2] & 0x3F) / 63.0f;
+        break;
+    case GX_RGBA8:
+        out[0] = color[3] / 255.0f;
+        out[1] = color[2] / 255.0f;
+        out[2] = color[1] / 255.0f;
+        out[3] = color[0] / 255.0f;
+        break;
+    default:
+        out[0] = out[1] = out[2] = out[3] = 1.0f;
+        break;
+    }
+}
+
+/**
+ * Gets a material or ambient color
+ * @param source ShaderManager::GenericSource of the color
+ * @param colors Vertex colors (RGBA, 0-1)
+ * @param reg XF material or ambient color register (RGBA8)
+ * @param out Result color (RGBA, 0-1)
+ */
+static void GenericSource(int source, const f32 colors[2][4], u32 reg, f32* out) {
+    for (int i = 0; i < 4; i++) {
+        switch (source) {
+        case ShaderManager::kGenericSource_Zero:
+            out[i] = 0.0f;
+            break;
+        case ShaderManager::kGenericSource_One:
+            out[i] = 1.0f;
+            break;
+        case ShaderManager::kGenericSource_Register:
+            out[i] = (f32)((reg >> (24 - i * 8)) & 0xFF) / 255.0f;
+            break;
+        case ShaderManager::kGenericSource_Color0:
+            out[i] = colors[0][i];
+            break;
+        default:
+            out[i] = colors[1][i];
+            break;
+        }
+    }
+}
+
+/**
+ * Intensity of a light at a vertex
+ * @param light Light index
+ * @param func Attenuation function | diffuse function << 2
+ * @param pos Vertex position in view space
+ * @param nrm Vertex normal in view space
+ * @return Light intensity
+ */
+static f32 GenericLight(int light, int func, const f32* pos, const f32* nrm) {
+    const f32* data = (const f32*)&gp::g_xf_mem[XF_LIGHTS + light * 0x10];
+    const f32* cos_atten = &data[4];
+    const f32* light_pos = &data[10];
+    const f32* light_dir = &data[13];
+    int attn_func = func & 3;
+    int diffuse_func = func >> 2;
+    f32 atten = 1.0f;
+    f32 intensity;
+
+    // Dist attenuation, make sure not equal to 0
+    f32 dist_atten[3] = { data[7], data[8], data[9] };
+    if (fabs(dist_atten[0]) < 0.00001f && fabs(dist_atten[1]) < 0.00001f &&
+        fabs(dist_atten[2]) < 0.00001f) {
+        dist_atten[0] = 0.00001f;
+    }
+    // Simple diffuse lighting
+    if ((attn_func & 1) == 0) {
+        f32 dir[3] = { light_pos[0] - pos[0], light_pos[1] - pos[1], light_pos[2] - pos[2] };
+        Normalize3(dir);
+        intensity = Dot3(dir, nrm);
+
+    // Specular lighting
+    } else if (attn_func == 1) {
+        f32 dir[3] = { light_pos[0], light_pos[1], light_pos[2] };
+        Normalize3(dir);
+        atten = (Dot3(nrm, dir) >= 0.0f) ? std::max(0.0f, Dot3(nrm, light_dir)) : 0.0f;
+        f32 poly[3] = { 1.0f, atten, atten * atten };
+        atten = std::max(0.0f, Dot3(cos_atten, poly)) / Dot3(dist_atten, poly);
+        intensity = atten * Dot3(dir, nrm);
+
+    // Spot lighting
+    } else {
+        f32 dir[3] = { light_pos[0] - pos[0], light_pos[1] - pos[1], light_pos[2] - pos[2] };
+        f32 dist = sqrtf(Dot3(dir, dir));
+        Normalize3(dir);
+        atten = std::max(0.0f, Dot3(dir, light_dir));
+        f32 poly[3] = { 1.0f, atten, atten * atten };
+        f32 dist_poly[3] = { 1.0f, dist, dist * dist };
+        atten = std::max(0.0f, Dot3(cos_atten, poly)) / Dot3(dist_atten, dist_poly);
+        intensity = atten * Dot3(dir, nrm);
+    }
+    switch (diffuse_func) {
+    case GX_DF_NONE: return atten;
+    case GX_DF_SIGN: return intensity;
+    default: return std::max(intensity, 0.0f);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// RendererSoft
+
+/// RendererSoft constructor
+RendererSoft::RendererSoft() {
+    rasterizer_ = NULL;
+    vbo_ = NULL;
+    cull_mode_ = 0;
+    scissor_ = Rect(0, 0, kGCEFBWidth, kGCEFBHeight);
+    line_width_ = 1.0f;
+    point_size_ = 1.0f;
+    xfb_width_ = 0;
+    xfb_height_ = 0;
+    last_fps_ticks_ = 0;
+    fps_frames_ = 0;
+    cmode0_._u32 = 0;
+    cmode1_._u32 = 0;
+    zmode_._u32 = 0;
+    memset(&vertex_state_, 0, sizeof(vertex_state_));
+    memset(&vertex_layout_, 0, sizeof(vertex_layout_));
+    memset(&generic_state_, 0, sizeof(generic_state_));
+    draw_state_ = SoftDrawState();
+    memset(samplers_, 0, sizeof(samplers_));
+    memset(tev_registers_, 0, sizeof(tev_registers_));
+    memset(konst_registers_, 0, sizeof(konst_registers_));
+    shader_interface_ = new ShaderInterface(this);
+    texture_interface_ = new TextureInterface(this);
+}
+
+/// RendererSoft destructor
+RendererSoft::~RendererSoft() {
+    delete shader_interface_;
+    delete texture_interface_;
+    delete rasterizer_;
+    delete[] vbo_;
+}
+
+/**
+ * Write data to BP for renderer internal use (e.g. direct to shader)
+ * @param addr BP register address
+ * @param data Value to write to BP register
+ */
+void RendererSoft::WriteBP(u8 addr, u32 data) {
+    switch (addr) {
+    // SetBlendMode and friends only hear about the fields that are set, keep the whole register
+    case BP_REG_PE_CMODE0:
+        cmode0_ = gp::g_bp_regs.cmode0;
+        break;
+
+    case BP_REG_PE_CMODE1:
+        cmode1_ = gp::g_bp_regs.cmode1;
+        break;
+
+    case BP_REG_TEV_REGISTER_L + 0:
+    case BP_REG_TEV_REGISTER_H + 0:
+    case BP_REG_TEV_REGISTER_L + 2:
+    case BP_REG_TEV_REGISTER_H + 2:
+    case BP_REG_TEV_REGISTER_L + 4:
+    case BP_REG_TEV_REGISTER_H + 4:
+    case BP_REG_TEV_REGISTER_L + 6:
+    case BP_REG_TEV_REGISTER_H + 6:
+        {
+            int index = ((addr >> 1) - 0x70);
+            bool konst = (data >> 23) & 1;
+            s16* dst = konst ? konst_registers_[index] : tev_registers_[index];
+
+            // Konst colors are 8-bit, registers are signed 11-bit
+            s16 lo = konst ? (s16)(data & 0xFF) : (s16)(((s32)(data << 21)) >> 21);
+            s16 hi = konst ? (s16)((data >> 12) & 0xFF) : (s16)(((s32)(data << 9)) >> 21);
+
+            if (addr & 1) { // green/blue
+                dst[1] = hi;
+                dst[2] = lo;
+            } else { // red/alpha
+                dst[3] = hi;
+                dst[0] = lo;
+            }
+        }
+        break;
+    }
+}
+
+/**
+ * Begin renderering of a primitive
+ * @param prim Primitive type (e.g. GX_TRIANGLES)
+ * @param count Number of vertices to be drawn (used for appropriate memory management, only)
+ * @param vbo Pointer to VBO, which will be set by API in this function
+ * @param vbo_offset Offset of the primitive into the current batch (in vertices, laid out as
+ * VertexLoader_GetLayout says for the current vertex state)
+ */
+void RendererSoft::BeginPrimitive(GXPrimitive prim, int count, u8** vbo, u32 vbo_offset) {
+    if (0 == count) {
+        return;
+    }
+    *vbo = vbo_ + vbo_offset * vertex_layout_.stride;
+}
+
+/**
+ * Draws a batch of primitives from the previously decoded vertex array
+ * @param prim Primitive type the batch is drawn as (GX_TRIANGLES, GX_LINES or GX_POINTS)
+ * @param vertex_num Number of vertices in the batch
+ * @param indices Index list of the batch, relative to the first vertex of the batch
+ * @param index_num Number of indices
+ */
+void RendererSoft::DrawPrimitives(GXPrimitive prim, u32 vertex_num, const u32* indices,
+    int index_num) {
+    if (0 == index_num) {
+        return;
+    }
+    video_core::g_shader_manager->GetGenericState(generic_state_);
+
+    UpdateDrawState();
+    TransformVertices(vertex_num);
+
+    const ClipVertex* v = &clip_vertices_[0];
+    switch (prim) {
+    case GX_TRIANGLES:
+        for (int i = 0; i + 2 < index_num; i += 3) {
+            DrawTriangle(v[indices[i]], v[indices[i + 1]], v[indices[i + 2]]);
+        }
+        break;
+    case GX_LINES:
+        for (int i = 0; i + 1 < index_num; i += 2) {
+            DrawLine(v[indices[i]], v[indices[i + 1]]);
+        }
+        break;
+    default:
+        for (int i = 0; i < index_num; i++) {
+            DrawPoint(v[indices[i]]);
+        }
+        break;
+    }
+}
+
+/// Captures the draw state of the pixel stages and hands it to the rasterizer
+void RendererSoft::UpdateDrawState() {
+    draw_state_ = SoftDrawState();
+    draw_state_.generic = generic_state_;
+
+    for (int stage = 0; stage <= generic_state_.fragment[0]; stage++) {
+        const gp::BPTevKSel& ksel = gp::g_bp_regs.ksel[stage >> 1];
+        s16 konst_alpha[4];
+
+        draw_state_.combiner[stage] = gp::g_bp_regs.combiner[stage];
+        GetKonst(ksel.get_konst_color_sel(stage), draw_state_.konst[stage]);
+        GetKonst(ksel.get_konst_alpha_sel(stage), konst_alpha);
+        draw_state_.konst[stage][3] = konst_alpha[3];
+    }
+    memcpy(draw_state_.registers, tev_registers_, sizeof(tev_registers_));
+    memcpy(draw_state_.samplers, samplers_, sizeof(samplers_));
+    draw_state_.alpha_func = gp::g_bp_regs.alpha_func;
+    draw_state_.zmode = zmode_;
+    draw_state_.cmode0 = cmode0_;
+    draw_state_.cmode1 = cmode1_;
+    draw_state_.zcontrol = gp::g_bp_regs.zcontrol;
+    draw_state_.scissor = scissor_;
+    draw_state_.num_texcoords = CLAMP((int)gp::g_bp_regs.genmode.num_texgens, 1,
+        kGCMaxActiveTextures);
+
+    rasterizer_->SetDrawState(draw_state_);
+}
+
+/**
+ * Gets a TEV konst color
+ * @param sel Konst selection of BPTevKSel
+ * @param out Result color (RGBA, 0-255)
+ */
+void RendererSoft::GetKonst(int sel, s16* out) const {
+    static const s16 fractions[8] = { 255, 223, 191, 159, 128, 96, 64, 32 };
+
+    for (int i = 0; i < 4; i++) {
+        if (sel < 8) {
+            out[i] = fractions[sel];
+        } else if (sel >= 12 && sel < 16) {
+            out[i] = konst_registers_[sel - 12][i];
+        } else if (sel >= 16) {
+            out[i] = konst_registers_[sel & 3][(sel - 16) >> 2];
+        } else {
+            out[i] = 0;
+        }
+    }
+}
+
+/**
+ * Transforms and lights the vertices of the batch, like the generic vertex shader
+ * @param vertex_num Number of vertices in the batch
+ */
+void RendererSoft::TransformVertices(u32 vertex_num) {
+    const f32* xf_mem = (const f32*)gp::g_xf_mem;
+    const gp::XFViewport& viewport = gp::g_xf_regs.viewport;
+    const int flags = generic_state_.vertex[0];
+    const int num_texcoords = draw_state_.num_texcoords;
+
+    const int tex_matrix_offsets[8] = {
+        (int)gp::g_cp_regs.matrix_index_a.tex0_midx, (int)gp::g_cp_regs.matrix_index_a.tex1_midx,
+        (int)gp::g_cp_regs.matrix_index_a.tex2_midx, (int)gp::g_cp_regs.matrix_index_a.tex3_midx,
+        (int)gp::g_cp_regs.matrix_index_b.tex4_midx, (int)gp::g_cp_regs.matrix_index_b.tex5_midx,
+        (int)gp::g_cp_regs.matrix_index_b.tex6_midx, (int)gp::g_cp_regs.matrix_index_b.tex7_midx
+    };
+    const f32 tex_dqf[8] = {
+        gp::g_cp_regs.vat_reg_a[gp::g_cur_vat].get_tex0_dqf(),
+        gp::g_cp_regs.vat_reg_b[gp::g_cur_vat].get_tex1_dqf(),
+        gp::g_cp_regs.vat_reg_b[gp::g_cur_vat].get_tex2_dqf(),
+        gp::g_cp_regs.vat_reg_b[gp::g_cur_vat].get_tex3_dqf(),
+        gp::g_cp_regs.vat_reg_c[gp::g_cur_vat].get_tex4_dqf(),
+        gp::g_cp_regs.vat_reg_c[gp::g_cur_vat].get_tex5_dqf(),
+        gp::g_cp_regs.vat_reg_c[gp::g_cur_vat].get_tex6_dqf(),
+        gp::g_cp_regs.vat_reg_c[gp::g_cur_vat].get_tex7_dqf()
+    };
+
+    f32 pos_dqf = 1.0f;
+    if (flags & ShaderManager::kFlag_VertexPostition_DQF) {
+        pos_dqf = gp::g_cp_regs.vat_reg_a[gp::g_cur_vat].get_pos_dqf();
+    }
+    // Viewport, relative to the scissor box offset
+    const f32 x_orig = viewport.x_orig - (f32)(gp::g_bp_regs.scissor_offset.x * 2);
+    const f32 y_orig = viewport.y_orig - (f32)(gp::g_bp_regs.scissor_offset.y * 2);
+
+    if (clip_vertices_.size() < vertex_num) {
+        clip_vertices_.resize(vertex_num);
+    }
+    for (u32 n = 0; n < vertex_num; n++) {
+        GXVertex vertex;
+        gp::VertexLoader_UnpackVertex(vertex_state_, vertex_layout_, 
+            vbo_ + n * vertex_layout_.stride, &vertex);
+        ClipVertex& out = clip_vertices_[n];
+
+        // Position and normal
+        // -------------------
+
+        f32 position[3] = { 0.0f, 0.0f, 0.0f };
+        ReadComponents(vertex.position, vertex_state_.pos.comp_type,
+            (GX_POS_XYZ == vertex_state_.pos.comp_count) ? 3 : 2, position);
+
+        int pos_nrm_index = gp::g_cp_regs.matrix_index_a.pos_normal_midx;
+        if (flags & ShaderManager::kFlag_MatrixIndexed_Position) {
+            pos_nrm_index = vertex.pm_idx;
+        }
+        f32 pos[3];
+        for (int r = 0; r < 3; r++) {
+            const f32* row = &xf_mem[((pos_nrm_index + r) & 0x3F) * 4];
+            pos[r] = row[0] * position[0] * pos_dqf + row[1] * position[1] * pos_dqf +
+                row[2] * position[2] * pos_dqf + row[3];
+        }
+        f32 normal[3] = { 0.0f, 0.0f, 0.0f };
+        if (vertex_state_.nrm.attr_type) {
+            ReadComponents(vertex.normal, vertex_state_.nrm.comp_type, 3, normal);
+        }
+        f32 nrm[3];
+        for (int r = 0; r < 3; r++) {
+            nrm[r] = Dot3(&xf_mem[XF_NORMALMATRICES + (((pos_nrm_index & 0x1F) + r) & 0x1F) * 3],
+                normal);
+        }
+        Normalize3(nrm);
+
+        // Projection and viewport, the GC's clip space z goes from -w (near) to 0 (far)
+        const f32* proj = gp::g_projection_matrix;
+        f32 clip[4];
+        for (int r = 0; r < 4; r++) {
+            clip[r] = proj[r] * pos[0] + proj[4 + r] * pos[1] + proj[8 + r] * pos[2] + proj[12 + r];
+        }
+        out.w = clip[3];
+        out.clip_z = clip[2];
+        out.x = x_orig * clip[3] + viewport.wd * clip[0];
+        out.y = y_orig * clip[3] + viewport.ht * clip[1];
+        out.z = viewport.far_z * clip[3] + viewport.z_range * clip[2];
+
+        // Texture coordinates
+        // -------------------
+
+        for (int t = 0; t < num_texcoords; t++) {
+            f32 st[2] = { 0.0f, 0.0f };
+            if (vertex_state_.tex[t].attr_type) {
+                ReadComponents(&vertex.texcoords[t * 2], vertex_state_.tex[t].comp_type,
+                    (GX_TEX_ST == vertex_state_.tex[t].comp_count) ? 2 : 1, st);
+            }
+            int index = tex_matrix_offsets[t];
+            if (flags & (ShaderManager::kFlag_MatrixIndexed_TexCoord_0 << t)) {
+                index = vertex.tm_idx[t];
+            }
+            for (int r = 0; r < 2; r++) {
+                const f32* row = &xf_mem[((index + r) & 0x3F) * 4];
+                out.texcoords[t][r] = row[0] * st[0] * tex_dqf[t] + row[1] * st[1] * tex_dqf[t] +
+                    row[3];
+            }
+        }
+
+        // Color channels
+        // --------------
+
+        f32 col[2][4];
+        f32 chan[2][4];
+        VertexColor(generic_state_.vertex[1], (const u8*)&vertex.color[0], col[0]);
+        VertexColor(generic_state_.vertex[2], (const u8*)&vertex.color[1], col[1]);
+
+        for (int c = 0; c < 2; c++) {
+            const ShaderManager::GenericState::Channel& gen = generic_state_.channels[c];
+            f32 mat[4];
+            f32 amb[4];
+            f32 src[4];
+
+            GenericSource(gen.source[0], col, gp::g_xf_regs.material[c]._u32, mat);
+            GenericSource(gen.source[1], col, gp::g_xf_regs.material[c]._u32, src);
+            mat[3] = src[3];
+            GenericSource(gen.source[2], col, gp::g_xf_regs.ambient[c]._u32, amb);
+            GenericSource(gen.source[3], col, gp::g_xf_regs.ambient[c]._u32, src);
+            amb[3] = src[3];
+
+            for (int light = 0; light < kGCMaxLights; light++) {
+                const u32 light_col = gp::g_xf_mem[XF_LIGHTS + light * 0x10 + 3];
+
+                if (gen.lighting[0] & (1 << light)) {
+                    f32 intensity = GenericLight(light, gen.lighting[2], pos, nrm);
+                    amb[0] += intensity * ((light_col >> 24) & 0xFF) / 255.0f;
+                    amb[1] += intensity * ((light_col >> 16) & 0xFF) / 255.0f;
+                    amb[2] += intensity * ((light_col >> 8) & 0xFF) / 255.0f;
+                }
+                if (gen.lighting[1] & (1 << light)) {
+                    f32 intensity = GenericLight(light, gen.lighting[3], pos, nrm);
+                    amb[3] += intensity * (light_col & 0xFF) / 255.0f;
+                }
+            }
+            // Unlit channels have an ambient of one, so this is just the material for them
+            for (int i = 0; i < 4; i++) {
+                chan[c][i] = mat[i] * ClampColor(amb[i]);
+            }
+        }
+        if (generic_state_.vertex[3] < 2) {
+            memcpy(chan[1], (generic_state_.vertex[2] >= 0) ? col[0] : chan[0], sizeof(chan[1]));
+        }
+        for (int c = 0; c < 2; c++) {
+            for (int i = 0; i < 4; i++) {
+                out.colors[c][i] = ClampColor(chan[c][i]) * 255.0f;
+            }
+        }
+    }
+}
+
+/// Distance of a vertex to a clip plane, negative if it's clipped
+f32 RendererSoft::ClipDistance(const ClipVertex& vertex, int plane) {
+    static const f32 guard_band = (f32)kGuardBand;
+
+    switch (plane) {
+    case kClipPlane_W:      return vertex.w - kMinClipW;
+    case kClipPlane_Near:   return vertex.clip_z + vertex.w;
+    case kClipPlane_Left:   return vertex.x + guard_band * vertex.w;
+    case kClipPlane_Right:  return (kGCEFBWidth + guard_band) * vertex.w - vertex.x;
+    case kClipPlane_Top:    return vertex.y + guard_band * vertex.w;
+    default:                return (kGCEFBHeight + guard_band) * vertex.w - vertex.y;
+    }
+}
+
+/// Interpolates between two vertices
+void RendererSoft::LerpVertex(const ClipVertex& a, const ClipVertex& b, f32 t, ClipVertex& out) {
+    const f32* src_a = (const f32*)&a;
+    const f32* src_b = (const f32*)&b;
+    f32* dst = (f32*)&out;
+
+    for (size_t i = 0; i < sizeof(ClipVertex) / sizeof(f32); i++) {
+        dst[i] = src_a[i] + (src_b[i] - src_a[i]) * t;
+    }
+}
+
+/// Divides by w, giving the vertex the rasterizer takes
+void RendererSoft::ProjectVertex(const ClipVertex& in, SoftVertex& out) {
+    out.inv_w = 1.0f / in.w;
+    out.x = in.x * out.inv_w;
+    out.y = in.y * out.inv_w;
+    out.z = in.z * out.inv_w;
+    memcpy(out.colors, in.colors, sizeof(out.colors));
+    memcpy(out.texcoords, in.texcoords, sizeof(out.texcoords));
+}
+
+/**
+ * Clips, culls and draws a triangle
+ * @param v0 First vertex
+ * @param v1 Second vertex
+ * @param v2 Third vertex
+ */
+void RendererSoft::DrawTriangle(const ClipVertex& v0, const ClipVertex& v1,
+    const ClipVertex& v2) {
+    ClipVertex polygon[2][kMaxClipVertices];
+    int num_vertices = 3;
+    int current = 0;
+
+    polygon[0][0] = v0;
+    polygon[0][1] = v1;
+    polygon[0][2] = v2;
+
+    // Sutherland-Hodgman against each plane. New vertices are always interpolated from the inside
+    // vertex, so triangles sharing an edge get the same vertex and no gaps open up between them
+    for (int plane = 0; plane < kNumClipPlanes; plane++) {
+        const ClipVertex* in = polygon[current];
+        ClipVertex* out = polygon[current ^ 1];
+        int num_out = 0;
+        bool clipped = false;
+
+        for (int i = 0; i < num_vertices; i++) {
+            if (ClipDistance(in[i], plane) < 0.0f) {
+                clipped = true;
+                break;
+            }
+        }
+        if (!clipped) {
+            continue;
+        }
+        for (int i = 0; i < num_vertices; i++) {
+            const ClipVertex& a = in[i];
+            const ClipVertex& b = in[(i + 1) % num_vertices];
+            f32 dist_a = ClipDistance(a, plane);
+            f32 dist_b = ClipDistance(b, plane);
+
+            if (dist_a >= 0.0f) {
+                out[num_out++] = a;
+            }
+            if ((dist_a >= 0.0f) != (dist_b >= 0.0f)) {
+                if (dist_a >= 0.0f) {
+                    LerpVertex(a, b, dist_a / (dist_a - dist_b), out[num_out++]);
+                } else {
+                    LerpVertex(b, a, dist_b / (dist_b - dist_a), out[num_out++]);
+                }
+            }
+        }
+        num_vertices = num_out;
+        current ^= 1;
+        if (num_vertices < 3) {
+            return;
+        }
+    }
+    SoftVertex vertices[kMaxClipVertices];
+    for (int i = 0; i < num_vertices; i++) {
+        ProjectVertex(polygon[current][i], vertices[i]);
+    }
+
+    // Facing from the signed area, positive is clockwise in the EFB (y down)
+    f32 area = 0.0f;
+    for (int i = 0; i < num_vertices; i++) {
+        const SoftVertex& a = vertices[i];
+        const SoftVertex& b = vertices[(i + 1) % num_vertices];
+        area += a.x * b.y - b.x * a.y;
+    }
+    switch (cull_mode_) {
+    case 1:
+        if (area > 0.0f) return;
+        break;
+    case 2:
+        if (area < 0.0f) return;
+        break;
+    case 3:
+        return;
+    }
+    for (int i = 1; i + 1 < num_vertices; i++) {
+        rasterizer_->DrawTriangle(vertices[0], vertices[i], vertices[i + 1]);
+    }
+}
+
+/**
+ * Clips and draws a line as a quad of the line width
+ * @param v0 First vertex
+ * @param v1 Second vertex
+ */
+void RendererSoft::DrawLine(const ClipVertex& v0, const ClipVertex& v1) {
+    f32 t0 = 0.0f;
+    f32 t1 = 1.0f;
+
+    if (line_width_ <= 0.0f) {
+        return;
+    }
+    for (int plane = 0; plane < kNumClipPlanes; plane++) {
+        f32 dist_0 = ClipDistance(v0, plane);
+        f32 dist_1 = ClipDistance(v1, plane);
+
+        if (dist_0 < 0.0f && dist_1 < 0.0f) {
+            return;
+        }
+        if (dist_0 < 0.0f) {
+            t0 = std::max(t0, dist_0 / (dist_0 - dist_1));
+        } else if (dist_1 < 0.0f) {
+            t1 = std::min(t1, dist_0 / (dist_0 - dist_1));
+        }
+    }
+    if (t0 > t1) {
+        return;
+    }
+    ClipVertex clipped[2];
+    LerpVertex(v0, v1, t0, clipped[0]);
+    LerpVertex(v0, v1, t1, clipped[1]);
+
+    SoftVertex a[2];
+    SoftVertex b[2];
+    ProjectVertex(clipped[0], a[0]);
+    ProjectVertex(clipped[1], b[0]);
+    a[1] = a[0];
+    b[1] = b[0];
+
+    // Widen across the major axis, as the GC does
+    f32 half_width = line_width_ * 0.5f;
+    if (fabs(b[0].x - a[0].x) >= fabs(b[0].y - a[0].y)) {
+        a[0].y -= half_width;
+        a[1].y += half_width;
+        b[0].y -= half_width;
+        b[1].y += half_width;
+    } else {
+        a[0].x -= half_width;
+        a[1].x += half_width;
+        b[0].x -= half_width;
+        b[1].x += half_width;
+    }
+    rasterizer_->DrawTriangle(a[0], a[1], b[0]);
+    rasterizer_->DrawTriangle(a[1], b[1], b[0]);
+}
+
+/**
+ * Draws a point as a square of the point size
+ * @param v Vertex
+ */
+void RendererSoft::DrawPoint(const ClipVertex& v) {
+    if (point_size_ <= 0.0f) {
+        return;
+    }
+    for (int plane = 0; plane < kNumClipPlanes; plane++) {
+        if (ClipDistance(v, plane) < 0.0f) {
+            return;
+        }
+    }
+    SoftVertex corners[4];
+    ProjectVertex(v, corners[0]);
+
+    f32 half_size = point_size_ * 0.5f;
+    f32 x = corners[0].x;
+    f32 y = corners[0].y;
+    for (int i = 1; i < 4; i++) {
+        corners[i] = corners[0];
+    }
+    corners[0].x = x - half_size;
+    corners[0].y = y - half_size;
+    corners[1].x = x + half_size;
+    corners[1].y = y - half_size;
+    corners[2].x = x - half_size;
+    corners[2].y = y + half_size;
+    corners[3].x = x + half_size;
+    corners[3].y = y + half_size;
+
+    rasterizer_->DrawTriangle(corners[0], corners[1], corners[2]);
+    rasterizer_->DrawTriangle(corners[1], corners[3], corners[2]);
+}
+
+/// Swap buffers (render frame)
+void RendererSoft::SwapBuffers() {
+    u32 ticks = SDL_GetTicks();
+
+    current_frame_++;
+    fps_frames_++;
+
+    // Nothing to present, frames are only dumped (see CopyToXFB)
+    if (ticks - last_fps_ticks_ >= 1000) {
+        current_fps_ = 1000.0f * fps_frames_ / (ticks - last_fps_ticks_);
+        last_fps_ticks_ = ticks;
+        fps_frames_ = 0;
+    }
+}
+
+/// Sets the renderer depth test mode
+void RendererSoft::SetDepthMode() {
+    zmode_ = gp::g_bp_regs.zmode;
+}
+
+/// Sets the renderer generation mode
+void RendererSoft::SetGenerationMode() {
+    cull_mode_ = gp::g_bp_regs.genmode.cull_mode;
+}
+
+/**
+ * Sets the renderer blend mode
+ * @param pe_cmode_0 BPPECMode0 register to user for blend settings
+ * @param pe_cmode_1 BPPECMode1 register to user for blend settings
+ * @param blend_mode_ Forces blend mode to update
+ */
+void RendererSoft::SetBlendMode(const gp::BPPECMode0& pe_cmode_0,
+    const gp::BPPECMode1& pe_cmode_1, bool force_update) {
+    cmode0_.blend_enable = pe_cmode_0.blend_enable;
+    cmode0_.src_factor = pe_cmode_0.src_factor;
+    cmode0_.dst_factor = pe_cmode_0.dst_factor;
+    cmode0_.subtract = pe_cmode_0.subtract;
+    cmode1_ = pe_cmode_1;
+}
+
+/**
+ * Sets the renderer logic op mode
+ * @param pe_cmode_0 BPPECMode0 register to user for blend settings
+ */
+void RendererSoft::SetLogicOpMode(const gp::BPPECMode0& pe_cmode_0) {
+    cmode0_.logicop_enable = pe_cmode_0.logicop_enable;
+    cmode0_.logic_mode = pe_cmode_0.logic_mode;
+}
+
+/**
+ * Sets the renderer color mask mode
+ * @param pe_cmode_0 BPPECMode0 register to user for blend settings
+ */
+void RendererSoft::SetColorMask(const gp::BPPECMode0& pe_cmode_0) {
+    cmode0_.color_update = pe_cmode_0.color_update;
+    cmode0_.alpha_update = pe_cmode_0.alpha_update;
+}
+
+/**
+ * Sets the scissor box
+ * @param rect Renderer rectangle to set scissor box to
+ */
+void RendererSoft::SetScissorBox(const Rect& rect) {
+    scissor_ = RendererToEFBRect(rect);
+}
+
+/**
+ * Sets the line and point size
+ * @param line_width Line width to use
+ * @param point_size Point size to use
+ */
+void RendererSoft::SetLinePointSize(f32 line_width, f32 point_size) {
+    line_width_ = line_width;
+    point_size_ = point_size;
+}
+
+/**
+ * Converts a rectangle in renderer coordinates (bottom up) to EFB pixels (top down)
+ * @param rect Renderer rectangle
+ * @return EFB rectangle, ordered and clamped to the EFB, x1/y1 exclusive
+ */
+Rect RendererSoft::RendererToEFBRect(const Rect& rect) {
+    int y0 = kGCEFBHeight - rect.y0_;
+    int y1 = kGCEFBHeight - rect.y1_;
+
+    return Rect(CLAMP(std::min(rect.x0_, rect.x1_), 0, kGCEFBWidth),
+                CLAMP(std::min(y0, y1), 0, kGCEFBHeight),
+                CLAMP(std::max(rect.x0_, rect.x1_), 0, kGCEFBWidth),
+                CLAMP(std::max(y0, y1), 0, kGCEFBHeight));
+}
+
+/**
+ * Copies a region of the EFB, box filtered to the destination size
+ * @param src_rect Source rectangle in renderer coordinates
+ * @param dst Destination (RGBA8, top row first)
+ * @param dst_width Width of the destination in pixels
+ * @param dst_height Height of the destination in pixels
+ * @param depth Copy the Z buffer rather than the color buffer
+ * @param intensity Convert the copy to intensity
+ */
+void RendererSoft::CopyEFB(const Rect& src_rect, u8* dst, int dst_width, int dst_height,
+    bool depth, bool intensity) {
+    Rect rect = RendererToEFBRect(src_rect);
+    int src_width = rect.width();
+    int src_height = rect.height();
+
+    rasterizer_->Flush();
+    if (0 == src_width || 0 == src_height) {
+        return;
+    }
+    const u8* efb_color = rasterizer_->efb_color();
+    const u32* efb_depth = rasterizer_->efb_depth();
+
+    for (int dy = 0; dy < dst_height; dy++) {
+        int y0 = rect.y0_ + dy * src_height / dst_height;
+        int y1 = std::max(rect.y0_ + (dy + 1) * src_height / dst_height, y0 + 1);
+
+        for (int dx = 0; dx < dst_width; dx++) {
+            int x0 = rect.x0_ + dx * src_width / dst_width;
+            int x1 = std::max(rect.x0_ + (dx + 1) * src_width / dst_width, x0 + 1);
+            int count = (x1 - x0) * (y1 - y0);
+            u32 sum[4] = { 0, 0, 0, 0 };
+
+            for (int y = y0; y < y1; y++) {
+                for (int x = x0; x < x1; x++) {
+                    int offset = y * kGCEFBWidth + x;
+                    if (depth) {
+                        sum[0] += efb_depth[offset] >> 16;
+                    } else {
+                        sum[0] += efb_color[offset * 4 + 0];
+                        sum[1] += efb_color[offset * 4 + 1];
+                        sum[2] += efb_color[offset * 4 + 2];
+                        sum[3] += efb_color[offset * 4 + 3];
+                    }
+                }
+            }
+            u8* texel = &dst[(dy * dst_width + dx) * 4];
+            if (depth) {
+                texel[0] = texel[1] = texel[2] = (u8)((sum[0] + count / 2) / count);
+                texel[3] = 0xFF;
+                continue;
+            }
+            for (int i = 0; i < 4; i++) {
+                texel[i] = (u8)((sum[i] + count / 2) / count);
+            }
+            if (intensity) {
+                int y = ((66 * texel[0] + 129 * texel[1] + 25 * texel[2] + 128) >> 8) + 16;
+                texel[0] = texel[1] = texel[2] = (u8)y;
+            }
+        }
+    }
+}
+
+/**
+ * Blits the EFB to the external framebuffer (XFB)
+ * @param src_rect Source rectangle in EFB to copy
+ * @param dst_rect Destination rectangle in EFB to copy to
+ */
+void RendererSoft::CopyToXFB(const Rect& src_rect, const Rect& dst_rect) {
+    int width = std::min((int)dst_rect.width(), kGCEFBWidth);
+    int height = std::min((int)dst_rect.height(), kGCEFBHeight * 2);
+
+    if (0 == width || 0 == height) {
+        return;
+    }
+    xfb_.resize(width * height * 4);
+    xfb_width_ = width;
+    xfb_height_ = height;
+    CopyEFB(src_rect, &xfb_[0], width, height, false, false);
+
+    // Optionally dump the frame to TGA, the output is the same on every run and host...
+    if (common::g_config->current_renderer_config().enable_frame_dumping) {
+        std::string filepath = common::g_config->program_dir() + std::string("/dump/frames/");
+        common::CreateFullPath(filepath);
+        filepath = common::FormatStr("%s/%08d.tga", filepath.c_str(), current_frame_);
+        video_core::DumpTGA(filepath, width, height, &xfb_[0]);
+    }
+}
+
+/**
+ * Clear the screen
+ * @param rect Screen rectangle to clear
+ * @param enable_color Enable color clearing
+ * @param enable_alpha Enable alpha clearing
+ * @param enable_z Enable depth clearing
+ * @param color Clear color
+ * @param z Clear depth
+ */
+void RendererSoft::Clear(const Rect& rect, bool enable_color, bool enable_alpha, bool enable_z,
+    u32 color, u32 z) {
+    rasterizer_->Clear(RendererToEFBRect(rect), enable_color, enable_alpha, enable_z, color, z);
+}
+
+/// Initialize the renderer
+void RendererSoft::Init() {
+    vbo_ = new u8[VBO_MAX_BATCH_VERTS * sizeof(GXVertex)];
+    rasterizer_ = new Rasterizer(Rasterizer::DefaultThreadCount());
+    last_fps_ticks_ = SDL_GetTicks();
+    LOG_NOTICE(TVIDEO, "Software renderer initialized, rasterizing with %d threads",
+        rasterizer_->num_threads());
+}
+
+/// Shutdown the renderer
+void RendererSoft::ShutDown() {
+    delete rasterizer_;
+    rasterizer_ = NULL;
+    delete[] vbo_;
+    vbo_ = NULL;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// RendererSoft::TextureInterface
+
+/**
+ * Create a new texture in RAM
+ * @param active_texture_unit Active texture unit to bind to for creation
+ * @param cache_entry CacheEntry to create texture for
+ * @param raw_data Raw texture data (RGBA8), NULL for EFB copies
+ * @return Pointer to the new texture
+ */
+TextureManager::CacheEntry::BackendData* RendererSoft::TextureInterface::Create(
+    int active_texture_unit, const TextureManager::CacheEntry& cache_entry, u8* raw_data) {
+    SoftTexture* texture = new SoftTexture(cache_entry.width_, cache_entry.height_);
+
+    if (NULL != raw_data) {
+        memcpy(&texture->texels_[0], raw_data, texture->texels_.size());
+    }
+    if (TextureManager::kSourceType_EFBCopy == cache_entry.type_) {
+        texture->is_depth_copy_ = (cache_entry.efb_copy_data_.pixel_format_ ==
+            gp::kPixelFormat_Z24);
+        texture->is_intensity_copy_ = cache_entry.efb_copy_data_.copy_exec_.intensity_fmt;
+    }
+    return texture;
+}
+
+/**
+ * Delete a texture from RAM
+ * @param backend_data Texture to delete
+ */
+void RendererSoft::TextureInterface::Delete(TextureManager::CacheEntry::BackendData* backend_data) {
+    // Binned triangles may still sample it
+    if (NULL != parent_->rasterizer_) {
+        parent_->rasterizer_->Flush();
+    }
+    for (int i = 0; i < kGCMaxTextureMaps; i++) {
+        if (parent_->samplers_[i].texture == backend_data) {
+            parent_->samplers_[i].texture = NULL;
+        }
+    }
+    delete backend_data;
+}
+
+/**
+ * Call to update a texture with a new EFB copy of the region specified by rect
+ * @param src_rect Source rectangle to copy from EFB
+ * @param dst_rect Destination rectange to copy to
+ * @param backend_data Texture to copy into
+ */
+void RendererSoft::TextureInterface::CopyEFB(const Rect& src_rect, const Rect& dst_rect,
+    const TextureManager::CacheEntry::BackendData* backend_data) {
+    SoftTexture* texture = const_cast<SoftTexture*>(static_cast<const SoftTexture*>(
+        backend_data));
+
+    parent_->CopyEFB(src_rect, &texture->texels_[0], texture->width_, texture->height_,
+        texture->is_depth_copy_, texture->is_intensity_copy_);
+}
+
+/**
+ * Binds a texture to a texture map
+ * @param active_texture_unit Texture map to bind to
+ * @param backend_data Texture to bind
+ */
+void RendererSoft::TextureInterface::Bind(int active_texture_unit,
+    const TextureManager::CacheEntry::BackendData* backend_data) {
+    parent_->samplers_[active_texture_unit].texture = static_cast<const SoftTexture*>(
+        backend_data);
+}
+
+/**
+ * Updates the texture parameters
+ * @param active_texture_unit Active texture unit to update the parameters for
+ * @param tex_mode_0 BP TexMode0 register to use for the update
+ * @param tex_mode_1 BP TexMode1 register to use for the update
+ */
+void RendererSoft::TextureInterface::UpdateParameters(int active_texture_unit,
+    const gp::BPTexMode0& tex_mode_0, const gp::BPTexMode1& tex_mode_1) {
+    SoftSampler& sampler = parent_->samplers_[active_texture_unit];
+
+    sampler.wrap_s = tex_mode_0.wrap_s;
+    sampler.wrap_t = tex_mode_0.wrap_t;
+    sampler.linear = tex_mode_0.mag_filter;
+}
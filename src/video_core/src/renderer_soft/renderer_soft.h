@@ -0,0 +1,399 @@
+/**
+ * Copyright (C) 2005-2012 Gekko Emulator
+ *
+ * @file    renderer_soft.h
+ * @author  ShizZy <shizzy247@gmail.com>
+ * @date    2013-02-27
+ * @brief   Software renderer, draws the EFB and XFB in RAM on the CPU
+ *
+ * @section LICENSE
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details at
+ * http://www.gnu.org/copyleft/gpl.html
+ *
+ * Official project repository can be found at:
+ * http://code.google.com/p/gekko-gc-emu/
+ */
+
+#ifndef VIDEO_CORE_RENDERER_SOFT_H_
+#define VIDEO_CORE_RENDERER_SOFT_H_
+
+#include <vector>
+
+#include "common.h"
+#include "gx_types.h"
+#include "renderer_base.h"
+
+#include "pixel_pipeline.h"
+#include "rasterizer.h"
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Software Renderer
+
+/**
+ * @brief Renderer that needs no GPU. Vertices are transformed and lit on the GP thread the way the
+ * generic shader does it, clipped and handed to the tile rasterizer, which shades them with an
+ * integer TEV into an EFB in RAM. EFB copies go to textures or to an XFB in RAM. Output only
+ * depends on the GP command stream, not on the number of rasterizer threads, so frames can be
+ * compared bit for bit between machines.
+ */
+class RendererSoft : virtual public RendererBase {
+public:
+
+    /// Distance vertices may be outside the EFB before they are clipped (in pixels)
+    static const int kGuardBand = 64;
+
+    RendererSoft();
+    ~RendererSoft();
+
+    /**
+     * Write data to BP for renderer internal use (e.g. direct to shader)
+     * @param addr BP register address
+     * @param data Value to write to BP register
+     */
+    void WriteBP(u8 addr, u32 data);
+
+    /**
+     * Write data to CP for renderer internal use (e.g. direct to shader)
+     * @param addr CP register address
+     * @param data Value to write to CP register
+     */
+    void WriteCP(u8 addr, u32 data) {}
+
+    /**
+     * Write data to XF for renderer internal use (e.g. direct to shader)
+     * @param addr XF address
+     * @param length Length (in 32-bit words) to write to XF
+     * @param data Data buffer to write to XF
+     */
+    void WriteXF(u16 addr, int length, u32* data) {}
+
+    /**
+     * Begin renderering of a primitive
+     * @param prim Primitive type (e.g. GX_TRIANGLES)
+     * @param count Number of vertices to be drawn (used for appropriate memory management, only)
+     * @param vbo Pointer to VBO, which will be set by API in this function
+     * @param vbo_offset Offset of the primitive into the current batch (in vertices, laid out
+     * as VertexLoader_GetLayout says for the current vertex state)
+     */
+    void BeginPrimitive(GXPrimitive prim, int count, u8** vbo, u32 vbo_offset);
+
+    /**
+     * Set the current vertex state (format and count of each vertex component)
+     * @param vertex_state VertexState structure of the current vertex state
+     */
+    void SetVertexState(const gp::VertexState& vertex_state) {
+        vertex_state_ = vertex_state;
+        gp::VertexLoader_GetLayout(vertex_state, &vertex_layout_);
+    }
+
+    /**
+     * Used to signal to the render that a region in XF is required by a primitive
+     * @param index Vector index in XF memory that is required
+     */
+    void VertexPosition_UseIndexXF(u8 index) {}
+
+    /**
+     * Draws a batch of primitives from the previously decoded vertex array
+     * @param prim Primitive type the batch is drawn as (GX_TRIANGLES, GX_LINES or GX_POINTS)
+     * @param vertex_num Number of vertices in the batch
+     * @param indices Index list of the batch, relative to the first vertex of the batch
+     * @param index_num Number of indices
+     */
+    void DrawPrimitives(GXPrimitive prim, u32 vertex_num, const u32* indices, int index_num);
+
+    /// Sets the renderer viewport location, width, and height (read from XF when drawing)
+    void SetViewport(int x, int y, int width, int height) {}
+
+    /// Swap buffers (render frame)
+    void SwapBuffers();
+
+    /// Sets the renderer depthrange, znear and zfar (read from XF when drawing)
+    void SetDepthRange(double znear, double zfar) {}
+
+    /// Sets the renderer depth test mode
+    void SetDepthMode();
+
+    /// Sets the renderer generation mode
+    void SetGenerationMode();
+
+    /**
+     * Sets the renderer blend mode
+     * @param pe_cmode_0 BPPECMode0 register to user for blend settings
+     * @param pe_cmode_1 BPPECMode1 register to user for blend settings
+     * @param blend_mode_ Forces blend mode to update
+     */
+    void SetBlendMode(const gp::BPPECMode0& pe_cmode_0, const gp::BPPECMode1& pe_cmode_1,
+        bool force_update);
+
+    /**
+     * Sets the renderer logic op mode
+     * @param pe_cmode_0 BPPECMode0 register to user for blend settings
+     */
+    void SetLogicOpMode(const gp::BPPECMode0& pe_cmode_0);
+
+    /**
+     * Sets the renderer dither mode
+     * @param pe_cmode_0 BPPECMode0 register to user for blend settings
+     */
+    void SetDitherMode(const gp::BPPECMode0& pe_cmode_0) {}
+
+    /**
+     * Sets the renderer color mask mode
+     * @param pe_cmode_0 BPPECMode0 register to user for blend settings
+     */
+    void SetColorMask(const gp::BPPECMode0& pe_cmode_0);
+
+    /* Sets the scissor box
+     * @param rect Renderer rectangle to set scissor box to
+     */
+    void SetScissorBox(const Rect& rect);
+
+    /**
+     * Sets the line and point size
+     * @param line_width Line width to use
+     * @param point_size Point size to use
+     */
+    void SetLinePointSize(f32 line_width, f32 point_size);
+
+    /**
+     * Blits the EFB to the external framebuffer (XFB)
+     * @param src_rect Source rectangle in EFB to copy
+     * @param dst_rect Destination rectangle in EFB to copy to
+     */
+    void CopyToXFB(const Rect& src_rect, const Rect& dst_rect);
+
+    /**
+     * Clear the screen
+     * @param rect Screen rectangle to clear
+     * @param enable_color Enable color clearing
+     * @param enable_alpha Enable alpha clearing
+     * @param enable_z Enable depth clearing
+     * @param color Clear color
+     * @param z Clear depth
+     */
+    void Clear(const Rect& rect, bool enable_color, bool enable_alpha, bool enable_z,
+        u32 color, u32 z);
+
+    /**
+     * Set a specific render mode
+     * @param flag Render flags mode to enable
+     */
+    void SetMode(kRenderMode flags) {}
+
+    /**
+     * Restore the render mode
+     * @param pe_cmode_0 BPPECMode0 register to user for blend settings
+     */
+    void RestoreMode(const gp::BPPECMode0& pe_cmode_0) {}
+
+    /// Reset the full renderer API to the NULL state
+    void ResetRenderState() {}
+
+    /// Restore the full renderer API state - As the game set it
+    void RestoreRenderState() {}
+
+    /**
+     * Set the emulator window to use for renderer
+     * @param window EmuWindow handle to emulator window to use for rendering
+     */
+    void SetWindow(EmuWindow* window) {}
+
+    /// Initialize the renderer
+    void Init();
+
+    /// Shutdown the renderer
+    void ShutDown();
+
+    /// Returns the last frame copied to the XFB (RGBA8, top row first)
+    const u8* xfb() const { return xfb_.empty() ? NULL : &xfb_[0]; }
+
+    /// Returns the width of the XFB in pixels
+    int xfb_width() const { return xfb_width_; }
+
+    /// Returns the height of the XFB in pixels
+    int xfb_height() const { return xfb_height_; }
+
+private:
+
+    /// Shader interface without shaders, the pixel stages evaluate the generic state instead
+    class ShaderInterface : virtual public ShaderManager::BackendInterface {
+    public:
+        ShaderInterface(RendererSoft* parent) : parent_(parent) {}
+        ~ShaderInterface() {}
+
+        ShaderManager::CacheEntry::BackendData* Create(const char* vs_header,
+            const char* fs_header) {
+            return NULL;
+        }
+        ShaderManager::CacheEntry::BackendData* CreateAsync(const char* vs_header,
+            const char* fs_header) {
+            return NULL;
+        }
+        bool IsReady(ShaderManager::CacheEntry::BackendData* backend_data) { return true; }
+        void BindGeneric(const ShaderManager::GenericState& state) {}
+        ShaderManager::CacheEntry::BackendData* CreateFromBinary(const u8* binary, size_t size) {
+            return NULL;
+        }
+        bool GetBinary(const ShaderManager::CacheEntry::BackendData* backend_data,
+            std::vector<u8>& binary) {
+            return false;
+        }
+        std::string GetBinaryTag() { return "software"; }
+        void Delete(ShaderManager::CacheEntry::BackendData* backend_data) {}
+        void Bind(const ShaderManager::CacheEntry::BackendData* backend_data) {}
+
+    private:
+        RendererSoft* parent_;
+
+        DISALLOW_COPY_AND_ASSIGN(ShaderInterface);
+    };
+
+    /// Texture interface keeping the decoded textures in RAM
+    class TextureInterface : virtual public TextureManager::BackendInterface {
+    public:
+        TextureInterface(RendererSoft* parent) : parent_(parent) {}
+        ~TextureInterface() {}
+
+        TextureManager::CacheEntry::BackendData* Create(int active_texture_unit,
+            const TextureManager::CacheEntry& cache_entry, u8* raw_data);
+        void Delete(TextureManager::CacheEntry::BackendData* backend_data);
+        void CopyEFB(const Rect& src_rect, const Rect& dst_rect,
+            const TextureManager::CacheEntry::BackendData* backend_data);
+        void Bind(int active_texture_unit,
+            const TextureManager::CacheEntry::BackendData* backend_data);
+        void UpdateParameters(int active_texture_unit, const gp::BPTexMode0& tex_mode_0,
+            const gp::BPTexMode1& tex_mode_1);
+
+    private:
+        RendererSoft* parent_;
+
+        DISALLOW_COPY_AND_ASSIGN(TextureInterface);
+    };
+
+    /// Vertex after transform and lighting, in clip space with the viewport applied
+    struct ClipVertex {
+        f32 x;                                      ///< EFB x multiplied by w
+        f32 y;                                      ///< EFB y multiplied by w
+        f32 z;                                      ///< 24-bit depth multiplied by w
+        f32 w;
+        f32 clip_z;                                 ///< Clip space z, -w (near) to 0 (far)
+        f32 colors[kGCMaxVertexColors][4];          ///< Color channels (RGBA, 0-255)
+        f32 texcoords[kGCMaxActiveTextures][2];     ///< Texture coordinates
+    };
+
+    /// Clip planes, the GC's near plane and the guard band around the EFB
+    enum ClipPlane {
+        kClipPlane_W = 0,
+        kClipPlane_Near,
+        kClipPlane_Left,
+        kClipPlane_Right,
+        kClipPlane_Top,
+        kClipPlane_Bottom,
+        kNumClipPlanes
+    };
+
+    /// Maximum number of vertices a triangle can have after clipping
+    static const int kMaxClipVertices = 3 + kNumClipPlanes;
+
+    /**
+     * Transforms and lights the vertices of the batch, like the generic vertex shader
+     * @param vertex_num Number of vertices in the batch
+     */
+    void TransformVertices(u32 vertex_num);
+
+    /// Captures the draw state of the pixel stages and hands it to the rasterizer
+    void UpdateDrawState();
+
+    /**
+     * Gets a TEV konst color
+     * @param sel Konst selection of BPTevKSel
+     * @param out Result color (RGBA, 0-255)
+     */
+    void GetKonst(int sel, s16* out) const;
+
+    /// Distance of a vertex to a clip plane, negative if it's clipped
+    static f32 ClipDistance(const ClipVertex& vertex, int plane);
+
+    /// Interpolates between two vertices
+    static void LerpVertex(const ClipVertex& a, const ClipVertex& b, f32 t, ClipVertex& out);
+
+    /// Divides by w, giving the vertex the rasterizer takes
+    static void ProjectVertex(const ClipVertex& in, SoftVertex& out);
+
+    /**
+     * Clips, culls and draws a triangle
+     * @param v0 First vertex
+     * @param v1 Second vertex
+     * @param v2 Third vertex
+     */
+    void DrawTriangle(const ClipVertex& v0, const ClipVertex& v1, const ClipVertex& v2);
+
+    /**
+     * Clips and draws a line as a quad of the line width
+     * @param v0 First vertex
+     * @param v1 Second vertex
+     */
+    void DrawLine(const ClipVertex& v0, const ClipVertex& v1);
+
+    /**
+     * Draws a point as a square of the point size
+     * @param v Vertex
+     */
+    void DrawPoint(const ClipVertex& v);
+
+    /**
+     * Copies a region of the EFB, box filtered to the destination size
+     * @param src_rect Source rectangle in renderer coordinates
+     * @param dst Destination (RGBA8, top row first)
+     * @param dst_width Width of the destination in pixels
+     * @param dst_height Height of the destination in pixels
+     * @param depth Copy the Z buffer rather than the color buffer
+     * @param intensity Convert the copy to intensity
+     */
+    void CopyEFB(const Rect& src_rect, u8* dst, int dst_width, int dst_height, bool depth,
+        bool intensity);
+
+    /**
+     * Converts a rectangle in renderer coordinates (bottom up) to EFB pixels (top down)
+     * @param rect Renderer rectangle
+     * @return EFB rectangle, ordered and clamped to the EFB, x1/y1 exclusive
+     */
+    static Rect RendererToEFBRect(const Rect& rect);
+
+    Rasterizer*                 rasterizer_;
+    u8*                         vbo_;               ///< Vertex storage for one batch
+    std::vector<ClipVertex>     clip_vertices_;     ///< Transformed vertices of the batch
+    gp::VertexState             vertex_state_;
+    gp::VertexLayout            vertex_layout_;     ///< Layout of vertices with vertex_state_
+
+    ShaderManager::GenericState generic_state_;     ///< Generic shader state of the batch
+    SoftDrawState               draw_state_;        ///< Draw state of the last batch
+    SoftSampler                 samplers_[kGCMaxTextureMaps];
+    s16                         tev_registers_[4][4];   ///< TEV registers set by BP (RGBA)
+    s16                         konst_registers_[4][4]; ///< TEV konst colors set by BP (RGBA)
+    gp::BPPECMode0              cmode0_;
+    gp::BPPECMode1              cmode1_;
+    gp::BPPEZMode               zmode_;
+    int                         cull_mode_;         ///< 0 - none, 1 - back, 2 - front, 3 - all
+    Rect                        scissor_;           ///< Scissor box in EFB pixels
+    f32                         line_width_;        ///< Line width in pixels
+    f32                         point_size_;        ///< Point size in pixels
+
+    std::vector<u8>             xfb_;               ///< Last XFB copy (RGBA8)
+    int                         xfb_width_;
+    int                         xfb_height_;
+    u32                         last_fps_ticks_;    ///< SDL ticks when the FPS were last updated
+    int                         fps_frames_;        ///< Frames since the FPS were last updated
+
+    DISALLOW_COPY_AND_ASSIGN(RendererSoft);
+};
+
+#endif // VIDEO_CORE_RENDERER_SOFT_H_
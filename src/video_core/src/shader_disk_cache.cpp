@@ -0,0 +1,165 @@
+/**
+ * Copyright (C) 2005-2012 Gekko Emulator
+ *
+ * @file    shader_disk_cache.cpp
+ * @author  ShizZy <shizzy247@gmail.com>
+ * @date    2013-02-25
+ * @brief   On-disk store of generated shaders and their compiled binaries, one file per game
+ *
+ * @section LICENSE
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details at
+ * http://www.gnu.org/copyleft/gpl.html
+ *
+ * Official project repository can be found at:
+ * http://code.google.com/p/gekko-gc-emu/
+ */
+
+#include "shader_disk_cache.h"
+
+static const u32 kMagicNum      = 0x43485347;   ///< "GSHC"
+static const u32 kMaxRecordSize = 0x1000000;    ///< Anything bigger is a corrupt record
+
+struct FileHeader {
+    u32 magic_num;
+    u32 version;
+    u32 tag_size;       ///< Followed by the binary tag
+};
+
+struct RecordHeader {
+    u64 hash;
+    u32 vs_size;
+    u32 fs_size;
+    u32 binary_size;    ///< Followed by the vertex header, fragment header and binary
+    u32 reserved;
+};
+
+ShaderDiskCache::ShaderDiskCache() : file_(NULL) {
+}
+
+ShaderDiskCache::~ShaderDiskCache() {
+    Close();
+}
+
+/// Read all records of a cache file
+bool ShaderDiskCache::Load(const std::string& filename, const std::string& binary_tag,
+    std::vector<Entry>& entries) {
+    FileHeader header;
+    RecordHeader record;
+    std::string tag;
+
+    entries.clear();
+    FILE* file = fopen(filename.c_str(), "rb");
+    if (file == NULL) {
+        return false;
+    }
+    if (fread(&header, sizeof(header), 1, file) != 1 || header.magic_num != kMagicNum ||
+        header.version != kVersion || header.tag_size > kMaxRecordSize) {
+        LOG_NOTICE(TVIDEO, "Shader cache %s is from another version, discarding it",
+            filename.c_str());
+        fclose(file);
+        return false;
+    }
+    tag.resize(header.tag_size);
+    if (header.tag_size && fread(&tag[0], header.tag_size, 1, file) != 1) {
+        fclose(file);
+        return false;
+    }
+    bool keep_binaries = (tag == binary_tag);
+    bool complete = true;
+
+    for (;;) {
+        size_t header_size = fread(&record, 1, sizeof(record), file);
+        if (header_size == 0) {
+            break;
+        }
+        if (header_size != sizeof(record) || record.vs_size > kMaxRecordSize ||
+            record.fs_size > kMaxRecordSize || record.binary_size > kMaxRecordSize) {
+            complete = false;
+            break;
+        }
+        Entry entry;
+        entry.hash = record.hash;
+        entry.vs_header.resize(record.vs_size);
+        entry.fs_header.resize(record.fs_size);
+        entry.binary.resize(record.binary_size);
+        if ((record.vs_size && fread(&entry.vs_header[0], record.vs_size, 1, file) != 1) ||
+            (record.fs_size && fread(&entry.fs_header[0], record.fs_size, 1, file) != 1) ||
+            (record.binary_size && fread(&entry.binary[0], record.binary_size, 1, file) != 1)) {
+            complete = false; // Cut short while it was written
+            break;
+        }
+        if (!keep_binaries) {
+            entry.binary.clear();
+        }
+        entries.push_back(entry);
+    }
+    fclose(file);
+
+    if (!keep_binaries) {
+        LOG_NOTICE(TVIDEO, "Shader cache %s was compiled by another driver, recompiling %d shaders",
+            filename.c_str(), (int)entries.size());
+    }
+    // Records appended after a broken one couldn't be read back
+    return keep_binaries && complete;
+}
+
+/// Open a cache file for appending records
+bool ShaderDiskCache::Open(const std::string& filename, const std::string& binary_tag,
+    bool truncate) {
+    Close();
+
+    if (!truncate) {
+        file_ = fopen(filename.c_str(), "ab");
+        return (file_ != NULL);
+    }
+    file_ = fopen(filename.c_str(), "wb");
+    if (file_ == NULL) {
+        LOG_ERROR(TVIDEO, "Unable to create shader cache %s", filename.c_str());
+        return false;
+    }
+    FileHeader header;
+    header.magic_num    = kMagicNum;
+    header.version      = kVersion;
+    header.tag_size     = (u32)binary_tag.size();
+    fwrite(&header, sizeof(header), 1, file_);
+    fwrite(binary_tag.data(), binary_tag.size(), 1, file_);
+    fflush(file_);
+    return true;
+}
+
+/// Close the cache file
+void ShaderDiskCache::Close() {
+    if (file_ != NULL) {
+        fclose(file_);
+        file_ = NULL;
+    }
+}
+
+/// Append a record and flush it out to disk
+void ShaderDiskCache::Append(const Entry& entry) {
+    if (file_ == NULL) {
+        return;
+    }
+    RecordHeader record;
+    record.hash         = entry.hash;
+    record.vs_size      = (u32)entry.vs_header.size();
+    record.fs_size      = (u32)entry.fs_header.size();
+    record.binary_size  = (u32)entry.binary.size();
+    record.reserved     = 0;
+
+    fwrite(&record, sizeof(record), 1, file_);
+    fwrite(entry.vs_header.data(), entry.vs_header.size(), 1, file_);
+    fwrite(entry.fs_header.data(), entry.fs_header.size(), 1, file_);
+    if (!entry.binary.empty()) {
+        fwrite(&entry.binary[0], entry.binary.size(), 1, file_);
+    }
+    fflush(file_);
+}
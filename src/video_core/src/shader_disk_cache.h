@@ -0,0 +1,94 @@
+/**
+ * Copyright (C) 2005-2012 Gekko Emulator
+ *
+ * @file    shader_disk_cache.h
+ * @author  ShizZy <shizzy247@gmail.com>
+ * @date    2013-02-25
+ * @brief   On-disk store of generated shaders and their compiled binaries, one file per game
+ *
+ * @section LICENSE
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details at
+ * http://www.gnu.org/copyleft/gpl.html
+ *
+ * Official project repository can be found at:
+ * http://code.google.com/p/gekko-gc-emu/
+ */
+
+#ifndef VIDEO_CORE_SHADER_DISK_CACHE_H_
+#define VIDEO_CORE_SHADER_DISK_CACHE_H_
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "common.h"
+#include "hash.h"
+
+/**
+ * @brief Shader cache file. A file starts with a header holding the format version and the tag of
+ * the backend that compiled the binaries, followed by one record per shader. New shaders are
+ * appended as they are created, a record cut short by a crash is ignored on the next load.
+ */
+class ShaderDiskCache {
+public:
+    /// Bump when the shader generator changes, so old files get dropped
+    static const u32 kVersion = 2;
+
+    /// Shader record
+    struct Entry {
+        common::Hash64      hash;       ///< ShaderManager state hash
+        std::string         vs_header;  ///< Generated vertex shader header
+        std::string         fs_header;  ///< Generated fragment shader header
+        std::vector<u8>     binary;     ///< Backend program binary, empty if there is none
+    };
+
+    ShaderDiskCache();
+    ~ShaderDiskCache();
+
+    /**
+     * @brief Read all records of a cache file
+     * @param filename Path of the cache file
+     * @param binary_tag Tag of the backend, binaries saved under another tag are dropped
+     * @param entries Receives the records
+     * @return True if the file is intact and has this version and binary tag, false if it has to
+     * be rewritten
+     */
+    static bool Load(const std::string& filename, const std::string& binary_tag,
+        std::vector<Entry>& entries);
+
+    /**
+     * @brief Open a cache file for appending records
+     * @param filename Path of the cache file
+     * @param binary_tag Tag of the backend
+     * @param truncate Start a new file instead of appending to the current one
+     * @return True on success
+     */
+    bool Open(const std::string& filename, const std::string& binary_tag, bool truncate);
+
+    /// Close the cache file
+    void Close();
+
+    /**
+     * @brief Append a record and flush it out to disk
+     * @param entry Shader record to write
+     */
+    void Append(const Entry& entry);
+
+    /// Returns true if a cache file is open
+    bool IsOpen() const { return file_ != NULL; }
+
+private:
+    FILE*   file_;
+
+    DISALLOW_COPY_AND_ASSIGN(ShaderDiskCache);
+};
+
+#endif // VIDEO_CORE_SHADER_DISK_CACHE_H_
@@ -24,6 +24,8 @@
 
 #include "hash.h"
 #include "misc_utils.h"
+#include "file_utils.h"
+#include "config.h"
 
 #include "shader_manager.h"
 
@@ -39,9 +41,15 @@ ShaderManager::ShaderManager(const BackendInterface* backend_interface) {
     active_shader_      = new CacheEntry(); // Something that is empty so this isn't NULL
     vsh_                = new ShaderHeader();
     fsh_                = new ShaderHeader();
+    disk_cache_         = new ShaderDiskCache();
+    async_              = common::g_config->current_renderer_config().enable_async_shaders;
+
+    // State hashes are saved to disk, so unused bits must be the same every run
+    memset(&state_, 0, sizeof(state_));
 }
 
 ShaderManager::~ShaderManager() {
+    delete disk_cache_;
     delete cache_;
     delete active_shader_;
     delete vsh_;
@@ -349,7 +357,7 @@ void ShaderManager::GenerateFragmentHeader() {
             int texmap = state_.fields.tev_order[reg_index].get_texmap(stage);
             
             // Set texture to 0 if texgen is disabled...
-            if (!(u32)texcoord < gp::g_bp_regs.genmode.num_texgens) {
+            if ((u32)texcoord >= gp::g_bp_regs.genmode.num_texgens) {
                 texcoord = 0;
             }
             /*TextureManager::CacheEntry* tex_entry = video_core::g_texture_manager->active_textures_[texmap];
@@ -415,6 +423,108 @@ void ShaderManager::GenerateFragmentHeader() {
     }
 }
 
+/**
+ * Fills in the generic shader state for the current state
+ * @param generic_state Result generic shader state
+ */
+void ShaderManager::GenerateGenericState(GenericState& generic_state) {
+    const gp::VertexState& vertex_state = state_.fields.vertex_state;
+
+    memset(&generic_state, 0, sizeof(generic_state));
+
+    // Fragment state, same sources as GenerateFragmentHeader
+    // ------------------------------------------------------
+
+    for (int stage = 0; stage <= gp::g_bp_regs.genmode.num_tevstages; stage++) {
+        GenericState::Stage& dst = generic_state.stages[stage];
+        const gp::BPTevCombiner& combiner = state_.fields.tev_combiner[stage];
+        const gp::BPTevOrder& tev_order = state_.fields.tev_order[stage / 2];
+
+        dst.color_sel[0] = combiner.color.sel_a;
+        dst.color_sel[1] = combiner.color.sel_b;
+        dst.color_sel[2] = combiner.color.sel_c;
+        dst.color_sel[3] = combiner.color.sel_d;
+        dst.alpha_sel[0] = combiner.alpha.sel_a;
+        dst.alpha_sel[1] = combiner.alpha.sel_b;
+        dst.alpha_sel[2] = combiner.alpha.sel_c;
+        dst.alpha_sel[3] = combiner.alpha.sel_d;
+        dst.dest[0] = combiner.color.dest;
+        dst.dest[1] = combiner.alpha.dest;
+        dst.dest[2] = gp::g_bp_regs.combiner[stage].color.clamp;
+        dst.dest[3] = gp::g_bp_regs.combiner[stage].alpha.clamp;
+
+        dst.texture[0] = -1;
+        if (gp::g_bp_regs.tevorder[stage / 2].get_enable(stage)) {
+            int texcoord = tev_order.get_texcoord(stage);
+            if ((u32)texcoord >= gp::g_bp_regs.genmode.num_texgens) {
+                texcoord = 0;
+            }
+            dst.texture[0] = tev_order.get_texmap(stage);
+            dst.texture[1] = texcoord;
+        }
+        dst.texture[2] = tev_order.get_colorchan(stage);
+    }
+    generic_state.fragment[0] = state_.fields.num_stages;
+    generic_state.fragment[1] = state_.fields.alpha_func.comp0;
+    generic_state.fragment[2] = state_.fields.alpha_func.comp1;
+    generic_state.fragment[3] = state_.fields.alpha_func.logic;
+
+    generic_state.output[0] = state_.fields.efb_format;
+    generic_state.output[1] = (state_.fields.flags & kFlag_DestinationAlpha) ? 1 : 0;
+    generic_state.output[2] = gp::g_bp_regs.combiner[gp::g_bp_regs.genmode.num_tevstages].color.dest;
+    generic_state.output[3] = gp::g_bp_regs.combiner[gp::g_bp_regs.genmode.num_tevstages].alpha.dest;
+
+    // Vertex state, same sources as GenerateVertexHeader
+    // --------------------------------------------------
+
+    generic_state.vertex[0] = state_.fields.flags;
+    generic_state.vertex[1] = vertex_state.col[0].attr_type ? 
+        (int)gp::g_cp_regs.vat_reg_a[gp::g_cur_vat].col0_type : -1;
+    generic_state.vertex[2] = vertex_state.col[1].attr_type ? 
+        (int)gp::g_cp_regs.vat_reg_a[gp::g_cur_vat].col1_type : -1;
+    generic_state.vertex[3] = state_.fields.num_color_chans;
+
+    for (int chan_num = 0; chan_num < 2; chan_num++) {
+        GenericState::Channel& dst = generic_state.channels[chan_num];
+        const gp::XFLitChannel& color = state_.fields.color_channel[chan_num];
+        const gp::XFLitChannel& alpha = state_.fields.alpha_channel[chan_num];
+
+        // Unused channels come out white
+        if (chan_num >= (int)state_.fields.num_color_chans) {
+            for (int i = 0; i < 4; i++) {
+                dst.source[i] = kGenericSource_One;
+            }
+            continue;
+        }
+        // Vertex color of this channel, if the vertex has one
+        int vertex_src = -1;
+        if (chan_num == 1 && vertex_state.col[1].attr_type) {
+            vertex_src = kGenericSource_Color1;
+        } else if (chan_num == 0 && vertex_state.col[0].attr_type) {
+            vertex_src = kGenericSource_Color0;
+        }
+        dst.source[0] = !color.material_src ? kGenericSource_Register : 
+            (vertex_src >= 0 ? vertex_src : kGenericSource_One);
+        dst.source[1] = !alpha.material_src ? kGenericSource_Register : 
+            (vertex_src >= 0 ? vertex_src : kGenericSource_One);
+        dst.source[2] = kGenericSource_One;
+        dst.source[3] = kGenericSource_One;
+        if (color.enable_lighting) {
+            dst.source[2] = !color.ambsource ? kGenericSource_Register : 
+                (vertex_src >= 0 ? vertex_src : kGenericSource_Zero);
+        }
+        // Alpha ambient follows the material source bit, as in GenerateVertexLightingHeader
+        if (alpha.enable_lighting) {
+            dst.source[3] = !alpha.material_src ? kGenericSource_Register : 
+                (vertex_src >= 0 ? vertex_src : kGenericSource_Zero);
+        }
+        dst.lighting[0] = color.get_light_mask();
+        dst.lighting[1] = alpha.get_light_mask();
+        dst.lighting[2] = color.attn_func | (color.diffuse_func << 2);
+        dst.lighting[3] = alpha.attn_func | (alpha.diffuse_func << 2);
+    }
+}
+
 void ShaderManager::Bind() {
     static CacheEntry   cache_entry;
     cache_entry.hash_ = common::GetHash64(state_.mem, sizeof(State), 0);
@@ -425,12 +535,148 @@ void ShaderManager::Bind() {
             this->GenerateVertexHeader();
             this->GenerateFragmentHeader();
 
-            cache_entry.backend_data_ = backend_interface_->Create(vsh_->Read(), fsh_->Read());
+            // Don't stall the GP on the compile, draw with the generic shader until it's done
+            if (async_) {
+                cache_entry.backend_data_ = backend_interface_->CreateAsync(vsh_->Read(), 
+                    fsh_->Read());
+                cache_entry.ready_ = false;
+            } else {
+                cache_entry.backend_data_ = backend_interface_->Create(vsh_->Read(), fsh_->Read());
+                cache_entry.ready_ = true;
+            }
 
             // Update cache with new information...
             active_shader_ = cache_->Update(cache_entry.hash_, cache_entry);
+
+            if (disk_cache_->IsOpen()) {
+                ShaderDiskCache::Entry entry;
+                entry.hash      = cache_entry.hash_;
+                entry.vs_header = vsh_->Read();
+                entry.fs_header = fsh_->Read();
+                if (cache_entry.ready_) {
+                    SaveToDiskCache(entry, cache_entry.backend_data_);
+                } else {
+                    pending_saves_.push_back(entry);
+                }
+            }
+        } else {
+            cache_->Touch(active_shader_);
+        }
+        if (active_shader_->ready_) {
+            backend_interface_->Bind(active_shader_->backend_data_);
+        } else {
+            GenerateGenericState(generic_state_);
+        }
+    }
+    if (!active_shader_->ready_) {
+        if (backend_interface_->IsReady(active_shader_->backend_data_)) {
+            active_shader_->ready_ = true;
+            backend_interface_->Bind(active_shader_->backend_data_);
+            FlushPendingSaves();
+        } else {
+            backend_interface_->BindGeneric(generic_state_);
         }
-        backend_interface_->Bind(active_shader_->backend_data_);
     }
     active_shader_->frame_used_ = video_core::g_current_frame;
 }
+
+/// Writes the shaders that finished compiling meanwhile to the on-disk cache
+void ShaderManager::FlushPendingSaves() {
+    for (size_t i = 0; i < pending_saves_.size(); ) {
+        CacheEntry* cache_entry = cache_->FetchFromHash(pending_saves_[i].hash);
+
+        if (NULL != cache_entry && !cache_entry->ready_) {
+            if (!backend_interface_->IsReady(cache_entry->backend_data_)) {
+                i++;
+                continue;
+            }
+            cache_entry->ready_ = true;
+        }
+        if (NULL != cache_entry) {
+            SaveToDiskCache(pending_saves_[i], cache_entry->backend_data_);
+        }
+        pending_saves_.erase(pending_saves_.begin() + i);
+    }
+}
+
+/**
+ * Loads the on-disk shader cache of a game and compiles all of its shaders. Shaders created
+ * from then on are added to it
+ * @param game_id ID of the game (e.g. GALE01), nothing is cached if empty
+ */
+void ShaderManager::LoadDiskCache(const char* game_id) {
+    std::vector<ShaderDiskCache::Entry> entries;
+    std::vector<int> loaded;
+
+    disk_cache_->Close();
+    pending_saves_.clear();
+    if (!common::g_config->current_renderer_config().enable_shader_cache || NULL == game_id ||
+        '\0' == game_id[0]) {
+        return;
+    }
+    std::string filepath = common::g_config->program_dir() + std::string("user/shaders/");
+    common::CreateFullPath(filepath);
+    filepath = common::FormatStr("%s%s.gsc", filepath.c_str(), game_id);
+
+    std::string binary_tag = backend_interface_->GetBinaryTag();
+    bool intact = ShaderDiskCache::Load(filepath, binary_tag, entries);
+
+    // Compile everything now, so that the game doesn't stall on it later. Shaders compiled in the
+    // background are written back once they are done
+    for (int i = 0; i < (int)entries.size(); i++) {
+        const ShaderDiskCache::Entry& entry = entries[i];
+        if (NULL != cache_->FetchFromHash(entry.hash)) {
+            intact = false; // Saved twice
+            continue;
+        }
+        CacheEntry cache_entry;
+        cache_entry.hash_ = entry.hash;
+        if (!entry.binary.empty()) {
+            cache_entry.backend_data_ = backend_interface_->CreateFromBinary(&entry.binary[0],
+                entry.binary.size());
+        }
+        if (NULL == cache_entry.backend_data_) {
+            if (async_) {
+                cache_entry.backend_data_ = backend_interface_->CreateAsync(
+                    entry.vs_header.c_str(), entry.fs_header.c_str());
+                cache_entry.ready_ = false;
+            } else {
+                cache_entry.backend_data_ = backend_interface_->Create(entry.vs_header.c_str(),
+                    entry.fs_header.c_str());
+            }
+            intact = false;
+        }
+        cache_->Update(cache_entry.hash_, cache_entry);
+        loaded.push_back(i);
+    }
+    LOG_NOTICE(TVIDEO, "Loaded %d shaders from %s", (int)loaded.size(), filepath.c_str());
+
+    // Keep appending to the file if it is good, otherwise write it out again with fresh binaries
+    if (intact) {
+        disk_cache_->Open(filepath, binary_tag, false);
+    } else if (disk_cache_->Open(filepath, binary_tag, true)) {
+        for (size_t i = 0; i < loaded.size(); i++) {
+            ShaderDiskCache::Entry& entry = entries[loaded[i]];
+            const CacheEntry* cache_entry = cache_->FetchFromHash(entry.hash);
+            if (cache_entry->ready_) {
+                SaveToDiskCache(entry, cache_entry->backend_data_);
+            } else {
+                entry.binary.clear();
+                pending_saves_.push_back(entry);
+            }
+        }
+    }
+}
+
+/**
+ * Writes a newly created shader to the on-disk cache
+ * @param entry Shader record, its binary is filled in from the backend
+ * @param backend_data Renderer-specific shader data of the shader
+ */
+void ShaderManager::SaveToDiskCache(ShaderDiskCache::Entry& entry,
+    const CacheEntry::BackendData* backend_data) {
+    if (!backend_interface_->GetBinary(backend_data, entry.binary)) {
+        entry.binary.clear();
+    }
+    disk_cache_->Append(entry);
+}
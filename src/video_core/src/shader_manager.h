@@ -31,6 +31,7 @@
 #include "bp_mem.h"
 #include "xf_mem.h"
 #include "vertex_loader.h"
+#include "shader_disk_cache.h"
 
 
 #ifndef VIDEO_CORE_SHADER_MANAGER_H_
@@ -70,6 +71,38 @@ public:
         kVertexComponent_NumberOf
     };
 
+    /// Where the generic shader takes a lighting channel's material or ambient color from
+    enum GenericSource {
+        kGenericSource_Zero = 0,
+        kGenericSource_One,
+        kGenericSource_Register,    ///< XF material/ambient color register
+        kGenericSource_Color0,      ///< Vertex color 0
+        kGenericSource_Color1       ///< Vertex color 1
+    };
+
+    /**
+     * Shader state as read by the generic shader, which does every TEV and lighting setup through
+     * uniforms rather than defines. Laid out as the std140 _GENERIC_UBO block of the default shaders
+     */
+    struct GenericState {
+        struct Stage {
+            s32 color_sel[4];   ///< TEV color inputs a, b, c, d
+            s32 alpha_sel[4];   ///< TEV alpha inputs a, b, c, d
+            s32 dest[4];        ///< Color dest, alpha dest, color clamp, alpha clamp
+            s32 texture[4];     ///< Texture map (-1 if disabled), texture coordinate, raster color
+        } stages[kGCMaxTevStages];
+        struct Channel {
+            s32 source[4];      ///< GenericSource of material color, material alpha, ambient color
+                                ///< and ambient alpha
+            s32 lighting[4];    ///< Color light mask, alpha light mask, color attenuation and
+                                ///< diffuse function (attn_func | diffuse_func << 2), alpha function
+        } channels[2];
+        s32 fragment[4];        ///< Last stage, alpha compare 0, alpha compare 1, compare logic
+        s32 output[4];          ///< EFB format, destination alpha, final color dest, final alpha dest
+        s32 vertex[4];          ///< Flags, vertex color 0 format (-1 if absent), vertex color 1
+                                ///< format, number of color channels
+    };
+
     /// Shader cache entry
     class CacheEntry {
     public:
@@ -84,21 +117,23 @@ public:
             backend_data_   = NULL; 
             hash_           = 0;
             frame_used_     = -1;
+            ready_          = true;
         }
         ~CacheEntry() { 
         }
         BackendData*        backend_data_;  ///< Pointer to backend renderer data
         common::Hash64      hash_;          ///< Hash of the shader state
         int                 frame_used_;    ///< Last frame that the shader was used
+        bool                ready_;         ///< False while the backend is still compiling it
     };
 
-    typedef HashContainer_STLMap<common::Hash64, CacheEntry> CacheContainer;
+    typedef HashContainer_LRU<common::Hash64, CacheEntry> CacheContainer;
 
     /// Renderer interface for controlling shaders
     class BackendInterface{
     public:
         BackendInterface() { }
-        ~BackendInterface() { }
+        virtual ~BackendInterface() { }
 
         /**
          * Create a new shader in the backend renderer
@@ -108,6 +143,54 @@ public:
          */
         virtual CacheEntry::BackendData* Create(const char* vs_header, const char* fs_header) = 0;
 
+        /**
+         * Start creating a new shader in the backend renderer without waiting for it to compile
+         * @param vs_header Vertex shader header definitions
+         * @param fs_header Fragment shader header definitions
+         * @return a pointer to CacheEntry::BackendData with renderer-specific shader data, which
+         * can't be bound or saved before IsReady returns true for it
+         */
+        virtual CacheEntry::BackendData* CreateAsync(const char* vs_header,
+            const char* fs_header) = 0;
+
+        /**
+         * Checks if a shader started by CreateAsync has finished compiling, without waiting on it
+         * @param backend_data Renderer-specific shader data of the shader
+         * @return True if the shader can be used
+         */
+        virtual bool IsReady(CacheEntry::BackendData* backend_data) = 0;
+
+        /**
+         * Binds the generic shader to the backend renderer, set up for the current draw state
+         * @param state Shader state for the generic shader
+         */
+        virtual void BindGeneric(const GenericState& state) = 0;
+
+        /**
+         * Create a shader in the backend renderer from a binary returned by GetBinary
+         * @param binary Shader binary
+         * @param size Size of the binary in bytes
+         * @return a pointer to CacheEntry::BackendData with renderer-specific shader data, NULL if
+         * the binary was rejected
+         */
+        virtual CacheEntry::BackendData* CreateFromBinary(const u8* binary, size_t size) = 0;
+
+        /**
+         * Gets the binary of a shader, for the on-disk shader cache
+         * @param backend_data Renderer-specific shader data of the shader
+         * @param binary Result shader binary
+         * @return True on success, false if the backend can't save shader binaries
+         */
+        virtual bool GetBinary(const CacheEntry::BackendData* backend_data,
+            std::vector<u8>& binary) = 0;
+
+        /**
+         * Gets a tag identifying what the shader binaries were built with (e.g. driver version),
+         * saved binaries are only loaded again under the same tag
+         * @return String tag
+         */
+        virtual std::string GetBinaryTag() = 0;
+
         /**
          * Delete a shader from the backend renderer
          * @param backend_data Renderer-specific shader data used by renderer to remove it
@@ -151,6 +234,20 @@ public:
      */
     void Purge(int age_limit=280);
 
+    /**
+     * Loads the on-disk shader cache of a game and compiles all of its shaders. Shaders created
+     * from then on are added to it
+     * @param game_id ID of the game (e.g. GALE01), nothing is cached if empty
+     */
+    void LoadDiskCache(const char* game_id);
+
+    /**
+     * Gets the generic shader state of the current state, for backends that evaluate it directly
+     * rather than compiling the generated shaders
+     * @param generic_state Result generic shader state
+     */
+    void GetGenericState(GenericState& generic_state) { GenerateGenericState(generic_state); }
+
     // Update - this is the interface used by the rest of the video core to produce the shader
     ////////////////////////////////////////////////////////////////////////////////////////////////
 
@@ -169,6 +266,12 @@ private:
     CacheEntry*         active_shader_;         ///< Pointer to active shader in shader cache
     CacheContainer*     cache_;                 ///< Shader cache
     BackendInterface*   backend_interface_;     ///< Backend renderer interface
+    ShaderDiskCache*    disk_cache_;            ///< On-disk cache of the running game
+    bool                async_;                 ///< Compile new shaders in the background
+    GenericState        generic_state_;         ///< Generic shader state of the active shader
+
+    /// Shaders to write to the on-disk cache once their compile finishes
+    std::vector<ShaderDiskCache::Entry> pending_saves_;
 
     /// Structure to hold the current shader state
     union State {
@@ -243,6 +346,23 @@ private:
     /// Generates the fragment shader header for the current state
     void GenerateFragmentHeader();
 
+    /**
+     * Fills in the generic shader state for the current state
+     * @param generic_state Result generic shader state
+     */
+    void GenerateGenericState(GenericState& generic_state);
+
+    /// Writes the shaders that finished compiling meanwhile to the on-disk cache
+    void FlushPendingSaves();
+
+    /**
+     * Writes a newly created shader to the on-disk cache
+     * @param entry Shader record, its binary is filled in from the backend
+     * @param backend_data Renderer-specific shader data of the shader
+     */
+    void SaveToDiskCache(ShaderDiskCache::Entry& entry,
+        const CacheEntry::BackendData* backend_data);
+
     DISALLOW_COPY_AND_ASSIGN(ShaderManager);
 };
 
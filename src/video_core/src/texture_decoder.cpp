@@ -26,147 +26,249 @@
 #include "common.h"
 #include "config.h"
 #include "memory.h"
+#include "x86_utils.h"
 #include "hw/hw_gx.h"
 #include "bp_mem.h"
 #include "texture_decoder.h"
+#include "texture_decoder_simd.h"
 #include "video_core.h"
 #include "fifo_player.h"
 
-#include <vector>
-using namespace std;
-
 namespace gp {
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
 u8 tmem[TMEM_SIZE];
 
+/// Decoder used for each format, picked for the host CPU by TextureDecoder_Init
+static TextureDecodeFunc g_decoders[kTextureFormat_None];
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 // TEXTURE FORMAT DECODING
 
-static inline u32 __decode_col_rgb5a3(u16 _data) {
-    u8 r, g, b, a;
-
-    if (_data & SIGNED_BIT16) // rgb5
-    {
-        r = (u8)(255.0f * (((_data >> 10) & 0x1f) / 32.0f));
-        g = (u8)(255.0f * (((_data >> 5) & 0x1f) / 32.0f));
-        b = (u8)(255.0f * ((_data & 0x1f) / 32.0f));
-        a = 0xff;	
-    }else{ // rgb4a3
-        r = 17 * ((_data >> 8) & 0xf);
-        g = 17 * ((_data >> 4) & 0xf);
-        b = 17 * (_data & 0xf);
-        a = (u8)(255.0f * (((_data >> 12) & 7) / 8.0f));
+// Generic tile decoders, these handle any host and are the reference for the SIMD versions. Each
+// one copies a tile to the stack in guest byte order and writes it out as RGBA8 rows of stride
+// pixels.
+
+/// I4, 8x8 tiles of 4-bit intensities
+struct ScalarTileI4 {
+    inline void operator()(const u8* src, u32* dst, int stride) const {
+        u8 data[32];
+        LoadGuestBytes(src, data, 32);
+        for (int y = 0; y < 8; y++, dst += stride) {
+            for (int x = 0; x < 8; x += 2) {
+                u8 val = data[y * 4 + (x >> 1)];
+                dst[x + 0] = (val >> 4) * 0x11111111;
+                dst[x + 1] = (val & 0xf) * 0x11111111;
+            }
+        }
     }
-
-    return (a << 24) | (b << 16) | (g << 8) | r;
-}
-
-static inline u32 __decode_col_rgb565(u16 _data) {
-    u32 r, g, b;
-    r = (_data >> 11) << 3;
-    g = _data & 0x7E0; 
-    b = _data & 0x1F;
-    return 0xff000000 | (b << 19) | (g << 5) | r;
-}
-
-static inline void DecodeDtxBlock(const u8 *_src, u32 *_dst, u32 _width) {
-    u16 color1 = *(u16*)(_src + 2);
-    u16 color2 = *(u16*)(_src);
-    u32 bits = *(u32*)(_src + 4);
-
-    // Prepare color table
-    u32 table[4];
-    table[0] = __decode_col_rgb565(color1);
-    table[1] = __decode_col_rgb565(color2);
-
-    if (color1 > color2) {
-        table[2] =
-            ((((2*((table[0] >>  0) & 0xff) + ((table[1] >>  0) & 0xff))/3) & 0xFF) <<  0) |    // R
-            ((((2*((table[0] >>  8) & 0xff) + ((table[1] >>  8) & 0xff))/3) & 0xFF) <<  8) |    // G
-            ((((2*((table[0] >> 16) & 0xff) + ((table[1] >> 16) & 0xff))/3) & 0xFF) << 16) |    // B
-            0xff000000;
-
-        table[3] =
-            ((((2*((table[1] >>  0) & 0xff) + ((table[0] >>  0) & 0xff))/3) & 0xFF) <<  0) |    // R
-            ((((2*((table[1] >>  8) & 0xff) + ((table[0] >>  8) & 0xff))/3) & 0xFF) <<  8) |    // G
-            ((((2*((table[1] >> 16) & 0xff) + ((table[0] >> 16) & 0xff))/3) & 0xFF) << 16) |    // B
-            0xff000000;
-    } else {
-        table[2] =
-            ((((((table[0] >>  0) & 0xff) + ((table[1] >>  0) & 0xff)) / 2) & 0xFF) <<  0) |    // R
-            ((((((table[0] >>  8) & 0xff) + ((table[1] >>  8) & 0xff)) / 2) & 0xFF) <<  8) |    // G
-            ((((((table[0] >> 16) & 0xff) + ((table[1] >> 16) & 0xff)) / 2) & 0xFF) << 16) |    // B
-            0xff000000;
-
-        table[3] = 0x00000000;		//alpha
+};
+
+/// I8, 8x4 tiles of 8-bit intensities
+struct ScalarTileI8 {
+    inline void operator()(const u8* src, u32* dst, int stride) const {
+        u8 data[32];
+        LoadGuestBytes(src, data, 32);
+        for (int y = 0; y < 4; y++, dst += stride) {
+            for (int x = 0; x < 8; x++) {
+                dst[x] = data[y * 8 + x] * 0x01010101;
+            }
+        }
+    }
+};
+
+/// IA4, 8x4 tiles of 4-bit alpha (high) and intensity (low)
+struct ScalarTileIA4 {
+    inline void operator()(const u8* src, u32* dst, int stride) const {
+        u8 data[32];
+        LoadGuestBytes(src, data, 32);
+        for (int y = 0; y < 4; y++, dst += stride) {
+            for (int x = 0; x < 8; x++) {
+                u8 val = data[y * 8 + x];
+                dst[x] = ((val & 0xf) * 0x111111) | ((17 * (val >> 4)) << 24);
+            }
+        }
     }
-    // Decode image 4x4 layout
-    for (int iy = 3; iy >= 0; iy--) {
-        _dst[(iy * _width) + 0] = table[(bits >> 6) & 0x3];
-        _dst[(iy * _width) + 1] = table[(bits >> 4) & 0x3];
-        _dst[(iy * _width) + 2] = table[(bits >> 2) & 0x3];
-        _dst[(iy * _width) + 3] = table[(bits >> 0) & 0x3];
-        bits >>= 8;
+};
+
+/// IA8, 4x4 tiles of alpha, intensity byte pairs
+struct ScalarTileIA8 {
+    inline void operator()(const u8* src, u32* dst, int stride) const {
+        u8 data[32];
+        LoadGuestBytes(src, data, 32);
+        for (int y = 0; y < 4; y++, dst += stride) {
+            for (int x = 0; x < 4; x++) {
+                const u8* texel = &data[(y * 4 + x) * 2];
+                dst[x] = (texel[1] * 0x010101) | ((u32)texel[0] << 24);
+            }
+        }
     }
-}
-
-static inline void DecompressDxt1(u32* _dst, const u8* _src, int _width, int _height) {
-    u8*	runner = (u8 *)_src;
-
-    //#pragma omp for ordered schedule(dynamic)
-    for (int y = 0; y < _height; y += 8) {
-        for (int x = 0; x < _width; x += 8) {
-
-            //#pragma omp ordered
-            DecodeDtxBlock(runner, &_dst[(y*_width)+x], _width);
-            runner += 8;
-            DecodeDtxBlock(runner, &_dst[(y*_width)+x+4], _width);
-            runner += 8;
-            DecodeDtxBlock(runner, &_dst[((y+4)*_width)+x], _width);
-            runner += 8;
-            DecodeDtxBlock(runner, &_dst[((y+4)*_width)+x+4], _width);
-            runner += 8;
+};
+
+/// 4x4 tile of 16-bit colors
+static inline void DecodeTile16(const u8* src, u32* dst, int stride, u32 (*decode_color)(u16)) {
+    u8 data[32];
+    LoadGuestBytes(src, data, 32);
+    for (int y = 0; y < 4; y++, dst += stride) {
+        for (int x = 0; x < 4; x++) {
+            const u8* texel = &data[(y * 4 + x) * 2];
+            dst[x] = decode_color((texel[0] << 8) | texel[1]);
         }
     }
 }
 
-void unpackPixel(int _idx, u8* _dst, u16* _palette, u8 _fmt) {
-    //note, the _palette pointer is to Mem_RAM which is
-    //already swapped around for normal 32bit reads
-    //we have to swap which of the 16bit entries we read
-    _idx ^= 1;
-
-    switch(_fmt) {
-    case 0: // ia8
-        _dst[0] = _palette[_idx] >> 8; //& 0xFF;
-        _dst[1] = _palette[_idx] >> 8; //& 0xFF;
-        _dst[2] = _palette[_idx] >> 8; //& 0xFF;
-        _dst[3] = _palette[_idx] & 0xFF;
-        break;
-
-    case 1: // rgb565
-
-        *((u32*)_dst) = __decode_col_rgb565(_palette[_idx]);
-        break;
-
-    case 2: // rgb5a3
+/// RGB565, 4x4 tiles
+struct ScalarTileRGB565 {
+    inline void operator()(const u8* src, u32* dst, int stride) const {
+        DecodeTile16(src, dst, stride, DecodeColorRGB565);
+    }
+};
 
-        *((u32*)_dst) = __decode_col_rgb5a3(_palette[_idx]);
-        break;
+/// RGB5A3, 4x4 tiles
+struct ScalarTileRGB5A3 {
+    inline void operator()(const u8* src, u32* dst, int stride) const {
+        DecodeTile16(src, dst, stride, DecodeColorRGB5A3);
     }
-}
+};
+
+/// RGBA8, 4x4 tiles stored as 32 bytes of AR pairs followed by 32 bytes of GB pairs
+struct ScalarTileRGBA8 {
+    inline void operator()(const u8* src, u32* dst, int stride) const {
+        u8 data[64];
+        LoadGuestBytes(src, data, 64);
+        for (int y = 0; y < 4; y++, dst += stride) {
+            for (int x = 0; x < 4; x++) {
+                const u8* ar = &data[(y * 4 + x) * 2];
+                const u8* gb = ar + 32;
+                dst[x] = ((u32)ar[0] << 24) | (gb[1] << 16) | (gb[0] << 8) | ar[1];
+            }
+        }
+    }
+};
+
+/// C4, 8x8 tiles of 4-bit palette indices
+struct ScalarTileC4 {
+    const u32* lut;
+    inline void operator()(const u8* src, u32* dst, int stride) const {
+        u8 data[32];
+        LoadGuestBytes(src, data, 32);
+        for (int y = 0; y < 8; y++, dst += stride) {
+            for (int x = 0; x < 8; x += 2) {
+                u8 val = data[y * 4 + (x >> 1)];
+                dst[x + 0] = lut[val >> 4];
+                dst[x + 1] = lut[val & 0xf];
+            }
+        }
+    }
+};
+
+/// C8, 8x4 tiles of 8-bit palette indices
+struct ScalarTileC8 {
+    const u32* lut;
+    inline void operator()(const u8* src, u32* dst, int stride) const {
+        u8 data[32];
+        LoadGuestBytes(src, data, 32);
+        for (int y = 0; y < 4; y++, dst += stride) {
+            for (int x = 0; x < 8; x++) {
+                dst[x] = lut[data[y * 8 + x]];
+            }
+        }
+    }
+};
+
+/// C14X2, 4x4 tiles of 14-bit palette indices. Too many entries to convert the palette up front,
+/// so colors are converted as they're used
+struct ScalarTileC14X2 {
+    const TexturePalette* palette;
+    inline void operator()(const u8* src, u32* dst, int stride) const {
+        u8 data[32];
+        LoadGuestBytes(src, data, 32);
+        for (int y = 0; y < 4; y++, dst += stride) {
+            for (int x = 0; x < 4; x++) {
+                const u8* texel = &data[(y * 4 + x) * 2];
+                dst[x] = DecodePaletteColor(palette->raw, palette->format,
+                    ((texel[0] << 8) | texel[1]) & 0x3fff);
+            }
+        }
+    }
+};
+
+/// CMPR, 8x8 tiles of four 4x4 DXT1 blocks
+struct ScalarTileCMPR {
+    inline void operator()(const u8* src, u32* dst, int stride) const {
+        for (int block = 0; block < 4; block++, src += 8) {
+            u8 data[8];
+            u32 table[4];
+            LoadGuestBytes(src, data, 8);
+            DecodeDxtTable((data[0] << 8) | data[1], (data[2] << 8) | data[3], table);
+
+            u32* out = dst + (block >> 1) * 4 * stride + (block & 1) * 4;
+            for (int y = 0; y < 4; y++, out += stride) {
+                u8 bits = data[4 + y];
+                out[0] = table[(bits >> 6) & 0x3];
+                out[1] = table[(bits >> 4) & 0x3];
+                out[2] = table[(bits >> 2) & 0x3];
+                out[3] = table[(bits >> 0) & 0x3];
+            }
+        }
+    }
+};
 
-void unpack8(u8* dst, u8* src, int w, int h, u16* palette, u8 paletteFormat, int neww)
-{
-    u8* runner = dst;
+/// Decoder entry points for the generic tile decoders
+struct ScalarDecoders {
+    static void I4(const u8* src, u32* dst, int width, int height, const TexturePalette*) {
+        DecodeTiles<8, 8, 32>(src, dst, width, height, ScalarTileI4());
+    }
+    static void I8(const u8* src, u32* dst, int width, int height, const TexturePalette*) {
+        DecodeTiles<8, 4, 32>(src, dst, width, height, ScalarTileI8());
+    }
+    static void IA4(const u8* src, u32* dst, int width, int height, const TexturePalette*) {
+        DecodeTiles<8, 4, 32>(src, dst, width, height, ScalarTileIA4());
+    }
+    static void IA8(const u8* src, u32* dst, int width, int height, const TexturePalette*) {
+        DecodeTiles<4, 4, 32>(src, dst, width, height, ScalarTileIA8());
+    }
+    static void RGB565(const u8* src, u32* dst, int width, int height, const TexturePalette*) {
+        DecodeTiles<4, 4, 32>(src, dst, width, height, ScalarTileRGB565());
+    }
+    static void RGB5A3(const u8* src, u32* dst, int width, int height, const TexturePalette*) {
+        DecodeTiles<4, 4, 32>(src, dst, width, height, ScalarTileRGB5A3());
+    }
+    static void RGBA8(const u8* src, u32* dst, int width, int height, const TexturePalette*) {
+        DecodeTiles<4, 4, 64>(src, dst, width, height, ScalarTileRGBA8());
+    }
+    static void C4(const u8* src, u32* dst, int width, int height, const TexturePalette* palette) {
+        ScalarTileC4 tile = { palette->lut };
+        DecodeTiles<8, 8, 32>(src, dst, width, height, tile);
+    }
+    static void C8(const u8* src, u32* dst, int width, int height, const TexturePalette* palette) {
+        ScalarTileC8 tile = { palette->lut };
+        DecodeTiles<8, 4, 32>(src, dst, width, height, tile);
+    }
+    static void C14X2(const u8* src, u32* dst, int width, int height,
+        const TexturePalette* palette) {
+        ScalarTileC14X2 tile = { palette };
+        DecodeTiles<4, 4, 32>(src, dst, width, height, tile);
+    }
+    static void CMPR(const u8* src, u32* dst, int width, int height, const TexturePalette*) {
+        DecodeTiles<8, 8, 32>(src, dst, width, height, ScalarTileCMPR());
+    }
 
-    //printf("fmt: %d", paletteFormat);
-    for (int y = 0; y < h; ++y)
-        for (int x = 0; x < neww; ++x, runner += 4)
-            unpackPixel(src[y*w + x], runner, palette, paletteFormat);
-}
+    static void Fill(TextureDecodeFunc* table) {
+        table[kTextureFormat_Intensity4]        = I4;
+        table[kTextureFormat_Intensity8]        = I8;
+        table[kTextureFormat_IntensityAlpha4]   = IA4;
+        table[kTextureFormat_IntensityAlpha8]   = IA8;
+        table[kTextureFormat_RGB565]            = RGB565;
+        table[kTextureFormat_RGB5A3]            = RGB5A3;
+        table[kTextureFormat_RGBA8]             = RGBA8;
+        table[kTextureFormat_C4]                = C4;
+        table[kTextureFormat_C8]                = C8;
+        table[kTextureFormat_C14X2]             = C14X2;
+        table[kTextureFormat_CMPR]              = CMPR;
+    }
+};
 
 /**
  * Get the size of a texture
@@ -212,226 +314,53 @@ size_t TextureDecoder_GetSize(TextureFormat format, int width, int height) {
  * @param dst Destination data buffer for decoded RGBA8 texture
  */
 void TextureDecoder_Decode(TextureFormat format, int width, int height, const u8* src, u8* dst) {
-    int	x = 0, y = 0, dx = 0, dy = 0, i = 0, j = 0;
-    u32 val = 0;
-    int _8_width = (width + 7) & ~7;
-    int _4_width = (width + 3) & ~3;
-    u8 *dst8 = new u8[width * height * 32];
-    u32 *dst32 = (u32*)dst8;
-    const u16 *src16 = (const u16*)src;
-
     // TODO(Neobrain): Do something with me...
     //if (fifo_player::IsRecording()) {
     //    fifo_player::MemUpdate(addr, src8, width * height * 4); // TODO: Use proper size!
     //}
 
-    u8 pallette_fmt = (gp::g_bp_regs.mem[0x98] >> 10) & 3;
-    u32 pallette_addr = ((gp::g_bp_regs.mem[0x98] & 0x3ff) << 5);
-    u16	*pal16 = ((u16*)&gp::tmem[pallette_addr & TMEM_MASK]);
-
-    switch(format) {
-    case kTextureFormat_Intensity4:
-        for (y = 0; y < height; y += 8) {
-            for (x = 0; x < _8_width; x += 8) {
-                for (dy = 0; dy < 8; dy++) {
-                    for (dx = 0; dx < 8; dx+=2, src++) {
-                        // Convert 2 4-bit instensity pixels to 32-bit RGBA
-						val = ((*(u8 *)((uintptr_t)src ^ 3) & 0x0f)) * 0x11111111;
-						dst32[(_8_width * (y + dy) + x + dx + 1)] = val;
-						val = ((*(u8 *)((uintptr_t)src ^ 3) & 0xf0) >> 4) * 0x11111111;
-						dst32[(_8_width * (y + dy) + x + dx)] = val;
- 					}
-                }
-            }
-        }
-        for (y = 0; y < height; y++) {
-            memcpy(&dst[y*width*4], &dst8[y*_8_width*4], width*4);
-        }
-        break;
-
-    case kTextureFormat_Intensity8:
-        for (y = 0; y < height; y += 4) {
-            for (x = 0; x < width; x += 8) {
-                for (dy = 0; dy < 4; dy++) {
-                    for (dx = 0; dx < 8; dx++) {
-                        // Converts one 8-bit instensity pixel to 32-bit RGBA
-						val = (*(u8 *)((uintptr_t)src ^ 3)) * 0x1010101;
-						dst32[(_8_width * (y + dy) + x + dx)] = val;
-                        src++;
-					}
-                }
-            }
-        }
-        for (y=0; y < height; y++) {
-            memcpy(&dst[y*width*4], &dst8[y*_8_width*4], width*4);
-        }
-        break;
-
-    case kTextureFormat_IntensityAlpha4:
-        for (y = 0; y < height; y += 4) {
-            for (x = 0; x < _8_width; x += 8) {
-                for (dy = 0; dy < 4; dy++) {
-                    for (dx = 0; dx < 8; dx++, src++) {
-		 				val = (((*(u8 *)((uintptr_t)src ^ 3) & 0x0f)) * 0x111111) | 
-                            ((17 * ((*(u8 *)((uintptr_t)src ^ 3) & 0xf0) >> 4)) << 24);
-		 				dst32[(_8_width * (y + dy) + x + dx)] = val;
- 		 			}
-                }
-            }
-        }
-        for (y=0; y < height; y++) {
-            memcpy(&dst[y*width*4], &dst8[y*_8_width*4], width*4);
-        }
-		break;
-
-    case kTextureFormat_IntensityAlpha8:
-        for (y = 0; y < height; y += 4) {
-            for (x = 0; x < _4_width; x += 4) {
-                for (dy = 0; dy < 4; dy++) {
-                    for (dx = 0; dx < 4; dx++, src+=2) {
-						val = (((u32)*(u8 *)(((uintptr_t)src + 1) ^ 3)) * 0x00010101) | 
-                            ((u32)*(u8 *)((uintptr_t)src ^ 3) << 24);
-						dst32[(_4_width * (y + dy) + x + dx)] = val;
-					}
-                }
-            }
-        }
-        for (y=0; y < height; y++) {
-            memcpy(&dst[y*width*4], &dst8[y*_4_width*4], width*4);
-        }
-		break;
-
-    case kTextureFormat_RGB565:
-		for (y = 0; y < height; y += 4) {
-			for (x = 0; x < _4_width; x += 4) {
-				for (dy = 0; dy < 4; dy++) {
-					for (dx = 0; dx < 4; dx++) {
-						// memory is not already swapped.. use this to grab high word first
-						j ^= 1; 
-						// decode color
-						dst32[_4_width * (y + dy) + x + dx] = __decode_col_rgb565((*((u16*)(src16 + j))));
-						// only increment every other time otherwise you get address doubles
-						if (!j) src16 += 2; 
-					}
-                }
-            }
-        }
-        for (y=0; y < height; y++) {
-            memcpy(&dst[y*width*4], &dst8[y*_4_width*4], width*4);
-        }
-        break;
-
-    case kTextureFormat_RGB5A3:
-		for (y = 0; y < height; y += 4) {
-			for (x = 0; x < _4_width; x += 4) {
-				for (dy = 0; dy < 4; dy++) {
-					for (dx = 0; dx < 4; dx++) {
-						// memory is not already swapped.. use this to grab high word first
-						j ^= 1;
-						// decode color
-						dst32[_4_width * (y + dy) + x + dx] = __decode_col_rgb5a3((*((u16*)(src16 + j))));
-						// only increment every other time otherwise you get address doubles
-						if (!j) src16 += 2;
-					}
-                }
-            }
-        }
-		for (y=0; y < height; y++) {
-            memcpy(&dst[y*width*4], &dst8[y*_4_width*4], width*4);
-        }
-		break;
-
-    case kTextureFormat_RGBA8: // rgba8
-		for (y = 0; y < height; y += 4) {
-			for (x = 0; x < _4_width; x += 4) {
-				for (dy = 0; dy < 4; dy++) {
-					for (dx = 0; dx < 4; dx++) {
-						// memory is not already swapped.. use this to grab high word first
-						j ^= 1;
-						// fetch data
-						dst32[_4_width * (y + dy) + x + dx] = ((*((u16*)(src16 + j))) << 16);
-						// only increment every other time otherwise you get address doubles
-						if (!j) src16 += 2;
-					}
-                }
-				for (dy = 0; dy < 4; dy++) {
-					for (dx = 0; dx < 4; dx++) {
-						// memory is not already swapped.. use this to grab high word first
-						j ^= 1;
-						// fetch color data
-						val = dst32[_4_width * (y + dy) + x + dx] | ((*((u16*)(src16 + j))));
-						// decode color data
-						dst32[_4_width * (y + dy) + x + dx] = (val & 0xff00ff00) | 
-										((val & 0xff0000) >> 16) | 
-										((val & 0xff) << 16);
-						// only increment every other time otherwise you get address doubles
-						if (!j) src16 += 2;
-					}
-                }
-			}
-        }
-		for (y=0; y < height; y++) {
-            memcpy(&dst[y*width*4], &dst8[y*_4_width*4], width*4);
-        }
-		break;
-
-    case kTextureFormat_C4:
-        for (y = 0; y < height; y += 8) {
-            for (x = 0; x < _8_width; x += 8) {
-                for (dy = 0; dy < 8; dy++) {
-                    dst8[_8_width * (y + dy) + x + 0] = (*(u8 *)((uintptr_t)src ^ 3) >> 4);
-                    dst8[_8_width * (y + dy) + x + 1] = (*(u8 *)((uintptr_t)src ^ 3) & 0x0f);
-                    src++;
-
-                    dst8[_8_width * (y + dy) + x + 2] = (*(u8 *)((uintptr_t)src ^ 3) >> 4);
-                    dst8[_8_width * (y + dy) + x + 3] = (*(u8 *)((uintptr_t)src ^ 3) & 0x0f);
-                    src++;
-
-                    dst8[_8_width * (y + dy) + x + 4] = (*(u8 *)((uintptr_t)src ^ 3) >> 4);
-                    dst8[_8_width * (y + dy) + x + 5] = (*(u8 *)((uintptr_t)src ^ 3) & 0x0f);
-                    src++;
-
-                    dst8[_8_width * (y + dy) + x + 6] = (*(u8 *)((uintptr_t)src ^ 3) >> 4);
-                    dst8[_8_width * (y + dy) + x + 7] = (*(u8 *)((uintptr_t)src ^ 3) & 0x0f);
-                    src++;
-                }
-            }
-        }
-        unpack8(dst, dst8, _8_width, height, pal16, pallette_fmt, width);
-        break;
-
-    case kTextureFormat_C8:
-        for (y = 0; y < height; y += 4) {
-            for (x = 0; x < _8_width; x += 8) {
-                *(u32 *)&dst8[_8_width * (y + 0) + x] = BSWAP32(*(u32 *)((uintptr_t)src));
-                *(u32 *)&dst8[_8_width * (y + 0) + x + 4] = BSWAP32(*(u32 *)((uintptr_t)src + 4));
+    TextureDecodeFunc decode = (format < kTextureFormat_None) ? g_decoders[format] : NULL;
+    if (decode == NULL) {
+        LOG_ERROR(TGP, "Unsupported texture format %d!", format);
+        return;
+    }
 
-                *(u32 *)&dst8[_8_width * (y + 1) + x] = BSWAP32(*(u32 *)((uintptr_t)src + 8));
-                *(u32 *)&dst8[_8_width * (y + 1) + x + 4] = BSWAP32(*(u32 *)((uintptr_t)src + 12));
+    TexturePalette palette;
+    palette.format = (gp::g_bp_regs.mem[0x98] >> 10) & 3;
+    palette.raw = &gp::tmem[((gp::g_bp_regs.mem[0x98] & 0x3ff) << 5) & TMEM_MASK];
 
-                *(u32 *)&dst8[_8_width * (y + 2) + x] = BSWAP32(*(u32 *)((uintptr_t)src + 16));
-                *(u32 *)&dst8[_8_width * (y + 2) + x + 4] = BSWAP32(*(u32 *)((uintptr_t)src + 20));
+    // Convert the palette once instead of once per texel
+    int num_entries = 0;
+    if (format == kTextureFormat_C4) {
+        num_entries = 16;
+    } else if (format == kTextureFormat_C8) {
+        num_entries = 256;
+    }
+    for (int i = 0; i < num_entries; i++) {
+        palette.lut[i] = DecodePaletteColor(palette.raw, palette.format, i);
+    }
+    decode(src, (u32*)dst, width, height, &palette);
+}
 
-                *(u32 *)&dst8[_8_width * (y + 3) + x] = BSWAP32(*(u32 *)((uintptr_t)src + 24));
-                *(u32 *)&dst8[_8_width * (y + 3) + x + 4] = BSWAP32(*(u32 *)((uintptr_t)src + 28));
-                src+=32;
-            }
-        }
-        unpack8(dst, dst8, _8_width, height, pal16, pallette_fmt, width);
-        break;
+/// Pick the fastest decoder of each texture format for the host CPU
+void TextureDecoder_Init() {
+    const char* isa = "generic";
 
-    case kTextureFormat_CMPR:
-        DecompressDxt1(dst32, src, _8_width, height);
-        for (y=0; y < height; y++) {
-            memcpy(&dst[y*_8_width*4], &dst8[y*_8_width*4], _8_width*4);
-        }
-        break;
+    memset(g_decoders, 0, sizeof(g_decoders));
+    ScalarDecoders::Fill(g_decoders);
 
-    default:
-        LOG_ERROR(TGP, "Unsupported texture format %d!", format);
-        break;
+#ifdef TEXTURE_DECODER_SSE2
+    common::X86Utils x86_utils;
+    if (x86_utils.IsExtensionSupported(common::X86Utils::kExtensionX86_SSE2)) {
+        SimdDecoders<IsaSSE2>::Fill(g_decoders);
+        isa = "SSE2";
+    }
+    if (x86_utils.IsExtensionSupported(common::X86Utils::kExtensionX86_SSSE3) &&
+        TextureDecoder_GetSSSE3Decoders(g_decoders)) {
+        isa = "SSSE3";
     }
-    delete dst8;
+#endif
+    LOG_NOTICE(TGP, "TextureDecoder: using %s decoders", isa);
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -52,6 +52,9 @@ enum TextureFormat {
     kTextureFormat_None
 };
 
+/// Pick the texture decoders for the host CPU, must be called before decoding
+void TextureDecoder_Init();
+
 /**
  * Get the size of a texture
  * @param format Format of the texture
@@ -0,0 +1,423 @@
+/**
+ * Copyright (C) 2005-2012 Gekko Emulator
+ *
+ * @file    texture_decoder_simd.h
+ * @author  ShizZy <shizzy247@gmail.com>
+ * @date    2013-02-15
+ * @brief   Tile decoders shared by the scalar and SIMD texture decoder builds
+ *
+ * @section LICENSE
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details at
+ * http://www.gnu.org/copyleft/gpl.html
+ *
+ * Official project repository can be found at:
+ * http://code.google.com/p/gekko-gc-emu/
+ */
+
+#ifndef VIDEO_CORE_TEXTURE_DECODER_SIMD_H_
+#define VIDEO_CORE_TEXTURE_DECODER_SIMD_H_
+
+#include "common.h"
+#include "memory.h"
+#include "texture_decoder.h"
+
+#if defined(EMU_ARCHITECTURE_X64) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TEXTURE_DECODER_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace gp {
+
+/// Palette of the texture being decoded, for the color indexed formats
+struct TexturePalette {
+    const u8*   raw;        ///< TLUT in TMEM, laid out like Mem_RAM
+    int         format;     ///< 0 = IA8, 1 = RGB565, 2 = RGB5A3
+    u32         lut[256];   ///< C4/C8 entries already converted to RGBA8
+};
+
+/**
+ * Decode all tiles of a texture in one format to RGBA8
+ * @param src Source texture data, laid out like Mem_RAM
+ * @param dst Destination RGBA8 buffer, width * height pixels
+ * @param width Width in pixels of the texture
+ * @param height Height in pixels of the texture
+ * @param palette Palette for the color indexed formats, NULL otherwise
+ */
+typedef void (*TextureDecodeFunc)(const u8* src, u32* dst, int width, int height,
+    const TexturePalette* palette);
+
+/**
+ * Fill in the SSSE3 decoders of the formats that have one
+ * @param table Decoders indexed by TextureFormat
+ * @return True if the SSSE3 decoders were built into this binary
+ */
+bool TextureDecoder_GetSSSE3Decoders(TextureDecodeFunc* table);
+
+// Everything below is built once per instruction set, keep it out of the linker's sight so that
+// the SSSE3 translation unit can't hand its copies to the baseline one
+namespace {
+
+/// Read the n-th big endian halfword of texture data laid out like Mem_RAM
+#define TEX_READ16(base, n) MEM_LOAD16((const u8*)(base) + MEM_SWIZZLE16((n) << 1))
+
+/// Copy size bytes (a multiple of 4) of texture data to out in guest byte order
+static inline void LoadGuestBytes(const u8* src, u8* out, int size) {
+    for (int i = 0; i < size; i += 4) {
+        *(u32*)&out[i] = MEM_LOAD32_BYTES(src + i);
+    }
+}
+
+static inline u32 DecodeColorRGB5A3(u16 data) {
+    u32 r, g, b, a;
+    if (data & 0x8000) { // rgb5
+        r = (255 * ((data >> 10) & 0x1f)) >> 5;
+        g = (255 * ((data >> 5) & 0x1f)) >> 5;
+        b = (255 * (data & 0x1f)) >> 5;
+        a = 0xff;
+    } else { // rgb4a3
+        r = 17 * ((data >> 8) & 0xf);
+        g = 17 * ((data >> 4) & 0xf);
+        b = 17 * (data & 0xf);
+        a = (255 * ((data >> 12) & 7)) >> 3;
+    }
+    return (a << 24) | (b << 16) | (g << 8) | r;
+}
+
+static inline u32 DecodeColorRGB565(u16 data) {
+    u32 r = (data >> 11) << 3;
+    u32 g = data & 0x7E0;
+    u32 b = data & 0x1F;
+    return 0xff000000 | (b << 19) | (g << 5) | r;
+}
+
+/// Convert palette entry idx to RGBA8
+static inline u32 DecodePaletteColor(const u8* raw, int format, int idx) {
+    u16 color = TEX_READ16(raw, idx);
+    switch (format) {
+    case 0: // ia8
+        return ((u32)(color & 0xff) << 24) | ((color >> 8) * 0x010101);
+    case 1:
+        return DecodeColorRGB565(color);
+    case 2:
+        return DecodeColorRGB5A3(color);
+    }
+    return 0;
+}
+
+/// Build the 4 entry color table of a DXT1 block from its two endpoint colors
+static inline void DecodeDxtTable(u16 color1, u16 color2, u32* table) {
+    table[0] = DecodeColorRGB565(color1);
+    table[1] = DecodeColorRGB565(color2);
+    table[2] = table[3] = 0xff000000;
+    for (int shift = 0; shift < 24; shift += 8) {
+        u32 c0 = (table[0] >> shift) & 0xff;
+        u32 c1 = (table[1] >> shift) & 0xff;
+        if (color1 > color2) {
+            table[2] |= (((2 * c0 + c1) / 3) & 0xff) << shift;
+            table[3] |= (((2 * c1 + c0) / 3) & 0xff) << shift;
+        } else {
+            table[2] |= (((c0 + c1) / 2) & 0xff) << shift;
+        }
+    }
+    if (color1 <= color2) {
+        table[3] = 0x00000000; // alpha
+    }
+}
+
+/**
+ * Walk the tiles of a texture and decode each one with tile(src, dst, stride). Tiles that are cut
+ * by the right or bottom edge are decoded to a scratch tile and clipped on the way out.
+ */
+template <int kTileW, int kTileH, int kTileBytes, typename TileDecoder>
+static inline void DecodeTiles(const u8* src, u32* dst, int width, int height,
+    const TileDecoder& tile) {
+    u32 edge[8 * 8];
+
+    for (int y = 0; y < height; y += kTileH) {
+        for (int x = 0; x < width; x += kTileW, src += kTileBytes) {
+            if (x + kTileW <= width && y + kTileH <= height) {
+                tile(src, &dst[y * width + x], width);
+            } else {
+                tile(src, edge, kTileW);
+
+                int w = (width - x < kTileW) ? width - x : kTileW;
+                int h = (height - y < kTileH) ? height - y : kTileH;
+                for (int ty = 0; ty < h; ty++) {
+                    memcpy(&dst[(y + ty) * width + x], &edge[ty * kTileW], w * 4);
+                }
+            }
+        }
+    }
+}
+
+#ifdef TEXTURE_DECODER_SSE2
+
+/// Baseline primitives, SSE2 is always there on x86-64
+struct IsaSSE2 {
+    /// Load 16 bytes of texture data in guest byte order
+    static inline __m128i LoadGuest(const u8* src) {
+        __m128i v = _mm_loadu_si128((const __m128i*)src);
+#ifndef MEM_NATIVE_BE
+        v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+        v = _mm_shufflehi_epi16(_mm_shufflelo_epi16(v, 0xB1), 0xB1);
+#endif
+        return v;
+    }
+
+    /// Expand 16 intensity bytes to 16 grey RGBA8 pixels
+    static inline void SplatBytes(__m128i v, __m128i* px) {
+        __m128i lo = _mm_unpacklo_epi8(v, v);
+        __m128i hi = _mm_unpackhi_epi8(v, v);
+        px[0] = _mm_unpacklo_epi16(lo, lo);
+        px[1] = _mm_unpackhi_epi16(lo, lo);
+        px[2] = _mm_unpacklo_epi16(hi, hi);
+        px[3] = _mm_unpackhi_epi16(hi, hi);
+    }
+};
+
+#define TEX_STORE(dst, v) _mm_storeu_si128((__m128i*)(dst), (v))
+
+/// Swap the bytes of each big endian halfword to host order
+static inline __m128i SwapHalves(__m128i v) {
+    return _mm_or_si128(_mm_srli_epi16(v, 8), _mm_slli_epi16(v, 8));
+}
+
+/// Interleave 16-bit R|G<<8 and B|A<<8 lanes into 8 RGBA8 pixels, 2 rows of 4
+static inline void StoreRows4x2(__m128i rg, __m128i ba, u32* dst, int stride) {
+    TEX_STORE(dst, _mm_unpacklo_epi16(rg, ba));
+    TEX_STORE(dst + stride, _mm_unpackhi_epi16(rg, ba));
+}
+
+/// I4, 8x8 tiles of 4-bit intensities
+template <typename Isa> struct TileI4 {
+    inline void operator()(const u8* src, u32* dst, int stride) const {
+        const __m128i nibble = _mm_set1_epi8(0x0f);
+        __m128i px[4];
+
+        for (int half = 0; half < 2; half++, src += 16, dst += 4 * stride) {
+            __m128i g = Isa::LoadGuest(src);
+            __m128i hi = _mm_and_si128(_mm_srli_epi16(g, 4), nibble);
+            __m128i lo = _mm_and_si128(g, nibble);
+
+            for (int i = 0; i < 2; i++) {
+                __m128i p = i ? _mm_unpackhi_epi8(hi, lo) : _mm_unpacklo_epi8(hi, lo);
+                p = _mm_or_si128(p, _mm_slli_epi16(p, 4));
+                Isa::SplatBytes(p, px);
+
+                u32* row = dst + 2 * i * stride;
+                TEX_STORE(row, px[0]);
+                TEX_STORE(row + 4, px[1]);
+                TEX_STORE(row + stride, px[2]);
+                TEX_STORE(row + stride + 4, px[3]);
+            }
+        }
+    }
+};
+
+/// I8, 8x4 tiles of 8-bit intensities
+template <typename Isa> struct TileI8 {
+    inline void operator()(const u8* src, u32* dst, int stride) const {
+        __m128i px[4];
+
+        for (int half = 0; half < 2; half++, src += 16, dst += 2 * stride) {
+            Isa::SplatBytes(Isa::LoadGuest(src), px);
+            TEX_STORE(dst, px[0]);
+            TEX_STORE(dst + 4, px[1]);
+            TEX_STORE(dst + stride, px[2]);
+            TEX_STORE(dst + stride + 4, px[3]);
+        }
+    }
+};
+
+/// IA4, 8x4 tiles of 4-bit alpha (high) and intensity (low)
+template <typename Isa> struct TileIA4 {
+    inline void operator()(const u8* src, u32* dst, int stride) const {
+        const __m128i nibble = _mm_set1_epi8(0x0f);
+
+        for (int half = 0; half < 2; half++, src += 16, dst += 2 * stride) {
+            __m128i g = Isa::LoadGuest(src);
+            __m128i i = _mm_and_si128(g, nibble);
+            __m128i a = _mm_and_si128(_mm_srli_epi16(g, 4), nibble);
+            i = _mm_or_si128(i, _mm_slli_epi16(i, 4));
+            a = _mm_or_si128(a, _mm_slli_epi16(a, 4));
+
+            __m128i ii = _mm_unpacklo_epi8(i, i);
+            __m128i ia = _mm_unpacklo_epi8(i, a);
+            TEX_STORE(dst, _mm_unpacklo_epi16(ii, ia));
+            TEX_STORE(dst + 4, _mm_unpackhi_epi16(ii, ia));
+
+            ii = _mm_unpackhi_epi8(i, i);
+            ia = _mm_unpackhi_epi8(i, a);
+            TEX_STORE(dst + stride, _mm_unpacklo_epi16(ii, ia));
+            TEX_STORE(dst + stride + 4, _mm_unpackhi_epi16(ii, ia));
+        }
+    }
+};
+
+/// IA8, 4x4 tiles of alpha, intensity byte pairs
+template <typename Isa> struct TileIA8 {
+    inline void operator()(const u8* src, u32* dst, int stride) const {
+        for (int half = 0; half < 2; half++, src += 16, dst += 2 * stride) {
+            __m128i g = Isa::LoadGuest(src);
+            __m128i i = _mm_srli_epi16(g, 8);
+            StoreRows4x2(_mm_or_si128(i, _mm_slli_epi16(i, 8)),
+                _mm_or_si128(i, _mm_slli_epi16(g, 8)), dst, stride);
+        }
+    }
+};
+
+/// RGB565, 4x4 tiles
+template <typename Isa> struct TileRGB565 {
+    inline void operator()(const u8* src, u32* dst, int stride) const {
+        const __m128i mask_r = _mm_set1_epi16(0x00f8);
+        const __m128i mask_g = _mm_set1_epi16((s16)0xfc00);
+        const __m128i alpha = _mm_set1_epi16((s16)0xff00);
+
+        for (int half = 0; half < 2; half++, src += 16, dst += 2 * stride) {
+            __m128i v = SwapHalves(Isa::LoadGuest(src));
+            __m128i rg = _mm_or_si128(_mm_and_si128(_mm_srli_epi16(v, 8), mask_r),
+                _mm_and_si128(_mm_slli_epi16(v, 5), mask_g));
+            __m128i ba = _mm_or_si128(_mm_and_si128(_mm_slli_epi16(v, 3), mask_r), alpha);
+            StoreRows4x2(rg, ba, dst, stride);
+        }
+    }
+};
+
+/// RGB5A3, 4x4 tiles, each texel picks rgb5 or rgb4a3 by its top bit
+template <typename Isa> struct TileRGB5A3 {
+    inline void operator()(const u8* src, u32* dst, int stride) const {
+        const __m128i mask3 = _mm_set1_epi16(0x07);
+        const __m128i mask4 = _mm_set1_epi16(0x0f);
+        const __m128i mask5 = _mm_set1_epi16(0x1f);
+        const __m128i mul17 = _mm_set1_epi16(17);
+        const __m128i mul255 = _mm_set1_epi16(255);
+
+        for (int half = 0; half < 2; half++, src += 16, dst += 2 * stride) {
+            __m128i v = SwapHalves(Isa::LoadGuest(src));
+            __m128i rgb5 = _mm_srai_epi16(v, 15);
+
+            __m128i r5 = _mm_srli_epi16(_mm_mullo_epi16(
+                _mm_and_si128(_mm_srli_epi16(v, 10), mask5), mul255), 5);
+            __m128i g5 = _mm_srli_epi16(_mm_mullo_epi16(
+                _mm_and_si128(_mm_srli_epi16(v, 5), mask5), mul255), 5);
+            __m128i b5 = _mm_srli_epi16(_mm_mullo_epi16(_mm_and_si128(v, mask5), mul255), 5);
+
+            __m128i r4 = _mm_mullo_epi16(_mm_and_si128(_mm_srli_epi16(v, 8), mask4), mul17);
+            __m128i g4 = _mm_mullo_epi16(_mm_and_si128(_mm_srli_epi16(v, 4), mask4), mul17);
+            __m128i b4 = _mm_mullo_epi16(_mm_and_si128(v, mask4), mul17);
+            __m128i a3 = _mm_srli_epi16(_mm_mullo_epi16(
+                _mm_and_si128(_mm_srli_epi16(v, 12), mask3), mul255), 3);
+
+            __m128i r = _mm_or_si128(_mm_and_si128(rgb5, r5), _mm_andnot_si128(rgb5, r4));
+            __m128i g = _mm_or_si128(_mm_and_si128(rgb5, g5), _mm_andnot_si128(rgb5, g4));
+            __m128i b = _mm_or_si128(_mm_and_si128(rgb5, b5), _mm_andnot_si128(rgb5, b4));
+            __m128i a = _mm_or_si128(_mm_and_si128(rgb5, mul255), _mm_andnot_si128(rgb5, a3));
+
+            StoreRows4x2(_mm_or_si128(r, _mm_slli_epi16(g, 8)),
+                _mm_or_si128(b, _mm_slli_epi16(a, 8)), dst, stride);
+        }
+    }
+};
+
+/// RGBA8, 4x4 tiles stored as 32 bytes of AR pairs followed by 32 bytes of GB pairs
+template <typename Isa> struct TileRGBA8 {
+    inline void operator()(const u8* src, u32* dst, int stride) const {
+        for (int half = 0; half < 2; half++, src += 16, dst += 2 * stride) {
+            __m128i ar = Isa::LoadGuest(src);
+            __m128i gb = Isa::LoadGuest(src + 32);
+            StoreRows4x2(_mm_or_si128(_mm_srli_epi16(ar, 8), _mm_slli_epi16(gb, 8)),
+                _mm_or_si128(_mm_srli_epi16(gb, 8), _mm_slli_epi16(ar, 8)), dst, stride);
+        }
+    }
+};
+
+/// CMPR, 8x8 tiles of four DXT1 blocks. Texel indices are matched against all four table
+/// entries at once, a row of 4 texels per compare.
+template <typename Isa> struct TileCMPR {
+    inline void operator()(const u8* src, u32* dst, int stride) const {
+        const __m128i masks = _mm_set_epi32(0x03, 0x0c, 0x30, 0xc0);
+        const __m128i index1 = _mm_set_epi32(0x01, 0x04, 0x10, 0x40);
+        const __m128i index2 = _mm_set_epi32(0x02, 0x08, 0x20, 0x80);
+        const __m128i index3 = masks;
+
+        for (int block = 0; block < 4; block++, src += 8) {
+            u8 b[8];
+            u32 table[4];
+            LoadGuestBytes(src, b, 8);
+            DecodeDxtTable((b[0] << 8) | b[1], (b[2] << 8) | b[3], table);
+
+            __m128i t0 = _mm_set1_epi32(table[0]);
+            __m128i t1 = _mm_set1_epi32(table[1]);
+            __m128i t2 = _mm_set1_epi32(table[2]);
+            __m128i t3 = _mm_set1_epi32(table[3]);
+
+            u32* out = dst + (block >> 1) * 4 * stride + (block & 1) * 4;
+            for (int row = 0; row < 4; row++, out += stride) {
+                __m128i idx = _mm_and_si128(_mm_set1_epi32(b[4 + row]), masks);
+                __m128i px = _mm_andnot_si128(_mm_or_si128(_mm_or_si128(
+                    _mm_cmpeq_epi32(idx, index1), _mm_cmpeq_epi32(idx, index2)),
+                    _mm_cmpeq_epi32(idx, index3)), t0);
+                px = _mm_or_si128(px, _mm_and_si128(_mm_cmpeq_epi32(idx, index1), t1));
+                px = _mm_or_si128(px, _mm_and_si128(_mm_cmpeq_epi32(idx, index2), t2));
+                px = _mm_or_si128(px, _mm_and_si128(_mm_cmpeq_epi32(idx, index3), t3));
+                TEX_STORE(out, px);
+            }
+        }
+    }
+};
+
+/// Decoder entry points for the direct color formats, built for one instruction set
+template <typename Isa> struct SimdDecoders {
+    static void I4(const u8* src, u32* dst, int width, int height, const TexturePalette*) {
+        DecodeTiles<8, 8, 32>(src, dst, width, height, TileI4<Isa>());
+    }
+    static void I8(const u8* src, u32* dst, int width, int height, const TexturePalette*) {
+        DecodeTiles<8, 4, 32>(src, dst, width, height, TileI8<Isa>());
+    }
+    static void IA4(const u8* src, u32* dst, int width, int height, const TexturePalette*) {
+        DecodeTiles<8, 4, 32>(src, dst, width, height, TileIA4<Isa>());
+    }
+    static void IA8(const u8* src, u32* dst, int width, int height, const TexturePalette*) {
+        DecodeTiles<4, 4, 32>(src, dst, width, height, TileIA8<Isa>());
+    }
+    static void RGB565(const u8* src, u32* dst, int width, int height, const TexturePalette*) {
+        DecodeTiles<4, 4, 32>(src, dst, width, height, TileRGB565<Isa>());
+    }
+    static void RGB5A3(const u8* src, u32* dst, int width, int height, const TexturePalette*) {
+        DecodeTiles<4, 4, 32>(src, dst, width, height, TileRGB5A3<Isa>());
+    }
+    static void RGBA8(const u8* src, u32* dst, int width, int height, const TexturePalette*) {
+        DecodeTiles<4, 4, 64>(src, dst, width, height, TileRGBA8<Isa>());
+    }
+    static void CMPR(const u8* src, u32* dst, int width, int height, const TexturePalette*) {
+        DecodeTiles<8, 8, 32>(src, dst, width, height, TileCMPR<Isa>());
+    }
+
+    /// Fill in the decoders of the formats that have a SIMD path
+    static void Fill(TextureDecodeFunc* table) {
+        table[kTextureFormat_Intensity4]        = I4;
+        table[kTextureFormat_Intensity8]        = I8;
+        table[kTextureFormat_IntensityAlpha4]   = IA4;
+        table[kTextureFormat_IntensityAlpha8]   = IA8;
+        table[kTextureFormat_RGB565]            = RGB565;
+        table[kTextureFormat_RGB5A3]            = RGB5A3;
+        table[kTextureFormat_RGBA8]             = RGBA8;
+        table[kTextureFormat_CMPR]              = CMPR;
+    }
+};
+
+#endif // TEXTURE_DECODER_SSE2
+
+} // namespace
+
+} // namespace
+
+#endif // VIDEO_CORE_TEXTURE_DECODER_SIMD_H_
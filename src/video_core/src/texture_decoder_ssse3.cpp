@@ -0,0 +1,70 @@
+/**
+ * Copyright (C) 2005-2012 Gekko Emulator
+ *
+ * @file    texture_decoder_ssse3.cpp
+ * @author  ShizZy <shizzy247@gmail.com>
+ * @date    2013-02-15
+ * @brief   SSSE3 texture decoders, this file is built with SSSE3 code generation enabled
+ *
+ * @section LICENSE
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details at
+ * http://www.gnu.org/copyleft/gpl.html
+ *
+ * Official project repository can be found at:
+ * http://code.google.com/p/gekko-gc-emu/
+ */
+
+#include "common.h"
+#include "texture_decoder_simd.h"
+
+#if defined(TEXTURE_DECODER_SSE2) && (defined(__SSSE3__) || defined(_MSC_VER))
+#define TEXTURE_DECODER_SSSE3
+#include <tmmintrin.h>
+#endif
+
+namespace gp {
+
+#ifdef TEXTURE_DECODER_SSSE3
+
+/// SSSE3 primitives, byte shuffles replace the SSE2 shift and unpack sequences
+struct IsaSSSE3 {
+    static inline __m128i LoadGuest(const u8* src) {
+        __m128i v = _mm_loadu_si128((const __m128i*)src);
+#ifndef MEM_NATIVE_BE
+        v = _mm_shuffle_epi8(v, _mm_set_epi8(12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3));
+#endif
+        return v;
+    }
+
+    static inline void SplatBytes(__m128i v, __m128i* px) {
+        px[0] = _mm_shuffle_epi8(v, _mm_set_epi8(3, 3, 3, 3, 2, 2, 2, 2, 1, 1, 1, 1, 0, 0, 0, 0));
+        px[1] = _mm_shuffle_epi8(v, _mm_set_epi8(7, 7, 7, 7, 6, 6, 6, 6, 5, 5, 5, 5, 4, 4, 4, 4));
+        px[2] = _mm_shuffle_epi8(v, _mm_set_epi8(11, 11, 11, 11, 10, 10, 10, 10, 9, 9, 9, 9,
+            8, 8, 8, 8));
+        px[3] = _mm_shuffle_epi8(v, _mm_set_epi8(15, 15, 15, 15, 14, 14, 14, 14, 13, 13, 13, 13,
+            12, 12, 12, 12));
+    }
+};
+
+bool TextureDecoder_GetSSSE3Decoders(TextureDecodeFunc* table) {
+    SimdDecoders<IsaSSSE3>::Fill(table);
+    return true;
+}
+
+#else
+
+bool TextureDecoder_GetSSSE3Decoders(TextureDecodeFunc* table) {
+    return false;
+}
+
+#endif // TEXTURE_DECODER_SSSE3
+
+} // namespace
@@ -32,12 +32,19 @@
 TextureManager::TextureManager(const BackendInterface* backend_interface) {
     backend_interface_  = const_cast<BackendInterface*>(backend_interface);
     cache_              = new CacheContainer();
+    budget_bytes_       = (size_t)common::g_config->current_renderer_config().texture_cache_size << 20;
+    prefetcher_         = NULL;
+    int num_threads     = TexturePrefetcher::DefaultThreadCount();
+    if (num_threads > 0) {
+        prefetcher_ = new TexturePrefetcher(num_threads);
+    }
     for (int i = 0; i < kGCMaxActiveTextures; i++) {
         active_textures_[i] = NULL;
     }
 }
 
 TextureManager::~TextureManager() {
+    delete prefetcher_;
     delete cache_;
 }
 
@@ -51,52 +58,84 @@ void TextureManager::UpdateData(int active_texture_unit, const gp::BPTexImage0&
     const gp::BPTexImage3& tex_image_3) {
     static CacheEntry   cache_entry;
     static u8           raw_data[kGCMaxTextureWidth * kGCMaxTextureHeight * 4];
+    const u8*           decoded = NULL;
 
     if (tex_image_3.image_base == 0) {
         return;
     }
-    cache_entry.address_    = tex_image_3.image_base << 5;
-    cache_entry.format_     = (gp::TextureFormat)tex_image_0.format;
-    cache_entry.width_      = tex_image_0.width + 1;
-    cache_entry.height_     = tex_image_0.height + 1;
-    cache_entry.type_       = kSourceType_Normal;
-    cache_entry.size_       = gp::TextureDecoder_GetSize(cache_entry.format_, 
-                                                         cache_entry.width_, 
-                                                         cache_entry.height_);
+    SetSource(tex_image_0, tex_image_3, cache_entry);
+
     // Try to find an EFB copy in cache (EFB copy address used as hash)
     active_textures_[active_texture_unit] = cache_->FetchFromHash(cache_entry.address_);
 
     // If that failed, try to find a normal texture in cache
     if (NULL == active_textures_[active_texture_unit]) {
 
-        cache_entry.hash_       = common::GetHash64(&Mem_RAM[cache_entry.address_ & RAM_MASK],
-                                                    cache_entry.size_, 
-                                                    kHashSamples);
-        active_textures_[active_texture_unit] = cache_->FetchFromHash(cache_entry.hash_);
+        // Nothing to hash if none of the source pages were written since the texture was cached
+        cache_entry.write_gen_  = Memory_GetWriteGen(cache_entry.address_, cache_entry.size_);
+        active_textures_[active_texture_unit] = FetchUnchanged(cache_entry);
+
+        // Otherwise hash all of the source data and look the texture up by content, a worker may
+        // already have done both the hashing and the decoding
+        if (NULL == active_textures_[active_texture_unit]) {
+            if (NULL != prefetcher_) {
+                decoded = prefetcher_->Collect(active_texture_unit, GetPrefetchKey(cache_entry),
+                    &cache_entry.hash_);
+            }
+            if (NULL == decoded) {
+                cache_entry.hash_ = common::GetHash64(&Mem_RAM[cache_entry.address_ & RAM_MASK],
+                                                      cache_entry.size_, 0);
+            }
+            active_textures_[active_texture_unit] = cache_->FetchFromHash(cache_entry.hash_);
+
+            if (NULL != active_textures_[active_texture_unit] &&
+                active_textures_[active_texture_unit]->address_ == cache_entry.address_) {
+                active_textures_[active_texture_unit]->write_gen_ = cache_entry.write_gen_;
+            }
+        }
 
         // If that failed, create a new normal texture
         if (NULL == active_textures_[active_texture_unit]) {
-            // Decode texture from source data to RGBA8 raw data...
-            gp::TextureDecoder_Decode(cache_entry.format_, 
-                                      cache_entry.width_,
-                                      cache_entry.height_,
-                                      &Mem_RAM[cache_entry.address_ & RAM_MASK],
-                                      raw_data);
+            // Older versions of this texture (same place and layout, different data) are stale now
+            CacheEntry* stale = cache_->FetchFromAddress(cache_entry.address_);
+            while (NULL != stale) {
+                CacheEntry* next = cache_->NextAtAddress(stale);
+                if (stale->type_ == kSourceType_Normal && stale->format_ == cache_entry.format_ &&
+                    stale->width_ == cache_entry.width_ && stale->height_ == cache_entry.height_ &&
+                    IsEvictable(stale)) {
+                    Evict(stale);
+                }
+                stale = next;
+            }
+
+            // Decode texture from source data to RGBA8 raw data, unless a worker already did...
+            if (NULL == decoded) {
+                gp::TextureDecoder_Decode(cache_entry.format_, 
+                                          cache_entry.width_,
+                                          cache_entry.height_,
+                                          &Mem_RAM[cache_entry.address_ & RAM_MASK],
+                                          raw_data);
+                decoded = raw_data;
+            }
 
             // Create a texture in VRAM from raw data...
             cache_entry.backend_data_ = backend_interface_->Create(active_texture_unit, 
                                                                    cache_entry,
-                                                                   raw_data);
+                                                                   const_cast<u8*>(decoded));
             // Optionally dump texture to TGA...
             if (common::g_config->current_renderer_config().enable_texture_dumping) {
                 std::string filepath = common::g_config->program_dir() + std::string("/dump/textures/");
                 common::CreateFullPath(filepath);
                 filepath = common::FormatStr("%s/%08x.tga", filepath.c_str(), cache_entry.hash_);
-                video_core::DumpTGA(filepath, cache_entry.width_, cache_entry.height_, raw_data);
+                video_core::DumpTGA(filepath, cache_entry.width_, cache_entry.height_,
+                    const_cast<u8*>(decoded));
             }
 
             // Update cache with new information...
-            active_textures_[active_texture_unit] = cache_->Update(cache_entry.hash_, cache_entry);
+            cache_entry.frame_used_ = video_core::g_current_frame;
+            active_textures_[active_texture_unit] = cache_->Update(cache_entry.hash_, cache_entry,
+                cache_entry.address_, cache_entry.width_ * cache_entry.height_ * 4);
+            EnforceBudget();
         }
     } else {
         // Get "used as" format for EFB copies
@@ -107,6 +146,32 @@ void TextureManager::UpdateData(int active_texture_unit, const gp::BPTexImage0&
     }
 
     active_textures_[active_texture_unit]->frame_used_ = video_core::g_current_frame;
+    cache_->Touch(active_textures_[active_texture_unit]);
+}
+
+/**
+ * Starts decoding the texture set up for a texture unit on a worker thread, so that it is
+ * likely ready by the time UpdateData needs it. Does nothing if the texture is cached
+ * @param active_texture_unit Texture unit the texture was set up for (0-7)
+ * @param tex_image_0 BP TexImage0 register of the texture unit
+ * @param tex_image_3 BP TexImage3 register of the texture unit
+ */
+void TextureManager::Prefetch(int active_texture_unit, const gp::BPTexImage0& tex_image_0,
+    const gp::BPTexImage3& tex_image_3) {
+    CacheEntry cache_entry;
+
+    if (NULL == prefetcher_ || tex_image_3.image_base == 0) {
+        return;
+    }
+    SetSource(tex_image_0, tex_image_3, cache_entry);
+    if (!TexturePrefetcher::IsPrefetchable(cache_entry.format_) ||
+        NULL != cache_->FetchFromHash(cache_entry.address_)) {
+        return; // Paletted or an EFB copy
+    }
+    cache_entry.write_gen_ = Memory_GetWriteGen(cache_entry.address_, cache_entry.size_);
+    if (NULL == FetchUnchanged(cache_entry)) {
+        prefetcher_->Submit(active_texture_unit, GetPrefetchKey(cache_entry));
+    }
 }
 
 /** 
@@ -165,7 +230,8 @@ void TextureManager::CopyEFB(u32 addr, gp::BPPixelFormat efb_pixel_format,
     if (NULL == cache_ptr) {
         // create a texture in VRAM for storing the EFB copy...
         cache_entry.backend_data_ = backend_interface_->Create(0, cache_entry, NULL);
-        cache_ptr = cache_->Update(cache_entry.hash_, cache_entry);   
+        cache_ptr = cache_->Update(cache_entry.hash_, cache_entry, addr,
+            cache_entry.width_ * cache_entry.height_ * 4);
     }
     dst_rect.x1_ = cache_entry.width_;
     dst_rect.y1_ = cache_entry.height_;
@@ -215,17 +281,114 @@ int TextureManager::Size() {
 }
 
 /**
- * Purges expired textures (textures that are older than current_frame + age_limit)
+ * Purges expired textures (textures that are older than current_frame + age_limit), then
+ * evicts least recently used textures until the cache is within its size budget
  * @param age_limit Acceptable age limit (in frames) for textures to still be considered fresh
  */
 void TextureManager::Purge(int age_limit) {
-    CacheEntry* cache_entry = NULL;
-    for (int i = 0; i < this->Size(); i++) {
-        cache_entry = cache_->FetchFromIndex(i);
-        if ((cache_entry->frame_used_ + age_limit) < video_core::g_current_frame && cache_entry->type_ != kSourceType_EFBCopy) {
-            backend_interface_->Delete(cache_entry->backend_data_);
-            cache_->Remove(cache_entry->hash_);
+    // Textures are kept in order of use, so stop at the first one that is still fresh
+    CacheEntry* cache_entry = cache_->Oldest();
+    while (NULL != cache_entry) {
+        CacheEntry* newer = cache_->Newer(cache_entry);
+        if (cache_entry->type_ != kSourceType_EFBCopy) {
+            if ((cache_entry->frame_used_ + age_limit) >= video_core::g_current_frame) {
+                break;
+            }
+            if (IsEvictable(cache_entry)) {
+                Evict(cache_entry);
+            }
+        }
+        cache_entry = newer;
+    }
+    EnforceBudget();
+}
+
+/**
+ * Returns true if a texture may be evicted: it isn't an EFB copy (those only come back with the
+ * next copy), it isn't bound to a texture unit and it wasn't used this frame
+ */
+bool TextureManager::IsEvictable(const CacheEntry* cache_entry) {
+    if (cache_entry->type_ == kSourceType_EFBCopy ||
+        cache_entry->frame_used_ == video_core::g_current_frame) {
+        return false;
+    }
+    for (int i = 0; i < kGCMaxActiveTextures; i++) {
+        if (active_textures_[i] == cache_entry) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Fills in the address, format and size of a normal texture from its BP registers
+ * @param tex_image_0 BP TexImage0 register of the texture
+ * @param tex_image_3 BP TexImage3 register of the texture
+ * @param cache_entry Result CacheEntry object
+ */
+void TextureManager::SetSource(const gp::BPTexImage0& tex_image_0,
+    const gp::BPTexImage3& tex_image_3, CacheEntry& cache_entry) {
+    cache_entry.address_    = tex_image_3.image_base << 5;
+    cache_entry.format_     = (gp::TextureFormat)tex_image_0.format;
+    cache_entry.width_      = tex_image_0.width + 1;
+    cache_entry.height_     = tex_image_0.height + 1;
+    cache_entry.type_       = kSourceType_Normal;
+    cache_entry.size_       = gp::TextureDecoder_GetSize(cache_entry.format_, 
+                                                         cache_entry.width_, 
+                                                         cache_entry.height_);
+}
+
+/// Returns the prefetch job key for a normal texture
+TexturePrefetcher::Key TextureManager::GetPrefetchKey(const CacheEntry& cache_entry) {
+    TexturePrefetcher::Key key;
+    key.address     = cache_entry.address_;
+    key.format      = cache_entry.format_;
+    key.width       = cache_entry.width_;
+    key.height      = cache_entry.height_;
+    key.size        = cache_entry.size_;
+    key.write_gen   = cache_entry.write_gen_;
+    return key;
+}
+
+/**
+ * Finds a cached texture whose source pages haven't been written since it was hashed
+ * @param cache_entry Address, format and size of the texture to look for
+ * @return Pointer to the cached texture if found, otherwise NULL
+ */
+TextureManager::CacheEntry* TextureManager::FetchUnchanged(const CacheEntry& cache_entry) {
+    CacheEntry* res = cache_->FetchFromAddress(cache_entry.address_);
+    for (; NULL != res; res = cache_->NextAtAddress(res)) {
+        if (res->type_ == kSourceType_Normal && res->write_gen_ == cache_entry.write_gen_ &&
+            res->format_ == cache_entry.format_ && res->width_ == cache_entry.width_ &&
+            res->height_ == cache_entry.height_) {
+            return res;
+        }
+    }
+    return NULL;
+}
+
+/// Deletes a texture from the backend renderer and from the cache
+void TextureManager::Evict(CacheEntry* cache_entry) {
+    backend_interface_->Delete(cache_entry->backend_data_);
+    cache_->Remove(cache_entry->hash_);
+}
+
+/// Evicts least recently used textures until the cache is within budget_bytes_
+void TextureManager::EnforceBudget() {
+    if (budget_bytes_ == 0) {
+        return;
+    }
+    CacheEntry* cache_entry = cache_->Oldest();
+    while (NULL != cache_entry && cache_->bytes() > budget_bytes_) {
+        CacheEntry* newer = cache_->Newer(cache_entry);
+        if (cache_entry->frame_used_ == video_core::g_current_frame &&
+            cache_entry->type_ != kSourceType_EFBCopy) {
+            break; // Everything from here on is in use
+        }
+        if (IsEvictable(cache_entry)) {
+            Evict(cache_entry);
         }
+        cache_entry = newer;
     }
 }
 
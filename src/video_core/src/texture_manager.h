@@ -34,6 +34,7 @@
 #include "bp_mem.h"
 #include "gx_types.h"
 #include "texture_decoder.h"
+#include "texture_prefetch.h"
 
 // TODO(ShizZy): Fix video_core so I can remove this shit...
 namespace video_core {
@@ -68,6 +69,7 @@ public:
             format_         = gp::kTextureFormat_None; 
             backend_data_   = NULL; 
             hash_           = 0;
+            write_gen_      = 0;
             frame_used_     = -1;
         }
         ~CacheEntry() { 
@@ -80,6 +82,7 @@ public:
         size_t              size_;          ///< Source size of texture in bytes
         BackendData*        backend_data_;  ///< Pointer to backend renderer data
         common::Hash64      hash_;          ///< Hash of source texture raw data
+        u64                 write_gen_;     ///< Memory_GetWriteGen of the source when it was hashed
         int                 frame_used_;    ///< Last frame that the texture was used
 
         /// EFB copy data (only relevant if if texture is from EFB copy)
@@ -108,15 +111,13 @@ public:
         } efb_copy_data_;
     };
 
-    typedef HashContainer_STLMap<common::Hash64, CacheEntry> CacheContainer;
-
-    static const int kHashSamples = 128;    ///< Number of texture samples to use for hash
+    typedef HashContainer_LRU<common::Hash64, CacheEntry> CacheContainer;
 
     /// Renderer interface for controlling textures
     class BackendInterface{
     public:
         BackendInterface() { }
-        ~BackendInterface() { }
+        virtual ~BackendInterface() { }
 
         /**
          * Create a new texture in the backend renderer
@@ -172,6 +173,16 @@ public:
     void UpdateData(int active_texture_unit, const gp::BPTexImage0& tex_image_0, 
         const gp::BPTexImage3& tex_image_3);
 
+    /**
+     * Starts decoding the texture set up for a texture unit on a worker thread, so that it is
+     * likely ready by the time UpdateData needs it. Does nothing if the texture is cached
+     * @param active_texture_unit Texture unit the texture was set up for (0-7)
+     * @param tex_image_0 BP TexImage0 register of the texture unit
+     * @param tex_image_3 BP TexImage3 register of the texture unit
+     */
+    void Prefetch(int active_texture_unit, const gp::BPTexImage0& tex_image_0,
+        const gp::BPTexImage3& tex_image_3);
+
     /** 
      * Copy the EFB to a texture
      * @param addr Address in RAM EFB copy is supposed to go
@@ -212,7 +223,8 @@ public:
     int Size();
 
     /**
-     * Purges expired textures (textures that are older than current_frame + age_limit)
+     * Purges expired textures (textures that are older than current_frame + age_limit), then
+     * evicts least recently used textures until the cache is within its size budget
      * @param age_limit Acceptable age limit (in frames) for textures to still be considered fresh
      * @todo The age_limit seems to affect games - e.g. Link's eyes in ZWW. Figure out why.
      */
@@ -228,8 +240,41 @@ public:
 
 private:
 
+    /**
+     * Returns true if a texture may be evicted: it isn't an EFB copy (those only come back with the
+     * next copy), it isn't bound to a texture unit and it wasn't used this frame
+     */
+    bool IsEvictable(const CacheEntry* cache_entry);
+
+    /**
+     * Fills in the address, format and size of a normal texture from its BP registers
+     * @param tex_image_0 BP TexImage0 register of the texture
+     * @param tex_image_3 BP TexImage3 register of the texture
+     * @param cache_entry Result CacheEntry object
+     */
+    void SetSource(const gp::BPTexImage0& tex_image_0, const gp::BPTexImage3& tex_image_3,
+        CacheEntry& cache_entry);
+
+    /// Returns the prefetch job key for a normal texture
+    TexturePrefetcher::Key GetPrefetchKey(const CacheEntry& cache_entry);
+
+    /**
+     * Finds a cached texture whose source pages haven't been written since it was hashed
+     * @param cache_entry Address, format and size of the texture to look for
+     * @return Pointer to the cached texture if found, otherwise NULL
+     */
+    CacheEntry* FetchUnchanged(const CacheEntry& cache_entry);
+
+    /// Deletes a texture from the backend renderer and from the cache
+    void Evict(CacheEntry* cache_entry);
+
+    /// Evicts least recently used textures until the cache is within budget_bytes_
+    void EnforceBudget();
+
     CacheContainer*     cache_;                                 ///< Texture cache
+    size_t              budget_bytes_;                          ///< Cache size limit, 0 for none
     BackendInterface*   backend_interface_;                     ///< Backend renderer interface
+    TexturePrefetcher*  prefetcher_;                            ///< Decode workers, NULL if none
 
     DISALLOW_COPY_AND_ASSIGN(TextureManager);
 };
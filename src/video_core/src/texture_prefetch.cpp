@@ -0,0 +1,165 @@
+/**
+ * Copyright (C) 2005-2012 Gekko Emulator
+ *
+ * @file    texture_prefetch.cpp
+ * @author  ShizZy <shizzy247@gmail.com>
+ * @date    2013-02-24
+ * @brief   Worker threads that hash and decode textures ahead of the draw that uses them
+ *
+ * @section LICENSE
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details at
+ * http://www.gnu.org/copyleft/gpl.html
+ *
+ * Official project repository can be found at:
+ * http://code.google.com/p/gekko-gc-emu/
+ */
+
+#include <algorithm>
+
+#include "SDL.h"
+
+#include "memory.h"
+
+#include "texture_prefetch.h"
+
+/// Upper limit on workers, there is only one job per texture unit to work on
+static const int kMaxPrefetchThreads = 4;
+
+TexturePrefetcher::TexturePrefetcher(int num_threads) {
+    for (int i = 0; i < kGCMaxActiveTextures; i++) {
+        memset(&slots_[i].key, 0, sizeof(slots_[i].key));
+        slots_[i].state = kSlotState_Empty;
+        slots_[i].hash  = 0;
+    }
+    quit_       = false;
+    mutex_      = SDL_CreateMutex();
+    queued_     = SDL_CreateCond();
+    finished_   = SDL_CreateCond();
+
+    for (int i = 0; i < num_threads; i++) {
+        SDL_Thread* thread = SDL_CreateThread(WorkerEntry, "TexturePrefetch", this);
+        if (thread == NULL) {
+            LOG_ERROR(TVIDEO, "Unable to create texture prefetch thread: %s", SDL_GetError());
+            break;
+        }
+        threads_.push_back(thread);
+    }
+    LOG_NOTICE(TVIDEO, "Decoding textures ahead of use on %d thread(s)", (int)threads_.size());
+}
+
+TexturePrefetcher::~TexturePrefetcher() {
+    SDL_LockMutex(mutex_);
+    quit_ = true;
+    SDL_CondBroadcast(queued_);
+    SDL_UnlockMutex(mutex_);
+
+    for (size_t i = 0; i < threads_.size(); i++) {
+        SDL_WaitThread(threads_[i], NULL);
+    }
+    SDL_DestroyCond(finished_);
+    SDL_DestroyCond(queued_);
+    SDL_DestroyMutex(mutex_);
+}
+
+/// Returns the number of workers to use on this host, 0 if prefetching isn't worth it
+int TexturePrefetcher::DefaultThreadCount() {
+    int num_threads = SDL_GetCPUCount() - 2;
+    return std::max(0, std::min(num_threads, kMaxPrefetchThreads));
+}
+
+/// Returns true if textures of a format can be prefetched
+bool TexturePrefetcher::IsPrefetchable(gp::TextureFormat format) {
+    return (format <= gp::kTextureFormat_RGBA8 || format == gp::kTextureFormat_CMPR);
+}
+
+/// Queue a texture to be hashed and decoded for a texture unit
+void TexturePrefetcher::Submit(int active_texture_unit, const Key& key) {
+    Slot& slot = slots_[active_texture_unit];
+
+    SDL_LockMutex(mutex_);
+    // The worker owns the slot's buffer until it is done
+    while (slot.state == kSlotState_Running) {
+        SDL_CondWait(finished_, mutex_);
+    }
+    if (slot.state == kSlotState_Empty || !(slot.key == key)) {
+        slot.key = key;
+        if (slot.state != kSlotState_Queued) {
+            slot.state = kSlotState_Queued;
+            queue_.push_back(active_texture_unit);
+        }
+        SDL_CondSignal(queued_);
+    }
+    SDL_UnlockMutex(mutex_);
+}
+
+/// Collect the result of a prefetch, blocking only while a worker is decoding it
+const u8* TexturePrefetcher::Collect(int active_texture_unit, const Key& key,
+    common::Hash64* hash) {
+    Slot& slot = slots_[active_texture_unit];
+    const u8* res = NULL;
+
+    SDL_LockMutex(mutex_);
+    if (slot.key == key) {
+        while (slot.state == kSlotState_Running) {
+            SDL_CondWait(finished_, mutex_);
+        }
+        if (slot.state == kSlotState_Done) {
+            *hash = slot.hash;
+            res = &slot.data[0];
+        } else if (slot.state == kSlotState_Queued) {
+            queue_.erase(std::find(queue_.begin(), queue_.end(), active_texture_unit));
+            slot.state = kSlotState_Empty;
+        }
+    }
+    SDL_UnlockMutex(mutex_);
+    return res;
+}
+
+int TexturePrefetcher::WorkerEntry(void* prefetcher) {
+    reinterpret_cast<TexturePrefetcher*>(prefetcher)->Run();
+    return 0;
+}
+
+/// Worker thread main loop
+void TexturePrefetcher::Run() {
+    SDL_LockMutex(mutex_);
+    for (;;) {
+        while (queue_.empty() && !quit_) {
+            SDL_CondWait(queued_, mutex_);
+        }
+        if (quit_) {
+            break;
+        }
+        Slot& slot = slots_[queue_.front()];
+        queue_.erase(queue_.begin());
+
+        Key key = slot.key;
+        size_t decoded_size = key.width * key.height * 4;
+        if (slot.data.size() < decoded_size) {
+            slot.data.resize(decoded_size);
+        }
+        u8* dst = &slot.data[0];
+        slot.state = kSlotState_Running;
+        SDL_UnlockMutex(mutex_);
+
+        // RAM may be written meanwhile, the caller only accepts the result if the write
+        // generation still matches at draw time
+        const u8* src = &Mem_RAM[key.address & RAM_MASK];
+        common::Hash64 hash = common::GetHash64(src, key.size, 0);
+        gp::TextureDecoder_Decode(key.format, key.width, key.height, src, dst);
+
+        SDL_LockMutex(mutex_);
+        slot.hash = hash;
+        slot.state = kSlotState_Done;
+        SDL_CondBroadcast(finished_);
+    }
+    SDL_UnlockMutex(mutex_);
+}
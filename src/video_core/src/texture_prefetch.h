@@ -0,0 +1,133 @@
+/**
+ * Copyright (C) 2005-2012 Gekko Emulator
+ *
+ * @file    texture_prefetch.h
+ * @author  ShizZy <shizzy247@gmail.com>
+ * @date    2013-02-24
+ * @brief   Worker threads that hash and decode textures ahead of the draw that uses them
+ *
+ * @section LICENSE
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details at
+ * http://www.gnu.org/copyleft/gpl.html
+ *
+ * Official project repository can be found at:
+ * http://code.google.com/p/gekko-gc-emu/
+ */
+
+#ifndef VIDEO_CORE_TEXTURE_PREFETCH_H_
+#define VIDEO_CORE_TEXTURE_PREFETCH_H_
+
+#include <vector>
+
+#include "common.h"
+#include "hash.h"
+
+#include "gx_types.h"
+#include "texture_decoder.h"
+
+struct SDL_Thread;
+struct SDL_mutex;
+struct SDL_cond;
+
+/**
+ * @brief Decodes textures on worker threads as soon as the GP sees a texture unit being set up,
+ * so that by the time a primitive using it is drawn the RGBA8 data is usually ready. Each texture
+ * unit has one job slot. Only the GP thread submits and consumes jobs, the backend upload stays on
+ * the GP thread. Paletted textures aren't prefetched since their palette lives in TMEM, which the
+ * GP thread may reload before the draw.
+ */
+class TexturePrefetcher {
+public:
+    /// Description of a texture to prefetch, also used to match a job with a draw
+    struct Key {
+        u32                 address;    ///< Source address of texture
+        gp::TextureFormat   format;     ///< Source texture format
+        int                 width;      ///< Width in pixels
+        int                 height;     ///< Height in pixels
+        size_t              size;       ///< Source size in bytes
+        u64                 write_gen;  ///< Memory_GetWriteGen of the source at submission
+
+        inline bool operator == (const Key& val) const {
+            return (address == val.address && format == val.format && width == val.width &&
+                height == val.height && size == val.size && write_gen == val.write_gen);
+        }
+    };
+
+    /**
+     * @brief Create the prefetcher
+     * @param num_threads Number of worker threads to start
+     */
+    TexturePrefetcher(int num_threads);
+    ~TexturePrefetcher();
+
+    /**
+     * @brief Returns the number of workers to use on this host, 0 if prefetching isn't worth it
+     * (the CPU and GP threads already take two cores)
+     */
+    static int DefaultThreadCount();
+
+    /**
+     * @brief Returns true if textures of a format can be prefetched
+     * @param format Source texture format
+     */
+    static bool IsPrefetchable(gp::TextureFormat format);
+
+    /**
+     * @brief Queue a texture to be hashed and decoded for a texture unit. Waits if the unit's
+     * previous job is still being worked on
+     * @param active_texture_unit Texture unit the texture was set up for (0-7)
+     * @param key Texture to decode
+     */
+    void Submit(int active_texture_unit, const Key& key);
+
+    /**
+     * @brief Collect the result of a prefetch, blocking only while a worker is decoding it. A job
+     * that no worker picked up yet is dropped instead, decoding it on the caller is as fast
+     * @param active_texture_unit Texture unit to collect (0-7)
+     * @param key Texture the caller needs
+     * @param hash Receives the hash of the source data on success
+     * @return RGBA8 texture data, valid until the next Submit for the unit, NULL if the unit has no
+     * finished prefetch of key
+     */
+    const u8* Collect(int active_texture_unit, const Key& key, common::Hash64* hash);
+
+private:
+    enum SlotState {
+        kSlotState_Empty = 0,   ///< No job, or its result was dropped
+        kSlotState_Queued,      ///< Waiting for a worker
+        kSlotState_Running,     ///< A worker is decoding it
+        kSlotState_Done,        ///< Result is ready
+    };
+
+    struct Slot {
+        Key                 key;
+        SlotState           state;
+        common::Hash64      hash;       ///< Hash of the source data
+        std::vector<u8>     data;       ///< Decoded RGBA8 texture
+    };
+
+    static int WorkerEntry(void* prefetcher);
+
+    /// Worker thread main loop
+    void Run();
+
+    Slot                    slots_[kGCMaxActiveTextures];
+    std::vector<int>        queue_;     ///< Slots waiting for a worker, oldest first
+    bool                    quit_;
+    std::vector<SDL_Thread*> threads_;
+    SDL_mutex*              mutex_;     ///< Guards the slots, the queue and quit_
+    SDL_cond*               queued_;    ///< Signaled when a job is queued or on shutdown
+    SDL_cond*               finished_;  ///< Signaled when a worker finishes a job
+
+    DISALLOW_COPY_AND_ASSIGN(TexturePrefetcher);
+};
+
+#endif // VIDEO_CORE_TEXTURE_PREFETCH_H_
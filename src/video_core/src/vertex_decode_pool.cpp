@@ -0,0 +1,155 @@
+/**
+ * Copyright (C) 2005-2012 Gekko Emulator
+ *
+ * @file    vertex_decode_pool.cpp
+ * @author  ShizZy <shizzy247@gmail.com>
+ * @date    2013-02-27
+ * @brief   Worker threads that decode the vertices of large primitives alongside the GP thread
+ *
+ * @section LICENSE
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details at
+ * http://www.gnu.org/copyleft/gpl.html
+ *
+ * Official project repository can be found at:
+ * http://code.google.com/p/gekko-gc-emu/
+ */
+
+#include <algorithm>
+
+#include "SDL.h"
+
+#include "atomic.h"
+
+#include "vertex_decode_pool.h"
+
+/// Upper limit on workers, the largest primitive only has 256 batches
+static const int kMaxDecodeThreads = 3;
+
+VertexDecodePool::VertexDecodePool(int num_threads) {
+    func_       = NULL;
+    job_        = NULL;
+    count_      = 0;
+    job_num_    = 0;
+    next_batch_ = 0;
+    num_active_ = 0;
+    quit_       = false;
+    mutex_      = SDL_CreateMutex();
+    queued_     = SDL_CreateCond();
+    finished_   = SDL_CreateCond();
+
+    for (int i = 0; i < num_threads; i++) {
+        SDL_Thread* thread = SDL_CreateThread(WorkerEntry, "VertexDecode", this);
+        if (thread == NULL) {
+            LOG_ERROR(TVIDEO, "Unable to create vertex decoding thread: %s", SDL_GetError());
+            break;
+        }
+        threads_.push_back(thread);
+    }
+    LOG_NOTICE(TVIDEO, "Decoding large primitives on %d extra thread(s)", (int)threads_.size());
+}
+
+VertexDecodePool::~VertexDecodePool() {
+    SDL_LockMutex(mutex_);
+    quit_ = true;
+    SDL_CondBroadcast(queued_);
+    SDL_UnlockMutex(mutex_);
+
+    for (size_t i = 0; i < threads_.size(); i++) {
+        SDL_WaitThread(threads_[i], NULL);
+    }
+    SDL_DestroyCond(finished_);
+    SDL_DestroyCond(queued_);
+    SDL_DestroyMutex(mutex_);
+}
+
+/// Returns the number of workers to use on this host, 0 if several threads aren't worth it
+int VertexDecodePool::DefaultThreadCount() {
+    int num_threads = SDL_GetCPUCount() - 2;
+    return std::max(0, std::min(num_threads, kMaxDecodeThreads));
+}
+
+/// Decodes the vertices of a job on the workers and the calling thread
+void VertexDecodePool::Decode(DecodeFunc func, const void* job, int count) {
+    SDL_LockMutex(mutex_);
+    func_ = func;
+    job_ = job;
+    count_ = count;
+    job_num_++;
+    common::AtomicStore(next_batch_, 0);
+    SDL_CondBroadcast(queued_);
+    SDL_UnlockMutex(mutex_);
+
+    DecodeBatches(func, job, count);
+
+    // Every batch is taken, wait for the workers still decoding theirs. A worker that was woken
+    // for this job but only gets the mutex now must not join it (next_batch_ will be reset for
+    // the next job while it still holds this one), so clear the job before it goes out of scope.
+    SDL_LockMutex(mutex_);
+    while (num_active_ > 0) {
+        SDL_CondWait(finished_, mutex_);
+    }
+    func_ = NULL;
+    job_ = NULL;
+    count_ = 0;
+    SDL_UnlockMutex(mutex_);
+}
+
+int VertexDecodePool::WorkerEntry(void* pool) {
+    reinterpret_cast<VertexDecodePool*>(pool)->Run();
+    return 0;
+}
+
+/// Worker thread main loop
+void VertexDecodePool::Run() {
+    SDL_LockMutex(mutex_);
+    u32 job_num = job_num_;
+
+    for (;;) {
+        while (job_num == job_num_ && !quit_) {
+            SDL_CondWait(queued_, mutex_);
+        }
+        if (quit_) {
+            break;
+        }
+        job_num = job_num_;
+        if (count_ == 0) {
+            continue; // Job already finished before this worker got to it
+        }
+        DecodeFunc func = func_;
+        const void* job = job_;
+        int count = count_;
+        num_active_++;
+        SDL_UnlockMutex(mutex_);
+
+        DecodeBatches(func, job, count);
+
+        SDL_LockMutex(mutex_);
+        if (--num_active_ == 0) {
+            SDL_CondSignal(finished_);
+        }
+    }
+    SDL_UnlockMutex(mutex_);
+}
+
+/// Decodes batches of the current job until all of them are taken
+void VertexDecodePool::DecodeBatches(DecodeFunc func, const void* job, int count) {
+    const u32 num_batches = (count + kBatchSize - 1) / kBatchSize;
+
+    for (;;) {
+        u32 batch = common::AtomicExchangeAdd(next_batch_, 1);
+        if (batch >= num_batches) {
+            break;
+        }
+        int first = batch * kBatchSize;
+        int size = count - first;
+        func(job, first, (size < kBatchSize) ? size : kBatchSize);
+    }
+}
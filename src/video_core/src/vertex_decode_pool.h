@@ -0,0 +1,109 @@
+/**
+ * Copyright (C) 2005-2012 Gekko Emulator
+ *
+ * @file    vertex_decode_pool.h
+ * @author  ShizZy <shizzy247@gmail.com>
+ * @date    2013-02-27
+ * @brief   Worker threads that decode the vertices of large primitives alongside the GP thread
+ *
+ * @section LICENSE
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details at
+ * http://www.gnu.org/copyleft/gpl.html
+ *
+ * Official project repository can be found at:
+ * http://code.google.com/p/gekko-gc-emu/
+ */
+
+#ifndef VIDEO_CORE_VERTEX_DECODE_POOL_H_
+#define VIDEO_CORE_VERTEX_DECODE_POOL_H_
+
+#include <vector>
+
+#include "common.h"
+
+struct SDL_Thread;
+struct SDL_mutex;
+struct SDL_cond;
+
+/**
+ * @brief Splits the decoding of a primitive's vertices between the GP thread and worker threads.
+ * Vertices are handed out in batches through a lock-free counter, the GP thread decodes batches
+ * as well and returns once every batch is done. Vertices decode independently of each other (each
+ * one has its own source data and VBO slot), so the batches may run in any order.
+ */
+class VertexDecodePool {
+public:
+    /**
+     * Decodes a batch of vertices of a job
+     * @param job Job passed to Decode
+     * @param first Index of the first vertex of the batch
+     * @param count Number of vertices in the batch
+     */
+    typedef void (*DecodeFunc)(const void* job, int first, int count);
+
+    /// Primitives with fewer vertices are faster to decode than to hand out
+    static const int kMinVertices   = 1024;
+
+    /// Vertices handed out at a time
+    static const int kBatchSize     = 256;
+
+    /**
+     * @brief Create the pool
+     * @param num_threads Number of worker threads to start
+     */
+    VertexDecodePool(int num_threads);
+    ~VertexDecodePool();
+
+    /**
+     * @brief Returns the number of workers to use on this host, 0 if decoding on several threads
+     * isn't worth it (the CPU and GP threads already take two cores)
+     */
+    static int DefaultThreadCount();
+
+    /**
+     * @brief Decodes the vertices of a job on the workers and the calling thread, returns when
+     * all of them are decoded. Only the GP thread may call this.
+     * @param func Batch decoding routine, called from several threads at once
+     * @param job Job data, only read by func
+     * @param count Number of vertices
+     */
+    void Decode(DecodeFunc func, const void* job, int count);
+
+private:
+    static int WorkerEntry(void* pool);
+
+    /// Worker thread main loop
+    void Run();
+
+    /**
+     * Decodes batches of the current job until all of them are taken
+     * @param func Batch decoding routine of the job
+     * @param job Job data
+     * @param count Number of vertices of the job
+     */
+    void DecodeBatches(DecodeFunc func, const void* job, int count);
+
+    DecodeFunc              func_;          ///< Decoding routine of the current job
+    const void*             job_;           ///< Current job
+    int                     count_;         ///< Number of vertices of the current job, 0 if none
+    u32                     job_num_;       ///< Incremented for every job
+    u32 volatile            next_batch_;    ///< Next batch of the current job to hand out
+    int                     num_active_;    ///< Workers that joined the current job
+    bool                    quit_;
+    std::vector<SDL_Thread*> threads_;
+    SDL_mutex*              mutex_;         ///< Guards everything but next_batch_
+    SDL_cond*               queued_;        ///< Signaled when a job starts or on shutdown
+    SDL_cond*               finished_;      ///< Signaled when the last worker leaves a job
+
+    DISALLOW_COPY_AND_ASSIGN(VertexDecodePool);
+};
+
+#endif // VIDEO_CORE_VERTEX_DECODE_POOL_H_
@@ -23,6 +23,8 @@
 */
 
 #include "common.h"
+#include "hash.h"
+#include "hash_container.h"
 #include "memory.h"
 
 #include "renderer_gl3/renderer_gl3.h"
@@ -30,803 +32,877 @@
 #include "video_core.h"
 #include "vertex_manager.h"
 #include "vertex_loader.h"
+#include "vertex_decode_pool.h"
 #include "fifo.h"
 #include "cp_mem.h"
 #include "xf_mem.h"
 
 namespace gp {
 
-typedef void (*VertexLoaderTable)(u32, u32*);	
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Vertex loader cache
+//
+// Every combination of VCD and VAT that a game draws with is compiled once into a vertex loader: a
+// flat list of steps, one per vertex component, each pointing at a routine that is specialized at
+// compile time for the component's attribute type (direct/index8/index16), element size, element
+// count and data source (FIFO or display list). Decoding a primitive is then a single loop over
+// the steps for each vertex, without any per-component format switches or Fifo_Pop* calls.
+
+static const int kMaxVertexLoaderSteps  = 21;   ///< 9 matrix indices + pos + nrm + 2 col + 8 tex
+static const u8  kNoArray               = 0xff; ///< Step doesn't read from a CP vertex array
+
+/// Key identifying a vertex loader, the VCD and VAT registers it was compiled for
+struct VertexLoaderKey {
+    u32 vcd_lo;
+    u32 vcd_hi;
+    u32 vat_a;
+    u32 vat_b;
+    u32 vat_c;
+};
+
+/// A single vertex component decoding step
+struct VertexLoaderStep {
+    u16 offset;     ///< Byte offset of the destination in the decoded vertex
+    u8  array;      ///< CP vertex array read by indexed components, kNoArray otherwise
+    u8  format;     ///< Component format, (count << 3) | type (for error reporting)
+    u32 base;       ///< Array base address, refreshed for every primitive
+    u32 stride;     ///< Array stride, refreshed for every primitive
+};
+
+/// Vertex loader step routines for a given data source
+template <typename Source> struct VertexProgram {
+    typedef void (*StepFunc)(const VertexLoaderStep& step, Source& src, u8* vertex);
+    StepFunc funcs[kMaxVertexLoaderSteps];
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Vertex data sources
+
+/// Reads vertex data straight from the FIFO ring (the mirror keeps it contiguous across the wrap)
+struct FifoSource {
+    u8* ptr;
+
+    FifoSource() : ptr(g_fifo_read_ptr) {
+    }
+    /// Write the read position back to the FIFO
+    inline void Commit() {
+        g_fifo_read_ptr = ptr;
+    }
+    inline u8 Read8() {
+        return *ptr++;
+    }
+    inline u16 Read16() {
+        u16 res = BSWAP16(*(u16*)ptr);
+        ptr += 2;
+        return res;
+    }
+    inline u32 Read32() {
+        u32 res = BSWAP32(*(u32*)ptr);
+        ptr += 4;
+        return res;
+    }
+    inline void Read(u8* dest, int size) {
+        memcpy(dest, ptr, size);
+        ptr += size;
+    }
+    inline void Skip(int size) {
+        ptr += size;
+    }
+};
+
+/// Reads vertex data from the display list currently being executed
+struct DisplayListSource {
+    u32 addr;
+
+    DisplayListSource() : addr(g_dl_read_addr + g_dl_read_offset) {
+    }
+    /// Write the read position back to the display list
+    inline void Commit() {
+        g_dl_read_offset = addr - g_dl_read_addr;
+    }
+    inline u8 Read8() {
+        return Mem_RAM[MEM_SWIZZLE8(addr++)];
+    }
+    inline u16 Read16() {
+        u16 res = (Mem_RAM[MEM_SWIZZLE8(addr + 0)] << 8) | Mem_RAM[MEM_SWIZZLE8(addr + 1)];
+        addr += 2;
+        return res;
+    }
+    inline u32 Read32() {
+        u32 res = (Mem_RAM[MEM_SWIZZLE8(addr + 0)] << 24) | (Mem_RAM[MEM_SWIZZLE8(addr + 1)] << 16) |
+            (Mem_RAM[MEM_SWIZZLE8(addr + 2)] << 8) | Mem_RAM[MEM_SWIZZLE8(addr + 3)];
+        addr += 4;
+        return res;
+    }
+    inline void Read(u8* dest, int size) {
+        for (int i = 0; i < size; i++) {
+            dest[i] = Mem_RAM[MEM_SWIZZLE8(addr++)];
+        }
+    }
+    inline void Skip(int size) {
+        addr += size;
+    }
+};
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 // Memory access
 
+/// Memory read for indexed 8-bit vertex components
+static __inline u8 _indexed_read_8(u32 addr) {
+    return Mem_RAM[MEM_SWIZZLE8(addr) & RAM_MASK];
+}
+
 /// Memory read for indexed 16-bit vertex components
 static __inline u16 _indexed_read_16(u32 addr) {
     if(!(addr & 1))
-        return *(u16 *)(&Mem_RAM[(addr ^ 2) & RAM_MASK]);
+        return MEM_LOAD16(&Mem_RAM[MEM_SWIZZLE16(addr) & RAM_MASK]);
 
     addr = addr & RAM_MASK;
-    return (u16)(Mem_RAM[(addr + 0) ^ 3] << 8) |
-        (u16)(Mem_RAM[(addr + 1) ^ 3]);
+    return (u16)(Mem_RAM[MEM_SWIZZLE8(addr + 0)] << 8) |
+        (u16)(Mem_RAM[MEM_SWIZZLE8(addr + 1)]);
 }
 
 /// Memory read for indexed 32-bit vertex components
 static __inline u32 _indexed_read_32(u32 addr) {
     addr &= RAM_MASK;
     if(!(addr & 3))
-        return *(u32 *)(&Mem_RAM[addr]);
+        return MEM_LOAD32(&Mem_RAM[addr]);
 
-    return ((u32)Mem_RAM[(addr + 0) ^ 3] << 24) |
-        ((u32)Mem_RAM[(addr + 1) ^ 3] << 16) |
-        ((u32)Mem_RAM[(addr + 2) ^ 3] << 8) |
-        ((u32)Mem_RAM[(addr + 3) ^ 3]);
+    return ((u32)Mem_RAM[MEM_SWIZZLE8(addr + 0)] << 24) |
+        ((u32)Mem_RAM[MEM_SWIZZLE8(addr + 1)] << 16) |
+        ((u32)Mem_RAM[MEM_SWIZZLE8(addr + 2)] << 8) |
+        ((u32)Mem_RAM[MEM_SWIZZLE8(addr + 3)]);
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
-// Vertex decoding
+// Vertex decoding steps
 
-/// Unknown position vertex component
-static void __pos_unknown(u32 addr, u32* data) {
-    _ASSERT_MSG(TGP, 0, "Unknown vertex position - count: %d format: %d", 
-        gp::g_cp_regs.vat_reg_a[gp::g_cur_vat].pos_count, 
-        gp::g_cp_regs.vat_reg_a[gp::g_cur_vat].pos_type);
+/// Matrix index
+template <typename Source> 
+static void DecodeMatrixIndex(const VertexLoaderStep& step, Source& src, u8* vertex) {
+    vertex[step.offset] = src.Read8();
 }
 
-/// Unknown color vertex component
-static void __col_unknown(u32 addr, u32* data) {
-    _ASSERT_MSG(TGP, 0, "Unknown vertex color - count: %d format: %d", 
-        gp::g_cp_regs.vat_reg_a[gp::g_cur_vat].col0_count, 
-        gp::g_cp_regs.vat_reg_a[gp::g_cur_vat].col0_type);
+/// Color that isn't present in the vertex, defaults to white
+template <typename Source> 
+static void DecodeColorNone(const VertexLoaderStep& step, Source& src, u8* vertex) {
+    *(u32*)(vertex + step.offset) = 0xffffffff;
 }
 
-/// Unknown normal vertex component
-static void __normal_unknown(u32 addr, u32* data) {
-    _ASSERT_MSG(TGP, 0, "Unknown vertex normal - count: %d format: %d", 
-        gp::g_cp_regs.vat_reg_a[gp::g_cur_vat].normal_count, 
-        gp::g_cp_regs.vat_reg_a[gp::g_cur_vat].normal_type);
+/// Unknown vertex component format
+template <typename Source> 
+static void DecodeUnknown(const VertexLoaderStep& step, Source& src, u8* vertex) {
+    _ASSERT_MSG(TGP, 0, "Unknown vertex component - offset: %d count: %d format: %d", 
+        step.offset, step.format >> 3, step.format & 7);
 }
 
-/// Unknown texture coordinate vertex component
-static void __texcoord_unknown(u32 addr, u32* data) {
-    _ASSERT_MSG(TGP, 0, "Unknown texture coordinate normal")
-}
-
-/// Direct vertex component 1 byte
-static void __direct_byte_1(u32 addr, u32* dest) {
-    u8* v = (u8*)dest;
-    v[0] = gp::Fifo_Pop8();
+/**
+ * Direct vertex component, kCount elements of kSize bytes read from the command stream
+ * @param step Decoding step
+ * @param src Vertex data source
+ * @param vertex Destination vertex
+ */
+template <typename Source, int kSize, int kCount> 
+static void DecodeDirect(const VertexLoaderStep& step, Source& src, u8* vertex) {
+    u8* dest = vertex + step.offset;
+    for (int i = 0; i < kCount; i++) {
+        if (kSize == 1) {
+            dest[i] = src.Read8();
+        } else if (kSize == 2) {
+            ((u16*)dest)[i] = src.Read16();
+        } else {
+            ((u32*)dest)[i] = src.Read32();
+        }
+    }
 }
 
-/// Direct vertex component 2 bytes
-static void __direct_byte_2(u32 addr, u32* dest) {
-    u8* v = (u8*)dest;
-    v[0] = gp::Fifo_Pop8();
-    v[1] = gp::Fifo_Pop8();
+/**
+ * Indexed vertex component, a kIndexSize byte index read from the command stream selects kCount
+ * elements of kSize bytes in a CP vertex array
+ * @param step Decoding step
+ * @param src Vertex data source
+ * @param vertex Destination vertex
+ */
+template <typename Source, int kIndexSize, int kSize, int kCount> 
+static void DecodeIndexed(const VertexLoaderStep& step, Source& src, u8* vertex) {
+    u32 index = (kIndexSize == 1) ? src.Read8() : src.Read16();
+    u32 addr = step.base + index * step.stride;
+    u8* dest = vertex + step.offset;
+    for (int i = 0; i < kCount; i++) {
+        if (kSize == 1) {
+            dest[i] = _indexed_read_8(addr + i);
+        } else if (kSize == 2) {
+            ((u16*)dest)[i] = _indexed_read_16(addr + (i << 1));
+        } else {
+            ((u32*)dest)[i] = _indexed_read_32(addr + (i << 2));
+        }
+    }
 }
 
-/// Direct vertex component 3 bytes
-static void __direct_byte_3(u32 addr, u32* dest) {
-    u8* v = (u8*)dest;
-    v[0] = gp::Fifo_Pop8();
-    v[1] = gp::Fifo_Pop8();
-    v[2] = gp::Fifo_Pop8();
+/// Selects the decoding routine for a component of kCount elements of kSize bytes
+template <typename Source, int kSize, int kCount>
+static typename VertexProgram<Source>::StepFunc GetDecodeFunc(GXAttrType attr) {
+    switch (attr) {
+    case GX_DIRECT:
+        return DecodeDirect<Source, kSize, kCount>;
+    case GX_INDEX8:
+        return DecodeIndexed<Source, 1, kSize, kCount>;
+    case GX_INDEX16:
+        return DecodeIndexed<Source, 2, kSize, kCount>;
+    default:
+        break;
+    }
+    return DecodeUnknown<Source>;
+}
+
+/// Selects the decoding routine for a component of count elements of kSize bytes
+template <typename Source, int kSize>
+static typename VertexProgram<Source>::StepFunc GetDecodeFunc(GXAttrType attr, int count) {
+    switch (count) {
+    case 1: 
+        return GetDecodeFunc<Source, kSize, 1>(attr);
+    case 2: 
+        return GetDecodeFunc<Source, kSize, 2>(attr);
+    case 3: 
+        return GetDecodeFunc<Source, kSize, 3>(attr);
+    case 9: 
+        return GetDecodeFunc<Source, kSize, 9>(attr);
+    }
+    return DecodeUnknown<Source>;
 }
 
-/// Direct vertex component 9 bytes
-static void __direct_byte_9(u32 addr, u32* dest) {
-    u8* v = (u8*)dest;
-    v[0] = gp::Fifo_Pop8();
-    v[1] = gp::Fifo_Pop8();
-    v[2] = gp::Fifo_Pop8();
-    v[3] = gp::Fifo_Pop8();
-    v[4] = gp::Fifo_Pop8();
-    v[5] = gp::Fifo_Pop8();
-    v[6] = gp::Fifo_Pop8();
-    v[7] = gp::Fifo_Pop8();
-    v[8] = gp::Fifo_Pop8();
-    _ASSERT_MSG(TGP, 0, "Unimplemented method %s (%s line %s)", __FUNCTION__, __FILE__, __LINE__);
+/**
+ * Selects the decoding routine for a vertex component
+ * @param attr Attribute type (direct, indexed8, etc.)
+ * @param size Size of a component element in bytes, 0 if the format is unknown
+ * @param count Number of component elements
+ * @return Decoding routine
+ */
+template <typename Source>
+static typename VertexProgram<Source>::StepFunc GetDecodeFunc(GXAttrType attr, int size, 
+    int count) {
+    switch (size) {
+    case 1: 
+        return GetDecodeFunc<Source, 1>(attr, count);
+    case 2: 
+        return GetDecodeFunc<Source, 2>(attr, count);
+    case 4: 
+        return GetDecodeFunc<Source, 4>(attr, count);
+    }
+    return DecodeUnknown<Source>;
 }
 
-/// Direct vertex component 1 short
-static void __direct_short_1(u32 addr, u32* dest) {
-    u16* v = (u16*)dest;
-    v[0] = gp::Fifo_Pop16();
-}
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Vertex loader compilation
+
+/// Vertex component kinds, they differ in how the VAT format maps to element size and count
+enum VertexComponentKind {
+    kComponent_Position = 0,
+    kComponent_Normal,
+    kComponent_Color,
+    kComponent_TexCoord
+};
 
-/// Direct vertex component 2 shorts
-static void __direct_short_2(u32 addr, u32* dest) {
-    u16* v = (u16*)dest;
-    v[0] = gp::Fifo_Pop16();
-    v[1] = gp::Fifo_Pop16();
-}
+/// Size (in bytes) of a vertex component element, by component type (U8, S8, U16, S16, F32)
+static const u8 kComponentElementSize[8]    = { 1, 1, 2, 2, 4, 0, 0, 0 };
 
-/// Direct vertex component 3 shorts
-static void __direct_short_3(u32 addr, u32* dest) {
-    u16* v = (u16*)dest;
-    v[0] = gp::Fifo_Pop16();
-    v[1] = gp::Fifo_Pop16();
-    v[2] = gp::Fifo_Pop16();
-}
+/// Size (in bytes) and count of a color element, by color type (RGB565 .. RGBA8)
+static const u8 kColorElementSize[8]        = { 2, 1, 4, 2, 1, 4, 0, 0 };
+static const u8 kColorElementCount[8]       = { 1, 3, 1, 1, 3, 1, 0, 0 };
 
-/// Direct vertex component 9 shorts
-static void __direct_short_9(u32 addr, u32* dest) {
-    u16* v = (u16*)dest;
-    v[0] = gp::Fifo_Pop16();
-    v[1] = gp::Fifo_Pop16();
-    v[2] = gp::Fifo_Pop16();
-    v[3] = gp::Fifo_Pop16();
-    v[4] = gp::Fifo_Pop16();
-    v[5] = gp::Fifo_Pop16();
-    v[6] = gp::Fifo_Pop16();
-    v[7] = gp::Fifo_Pop16();
-    v[8] = gp::Fifo_Pop16();
-    _ASSERT_MSG(TGP, 0, "Unimplemented method %s (%s line %s)", __FUNCTION__, __FILE__, __LINE__);
-}
-
-/// Direct vertex component 1 float
-static void __direct_float_1(u32 addr, u32* dest) {
-    dest[0] = gp::Fifo_Pop32();
-}
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Decoded vertex layout
+//
+// Every component gets room for the elements the renderer reads of it (3 position elements, 4
+// normal elements or 9 with NBT, 2 texture coordinate elements), rounded up to 4 bytes. With the
+// usual formats that is 40-60 bytes per vertex instead of a full GXVertex.
 
-/// Direct vertex component 2 floats
-static void __direct_float_2(u32 addr, u32* dest) {
-    dest[0] = gp::Fifo_Pop32();
-    dest[1] = gp::Fifo_Pop32();
-}
+static const int kMatrixIndicesSize = 12;       ///< pm_idx, 3 bytes of padding, tm_idx[8]
 
-/// Direct vertex component 3 floats
-static void __direct_float_3(u32 addr, u32* dest) {
-    dest[0] = gp::Fifo_Pop32();
-    dest[1] = gp::Fifo_Pop32();
-    dest[2] = gp::Fifo_Pop32();
-}
-
-/// Direct vertex component 9 floats
-static void __direct_float_9(u32 addr, u32* dest) {
-    dest[0] = gp::Fifo_Pop32();
-    dest[1] = gp::Fifo_Pop32();
-    dest[2] = gp::Fifo_Pop32();
-    dest[3] = gp::Fifo_Pop32();
-    dest[4] = gp::Fifo_Pop32();
-    dest[5] = gp::Fifo_Pop32();
-    dest[6] = gp::Fifo_Pop32();
-    dest[7] = gp::Fifo_Pop32();
-    dest[8] = gp::Fifo_Pop32();
-    _ASSERT_MSG(TGP, 0, "Unimplemented method %s (%s line %s)", __FUNCTION__, __FILE__, __LINE__);
-}
-
-/// Indexed vertex component 1 byte
-static void __indexed_byte_1(u32 addr, u32* dest) {
-    u8* v = (u8*)dest;
-    v[0] = Mem_RAM[addr & RAM_MASK];
-}
-
-/// Indexed vertex component 2 bytes
-static void __indexed_byte_2(u32 addr, u32* dest) {
-    u8* v = (u8*)dest;
-    u16 temp = _indexed_read_16(addr);
-    v[0] = (u8)((temp >> 8) & 0xFF);
-    v[1] = (u8)(temp & 0xFF);
-}
-
-/// Indexed vertex component 3 bytes
-static void __indexed_byte_3(u32 addr, u32* dest) {
-    u8* v = (u8*)dest;
-    u32 temp = _indexed_read_32(addr);
-    v[0] = (u8)((temp >> 24) & 0xFF);
-    v[1] = (u8)((temp >> 16) & 0xFF);
-    v[2] = (u8)((temp >> 8) & 0xFF);
-}
-
-/// Indexed vertex component 9 bytes
-static void __indexed_byte_9(u32 addr, u32* dest) {
-    // Unimplemented
-    _ASSERT_MSG(TGP, 0, "Unimplemented method %s (%s line %s)", __FUNCTION__, __FILE__, __LINE__);
+/// Rounds a component size up to 4 bytes
+static inline u16 _align_4(int size) {
+    return (u16)((size + 3) & ~3);
 }
 
-/// Indexed vertex component 1 short
-static void __indexed_short_1(u32 addr, u32* dest) {
-    u16* v = (u16*)dest;
-    v[0] = _indexed_read_16(addr);
-}
-
-/// Indexed vertex component 2 shorts
-static void __indexed_short_2(u32 addr, u32* dest) {
-    u16* v = (u16*)dest;
-    u32 temp = _indexed_read_32(addr);
-    v[0] = (temp >> 16);
-    v[1] = (temp & 0xFFFF);
-}
-
-/// Indexed vertex component 3 shorts
-static void __indexed_short_3(u32 addr, u32* dest) {
-    u16* v = (u16*)dest;
-    u32 temp = _indexed_read_32(addr);
-    v[0] = (temp >> 16);
-    v[1] = (temp & 0xFFFF);
-    v[2] = _indexed_read_16(addr + 4);
-}
-
-/// Indexed vertex component 9 shorts
-static void __indexed_short_9(u32 addr, u32* dest) {
-    u16* v = (u16*)dest;
-    v[0] = _indexed_read_16(addr);
-    v[1] = _indexed_read_16(addr + 2);
-    v[2] = _indexed_read_16(addr + 4);
-    v[3] = _indexed_read_16(addr + 6);
-    v[4] = _indexed_read_16(addr + 8);
-    v[5] = _indexed_read_16(addr + 10);
-    v[6] = _indexed_read_16(addr + 12);
-    v[7] = _indexed_read_16(addr + 14);
-    v[8] = _indexed_read_16(addr + 16);
-    _ASSERT_MSG(TGP, 0, "Unimplemented method %s (%s line %s)", __FUNCTION__, __FILE__, __LINE__);
+/// Size of the position of a decoded vertex
+static inline u16 _position_size(const VertexState& state) {
+    return _align_4(3 * kComponentElementSize[state.pos.comp_type]);
 }
 
-/// Indexed vertex component 1 float
-static void __indexed_float_1(u32 addr, u32* dest) {
-    dest[0] = _indexed_read_32(addr);
+/// Size of the normal(s) of a decoded vertex
+static inline u16 _normal_size(const VertexState& state) {
+    return _align_4((state.nrm.comp_count ? 9 : 4) * kComponentElementSize[state.nrm.comp_type]);
 }
 
-/// Indexed vertex component 2 floats
-static void __indexed_float_2(u32 addr, u32* dest) {
-    dest[0] = _indexed_read_32(addr);
-    dest[1] = _indexed_read_32(addr + 4);
+/// Size of a texture coordinate of a decoded vertex
+static inline u16 _texcoord_size(const VertexState& state, int i) {
+    return _align_4(2 * kComponentElementSize[state.tex[i].comp_type]);
 }
 
-/// Indexed vertex component 3 floats
-static void __indexed_float_3(u32 addr, u32* dest) {
-    dest[0] = _indexed_read_32(addr);
-    dest[1] = _indexed_read_32(addr + 4);
-    dest[2] = _indexed_read_32(addr + 8);
-}
-
-/// Indexed vertex component 9 floats
-static void __indexed_float_9(u32 addr, u32* dest) {
-    dest[0] = _indexed_read_32(addr);
-    dest[1] = _indexed_read_32(addr + 4);
-    dest[2] = _indexed_read_32(addr + 8);
-    dest[3] = _indexed_read_32(addr + 12);
-    dest[4] = _indexed_read_32(addr + 16);
-    dest[5] = _indexed_read_32(addr + 20);
-    dest[6] = _indexed_read_32(addr + 24);
-    dest[7] = _indexed_read_32(addr + 28);
-    dest[8] = _indexed_read_32(addr + 32);
-    _ASSERT_MSG(TGP, 0, "Unimplemented method %s (%s line %s)", __FUNCTION__, __FILE__, __LINE__);
+/**
+ * Gets the layout of decoded vertices with a vertex state
+ * @param vertex_state Vertex state
+ * @param layout Receives the layout
+ */
+void VertexLoader_GetLayout(const VertexState& vertex_state, VertexLayout* layout) {
+    u16 offset = 0;
+
+    layout->matrix_indices = offset;
+    offset += kMatrixIndicesSize;
+    layout->position = offset;
+    offset += _position_size(vertex_state);
+
+    // Missing colors are decoded as white, so colors are always there
+    for (int i = 0; i < kGCMaxVertexColors; i++) {
+        layout->color[i] = offset;
+        offset += sizeof(u32);
+    }
+    layout->normal = kNoVertexComponent;
+    if (vertex_state.nrm.attr_type != GX_NONE) {
+        layout->normal = offset;
+        offset += _normal_size(vertex_state);
+    }
+    for (int i = 0; i < kGCMaxActiveTextures; i++) {
+        layout->texcoords[i] = kNoVertexComponent;
+        if (vertex_state.tex[i].attr_type != GX_NONE) {
+            layout->texcoords[i] = offset;
+            offset += _texcoord_size(vertex_state, i);
+        }
+    }
+    layout->stride = offset;
 }
 
-////////////////////////////////////////////////////////////////////////////////////////////////////
-// Lookup tables for decoding vertex components
+/**
+ * Expands a decoded vertex to a full GXVertex, components it doesn't have are zeroed
+ * @param vertex_state Vertex state the vertex was decoded with
+ * @param layout Layout of the vertex state
+ * @param data Decoded vertex
+ * @param vertex Receives the expanded vertex
+ */
+void VertexLoader_UnpackVertex(const VertexState& vertex_state, const VertexLayout& layout, 
+    const u8* data, GXVertex* vertex) {
+    memset(vertex, 0, sizeof(GXVertex));
+
+    vertex->pm_idx = data[layout.matrix_indices];
+    memcpy(vertex->tm_idx, data + layout.matrix_indices + 4, sizeof(vertex->tm_idx));
+    memcpy(vertex->position, data + layout.position, _position_size(vertex_state));
+    for (int i = 0; i < kGCMaxVertexColors; i++) {
+        memcpy(&vertex->color[i], data + layout.color[i], sizeof(u32));
+    }
+    if (layout.normal != kNoVertexComponent) {
+        memcpy(vertex->normal, data + layout.normal, _normal_size(vertex_state));
+    }
+    for (int i = 0; i < kGCMaxActiveTextures; i++) {
+        if (layout.texcoords[i] != kNoVertexComponent) {
+            memcpy(&vertex->texcoords[i * 2], data + layout.texcoords[i], 
+                _texcoord_size(vertex_state, i));
+        }
+    }
+}
 
-// Position decoding
-// -----------------
+/// A compiled vertex loader
+struct VertexLoader {
+    VertexLoaderKey     key;            ///< VCD/VAT state this loader was compiled for
+    common::Hash64      hash;           ///< Hash of the key
+    VertexState         state;          ///< Vertex state passed to the renderer
+    VertexLayout        layout;         ///< Layout of the decoded vertices
+    int                 vertex_size;    ///< Size of a vertex in the command stream, in bytes
+    bool                reuse;          ///< Look up vertices for reuse before decoding them
+    int                 num_steps;      ///< Number of decoding steps per vertex
+    VertexLoaderStep    steps[kMaxVertexLoaderSteps];
 
-VertexLoaderTable LookupPositionDirect[0x10] = {
-    __direct_byte_2,    __direct_byte_2,    __direct_short_2,   __direct_short_2,
-    __direct_float_2,   __pos_unknown,      __pos_unknown,      __pos_unknown,     
-    __direct_byte_3,    __direct_byte_3,    __direct_short_3,   __direct_short_3, 
-    __direct_float_3,   __pos_unknown,      __pos_unknown,      __pos_unknown
-};
-VertexLoaderTable LookupPositionIndexed[0x10] = {
-    __indexed_byte_2,   __indexed_byte_2,   __indexed_short_2,  __indexed_short_2,
-    __indexed_float_2,  __pos_unknown,      __pos_unknown,      __pos_unknown,     
-    __indexed_byte_3,   __indexed_byte_3,   __indexed_short_3,  __indexed_short_3, 
-    __indexed_float_3,  __pos_unknown,      __pos_unknown,      __pos_unknown
+    VertexProgram<FifoSource>           fifo_program;   ///< Routines reading from the FIFO
+    VertexProgram<DisplayListSource>    dl_program;     ///< Routines reading from display lists
 };
 
-// Color decoding
-// --------------
+typedef HashContainer_STLMap<common::Hash64, VertexLoader> VertexLoaderCache;
 
-VertexLoaderTable LookupColorDirect[0x10] = {
-    __direct_short_1,   __direct_byte_3,    __direct_float_1,   __direct_short_1,
-    __direct_byte_3,    __direct_float_1,   __col_unknown,      __col_unknown,
-    __direct_short_1,   __direct_byte_3,    __direct_float_1,   __direct_short_1,
-    __direct_byte_3,    __direct_float_1,   __col_unknown,      __col_unknown,
-};
-VertexLoaderTable LookupColorIndexed[0x10] = {
-    __indexed_short_1,  __indexed_byte_3,   __indexed_float_1,  __indexed_short_1,
-    __indexed_byte_3,   __indexed_float_1,  __col_unknown,      __col_unknown,
-    __indexed_short_1,  __indexed_byte_3,   __indexed_float_1,  __indexed_short_1,
-    __indexed_byte_3,   __indexed_float_1,  __col_unknown,      __col_unknown
-};                                          
-
-// Normal decoding
-// ---------------
-
-VertexLoaderTable LookupNormalDirect[0x10] = {
-    __direct_byte_3,    __direct_byte_3,    __direct_short_3,   __direct_short_3,
-    __direct_float_3,   __normal_unknown,   __normal_unknown,   __normal_unknown,
-    __direct_byte_9,    __direct_byte_9,    __direct_short_9,   __direct_short_9,
-    __direct_float_9,   __normal_unknown,   __normal_unknown,   __normal_unknown
-};
-VertexLoaderTable LookupNormalIndexed[0x10] = {
-    __indexed_byte_3,   __indexed_byte_3,   __indexed_short_3,  __indexed_short_3,
-    __indexed_float_3,  __normal_unknown,   __normal_unknown,   __normal_unknown,
-    __indexed_byte_9,   __indexed_byte_9,   __indexed_short_9,  __indexed_short_9,
-    __indexed_float_9,  __normal_unknown,   __normal_unknown,   __normal_unknown
-};
+VertexLoaderCache*  g_loader_cache = NULL;  ///< Compiled vertex loaders, by VCD/VAT hash
+VertexLoader*       g_vat_loaders[8];       ///< Loader of each VAT for the current VCD, or NULL
+VertexDecodePool*   g_decode_pool = NULL;   ///< Decodes large primitives on several threads
+u8*                 g_new_vertex_data = NULL; ///< Data of the vertices a primitive didn't reuse
 
-// Texture coordinate decoding
-// ---------------------------
+/**
+ * Adds a step to a vertex loader
+ * @param loader Vertex loader to add the step to
+ * @param offset Byte offset of the destination in the decoded vertex
+ * @param array CP vertex array read by indexed components, kNoArray otherwise
+ * @param format Component format, (count << 3) | type
+ * @return Step index
+ */
+static int VertexLoader_AddStep(VertexLoader* loader, size_t offset, u8 array, u32 format) {
+    int n = loader->num_steps++;
+    loader->steps[n].offset = (u16)offset;
+    loader->steps[n].array  = array;
+    loader->steps[n].format = (u8)format;
+    loader->steps[n].base   = 0;
+    loader->steps[n].stride = 0;
+    return n;
+}
 
-VertexLoaderTable LookupTexCoordDirect[0x10] = {
-    __direct_byte_1,    __direct_byte_1,    __direct_short_1,   __direct_short_1,
-    __direct_float_1,   __texcoord_unknown, __texcoord_unknown, __texcoord_unknown,   
-    __direct_byte_2,    __direct_byte_2,    __direct_short_2,   __direct_short_2,
-    __direct_float_2,   __texcoord_unknown, __texcoord_unknown, __texcoord_unknown
-};
-VertexLoaderTable LookupTexCoordIndexed[0x10] = {
-    __indexed_byte_1,   __indexed_byte_1,   __indexed_short_1,  __indexed_short_1, 
-    __indexed_float_1,  __texcoord_unknown, __texcoord_unknown, __texcoord_unknown, 
-    __indexed_byte_2,   __indexed_byte_2,   __indexed_short_2,  __indexed_short_2, 
-    __indexed_float_2,  __texcoord_unknown, __texcoord_unknown, __texcoord_unknown
-};
+/**
+ * Adds a matrix index step to a vertex loader
+ * @param loader Vertex loader to add the step to
+ * @param offset Byte offset of the matrix index in the decoded vertex
+ */
+static void VertexLoader_AddMatrixIndex(VertexLoader* loader, size_t offset) {
+    int n = VertexLoader_AddStep(loader, offset, kNoArray, 0);
+    loader->fifo_program.funcs[n] = DecodeMatrixIndex<FifoSource>;
+    loader->dl_program.funcs[n] = DecodeMatrixIndex<DisplayListSource>;
+    loader->vertex_size += 1;
+}
 
-////////////////////////////////////////////////////////////////////////////////////////////////////
-// Primitive decoding
+/**
+ * Adds a vertex component step to a vertex loader
+ * @param loader Vertex loader to add the step to
+ * @param kind Vertex component kind
+ * @param component Vertex component description
+ * @param offset Byte offset of the component in the decoded vertex
+ * @param array CP vertex array read by the component when indexed
+ */
+static void VertexLoader_AddComponent(VertexLoader* loader, VertexComponentKind kind,
+    const VertexComponent& component, size_t offset, u8 array) {
 
-/// Gets the size of the next vertex to be decoded
-int VertexLoader_GetVertexSize() {
-    u16 size = 0;
-
-    if (gp::g_cp_regs.vcd_lo[0].pos_midx_enable) size += 1;
-    if (gp::g_cp_regs.vcd_lo[0].tex0_midx_enable) size += 1;
-    if (gp::g_cp_regs.vcd_lo[0].tex1_midx_enable) size += 1;
-    if (gp::g_cp_regs.vcd_lo[0].tex2_midx_enable) size += 1;
-    if (gp::g_cp_regs.vcd_lo[0].tex3_midx_enable) size += 1;
-    if (gp::g_cp_regs.vcd_lo[0].tex4_midx_enable) size += 1;
-    if (gp::g_cp_regs.vcd_lo[0].tex5_midx_enable) size += 1;
-    if (gp::g_cp_regs.vcd_lo[0].tex6_midx_enable) size += 1;
-    if (gp::g_cp_regs.vcd_lo[0].tex7_midx_enable) size += 1;
-
-    // Vertex position size
-    switch(gp::g_cp_regs.vcd_lo[0].position) {	
-    case GX_DIRECT:
-        size+=gp::kVertexPositionSize[gp::g_cp_regs.vat_reg_a[gp::g_cur_vat].get_pos()];
-        break;
-    case GX_INDEX8: 
-        size+=1; 
-        break;
-    case GX_INDEX16: 
-        size+=2; 
-        break;
-    }
-    // Vertex normal size
-    switch(gp::g_cp_regs.vcd_lo[0].normal) {	
-    case GX_DIRECT:
-        size+=gp::kVertexNormalSize[gp::g_cp_regs.vat_reg_a[gp::g_cur_vat].get_normal()];
-        break;
-    case GX_INDEX8:
-        size+=1; 
-        break;
-    case GX_INDEX16:
-        size+=2; 
+    int size = 0, count = 0;
+    u32 format = (component.comp_count << 3) | component.comp_type;
+
+    switch (kind) {
+    case kComponent_Position:
+        size = kComponentElementSize[component.comp_type];
+        count = component.comp_count ? 3 : 2;
         break;
-    }
-    // Vertex color 0 size
-    switch(gp::g_cp_regs.vcd_lo[0].color0) {	
-    case GX_DIRECT:
-        size+=gp::kVertexColorSize[gp::g_cp_regs.vat_reg_a[gp::g_cur_vat].get_col0()];
+    case kComponent_Normal:
+        size = kComponentElementSize[component.comp_type];
+        count = component.comp_count ? 9 : 3;
         break;
-    case GX_INDEX8:
-        size+=1;
+    case kComponent_Color:
+        size = kColorElementSize[component.comp_type];
+        count = kColorElementCount[component.comp_type];
         break;
-    case GX_INDEX16:
-        size+=2;
+    case kComponent_TexCoord:
+        size = kComponentElementSize[component.comp_type];
+        count = component.comp_count ? 2 : 1;
         break;
     }
-    // Vertex color 1 size
-    switch(gp::g_cp_regs.vcd_lo[0].color1) {	
-    case GX_DIRECT:
-        size+=gp::kVertexColorSize[gp::g_cp_regs.vat_reg_a[gp::g_cur_vat].get_col1()];
-        break;
-    case GX_INDEX8:
-        size+=1;
-        break;
-    case GX_INDEX16:
-        size+=2;
-        break;
+
+    if (component.attr_type == GX_NONE) {
+        if (kind == kComponent_Color) {
+            int n = VertexLoader_AddStep(loader, offset, kNoArray, format);
+            loader->fifo_program.funcs[n] = DecodeColorNone<FifoSource>;
+            loader->dl_program.funcs[n] = DecodeColorNone<DisplayListSource>;
+        }
+        return;
     }
-    // Texture coordinate 0 size
-    switch(gp::g_cp_regs.vcd_hi[0].tex0_coord) {
+    _ASSERT_MSG(TGP, kind != kComponent_Normal || count != 9, 
+        "Unimplemented vertex normal format (NBT)");
+
+    int n = VertexLoader_AddStep(loader, offset, 
+        (component.attr_type == GX_DIRECT) ? kNoArray : array, format);
+    loader->fifo_program.funcs[n] = GetDecodeFunc<FifoSource>(component.attr_type, size, count);
+    loader->dl_program.funcs[n] = GetDecodeFunc<DisplayListSource>(component.attr_type, size, 
+        count);
+
+    switch (component.attr_type) {
     case GX_DIRECT:
-        size+=gp::kVertexTextureSize[gp::g_cp_regs.vat_reg_a[gp::g_cur_vat].get_tex0()];
+        loader->vertex_size += size * count;
         break;
     case GX_INDEX8:
-        size+=1;
+        loader->vertex_size += 1;
         break;
     case GX_INDEX16:
-        size+=2;
-        break;
-    }
-    // Texture coordinate 1 size
-    switch(gp::g_cp_regs.vcd_hi[0].tex1_coord) {
-    case GX_DIRECT:
-        size+=gp::kVertexTextureSize[gp::g_cp_regs.vat_reg_b[gp::g_cur_vat].get_tex1()];
-        break;
-    case GX_INDEX8:
-        size+=1;
+        loader->vertex_size += 2;
         break;
-    case GX_INDEX16:
-        size+=2;
+    default:
         break;
     }
-    // Texture coordinate 2 size
-    switch(gp::g_cp_regs.vcd_hi[0].tex2_coord) {
-    case GX_DIRECT:
-        size+=gp::kVertexTextureSize[gp::g_cp_regs.vat_reg_b[gp::g_cur_vat].get_tex2()];
-        break;
-    case GX_INDEX8:
-        size+=1;
-        break;
-    case GX_INDEX16:
-        size+=2;
-        break;
+}
+
+/**
+ * Compiles a vertex loader for a VCD/VAT state
+ * @param loader Vertex loader to compile
+ * @param key VCD/VAT state to compile the loader for
+ */
+static void VertexLoader_Compile(VertexLoader* loader, const VertexLoaderKey& key) {
+    CPVertDescLo vcd_lo;
+    CPVertDescHi vcd_hi;
+    CPVatRegA vat_a;
+    CPVatRegB vat_b;
+    CPVatRegC vat_c;
+    VertexState& state = loader->state;
+
+    vcd_lo._u32 = key.vcd_lo;
+    vcd_hi._u32 = key.vcd_hi;
+    vat_a._u32 = key.vat_a;
+    vat_b._u32 = key.vat_b;
+    vat_c._u32 = key.vat_c;
+
+    loader->key = key;
+    loader->vertex_size = 0;
+    loader->num_steps = 0;
+
+    // Set renderer types
+    state.pos.attr_type     = (GXAttrType)vcd_lo.position;
+    state.pos.comp_count    = (GXCompCnt)vat_a.pos_count;
+    state.pos.comp_type     = (GXCompType)vat_a.pos_type;
+    state.nrm.attr_type     = (GXAttrType)vcd_lo.normal;
+    state.nrm.comp_count    = (GXCompCnt)vat_a.normal_count;
+    state.nrm.comp_type     = (GXCompType)vat_a.normal_type;
+    state.col[0].attr_type  = (GXAttrType)vcd_lo.color0;
+    state.col[0].comp_count = (GXCompCnt)vat_a.col0_count;
+    state.col[0].comp_type  = (GXCompType)vat_a.col0_type;
+    state.col[1].attr_type  = (GXAttrType)vcd_lo.color1;
+    state.col[1].comp_count = (GXCompCnt)vat_a.col1_count;
+    state.col[1].comp_type  = (GXCompType)vat_a.col1_type;
+    state.tex[0].attr_type  = (GXAttrType)vcd_hi.tex0_coord;
+    state.tex[0].comp_count = (GXCompCnt)vat_a.tex0_count;
+    state.tex[0].comp_type  = (GXCompType)vat_a.tex0_type;
+    state.tex[1].attr_type  = (GXAttrType)vcd_hi.tex1_coord;
+    state.tex[1].comp_count = (GXCompCnt)vat_b.tex1_count;
+    state.tex[1].comp_type  = (GXCompType)vat_b.tex1_type;
+    state.tex[2].attr_type  = (GXAttrType)vcd_hi.tex2_coord;
+    state.tex[2].comp_count = (GXCompCnt)vat_b.tex2_count;
+    state.tex[2].comp_type  = (GXCompType)vat_b.tex2_type;
+    state.tex[3].attr_type  = (GXAttrType)vcd_hi.tex3_coord;
+    state.tex[3].comp_count = (GXCompCnt)vat_b.tex3_count;
+    state.tex[3].comp_type  = (GXCompType)vat_b.tex3_type;
+    state.tex[4].attr_type  = (GXAttrType)vcd_hi.tex4_coord;
+    state.tex[4].comp_count = (GXCompCnt)vat_b.tex4_count;
+    state.tex[4].comp_type  = (GXCompType)vat_b.tex4_type;
+    state.tex[5].attr_type  = (GXAttrType)vcd_hi.tex5_coord;
+    state.tex[5].comp_count = (GXCompCnt)vat_c.tex5_count;
+    state.tex[5].comp_type  = (GXCompType)vat_c.tex5_type;
+    state.tex[6].attr_type  = (GXAttrType)vcd_hi.tex6_coord;
+    state.tex[6].comp_count = (GXCompCnt)vat_c.tex6_count;
+    state.tex[6].comp_type  = (GXCompType)vat_c.tex6_type;
+    state.tex[7].attr_type  = (GXAttrType)vcd_hi.tex7_coord;
+    state.tex[7].comp_count = (GXCompCnt)vat_c.tex7_count;
+    state.tex[7].comp_type  = (GXCompType)vat_c.tex7_type;
+
+    const VertexLayout& layout = loader->layout;
+    VertexLoader_GetLayout(state, &loader->layout);
+
+    // Matrix indices (VCD bits 0-8)
+    if (vcd_lo.pos_midx_enable) {
+        VertexLoader_AddMatrixIndex(loader, layout.matrix_indices);
     }
-    // Texture coordinate 3 size
-    switch(gp::g_cp_regs.vcd_hi[0].tex3_coord) {
-    case GX_DIRECT:
-        size+=gp::kVertexTextureSize[gp::g_cp_regs.vat_reg_b[gp::g_cur_vat].get_tex3()];
-        break;
-    case GX_INDEX8:
-        size+=1;
-        break;
-    case GX_INDEX16:
-        size+=2;
-        break;
+    for (int i = 0; i < kGCMaxActiveTextures; i++) {
+        if (vcd_lo._u32 & (2 << i)) {
+            VertexLoader_AddMatrixIndex(loader, layout.matrix_indices + 4 + i);
+        }
     }
-    // Texture coordinate 4 size
-    switch(gp::g_cp_regs.vcd_hi[0].tex4_coord) {
-    case GX_DIRECT:
-        size+=gp::kVertexTextureSize[gp::g_cp_regs.vat_reg_b[gp::g_cur_vat].get_tex4()];
-        break;
-    case GX_INDEX8:
-        size+=1;
-        break;
-    case GX_INDEX16:
-        size+=2;
-        break;
+
+    // Vertex components, in command stream order
+    VertexLoader_AddComponent(loader, kComponent_Position, state.pos, layout.position, 0);
+    VertexLoader_AddComponent(loader, kComponent_Normal, state.nrm, layout.normal, 1);
+    VertexLoader_AddComponent(loader, kComponent_Color, state.col[0], layout.color[0], 2);
+    VertexLoader_AddComponent(loader, kComponent_Color, state.col[1], layout.color[1], 3);
+    for (int i = 0; i < kGCMaxActiveTextures; i++) {
+        VertexLoader_AddComponent(loader, kComponent_TexCoord, state.tex[i], 
+            layout.texcoords[i], 4 + i);
     }
-    // Texture coordinate 5 size
-    switch(gp::g_cp_regs.vcd_hi[0].tex5_coord) {
-    case GX_DIRECT:
-        size+=gp::kVertexTextureSize[gp::g_cp_regs.vat_reg_c[gp::g_cur_vat].get_tex5()];
-        break;
-    case GX_INDEX8:
-        size+=1;
-        break;
-    case GX_INDEX16:
-        size+=2;
-        break;
+
+    // Vertices with indexed components are looked up by their data, which is mostly indices then
+    loader->reuse = false;
+    for (int n = 0; n < loader->num_steps; n++) {
+        if (loader->steps[n].array != kNoArray) {
+            loader->reuse = (loader->vertex_size <= VBO_MAX_REUSED_VERTEX_SIZE);
+        }
     }
-    // Texture coordinate 6 size
-    switch(gp::g_cp_regs.vcd_hi[0].tex6_coord) {
-    case GX_DIRECT:
-        size+=gp::kVertexTextureSize[gp::g_cp_regs.vat_reg_c[gp::g_cur_vat].get_tex6()];
-        break;
-    case GX_INDEX8:
-        size+=1;
-        break;
-    case GX_INDEX16:
-        size+=2;
-        break;
+}
+
+/**
+ * Fetches the vertex loader for the VCD and a VAT, compiling it if it isn't cached yet
+ * @param vat Vertex attribute table
+ * @return Vertex loader for the current state of the VAT
+ */
+static VertexLoader* VertexLoader_Fetch(int vat) {
+    // The loader of each VAT is kept until CP register writes change its format
+    if (g_vat_loaders[vat] != NULL) {
+        return g_vat_loaders[vat];
     }
-    // Texture coordinate 7 size
-    switch(gp::g_cp_regs.vcd_hi[0].tex7_coord) {
-    case GX_DIRECT:
-        size+=gp::kVertexTextureSize[gp::g_cp_regs.vat_reg_c[gp::g_cur_vat].get_tex7()];
-        break;
-    case GX_INDEX8:
-        size+=1;
-        break;
-    case GX_INDEX16:
-        size+=2;
-        break;
+    VertexLoaderKey key;
+    key.vcd_lo = gp::g_cp_regs.vcd_lo[0]._u32;
+    key.vcd_hi = gp::g_cp_regs.vcd_hi[0]._u32;
+    key.vat_a = gp::g_cp_regs.vat_reg_a[vat]._u32;
+    key.vat_b = gp::g_cp_regs.vat_reg_b[vat]._u32;
+    key.vat_c = gp::g_cp_regs.vat_reg_c[vat]._u32;
+
+    common::Hash64 hash = common::GetHash64((const u8*)&key, sizeof(key), 0);
+    VertexLoader* loader = g_loader_cache->FetchFromHash(hash);
+
+    if (loader == NULL || memcmp(&key, &loader->key, sizeof(key)) != 0) {
+        VertexLoader new_loader;
+        VertexLoader_Compile(&new_loader, key);
+        new_loader.hash = hash;
+        loader = g_loader_cache->Update(hash, new_loader);
+
+        LOG_DEBUG(TGP, "Compiled vertex loader %d: vcd=%08x:%08x vat=%08x:%08x:%08x size=%d",
+            g_loader_cache->Size(), key.vcd_lo, key.vcd_hi, key.vat_a, key.vat_b, key.vat_c,
+            loader->vertex_size);
     }
-    return size;
+    g_vat_loaders[vat] = loader;
+    return loader;
 }
 
-void SetVertexState() {
+/**
+ * Forgets the vertex formats of VATs, must be called whenever the VCD or VAT registers change
+ * @param vat_mask Bit mask of the VATs whose format has changed
+ */
+void VertexLoader_InvalidateFormats(u32 vat_mask) {
+    for (int vat = 0; vat < 8; vat++) {
+        if (vat_mask & (1 << vat)) {
+            g_vat_loaders[vat] = NULL;
+        }
+    }
 }
 
+/// Vertices to decode with a vertex loader, possibly on several threads
+template <typename Source>
+struct VertexDecodeJob {
+    const VertexLoader*             loader;
+    const VertexProgram<Source>*    program;    ///< Step routines for the data source
+    Source                          src;        ///< Data source at the first vertex
+    u8*                             vertices;   ///< Destination of the first vertex
+};
 
 /**
- * @brief Decode a primitive type
- * @param type Type of primitive (e.g. points, lines, triangles, etc.)
+ * Decodes a batch of the vertices of a job
+ * @param data VertexDecodeJob of the vertices
+ * @param first Index of the first vertex of the batch
+ * @param count Number of vertices in the batch
+ */
+template <typename Source>
+static void VertexLoader_DecodeBatch(const void* data, int first, int count) {
+    const VertexDecodeJob<Source>* job = static_cast<const VertexDecodeJob<Source>*>(data);
+    const VertexLoaderStep* steps = job->loader->steps;
+    const int num_steps = job->loader->num_steps;
+    const int stride = job->loader->layout.stride;
+    const VertexProgram<Source>& program = *job->program;
+
+    Source src = job->src;
+    src.Skip(first * job->loader->vertex_size);
+    u8* vertex = job->vertices + first * stride;
+
+    for (int i = 0; i < count; i++, vertex += stride) {
+        for (int n = 0; n < num_steps; n++) {
+            program.funcs[n](steps[n], src, vertex);
+        }
+    }
+}
+
+/**
+ * Decodes consecutive vertices with a vertex loader, on several threads if there are enough
+ * @param loader Vertex loader to run
+ * @param program Step routines for the data source
+ * @param src Vertex data source, left as is
  * @param count Number of vertices
+ * @param vertices Receives the decoded vertices, laid out by the loader
  */
-void VertexLoader_DecodePrimitive(GXPrimitive type, int count) {
-    static VertexState state;
-    CPVatRegA* vat_a = &gp::g_cp_regs.vat_reg_a[gp::g_cur_vat];
-    CPVatRegB* vat_b = &gp::g_cp_regs.vat_reg_b[gp::g_cur_vat];
-    CPVatRegC* vat_c = &gp::g_cp_regs.vat_reg_c[gp::g_cur_vat];
-
-    u32 pos_base        = gp::g_cp_regs.array_base[0].addr_base;
-    u8  pos_stride      = gp::g_cp_regs.array_stride[0].addr_stride;
-    u32 normal_base     = gp::g_cp_regs.array_base[1].addr_base;
-    u8  normal_stride   = gp::g_cp_regs.array_stride[1].addr_stride;
-    u32 col0_base       = gp::g_cp_regs.array_base[2].addr_base;
-    u8  col0_stride     = gp::g_cp_regs.array_stride[2].addr_stride;
-    u32 col1_base       = gp::g_cp_regs.array_base[3].addr_base;
-    u8  col1_stride     = gp::g_cp_regs.array_stride[3].addr_stride;
-    u32 tex0_base       = gp::g_cp_regs.array_base[4].addr_base;
-    u8  tex0_stride     = gp::g_cp_regs.array_stride[4].addr_stride;
-    u32 tex1_base       = gp::g_cp_regs.array_base[5].addr_base;
-    u8  tex1_stride     = gp::g_cp_regs.array_stride[5].addr_stride;
-    u32 tex2_base       = gp::g_cp_regs.array_base[6].addr_base;
-    u8  tex2_stride     = gp::g_cp_regs.array_stride[6].addr_stride;
-    u32 tex3_base       = gp::g_cp_regs.array_base[7].addr_base;
-    u8  tex3_stride     = gp::g_cp_regs.array_stride[7].addr_stride;
-    u32 tex4_base       = gp::g_cp_regs.array_base[8].addr_base;
-    u8  tex4_stride     = gp::g_cp_regs.array_stride[8].addr_stride;
-    u32 tex5_base       = gp::g_cp_regs.array_base[9].addr_base;
-    u8  tex5_stride     = gp::g_cp_regs.array_stride[9].addr_stride;
-    u32 tex6_base       = gp::g_cp_regs.array_base[10].addr_base;
-    u8  tex6_stride     = gp::g_cp_regs.array_stride[10].addr_stride;
-    u32 tex7_base       = gp::g_cp_regs.array_base[11].addr_base;
-    u8  tex7_stride     = gp::g_cp_regs.array_stride[11].addr_stride;
+template <typename Source>
+static void VertexLoader_Decode(const VertexLoader* loader, const VertexProgram<Source>& program,
+    const Source& src, int count, u8* vertices) {
+    VertexDecodeJob<Source> job;
+    job.loader = loader;
+    job.program = &program;
+    job.src = src;
+    job.vertices = vertices;
+
+    if (g_decode_pool != NULL && count >= VertexDecodePool::kMinVertices) {
+        g_decode_pool->Decode(VertexLoader_DecodeBatch<Source>, &job, count);
+    } else {
+        VertexLoader_DecodeBatch<Source>(&job, 0, count);
+    }
+}
 
-    // Set renderer types
-    state.pos.attr_type     = (GXAttrType)gp::g_cp_regs.vcd_lo[0].position;
-    state.pos.comp_count    = (GXCompCnt)vat_a->pos_count;
-    state.pos.comp_type     = (GXCompType)vat_a->pos_type;
-    state.nrm.attr_type     = (GXAttrType)gp::g_cp_regs.vcd_lo[0].normal;
-    state.nrm.comp_count    = (GXCompCnt)vat_a->normal_count;
-    state.nrm.comp_type     = (GXCompType)vat_a->normal_type;
-    state.col[0].attr_type  = (GXAttrType)gp::g_cp_regs.vcd_lo[0].color0;
-    state.col[0].comp_count = (GXCompCnt)vat_a->col0_count;
-    state.col[0].comp_type  = (GXCompType)vat_a->col0_type;
-    state.col[1].attr_type  = (GXAttrType)gp::g_cp_regs.vcd_lo[0].color1;
-    state.col[1].comp_count = (GXCompCnt)vat_a->col1_count;
-    state.col[1].comp_type  = (GXCompType)vat_a->col1_type;
-    state.tex[0].attr_type  = (GXAttrType)gp::g_cp_regs.vcd_hi[0].tex0_coord;
-    state.tex[0].comp_count = (GXCompCnt)vat_a->tex0_count;
-    state.tex[0].comp_type  = (GXCompType)vat_a->tex0_type;
-    state.tex[1].attr_type  = (GXAttrType)gp::g_cp_regs.vcd_hi[0].tex1_coord;
-    state.tex[1].comp_count = (GXCompCnt)vat_b->tex1_count;
-    state.tex[1].comp_type  = (GXCompType)vat_b->tex1_type;
-    state.tex[2].attr_type  = (GXAttrType)gp::g_cp_regs.vcd_hi[0].tex2_coord;
-    state.tex[2].comp_count = (GXCompCnt)vat_b->tex2_count;
-    state.tex[2].comp_type  = (GXCompType)vat_b->tex2_type;
-    state.tex[3].attr_type  = (GXAttrType)gp::g_cp_regs.vcd_hi[0].tex3_coord;
-    state.tex[3].comp_count = (GXCompCnt)vat_b->tex3_count;
-    state.tex[3].comp_type  = (GXCompType)vat_b->tex3_type;
-    state.tex[4].attr_type  = (GXAttrType)gp::g_cp_regs.vcd_hi[0].tex4_coord;
-    state.tex[4].comp_count = (GXCompCnt)vat_b->tex4_count;
-    state.tex[4].comp_type  = (GXCompType)vat_b->tex4_type;
-    state.tex[5].attr_type  = (GXAttrType)gp::g_cp_regs.vcd_hi[0].tex5_coord;
-    state.tex[5].comp_count = (GXCompCnt)vat_c->tex5_count;
-    state.tex[5].comp_type  = (GXCompType)vat_c->tex5_type;
-    state.tex[6].attr_type  = (GXAttrType)gp::g_cp_regs.vcd_hi[0].tex6_coord;
-    state.tex[6].comp_count = (GXCompCnt)vat_c->tex6_count;
-    state.tex[6].comp_type  = (GXCompType)vat_c->tex6_type;
-    state.tex[7].attr_type  = (GXAttrType)gp::g_cp_regs.vcd_hi[0].tex7_coord;
-    state.tex[7].comp_count = (GXCompCnt)vat_c->tex7_count;
-    state.tex[7].comp_type  = (GXCompType)vat_c->tex7_type;
-
-    video_core::g_renderer->SetVertexState(state);
-    video_core::g_shader_manager->UpdateVertexState(state);
-    video_core::g_shader_manager->UpdateFlag(ShaderManager::kFlag_VertexPostition_DQF, 
-        vat_a->get_pos_dqf_enabled());
+/**
+ * Runs a vertex loader over a primitive, decoding straight into the VBO
+ * @param loader Vertex loader to run
+ * @param program Step routines for the data source
+ * @param src Vertex data source
+ * @param count Number of vertices
+ */
+template <typename Source>
+static void VertexLoader_Run(const VertexLoader* loader, const VertexProgram<Source>& program,
+    Source& src, int count) {
+    u8* vertices = g_vbo;
 
-    // Configure renderer to begin a new primitive
-    VertexManager_BeginPrimitive(type, count);
+    VertexLoader_Decode(loader, program, src, count, vertices);
+    src.Skip(count * loader->vertex_size);
 
     for (int i = 0; i < count; i++) {
+        VertexManager_NextVertex();
+    }
+    VertexManager_UseVertices(vertices, count);
+}
 
-        // Matrix indices
-        if (gp::g_cp_regs.vcd_lo[0].pos_midx_enable)
-            g_vbo->pm_idx = gp::Fifo_Pop8();
-        if (gp::g_cp_regs.vcd_lo[0].tex0_midx_enable)
-            g_vbo->tm_idx[0] = gp::Fifo_Pop8();
-        if (gp::g_cp_regs.vcd_lo[0].tex1_midx_enable)
-            g_vbo->tm_idx[1] = gp::Fifo_Pop8();
-        if (gp::g_cp_regs.vcd_lo[0].tex2_midx_enable)
-            g_vbo->tm_idx[2] = gp::Fifo_Pop8();
-        if (gp::g_cp_regs.vcd_lo[0].tex3_midx_enable)
-            g_vbo->tm_idx[3] = gp::Fifo_Pop8();
-        if (gp::g_cp_regs.vcd_lo[0].tex4_midx_enable) 
-            g_vbo->tm_idx[4] = gp::Fifo_Pop8();
-        if (gp::g_cp_regs.vcd_lo[0].tex5_midx_enable)
-            g_vbo->tm_idx[5] = gp::Fifo_Pop8();
-        if (gp::g_cp_regs.vcd_lo[0].tex6_midx_enable)
-            g_vbo->tm_idx[6] = gp::Fifo_Pop8();
-        if (gp::g_cp_regs.vcd_lo[0].tex7_midx_enable)
-            g_vbo->tm_idx[7] = gp::Fifo_Pop8();
-
-        // Decode position
-        switch (gp::g_cp_regs.vcd_lo[0].position) {
-        case GX_DIRECT:
-            LookupPositionDirect[vat_a->get_pos()](0, g_vbo->position);
-            break;
-        case GX_INDEX8:
-            LookupPositionIndexed[vat_a->get_pos()](pos_base + (gp::Fifo_Pop8() * pos_stride),
-                g_vbo->position);
-            break;
-        case GX_INDEX16:
-            LookupPositionIndexed[vat_a->get_pos()](pos_base + (gp::Fifo_Pop16() * pos_stride),
-                g_vbo->position);
-            break;
-        }
-        // Decode normal
-        switch (gp::g_cp_regs.vcd_lo[0].normal) {
-        case GX_DIRECT:
-            LookupNormalDirect[vat_a->get_normal()](0, g_vbo->normal);
-            break;
-        case GX_INDEX8:
-            LookupNormalIndexed[vat_a->get_normal()](normal_base + (gp::Fifo_Pop8() * normal_stride),
-                g_vbo->normal);
-            break;
-        case GX_INDEX16:
-            LookupNormalIndexed[vat_a->get_normal()](normal_base + (gp::Fifo_Pop16() * normal_stride),
-                g_vbo->normal);
-            break;
-        }
-        // Decode color 0
-        switch (gp::g_cp_regs.vcd_lo[0].color0) {
-        case GX_NONE:
-            g_vbo->color[0] = 0xffffffff;
-            break;
-        case GX_DIRECT:
-            LookupColorDirect[vat_a->get_col0()](0, &g_vbo->color[0]);
-            break;
-        case GX_INDEX8:
-            LookupColorIndexed[vat_a->get_col0()](col0_base + (gp::Fifo_Pop8() * col0_stride),
-                &g_vbo->color[0]);
-            break;
-        case GX_INDEX16:
-            LookupColorIndexed[vat_a->get_col0()](col0_base + (gp::Fifo_Pop16() * col0_stride),
-                &g_vbo->color[0]);
-            break;
-        }
-        // Decode color 1
-        switch (gp::g_cp_regs.vcd_lo[0].color1) {
-        case GX_NONE:
-            g_vbo->color[1] = 0xffffffff;
-            break;
-        case GX_DIRECT:
-            LookupColorDirect[vat_a->get_col1()](0, &g_vbo->color[1]);
-            break;
-        case GX_INDEX8:
-            LookupColorIndexed[vat_a->get_col1()](col1_base + (gp::Fifo_Pop8() * col1_stride),
-                &g_vbo->color[1]);
-            break;
-        case GX_INDEX16:
-            LookupColorIndexed[vat_a->get_col1()](col1_base + (gp::Fifo_Pop16() * col1_stride),
-                &g_vbo->color[1]);
-            break;
+/**
+ * Decodes the vertices of a primitive, decoding only the vertices that the vertex manager hasn't
+ * seen yet in the current batch
+ * @param loader Vertex loader
+ * @param src Vertex data source
+ * @param count Number of vertices
+ */
+template <typename Source>
+static void VertexLoader_RunReused(const VertexLoader* loader, Source& src, int count) {
+    const VertexLoaderStep* steps = loader->steps;
+    const int num_steps = loader->num_steps;
+    const int vertex_size = loader->vertex_size;
+    u8 data[VBO_MAX_REUSED_VERTEX_SIZE];
+
+    // Decoded vertices depend on the array bases and strides, too
+    u64 context = loader->hash;
+    for (int n = 0; n < num_steps; n++) {
+        if (steps[n].array != kNoArray) {
+            context = (context ^ steps[n].base) * 0x100000001B3ULL;
+            context = (context ^ steps[n].stride) * 0x100000001B3ULL;
         }
+    }
+    VertexManager_EnableReuse(context);
 
-        // Decode texcoord 0
-        if (gp::g_cp_regs.vcd_hi[0].tex0_coord) {
-            switch(gp::g_cp_regs.vcd_hi[0].tex0_coord) {
-            case GX_DIRECT:
-                LookupTexCoordDirect[vat_a->get_tex0()](0, &g_vbo->texcoords[0 << 1]);
-                break;
-            case GX_INDEX8:
-                LookupTexCoordIndexed[vat_a->get_tex0()](tex0_base + (gp::Fifo_Pop8() * tex0_stride), 
-                    &g_vbo->texcoords[0 << 1]);
-                break;
-            case GX_INDEX16:
-                LookupTexCoordIndexed[vat_a->get_tex0()](tex0_base + (gp::Fifo_Pop16() * tex0_stride),
-                    &g_vbo->texcoords[0 << 1]);
-                break;
-            }
-        }
-        // Decode texcoord 1
-        if (gp::g_cp_regs.vcd_hi[0].tex1_coord) {
-            switch(gp::g_cp_regs.vcd_hi[0].tex1_coord) {
-            case GX_DIRECT:
-                LookupTexCoordDirect[vat_b->get_tex1()](0, &g_vbo->texcoords[1 << 1]);
-                break;
-            case GX_INDEX8:
-                LookupTexCoordIndexed[vat_b->get_tex1()](tex1_base + (gp::Fifo_Pop8() * tex1_stride),
-                    &g_vbo->texcoords[1 << 1]);
-                break;
-            case GX_INDEX16:
-                LookupTexCoordIndexed[vat_b->get_tex1()](tex1_base + (gp::Fifo_Pop16() * tex1_stride),
-                    &g_vbo->texcoords[1 << 1]);
-                break;
-            }
-        }
-        // Decode texcoord 2
-        if (gp::g_cp_regs.vcd_hi[0].tex2_coord) {
-            switch(gp::g_cp_regs.vcd_hi[0].tex2_coord) {
-            case GX_DIRECT:
-                LookupTexCoordDirect[vat_b->get_tex2()](0, &g_vbo->texcoords[2 << 1]);
-                break;
-            case GX_INDEX8:
-                LookupTexCoordIndexed[vat_b->get_tex2()](tex2_base + (gp::Fifo_Pop8() * tex2_stride),
-                    &g_vbo->texcoords[2 << 1]);
-                break;
-            case GX_INDEX16:
-                LookupTexCoordIndexed[vat_b->get_tex2()](tex2_base + (gp::Fifo_Pop16() * tex2_stride),
-                    &g_vbo->texcoords[2 << 1]);
-                break;
-            }
+    // Look up all vertices first, the ones that weren't seen yet get consecutive VBO slots and
+    // are decoded together afterwards
+    u8* vertices = g_vbo;
+    int new_count = 0;
+    for (int i = 0; i < count; i++) {
+        src.Read(data, vertex_size);
+        if (VertexManager_ReuseVertex(data, vertex_size)) {
+            continue;
         }
-        // Decode texcoord 3
-        if (gp::g_cp_regs.vcd_hi[0].tex3_coord) {
-            switch(gp::g_cp_regs.vcd_hi[0].tex3_coord) {
-            case GX_DIRECT:
-                LookupTexCoordDirect[vat_b->get_tex3()](0, &g_vbo->texcoords[3 << 1]);
-                break;
-            case GX_INDEX8:
-                LookupTexCoordIndexed[vat_b->get_tex3()](tex3_base + (gp::Fifo_Pop8() * tex3_stride),
-                    &g_vbo->texcoords[3 << 1]);
-                break;
-            case GX_INDEX16:
-                LookupTexCoordIndexed[vat_b->get_tex3()](tex3_base + (gp::Fifo_Pop16() * tex3_stride),
-                    &g_vbo->texcoords[3 << 1]);
-                break;
-            }
+        memcpy(&g_new_vertex_data[new_count * vertex_size], data, vertex_size);
+        new_count++;
+        VertexManager_NextVertex();
+    }
+    FifoSource new_src;
+    new_src.ptr = g_new_vertex_data;
+    VertexLoader_Decode(loader, loader->fifo_program, new_src, new_count, vertices);
+    VertexManager_UseVertices(vertices, new_count);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Primitive decoding
+
+/**
+ * Gets the size of a vertex in the command stream
+ * @param vat Vertex attribute table the vertex is drawn with
+ * @return Size of the vertex with the current VCD and the VAT
+ */
+int VertexLoader_GetVertexSize(int vat) {
+    return VertexLoader_Fetch(vat)->vertex_size;
+}
+
+/// Gets the size of the next vertex to be decoded once it is decoded
+int VertexLoader_GetDecodedVertexSize() {
+    return VertexLoader_Fetch(gp::g_cur_vat)->layout.stride;
+}
+
+/**
+ * Sets up the vertex state of the current vertex format and begins a primitive with it
+ * @param type Type of primitive (e.g. points, lines, triangles, etc.)
+ * @param count Number of vertices
+ * @return Vertex loader of the current vertex format
+ */
+static VertexLoader* VertexLoader_BeginPrimitive(GXPrimitive type, int count) {
+    static gp::VertexState batch_state;
+    VertexLoader* loader = VertexLoader_Fetch(gp::g_cur_vat);
+
+    // Batched primitives are drawn with the vertex state of their loader
+    if (memcmp(&loader->state, &batch_state, sizeof(batch_state))) {
+        VertexManager_Flush();
+        batch_state = loader->state;
+    }
+
+    // Array bases/strides change far more often than the vertex format, so they are not part of
+    // the loader key and are picked up here instead
+    for (int n = 0; n < loader->num_steps; n++) {
+        VertexLoaderStep& step = loader->steps[n];
+        if (step.array != kNoArray) {
+            step.base = gp::g_cp_regs.array_base[step.array].addr_base;
+            step.stride = gp::g_cp_regs.array_stride[step.array].addr_stride;
         }
-        // Decode texcoord 4
-        if (gp::g_cp_regs.vcd_hi[0].tex4_coord) {
-            switch(gp::g_cp_regs.vcd_hi[0].tex4_coord) {
-            case GX_DIRECT:
-                LookupTexCoordDirect[vat_b->get_tex4()](0, &g_vbo->texcoords[4 << 1]);
-                break;
-            case GX_INDEX8:
-                LookupTexCoordIndexed[vat_b->get_tex4()](tex4_base + (gp::Fifo_Pop8() * tex4_stride),
-                    &g_vbo->texcoords[4 << 1]);
-                break;
-            case GX_INDEX16:
-                LookupTexCoordIndexed[vat_b->get_tex4()](tex4_base + (gp::Fifo_Pop16() * tex4_stride),
-                    &g_vbo->texcoords[4 << 1]);
-                break;
-            }
+    }
+
+    video_core::g_renderer->SetVertexState(loader->state);
+    video_core::g_shader_manager->UpdateVertexState(loader->state);
+    video_core::g_shader_manager->UpdateFlag(ShaderManager::kFlag_VertexPostition_DQF, 
+        gp::g_cp_regs.vat_reg_a[gp::g_cur_vat].get_pos_dqf_enabled());
+
+    // Configure renderer to begin a new primitive
+    VertexManager_BeginPrimitive(type, count, loader->layout.stride);
+    return loader;
+}
+
+/**
+ * @brief Decode a primitive type
+ * @param type Type of primitive (e.g. points, lines, triangles, etc.)
+ * @param count Number of vertices
+ */
+void VertexLoader_DecodePrimitive(GXPrimitive type, int count) {
+    VertexLoader* loader = VertexLoader_BeginPrimitive(type, count);
+
+    if (g_dl_active) {
+        DisplayListSource src;
+        if (loader->reuse) {
+            VertexLoader_RunReused(loader, src, count);
+        } else {
+            VertexLoader_Run(loader, loader->dl_program, src, count);
         }
-        // Decode texcoord 5
-        if (gp::g_cp_regs.vcd_hi[0].tex5_coord) {
-            switch(gp::g_cp_regs.vcd_hi[0].tex5_coord) {
-            case GX_DIRECT:
-                LookupTexCoordDirect[vat_c->get_tex5()](0, &g_vbo->texcoords[5 << 1]);
-                break;
-            case GX_INDEX8:
-                LookupTexCoordIndexed[vat_c->get_tex5()](tex5_base + (gp::Fifo_Pop8() * tex5_stride),
-                    &g_vbo->texcoords[5 << 1]);
-                break;
-            case GX_INDEX16:
-                LookupTexCoordIndexed[vat_c->get_tex5()](tex5_base + (gp::Fifo_Pop16() * tex5_stride),
-                    &g_vbo->texcoords[5 << 1]);
-                break;
-            }
+        src.Commit();
+    } else {
+        FifoSource src;
+        if (loader->reuse) {
+            VertexLoader_RunReused(loader, src, count);
+        } else {
+            VertexLoader_Run(loader, loader->fifo_program, src, count);
         }
-        // Decode texcoord 6
-        if (gp::g_cp_regs.vcd_hi[0].tex6_coord) {
-            switch(gp::g_cp_regs.vcd_hi[0].tex6_coord) {
-            case GX_DIRECT:
-                LookupTexCoordDirect[vat_c->get_tex6()](0, &g_vbo->texcoords[6 << 1]);
-                break;
-            case GX_INDEX8:
-                LookupTexCoordIndexed[vat_c->get_tex6()](tex6_base + (gp::Fifo_Pop8() * tex6_stride),
-                    &g_vbo->texcoords[6 << 1]);
-                break;
-            case GX_INDEX16:
-                LookupTexCoordIndexed[vat_c->get_tex6()](tex6_base + (gp::Fifo_Pop16() * tex6_stride),
-                    &g_vbo->texcoords[6 << 1]);
-                break;
-            }
+        src.Commit();
+    }
+    VertexManager_EndPrimitive();
+}
+
+/**
+ * Decodes the vertices of a primitive with the current vertex format into a buffer, for drawing
+ * them later on with VertexLoader_DrawVertices
+ * @param data Vertex data, as it appears in the command stream
+ * @param count Number of vertices
+ * @param vertices Receives the decoded vertices, VertexLoader_GetDecodedVertexSize bytes each
+ * @return True on success, false if the format has indexed components (those read CP vertex
+ * arrays, which may have changed by the time the vertices are drawn)
+ */
+bool VertexLoader_DecodeVertices(const u8* data, int count, u8* vertices) {
+    const VertexLoader* loader = VertexLoader_Fetch(gp::g_cur_vat);
+    const VertexLoaderStep* steps = loader->steps;
+    const int num_steps = loader->num_steps;
+
+    for (int n = 0; n < num_steps; n++) {
+        if (steps[n].array != kNoArray) {
+            return false;
         }
-        // Decode texcoord 7
-        if (gp::g_cp_regs.vcd_hi[0].tex7_coord) {
-            switch(gp::g_cp_regs.vcd_hi[0].tex7_coord) {
-            case GX_DIRECT:
-                LookupTexCoordDirect[vat_c->get_tex7()](0, &g_vbo->texcoords[7 << 1]);
-                break;
-            case GX_INDEX8:
-                LookupTexCoordIndexed[vat_c->get_tex7()](tex7_base + (gp::Fifo_Pop8() * tex7_stride),
-                    &g_vbo->texcoords[7 << 1]);
-                break;
-            case GX_INDEX16:
-                LookupTexCoordIndexed[vat_c->get_tex7()](tex7_base + (gp::Fifo_Pop16() * tex7_stride),
-                    &g_vbo->texcoords[7 << 1]);
-                break;
-            }
-        }   
+    }
+    memset(vertices, 0, count * loader->layout.stride);
+
+    FifoSource src;
+    src.ptr = const_cast<u8*>(data);
+    VertexLoader_Decode(loader, loader->fifo_program, src, count, vertices);
+    return true;
+}
+
+/**
+ * Draws a primitive from vertices decoded by VertexLoader_DecodeVertices, the current vertex
+ * format must be the one they were decoded with
+ * @param type Type of primitive (e.g. points, lines, triangles, etc.)
+ * @param count Number of vertices
+ * @param vertices Decoded vertices
+ */
+void VertexLoader_DrawVertices(GXPrimitive type, int count, const u8* vertices) {
+    const int stride = VertexLoader_BeginPrimitive(type, count)->layout.stride;
+    u8* vbo = g_vbo;
+
+    // A primitive's vertices are consecutive in the VBO
+    memcpy(vbo, vertices, count * stride);
+    for (int i = 0; i < count; i++) {
         VertexManager_NextVertex();
     }
+    VertexManager_UseVertices(vbo, count);
     VertexManager_EndPrimitive();
 }
 
@@ -834,10 +910,26 @@ void VertexLoader_DecodePrimitive(GXPrimitive type, int count) {
 
 /// Initialize the Vertex Loader
 void VertexLoader_Init() {
+    g_loader_cache = new VertexLoaderCache();
+    VertexLoader_InvalidateFormats(0xFF);
+
+    g_new_vertex_data = new u8[VBO_MAX_BATCH_VERTS * VBO_MAX_REUSED_VERTEX_SIZE];
+    int num_threads = VertexDecodePool::DefaultThreadCount();
+    if (num_threads > 0) {
+        g_decode_pool = new VertexDecodePool(num_threads);
+    }
 }
 
 /// Shutdown the Vertex Loader
 void VertexLoader_Shutdown() {
+    delete g_loader_cache;
+    g_loader_cache = NULL;
+    VertexLoader_InvalidateFormats(0xFF);
+
+    delete g_decode_pool;
+    g_decode_pool = NULL;
+    delete[] g_new_vertex_data;
+    g_new_vertex_data = NULL;
 }
 
 } // namespace
@@ -47,6 +47,39 @@ struct VertexState {
     VertexComponent tex[kGCMaxActiveTextures];
 };
 
+static const u16 kNoVertexComponent = 0xffff;   ///< Offset of components a vertex doesn't have
+
+/**
+ * Where the components of a decoded vertex are stored. Decoded vertices only hold the components
+ * of their vertex state, packed in GXVertex order, instead of a full GXVertex. Matrix indices come
+ * first (pm_idx, 3 bytes of padding, tm_idx), as their presence isn't part of the vertex state.
+ */
+struct VertexLayout {
+    u16 stride;                                 ///< Size of a decoded vertex in bytes
+    u16 matrix_indices;                         ///< Offset of the matrix indices (12 bytes)
+    u16 position;                               ///< Offset of the position (3 elements)
+    u16 color[kGCMaxVertexColors];              ///< Offset of the colors (4 bytes each)
+    u16 normal;                                 ///< Offset of the normal(s) (4 or 9 elements)
+    u16 texcoords[kGCMaxActiveTextures];        ///< Offset of the texture coordinates (2 elements)
+};
+
+/**
+ * Gets the layout of decoded vertices with a vertex state
+ * @param vertex_state Vertex state
+ * @param layout Receives the layout
+ */
+void VertexLoader_GetLayout(const VertexState& vertex_state, VertexLayout* layout);
+
+/**
+ * Expands a decoded vertex to a full GXVertex, components it doesn't have are zeroed
+ * @param vertex_state Vertex state the vertex was decoded with
+ * @param layout Layout of the vertex state
+ * @param data Decoded vertex
+ * @param vertex Receives the expanded vertex
+ */
+void VertexLoader_UnpackVertex(const VertexState& vertex_state, const VertexLayout& layout, 
+    const u8* data, GXVertex* vertex);
+
 /**
  * @brief Decode a primitive type
  * @param type Type of primitive (e.g. points, lines, triangles, etc.)
@@ -55,10 +88,43 @@ struct VertexState {
 void VertexLoader_DecodePrimitive(GXPrimitive type, int count); 
 
 /**
- * @brief Gets the size of the next vertex to be decoded
- * @return Size of the next vertex to be decoded
+ * Decodes the vertices of a primitive with the current vertex format into a buffer, for drawing
+ * them later on with VertexLoader_DrawVertices
+ * @param data Vertex data, as it appears in the command stream
+ * @param count Number of vertices
+ * @param vertices Receives the decoded vertices, VertexLoader_GetDecodedVertexSize bytes each
+ * @return True on success, false if the format has indexed components (those read CP vertex
+ * arrays, which may have changed by the time the vertices are drawn)
+ */
+bool VertexLoader_DecodeVertices(const u8* data, int count, u8* vertices);
+
+/**
+ * Draws a primitive from vertices decoded by VertexLoader_DecodeVertices, the current vertex
+ * format must be the one they were decoded with
+ * @param type Type of primitive (e.g. points, lines, triangles, etc.)
+ * @param count Number of vertices
+ * @param vertices Decoded vertices
+ */
+void VertexLoader_DrawVertices(GXPrimitive type, int count, const u8* vertices);
+
+/**
+ * Gets the size of a vertex in the command stream
+ * @param vat Vertex attribute table the vertex is drawn with
+ * @return Size of the vertex with the current VCD and the VAT
+ */
+int VertexLoader_GetVertexSize(int vat);
+
+/**
+ * Forgets the vertex formats of VATs, must be called whenever the VCD or VAT registers change
+ * @param vat_mask Bit mask of the VATs whose format has changed
+ */
+void VertexLoader_InvalidateFormats(u32 vat_mask);
+
+/**
+ * Gets the size of the next vertex to be decoded once it is decoded
+ * @return Stride of the vertex in the vertex buffer
  */
-int VertexLoader_GetVertexSize();
+int VertexLoader_GetDecodedVertexSize();
 
 /// Initialize the Vertex Loader
 void VertexLoader_Init();
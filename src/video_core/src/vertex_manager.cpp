@@ -29,70 +29,285 @@
 
 namespace gp {
 
-GXVertex*   g_hardware_vbo = NULL;  ///< Pointer to hardware VBO (always GPU mem)
-GXVertex*   g_vbo = NULL;           ///< Pointer to VBO data (can be GPU or sys mem)
-GXVertex    g_quads_vbo[4];         ///< Temporary storage for a quad in the pipeline
-u32         g_vbo_offset = 0;       ///< Offset into VBO of current vertex writes
+/// Index list room for a batch, strips and fans need up to three indices per vertex
+static const int kMaxBatchIndices = 0x30000;
+
+/// Slots of the vertex reuse table, twice the vertices of a batch keeps it at most half full
+static const u32 kReuseSlots = VBO_MAX_BATCH_VERTS * 2;
+
+/// Vertex reuse table entry, only valid if its generation is the current one
+struct ReuseSlot {
+    u32 gen;                        ///< Generation the slot was filled in
+    u32 hash;                       ///< Hash of the vertex data
+    u32 vertex;                     ///< Batch vertex decoded from the data
+};
+
+u8*         g_vbo = NULL;           ///< Pointer to VBO data of the next vertex (in GPU mem)
+u32         g_vbo_stride = 0;       ///< Size of a vertex of the current batch
+u32         g_vbo_offset = 0;       ///< Offset of the current primitive into the batch, in vertices
 u32         g_vertex_num = 0;       ///< Current vertex number
-int         g_convert_quads_to_triangles = 0;
-int g_quad_counter = 0;
+u32         g_vbo_vertex_num = 0;   ///< Vertices the current primitive has added to the VBO
+GXPrimitive g_prim;                 ///< Type of the current primitive
+
+u32*        g_batch_indices = NULL; ///< Index list of the current batch
+int         g_batch_index_num = 0;  ///< Number of indices in the current batch
+GXPrimitive g_batch_prim;           ///< Primitive type the current batch is drawn as
+
+// Vertex reuse. Primitives with indexed components tend to refer to the same vertices over and
+// over (a vertex shared by six triangles of a mesh is sent six times), so their vertices are
+// looked up by their data (the index tuple, mostly) before they are decoded. Only the first copy
+// of a vertex is decoded and uploaded, the others become indices to it.
+bool        g_reuse = false;        ///< True if the current primitive reuses vertices
+u64         g_reuse_context = 0;    ///< Context of the vertices in the reuse table
+u32         g_reuse_gen = 1;        ///< Current generation of the reuse table, 0 is never valid
+u32         g_reuse_pending = 0;    ///< Slot the vertex being decoded goes to
+ReuseSlot*  g_reuse_slots = NULL;   ///< Vertex reuse table, open addressing with linear probing
+u8*         g_reuse_data = NULL;    ///< Vertex data of each batch vertex in the table
+u32*        g_prim_vertices = NULL; ///< Batch vertex of each vertex of the current primitive
+
+/**
+ * Gets the primitive type a primitive is drawn as in a batch, all triangle primitives are
+ * converted to triangle lists and line strips to line lists
+ * @param prim Primitive type (e.g. GX_TRIANGLES)
+ * @return GX_TRIANGLES, GX_LINES or GX_POINTS
+ */
+static inline GXPrimitive VertexManager_GetBatchPrimitive(GXPrimitive prim) {
+    switch (prim) {
+    case GX_LINES:
+    case GX_LINESTRIP:
+        return GX_LINES;
+    case GX_POINTS:
+        return GX_POINTS;
+    default:
+        return GX_TRIANGLES;
+    }
+}
+
+/// Vertices of a primitive that were all added to the batch, one after the other
+struct SequentialVertices {
+    u32 first;                      ///< Batch vertex of the first vertex of the primitive
+
+    inline u32 operator[](u32 i) const {
+        return first + i;
+    }
+};
+
+/// Vertices of a primitive that may refer to vertices decoded for earlier primitives
+struct ReusedVertices {
+    const u32* vertices;            ///< Batch vertex of each vertex of the primitive
+
+    inline u32 operator[](u32 i) const {
+        return vertices[i];
+    }
+};
+
+/**
+ * Generates list indices for a primitive
+ * @param prim Primitive type (e.g. GX_TRIANGLES)
+ * @param v Batch vertex of each vertex of the primitive (SequentialVertices or ReusedVertices)
+ * @param count Number of vertices
+ * @param indices Receives the indices
+ * @return Number of indices written
+ */
+template <typename Vertices>
+static int VertexManager_GenerateIndices(GXPrimitive prim, const Vertices& v, u32 count, 
+    u32* indices) {
+    u32* dst = indices;
+
+    switch (prim) {
+    case GX_QUADS: // Same split as the old quad to triangle conversion: 0-1-2, 2-3-0
+        for (u32 i = 0; i + 3 < count; i += 4) {
+            dst[0] = v[i];
+            dst[1] = v[i + 1];
+            dst[2] = v[i + 2];
+            dst[3] = v[i + 2];
+            dst[4] = v[i + 3];
+            dst[5] = v[i];
+            dst += 6;
+        }
+        break;
+
+    case GX_TRIANGLESTRIP: // Every other triangle is flipped to keep the winding
+        for (u32 i = 0; i + 2 < count; i++) {
+            dst[0] = v[i + (i & 1)];
+            dst[1] = v[i + 1 - (i & 1)];
+            dst[2] = v[i + 2];
+            dst += 3;
+        }
+        break;
+
+    case GX_TRIANGLEFAN:
+        for (u32 i = 1; i + 1 < count; i++) {
+            dst[0] = v[0];
+            dst[1] = v[i];
+            dst[2] = v[i + 1];
+            dst += 3;
+        }
+        break;
+
+    case GX_LINESTRIP:
+        for (u32 i = 0; i + 1 < count; i++) {
+            dst[0] = v[i];
+            dst[1] = v[i + 1];
+            dst += 2;
+        }
+        break;
+
+    case GX_TRIANGLES:
+        count -= count % 3;
+        for (u32 i = 0; i < count; i++) {
+            *dst++ = v[i];
+        }
+        break;
+
+    case GX_LINES:
+        count &= ~1;
+        for (u32 i = 0; i < count; i++) {
+            *dst++ = v[i];
+        }
+        break;
+
+    default:
+        for (u32 i = 0; i < count; i++) {
+            *dst++ = v[i];
+        }
+        break;
+    }
+    return (int)(dst - indices);
+}
+
+/// Hashes vertex data for the reuse table (FNV-1a)
+static inline u32 VertexManager_HashVertex(const u8* data, int size) {
+    u32 hash = 0x811C9DC5;
+    for (int i = 0; i < size; i++) {
+        hash = (hash ^ data[i]) * 0x01000193;
+    }
+    return hash;
+}
 
 void VertexManager_NextVertex() {
-    // Mark the vertex position XF index as "used" to renderer
-    video_core::g_renderer->VertexPosition_UseIndexXF(g_vbo->pm_idx);
-
-    g_quad_counter++;
-
-    // Convert quads to triangles on every 4th vertex
-    if (g_convert_quads_to_triangles && (g_quad_counter == 4)) {
-        g_quad_counter = 0;
-        g_vbo -= 3;
-
-        g_hardware_vbo[0] = g_vbo[0];
-        g_hardware_vbo[1] = g_vbo[1];
-        g_hardware_vbo[2] = g_vbo[2];
-        
-        g_hardware_vbo[3] = g_vbo[2];
-        g_hardware_vbo[4] = g_vbo[3];
-        g_hardware_vbo[5] = g_vbo[0];
-        
-        g_hardware_vbo += 6;
-        g_vbo = g_quads_vbo;
-        g_vertex_num += 3;
-    } else {
-        g_vbo++;
-        g_vertex_num++;
+    if (g_reuse) {
+        u32 vertex = g_vbo_offset + g_vbo_vertex_num;
+        g_reuse_slots[g_reuse_pending].gen = g_reuse_gen;
+        g_reuse_slots[g_reuse_pending].vertex = vertex;
+        g_prim_vertices[g_vertex_num] = vertex;
+    }
+    g_vbo += g_vbo_stride;
+    g_vbo_vertex_num++;
+    g_vertex_num++;
+}
+
+/// Tells the renderer which XF position matrices decoded vertices use
+void VertexManager_UseVertices(const u8* vertices, int count) {
+    // Mark the vertex position XF index as "used" to renderer (pm_idx leads the vertex layout)
+    for (int i = 0; i < count; i++, vertices += g_vbo_stride) {
+        video_core::g_renderer->VertexPosition_UseIndexXF(vertices[0]);
+    }
+}
+
+/// Forgets the vertices decoded so far, for when the CP vertex arrays may have been changed
+void VertexManager_InvalidateVertexCache() {
+    if (++g_reuse_gen == 0) {
+        memset(g_reuse_slots, 0, kReuseSlots * sizeof(ReuseSlot));
+        g_reuse_gen = 1;
+    }
+}
+
+/**
+ * Lets the vertices of the current primitive reuse vertices decoded earlier in the batch
+ * @param context Identifies everything decoded vertices depend on besides their data
+ */
+void VertexManager_EnableReuse(u64 context) {
+    if (context != g_reuse_context) {
+        VertexManager_InvalidateVertexCache();
+        g_reuse_context = context;
+    }
+    g_reuse = true;
+}
+
+/**
+ * Looks for a vertex of the current batch that was decoded from the same vertex data
+ * @param data Vertex data, as it appears in the command stream
+ * @param size Size of the vertex data, at most VBO_MAX_REUSED_VERTEX_SIZE bytes
+ * @return True if the vertex was reused
+ */
+bool VertexManager_ReuseVertex(const u8* data, int size) {
+    const u32 mask = kReuseSlots - 1;
+    u32 hash = VertexManager_HashVertex(data, size);
+    u32 i = hash & mask;
+
+    for (; g_reuse_slots[i].gen == g_reuse_gen; i = (i + 1) & mask) {
+        const ReuseSlot& slot = g_reuse_slots[i];
+        if (slot.hash == hash && 
+            memcmp(&g_reuse_data[slot.vertex * VBO_MAX_REUSED_VERTEX_SIZE], data, size) == 0) {
+            g_prim_vertices[g_vertex_num++] = slot.vertex;
+            return true;
+        }
     }
+    // Not seen yet, the slot is claimed once the vertex has been decoded
+    g_reuse_slots[i].hash = hash;
+    g_reuse_pending = i;
+    memcpy(&g_reuse_data[(g_vbo_offset + g_vbo_vertex_num) * VBO_MAX_REUSED_VERTEX_SIZE], data, 
+        size);
+    return false;
 }
 
 /// Begin a primitive
-void VertexManager_BeginPrimitive(GXPrimitive prim, int count) {
+void VertexManager_BeginPrimitive(GXPrimitive prim, int count, int vertex_stride) {
+    GXPrimitive batch_prim = VertexManager_GetBatchPrimitive(prim);
+
     g_vertex_num = 0;
-    g_quad_counter = 0;
-    
-    BP_LoadTexture();
-    if (GX_QUADS == prim) {
-        prim = GX_TRIANGLES;    // Most hardware doesn't support quads, so convert to triangles
-        count += count >> 1;    // Every 4 verts (quad) will be converted to 6 verts (triangle)
-        g_convert_quads_to_triangles = 1;
-        g_vbo = g_quads_vbo;
-        video_core::g_renderer->BeginPrimitive(prim, count, &g_hardware_vbo, g_vbo_offset);
-    } else {
-        video_core::g_renderer->BeginPrimitive(prim, count, &g_vbo, g_vbo_offset);
+    g_vbo_vertex_num = 0;
+    g_prim = prim;
+    g_reuse = false;
+
+    // Draw what has been batched up so far if this primitive doesn't fit in with it
+    if (g_vbo_offset != 0) {
+        if (batch_prim != g_batch_prim || g_batch_index_num + (count * 3) > kMaxBatchIndices ||
+            g_vbo_offset + count > VBO_MAX_BATCH_VERTS) {
+            VertexManager_Flush();
+        }
     }
+    // Texture state can only have changed since the last primitive if the batch was flushed
+    if (g_vbo_offset == 0) {
+        BP_LoadTexture();
+        g_batch_prim = batch_prim;
+    }
+    g_vbo_stride = vertex_stride;
+    video_core::g_renderer->BeginPrimitive(prim, count, &g_vbo, g_vbo_offset);
 }
 
 /// End a primitive
 void VertexManager_EndPrimitive() {
-    video_core::g_renderer->EndPrimitive(g_vbo_offset, g_vertex_num);
-    g_vbo_offset += g_vertex_num;
-    g_convert_quads_to_triangles = 0;
+    _ASSERT_MSG(TGP, (g_batch_index_num + (int)g_vertex_num * 3 <= kMaxBatchIndices),
+        "Batch index list overflow!");
+
+    if (g_reuse) {
+        ReusedVertices vertices = { g_prim_vertices };
+        g_batch_index_num += VertexManager_GenerateIndices(g_prim, vertices, g_vertex_num, 
+            &g_batch_indices[g_batch_index_num]);
+    } else {
+        SequentialVertices vertices = { g_vbo_offset };
+        g_batch_index_num += VertexManager_GenerateIndices(g_prim, vertices, g_vertex_num, 
+            &g_batch_indices[g_batch_index_num]);
+    }
+    g_vbo_offset += g_vbo_vertex_num;
+    g_reuse = false;
 }
 
-/// Flush the vertex manager
+/// Draw the primitives batched up so far
 void VertexManager_Flush() {
+    if (g_vbo_offset == 0) {
+        return;
+    }
+    video_core::g_renderer->DrawPrimitives(g_batch_prim, g_vbo_offset, g_batch_indices, 
+        g_batch_index_num);
+
     g_vbo_offset = 0;
-    g_vertex_num = 0;
+    g_batch_index_num = 0;
+
+    // Reused vertices are batch vertices
+    VertexManager_InvalidateVertexCache();
 }
 
 /// Initialize the vertex manager
@@ -100,12 +315,30 @@ void VertexManager_Init() {
     g_vbo = NULL;
     g_vbo_offset = 0;
     g_vertex_num = 0;
+    g_batch_indices = new u32[kMaxBatchIndices];
+    g_batch_index_num = 0;
+
+    g_reuse = false;
+    g_reuse_context = 0;
+    g_reuse_gen = 1;
+    g_reuse_slots = new ReuseSlot[kReuseSlots];
+    memset(g_reuse_slots, 0, kReuseSlots * sizeof(ReuseSlot));
+    g_reuse_data = new u8[VBO_MAX_BATCH_VERTS * VBO_MAX_REUSED_VERTEX_SIZE];
+    g_prim_vertices = new u32[VBO_MAX_BATCH_VERTS];
     LOG_NOTICE(TGP, "vertex manager initialized ok");
     return;
 }
 
 /// Shutdown the vertex manager
 void VertexManager_Shutdown() {
+    delete[] g_batch_indices;
+    g_batch_indices = NULL;
+    delete[] g_reuse_slots;
+    g_reuse_slots = NULL;
+    delete[] g_reuse_data;
+    g_reuse_data = NULL;
+    delete[] g_prim_vertices;
+    g_prim_vertices = NULL;
 }
 
 } // namespace
@@ -30,25 +30,65 @@
 #include "gx_types.h"
 
 #define VBO_SIZE                    (1024 * 1024 * 32)
+#define VBO_MAX_BATCH_VERTS         0x10000 ///< Enough for the largest primitive (16-bit count)
+#define VBO_MAX_REUSED_VERTEX_SIZE  32      ///< Largest vertex data looked up for reuse, in bytes
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 // Vertex Manager
 
 namespace gp {
 
-extern GXVertex*   g_vbo;               ///< Pointer to VBO data (when mapped, in GPU mem)
+extern u8*         g_vbo;               ///< Pointer to the next vertex (when mapped, in GPU mem)
 extern u32         g_vertex_num;        ///< Current vertex number
 
 /// Used for specifying next GX vertex is being sent to the renderer
 void VertexManager_NextVertex();
 
-/// Begin a primitive
-void VertexManager_BeginPrimitive(GXPrimitive prim, int count);
+/**
+ * Tells the renderer which XF position matrices decoded vertices use
+ * @param vertices First vertex, in the VBO
+ * @param count Number of vertices
+ */
+void VertexManager_UseVertices(const u8* vertices, int count);
+
+/**
+ * Begin a primitive. Primitives are added to the current batch, which is drawn if the primitive
+ * can't be drawn along with it
+ * @param prim Primitive type (e.g. GX_TRIANGLES)
+ * @param count Number of vertices
+ * @param vertex_stride Size of a decoded vertex in bytes (see VertexLayout)
+ */
+void VertexManager_BeginPrimitive(GXPrimitive prim, int count, int vertex_stride);
+
+/**
+ * Lets the vertices of the current primitive reuse vertices decoded earlier in the batch, each
+ * vertex is then looked up with VertexManager_ReuseVertex before it is decoded
+ * @param context Identifies everything decoded vertices depend on besides their data (vertex
+ * format, CP array bases and strides), vertices decoded in another context aren't reused
+ */
+void VertexManager_EnableReuse(u64 context);
+
+/**
+ * Looks for a vertex of the current batch that was decoded from the same vertex data. If there
+ * is one, it is added to the primitive. Otherwise the vertex has to be added with
+ * VertexManager_NextVertex as usual, it may be decoded to its VBO slot any time before the
+ * primitive ends
+ * @param data Vertex data, as it appears in the command stream
+ * @param size Size of the vertex data, at most VBO_MAX_REUSED_VERTEX_SIZE bytes
+ * @return True if the vertex was reused
+ */
+bool VertexManager_ReuseVertex(const u8* data, int size);
+
+/// Forgets the vertices decoded so far, for when the CP vertex arrays may have been changed
+void VertexManager_InvalidateVertexCache();
 
 /// End a primitive
 void VertexManager_EndPrimitive();
 
-/// Flush the vertex manager
+/**
+ * Draw the primitives batched up so far. Must be called before anything the batch is drawn with
+ * (registers, textures, vertex format) changes
+ */
 void VertexManager_Flush();
 
 /// Initialize the vertex manager
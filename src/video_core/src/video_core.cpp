@@ -32,15 +32,20 @@
 #include "video/emuwindow.h"
 
 #include "renderer_gl3/renderer_gl3.h"
+#include "renderer_null/renderer_null.h"
+#include "renderer_soft/renderer_soft.h"
 
 #include "video_core.h"
 #include "vertex_manager.h"
 #include "vertex_loader.h"
+#include "display_list_cache.h"
 #include "fifo.h"
 #include "fifo_player.h"
 #include "bp_mem.h"
 #include "cp_mem.h"
 #include "xf_mem.h"
+#include "texture_decoder.h"
+#include "dvd/loader.h"
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 // Video Core namespace
@@ -60,7 +65,11 @@ int VideoEntry(void*) {
     }
     g_emu_window->MakeCurrent();
     for(;;) {
-        gp::Fifo_DecodeCommand();
+        // Decode as long as complete commands are available, otherwise sleep until the CPU 
+        // thread publishes more data
+        if (!gp::Fifo_DecodeCommand()) {
+            gp::Fifo_WaitForData();
+        }
     }
     return E_OK;
 }
@@ -70,6 +79,9 @@ void Start() {
     if (g_emu_window == NULL) {
         LOG_ERROR(TGP, "video_core::Start called without calling Init()!");
     }
+    // Compile the game's cached shaders before the first frame, while the context is current
+    g_shader_manager->LoadDiskCache(dvd::g_current_game_id);
+
     if (common::g_config->enable_multicore()) {
         g_emu_window->DoneCurrent();
         g_video_thread = SDL_CreateThread(VideoEntry, NULL, NULL);
@@ -83,16 +95,29 @@ void Start() {
 /// Initialize the video core
 void Init(EmuWindow* emu_window) {
     g_emu_window = emu_window;
-    g_renderer = new RendererGL3();
+
+    switch (common::g_config->current_renderer()) {
+    case common::Config::RENDERER_NULL:
+        g_renderer = new RendererNull();
+        break;
+    case common::Config::RENDERER_SOFTWARE:
+        g_renderer = new RendererSoft();
+        break;
+    default:
+        g_renderer = new RendererGL3();
+        break;
+    }
     g_renderer->SetWindow(g_emu_window);
     g_renderer->Init();
 
     gp::Fifo_Init();
     gp::VertexManager_Init();
     gp::VertexLoader_Init();
+    gp::DisplayListCache_Init();
     gp::BP_Init();
     gp::CP_Init();
     gp::XF_Init();
+    gp::TextureDecoder_Init();
 
     g_shader_manager = new ShaderManager(g_renderer->shader_interface());
     g_texture_manager = new TextureManager(g_renderer->texture_interface());
@@ -107,6 +132,7 @@ void Shutdown() {
     gp::Fifo_Shutdown();
     gp::VertexManager_Shutdown();
     gp::VertexLoader_Shutdown();
+    gp::DisplayListCache_Shutdown();
 
     delete g_renderer;
     delete g_shader_manager;
@@ -33,6 +33,7 @@
 #include "bp_mem.h"
 #include "cp_mem.h"
 #include "xf_mem.h"
+#include "vertex_manager.h"
 
 #define XF_VIEWPORT_ZMAX            16777215.0f
 
@@ -152,11 +153,17 @@ void XF_Load(u32 length, u32 base_addr, u32* data) {
     // Register write
     if (base_addr & 0x1000) {
         u8 addr = (base_addr & 0xff);
+        if (memcmp(&g_xf_regs.mem[addr], data, length << 2)) {
+            VertexManager_Flush();
+        }
         memcpy(&g_xf_regs.mem[addr], data, length << 2);
         XF_RegisterUpdate(length, base_addr);
 
     // Transformation memory
     } else if ((base_addr + length) < 0x800) {
+        if (memcmp(&g_xf_mem[base_addr], data, length << 2)) {
+            VertexManager_Flush();
+        }
         memcpy(&g_xf_mem[base_addr], data, length << 2);
     } else {
         _ASSERT_MSG(TGP, 0, "XF write to %08X outside of address space!", base_addr + length); 
@@ -166,9 +173,15 @@ void XF_Load(u32 length, u32 base_addr, u32* data) {
 
 /// Write data into a XF register indexed-form
 void XF_LoadIndexed(u8 n, u16 index, u8 length, u16 addr) {
-    u32* data = (u32*)&Mem_RAM[CP_IDX_ADDR(index, n) & RAM_MASK];
-    memcpy(&g_xf_mem[addr], data, length << 2);
-    video_core::g_renderer->WriteXF(addr, length, data);
+    u32 src = CP_IDX_ADDR(index, n) & RAM_MASK;
+    for (int i = 0; i < length; i++) {
+        u32 data = MEM_LOAD32(&Mem_RAM[(src + (i << 2)) & RAM_MASK]);
+        if (g_xf_mem[addr + i] != data) {
+            VertexManager_Flush(); // Draw primitives batched up with the old matrices
+            g_xf_mem[addr + i] = data;
+        }
+    }
+    video_core::g_renderer->WriteXF(addr, length, &g_xf_mem[addr]);
 }
 
 /// Initialize XF